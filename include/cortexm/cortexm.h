@@ -30,6 +30,15 @@ int cortexm_set_irq_priority(int irq, int prio, u32 o_events) MCU_ROOT_CODE;
 
 void cortexm_svcall_get_thread_stack_ptr(void * ptr) MCU_ROOT_CODE;
 
+// critical sections that can be nested (restores the previous interrupt state)
+static inline u32 cortexm_root_enter_critical() {
+  const u32 primask = __get_PRIMASK();
+  __disable_irq();
+  return primask;
+}
+
+static inline void cortexm_root_exit_critical(u32 primask) { __set_PRIMASK(primask); }
+
 void cortexm_set_systick_reload(u32 value) MCU_ROOT_CODE;
 void cortexm_start_systick() MCU_ROOT_CODE;
 u32 cortexm_get_systick_value() MCU_ROOT_CODE;
@@ -82,6 +82,15 @@ static inline void task_root_set_current_priority(s8 value) {
 }
 
 void task_root_elevate_current_priority(s8 value) MCU_ROOT_EXEC_CODE;
+s8 task_root_get_ready_priority() MCU_ROOT_EXEC_CODE;
+u8 task_root_get_ready_count(s8 priority) MCU_ROOT_EXEC_CODE;
+int task_root_get_ready_next() MCU_ROOT_EXEC_CODE;
+
+// a task is executing if it is ready at the currently executing priority
+static inline int task_exec_asserted(int id) {
+  return task_ready_asserted(id)
+         && (sos_task_table[id].ready_priority == (u8)m_task_current_priority);
+}
 
 u32 task_reverse_memory_lookup(u32 input);
 
@@ -14,7 +14,7 @@ extern "C" {
 
 //flags 0 to 7 are unused
 #define TASK_FLAGS_USED (1<<0) //task is currently being used
-#define TASK_FLAGS_EXEC (1<<1) //set if task is part of current tasks being executed (highest priority of active tasks)
+#define TASK_FLAGS_READY (1<<1) //Task is linked in the ready list for its priority (used, active and not stopped)
 #define TASK_FLAGS_ACTIVE (1<<2) //Task is currently active (it is not blocked or sleeping)
 #define TASK_FLAGS_THREAD (1<<3) //Task is a thread task rather than a process (first thread)
 #define TASK_FLAGS_FIFO (1<<4) //Task is executed in FIFO rather than Round Robin mode
@@ -24,6 +24,9 @@ extern "C" {
 
 extern volatile task_t sos_task_table[];
 
+// keeps the ready lists in sync with the flags and priority (see task_ready.c)
+void task_root_update_ready(int id);
+
 static inline int task_enabled_active_not_stopped(int id){
     return (sos_task_table[id].flags & (TASK_FLAGS_USED | TASK_FLAGS_ACTIVE | TASK_FLAGS_STOPPED)) == (TASK_FLAGS_ACTIVE | TASK_FLAGS_USED );
 }
@@ -43,17 +46,15 @@ static inline void task_set_reent(int id, struct _reent * reent, struct _reent *
     sos_task_table[id].global_reent = global_reent;
 }
 
-static inline void task_assert_used(int id){ task_assert_flag(id, TASK_FLAGS_USED); }
-static inline void task_deassert_used(int id){ task_deassert_flag(id, TASK_FLAGS_USED); }
+static inline void task_assert_used(int id){ task_assert_flag(id, TASK_FLAGS_USED); task_root_update_ready(id); }
+static inline void task_deassert_used(int id){ task_deassert_flag(id, TASK_FLAGS_USED); task_root_update_ready(id); }
 static inline int task_used_asserted(int id){ return task_flag_asserted(id, TASK_FLAGS_USED); }
 static inline int task_enabled(int id){ return task_flag_asserted(id, TASK_FLAGS_USED); }
 
-static inline void task_assert_exec(int id){ task_assert_flag(id, TASK_FLAGS_EXEC); }
-static inline void task_deassert_exec(int id){ task_deassert_flag(id, TASK_FLAGS_EXEC); }
-static inline int task_exec_asserted(int id){ return task_flag_asserted(id, TASK_FLAGS_EXEC); }
+static inline int task_ready_asserted(int id){ return task_flag_asserted(id, TASK_FLAGS_READY); }
 
-static inline void task_assert_active(int id){ task_assert_flag(id, TASK_FLAGS_ACTIVE); }
-static inline void task_deassert_active(int id){ task_deassert_flag(id, TASK_FLAGS_ACTIVE); }
+static inline void task_assert_active(int id){ task_assert_flag(id, TASK_FLAGS_ACTIVE); task_root_update_ready(id); }
+static inline void task_deassert_active(int id){ task_deassert_flag(id, TASK_FLAGS_ACTIVE); task_root_update_ready(id); }
 static inline int task_active_asserted(int id){ return task_flag_asserted(id, TASK_FLAGS_ACTIVE); }
 
 static inline void task_assert_thread(int id){ task_assert_flag(id, TASK_FLAGS_THREAD); }
@@ -64,8 +65,8 @@ static inline void task_assert_fifo(int id){ task_assert_flag(id, TASK_FLAGS_FIF
 static inline void task_deassert_fifo(int id){ task_deassert_flag(id, TASK_FLAGS_FIFO); }
 static inline int task_fifo_asserted(int id){ return task_flag_asserted(id, TASK_FLAGS_FIFO); }
 
-static inline void task_assert_stopped(int id){ task_assert_flag(id, TASK_FLAGS_STOPPED); }
-static inline void task_deassert_stopped(int id){ task_deassert_flag(id, TASK_FLAGS_STOPPED); }
+static inline void task_assert_stopped(int id){ task_assert_flag(id, TASK_FLAGS_STOPPED); task_root_update_ready(id); }
+static inline void task_deassert_stopped(int id){ task_deassert_flag(id, TASK_FLAGS_STOPPED); task_root_update_ready(id); }
 static inline int task_stopped_asserted(int id){ return task_flag_asserted(id, TASK_FLAGS_STOPPED); }
 
 static inline void task_assert_root(int id){ task_assert_flag(id, TASK_FLAGS_ROOT); }
@@ -78,7 +79,7 @@ static inline int task_yield_asserted(int id){ return task_flag_asserted(id, TAS
 
 static inline void task_set_parent(int id, int parent){ sos_task_table[id].parent = parent; }
 static inline int task_get_parent(int id){ return sos_task_table[id].parent; }
-static inline void task_set_priority(int id, int priority){ sos_task_table[id].priority = priority; }
+static inline void task_set_priority(int id, int priority){ sos_task_table[id].priority = priority; task_root_update_ready(id); }
 static inline s8 task_get_priority(int id){ return sos_task_table[id].priority; }
 
 extern volatile int m_task_current;
@@ -57,6 +57,10 @@ typedef struct MCU_PACK {
   void *global_reent /*! Points to process re-entrancy data */;
   void *reent /*! Points to thread re-entrancy data */;
   int rr_time /*! The amount of time the task used in the round robin */;
+  volatile u8 ready_next /*! Next task in the ready list of the same priority */;
+  volatile u8 ready_prev /*! Previous task in the ready list of the same priority */;
+  volatile u8 ready_priority /*! Priority of the ready list the task is linked in */;
+  u8 resd;
 #if __FPU_USED == 1
   u32 fp[32];
   u32 fpscr;
@@ -6,12 +6,58 @@
 #include "sos/dev/drive.h"
 #include "sos/fs/devfs.h"
 
+/*
+ * drive_device passes everything through to another drive unless the config
+ * provides a cache. The cache holds cache_block_count blocks of
+ * cache_block_size bytes, replaces the least recently used block and keeps
+ * written blocks until they are replaced or flushed (write-back).
+ * I_DRIVE_SETATTR flushes the cache before the attributes are applied (an
+ * attr with no flags only flushes) and I_DRIVE_ISBUSY is 1 while a flush is
+ * in progress. Reading cached block N followed by N+1 reads up to read_ahead
+ * extra blocks in the same transfer.
+ *
+ * The wrapped drive must accept transfers of cache_block_size bytes (and
+ * (read_ahead + 1) * cache_block_size bytes when read_ahead is not zero) that
+ * start on a cache block. drive_sdspi needs a cache_block_size of 512.
+ */
+
+enum drive_device_cache_flags {
+  DRIVE_DEVICE_CACHE_FLAG_VALID = (1 << 0),
+  DRIVE_DEVICE_CACHE_FLAG_DIRTY = (1 << 1)
+};
+
+typedef struct {
+  u32 block; // byte address divided by cache_block_size
+  u32 tick;  // last use
+  u32 o_flags;
+} drive_device_cache_entry_t;
+
+// bytes needed for drive_device_config_t.cache
+#define DRIVE_DEVICE_CACHE_SIZE(block_count, block_size)                                 \
+  ((block_count) * (sizeof(drive_device_cache_entry_t) + (block_size)))
+
 typedef struct {
   u32 flags;
+  u32 tick;
+  u32 addressable_size;
+  u32 block_count; // cache blocks on the wrapped drive
+  u32 next_block;  // a miss on this block reads ahead
+  devfs_async_t op;     // transfer to the wrapped drive
+  devfs_async_t *async; // request being served
+  u32 block;            // position of the request
+  u32 offset;
+  int done;
+  u16 op_entry;
+  u16 op_count;
+  drive_attr_t attr; // applied once the flush completes
 } drive_device_state_t;
 
 typedef struct {
   devfs_device_t device;
+  void *cache; // DRIVE_DEVICE_CACHE_SIZE() bytes or NULL for no cache
+  u32 cache_block_size;
+  u16 cache_block_count;
+  u16 read_ahead;
 } drive_device_config_t;
 
 int drive_device_open(const devfs_handle_t *handle) MCU_ROOT_EXEC_CODE;
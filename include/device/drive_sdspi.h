@@ -13,7 +13,11 @@ typedef struct {
   const char *buf;
   int *nbyte;
   int count;
+  int block;       // block of the request being transferred
+  int block_count; // more than one uses CMD18/CMD25
   int timeout;
+  int result; // reported once the card has been released
+  int result_errno;
   uint8_t cmd[16];
   devfs_async_t op;
   mcu_event_handler_t handler;
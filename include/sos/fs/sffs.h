@@ -77,23 +77,22 @@
  *
  * ### Cache file list location and block
  *
- * Each time the file is read, it looks up the file segment starting
- * at the beginning of the file list. This can take a long time to look
- * up for large files.  The same is true for writing large files.
- *
- * The function to modify is sffs_file_loadsegment(). Add a sffs_list_t data
- * variable to the file handle. When looking for the next segment,
- * always start with the next entry in the list rather than starting over. That
- * can be done using sffs_list_getnext() and passing the current state of the
- * list. Re-init the list if the segment isn't found.
+ * The first read or write of an open file scans the file list once and
+ * keeps a RAM map of segment to block in the file handle (2 bytes per
+ * segment for up to SFFS_SEGMENT_MAP_SIZE segments). sffs_file_loadsegment()
+ * looks segments up in the map and sffs_file_savesegment() updates it.
+ * Segments past the map, or all segments if the map can't be allocated,
+ * are looked up by scanning the list from the beginning.
  *
  * ### Cleanup filesystem in the background
  *
- * The scratch pad needs to run periodically (preferably in the background)
- * rather than running during an operation.
- *
- * Create statistical triggers for cleaning the filesystem. As in
- * once, 90% of blocks are dirty, trigger a cleanup.
+ * If sffs_config_t.gc_reserve is set, sffs_init() starts a low priority
+ * thread that keeps at least that many blocks free. Every gc_interval ms it
+ * calls sffs_gc() until there is nothing left to do. Each call erases at
+ * most one section (the one with the fewest blocks to copy to the scratch
+ * pad). If no section can be erased, it consolidates the serial number list
+ * instead (only when no file is open). Writes only erase inline if the
+ * reserve runs out.
  *
  * ### Add a compile time switch to disable wear leveling
  *
@@ -109,10 +108,10 @@
  *
  * ### Large drives need a lookup table for the block allocator
  *
- * A table (or list) needs to be implemented for large drives
- * to keep track of which blocks are in use. Maybe just take one bit
- * per block and block off a section of the drive so that
- * blocks can be allocated very fast.
+ * sffs_init() builds a RAM map with the state of each block
+ * (4 bits per block) and a summary of each eraseable section. The
+ * allocator uses the map instead of reading block headers. If there isn't
+ * enough memory for the map, the headers are scanned on the device.
  *
  *
  *
@@ -126,10 +125,15 @@ typedef struct {
 	int serialno_killed;
 	int serialno;
 	drive_info_t dattr;
+	void * block_map; //RAM block status map (allocated by sffs_init())
+	void * serialno_index; //RAM index of the serial number list (allocated by sffs_init())
+	volatile u8 is_gc_running; //set while the gc thread runs
 } sffs_state_t;
 
 typedef struct {
 	sysfs_shared_config_t drive;
+	u16 gc_reserve; //free blocks the gc thread keeps erased (0 for no gc thread)
+	u16 gc_interval; //ms between gc passes (0 for the default)
 } sffs_config_t;
 
 
@@ -154,6 +158,7 @@ int sffs_stat(const void * cfg, const char * path, struct stat * stat);
 
 int sffs_unmount(const void * cfg);
 int sffs_ismounted(const void * cfg);
+int sffs_gc(const void * cfg, int reserve); //one gc time slice (returns 1 if there is more to do)
 
 #define SFFS_MOUNT(mount_loc_name, cfgp, permissions_value, owner_value) { \
 	.mount_path = mount_loc_name, \
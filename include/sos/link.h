@@ -41,6 +41,8 @@ extern "C" {
 extern int link_errno;
 
 #include "link/commands.h"
+#include "link/delta.h"
+#include "link/pool.h"
 
 void link_load_default_driver(link_transport_mdriver_t *driver);
 
@@ -90,6 +92,44 @@ int link_unlink(
   const char *path /*! The full path to the file to delete */);
 int link_lseek(link_transport_mdriver_t *driver, int fildes, s32 offset, int whence);
 
+/*
+ * Streams nbyte bytes of an open file with one read or write request. The
+ * data moves in chunks of full packets without waiting for a reply between
+ * them, so nbyte can be as large as the file (reads stop at the end of the
+ * file). link_read_stream() passes each chunk to callback as it arrives;
+ * link_write_stream() asks callback to fill each chunk and ends the stream
+ * early when callback returns less than it asked for. Both return the
+ * number of bytes the device transferred.
+ */
+typedef int (*link_stream_callback_t)(void *context, void *buf, int nbyte);
+int link_read_stream(
+  link_transport_mdriver_t *driver,
+  int fildes,
+  int nbyte,
+  link_stream_callback_t callback,
+  void *context);
+int link_write_stream(
+  link_transport_mdriver_t *driver,
+  int fildes,
+  int nbyte,
+  link_stream_callback_t callback,
+  void *context);
+
+/*
+ * Writes buf to fildes as a delta against old_fildes (both are open on the
+ * device and must be different files). The device sends a hash of each block
+ * of old_fildes; the host sends only the data that is not in those blocks
+ * and the device copies the rest from old_fildes. Devices without delta
+ * commands (or deltas that are not smaller than buf) get a link_write().
+ * Returns nbyte when the device's hash of the new file matches buf.
+ */
+int link_write_delta(
+  link_transport_mdriver_t *driver,
+  int old_fildes,
+  int fildes,
+  const void *buf,
+  int nbyte);
+
 // For files only
 int link_stat(link_transport_mdriver_t *driver, const char *path, struct stat *buf);
 int link_fstat(link_transport_mdriver_t *driver, int fildes, struct stat *buf);
@@ -119,6 +159,65 @@ int link_rename(
   const char *new_path);
 int link_chown(link_transport_mdriver_t *driver, const char *path, int owner, int group);
 int link_chmod(link_transport_mdriver_t *driver, const char *path, int mode);
+
+/*
+ * Batches file and directory operations into one compound command (see
+ * link_compound_t). Each link_compound_add_*() returns the index of the
+ * operation or -1 if the request is full. LINK_COMPOUND_FILDES refers to the
+ * file or directory opened by the last open/opendir in the same request.
+ * link_compound_execute() returns the number of operations the device ran
+ * (it stops early when its results are full). link_compound_get_result() then
+ * returns the result of each operation and copies its data (struct link_stat
+ * for stat and fstat, struct link_dirent for readdir, the bytes for read).
+ */
+typedef struct {
+  u32 o_flags;
+  u16 count;
+  u16 size;
+  u16 result_max; // the most result data the operations can produce
+  u16 result_count;
+  u16 result_size;
+  u8 cmd[LINK_COMPOUND_OP_MAX];
+  u16 result_offset[LINK_COMPOUND_OP_MAX];
+  u8 request[LINK_COMPOUND_REQUEST_MAX];
+  u8 result[LINK_COMPOUND_REPLY_MAX];
+} link_compound_request_t;
+
+void link_compound_init(link_compound_request_t *request, u32 o_flags);
+int link_compound_add_open(
+  link_compound_request_t *request,
+  const char *path,
+  int flags,
+  int mode);
+int link_compound_add_close(link_compound_request_t *request, int fildes);
+int link_compound_add_read(link_compound_request_t *request, int fildes, int nbyte);
+int link_compound_add_write(
+  link_compound_request_t *request,
+  int fildes,
+  const void *buf,
+  int nbyte);
+int link_compound_add_lseek(
+  link_compound_request_t *request,
+  int fildes,
+  s32 offset,
+  int whence);
+int link_compound_add_stat(link_compound_request_t *request, const char *path);
+int link_compound_add_fstat(link_compound_request_t *request, int fildes);
+int link_compound_add_unlink(link_compound_request_t *request, const char *path);
+int link_compound_add_mkdir(link_compound_request_t *request, const char *path, int mode);
+int link_compound_add_rmdir(link_compound_request_t *request, const char *path);
+int link_compound_add_opendir(link_compound_request_t *request, const char *path);
+int link_compound_add_readdir(link_compound_request_t *request, int dirp);
+int link_compound_add_closedir(link_compound_request_t *request, int dirp);
+int link_compound_execute(
+  link_transport_mdriver_t *driver,
+  link_compound_request_t *request);
+int link_compound_get_result(
+  const link_compound_request_t *request,
+  int index,
+  void *data,
+  int nbyte);
+
 int link_settime(link_transport_mdriver_t *driver, struct link_tm *t);
 int link_gettime(link_transport_mdriver_t *driver, struct link_tm *t);
 
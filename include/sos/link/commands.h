@@ -186,6 +186,53 @@ typedef struct MCU_PACK {
   link_trace_id_t trace_id;
 } link_posix_trace_shutdown_t;
 
+/*
+ * A compound command runs a batch of operations in one request. The host sends
+ * link_compound_t, waits for a link_reply_t (err is 0 if the device accepts the
+ * batch), then sends the request: for each operation, a link_op_t followed by
+ * its path (path_size bytes) or write data (nbyte bytes).
+ *
+ * The device replies with a link_reply_t (err is the number of operations
+ * executed, err_number is the size of the results) and then the results: for
+ * each operation, a link_reply_t followed by a struct link_stat (stat and
+ * fstat), d_ino and the null terminated d_name (readdir) or the data (read).
+ */
+typedef struct MCU_PACK {
+  link_cmd_t cmd;
+  u32 count;
+  u32 size;
+  u32 o_flags;
+} link_compound_t;
+
+enum link_compound_flags {
+  LINK_COMPOUND_FLAG_IS_STOP_ON_ERROR = (1 << 0)
+};
+
+#define LINK_COMPOUND_REQUEST_MAX 1024
+#define LINK_COMPOUND_REPLY_MAX 4096
+#define LINK_COMPOUND_OP_MAX 64
+// use the file or directory opened by the last open/opendir in the request
+#define LINK_COMPOUND_FILDES (-126)
+
+/*
+ * Delta commands update a file by sending only what changed (see
+ * sos/link/delta.h for the format). LINK_CMD_DELTA_SIGNATURE hashes each
+ * full block_size block of fildes: the device replies with a link_reply_t
+ * (err is the number of blocks) followed by a link_delta_signature_t for
+ * each block. LINK_CMD_DELTA_APPLY builds new_fildes from fildes and nbyte
+ * bytes of delta records: the device accepts with a link_reply_t (err is 0;
+ * older devices reply with EINVAL), the host sends the records and the
+ * device replies with the number of bytes written (err) followed, when err
+ * isn't negative, by the LINK_DELTA_DIGEST_SIZE byte SHA-256 of the new file.
+ */
+typedef struct MCU_PACK {
+  link_cmd_t cmd;
+  s32 fildes;
+  s32 new_fildes;
+  u32 block_size;
+  u32 nbyte;
+} link_delta_t;
+
 /*! \brief The USB Link Operation Data Structure (Interrupt Out)
  * \details This data structure defines the data unions
  */
@@ -218,6 +265,8 @@ typedef union {
   link_chown_t chown;
   link_chmod_t chmod;
   link_mkfs_t mkfs;
+  link_compound_t compound;
+  link_delta_t delta;
 } link_op_t;
 
 typedef struct MCU_PACK {
@@ -249,10 +298,25 @@ enum {
   LINK_CMD_CHMOD,
   LINK_CMD_EXEC,
   LINK_CMD_MKFS,
+  LINK_CMD_COMPOUND,
+  LINK_CMD_DELTA_SIGNATURE,
+  LINK_CMD_DELTA_APPLY,
   LINK_CMD_TOTAL
 };
 
-#define LINK_BOOTLOADER_CMD_TOTAL LINK_CMD_WRITE
+/*
+ * The bootloader accepts LINK_CMD_WRITE to stream an image to flash. The host
+ * sends link_write_t with the flash address and the size, waits for a
+ * link_reply_t (err is 0 if the bootloader accepts the stream; older
+ * bootloaders reply with EINVAL and a range below the program start address or
+ * past the end of the address space gets EFAULT) then writes all the data. Each
+ * packet is acknowledged before its page is programmed, so the host is at most
+ * one packet ahead of the flash. If a page fails to program, the next packet is
+ * nacked. The final link_reply_t has the number of bytes written in err (or the
+ * error) and the CRC-16 (link_transport_crc16()) of the data that was received
+ * in err_number.
+ */
+#define LINK_BOOTLOADER_CMD_TOTAL (LINK_CMD_WRITE + 1)
 #define LINK_BOOTLOADER_FILDES (-125)
 
 #endif /* SOS_LINK_COMMANDS_H_ */
@@ -0,0 +1,87 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SOS_LINK_DELTA_H_
+#define SOS_LINK_DELTA_H_
+
+/*
+ * A delta rebuilds a new file from an old one, rsync style. The old file is
+ * described by a signature: a weak (rolling) hash and a strong hash (the
+ * first LINK_DELTA_STRONG_SIZE bytes of the SHA-256) of each full block. The
+ * delta is a list of records: a record with offset LINK_DELTA_LITERAL is
+ * followed by nbyte bytes of new data, any other record copies nbyte bytes of
+ * the old file starting at offset. The rebuilt file is checked with its full
+ * SHA-256 digest.
+ */
+#define LINK_DELTA_LITERAL 0xffffffff
+#define LINK_DELTA_STRONG_SIZE 8
+#define LINK_DELTA_DIGEST_SIZE 32
+#define LINK_DELTA_BLOCK_SIZE_MIN 64
+#define LINK_DELTA_BLOCK_SIZE_MAX 4096
+#define LINK_DELTA_DEFAULT_BLOCK_SIZE 256
+
+typedef struct MCU_PACK {
+  u32 weak;
+  u8 strong[LINK_DELTA_STRONG_SIZE];
+} link_delta_signature_t;
+
+typedef struct MCU_PACK {
+  u32 offset;
+  u32 nbyte;
+} link_delta_record_t;
+
+// SHA-256 -- both ends need it and the kernel's crypto API may not be there
+typedef struct {
+  u32 state[8];
+  u32 size;
+  u8 block[64];
+} link_delta_digest_t;
+
+typedef int (*link_delta_read_t)(void *context, u32 offset, void *buf, int nbyte);
+typedef int (*link_delta_write_t)(void *context, const void *buf, int nbyte);
+
+// state of a delta that is applied as its bytes arrive
+typedef struct {
+  link_delta_read_t read_old;
+  link_delta_write_t write_new;
+  void *context;
+  u8 *buffer; // used to copy from the old file
+  u32 buffer_size;
+  link_delta_record_t record;
+  u32 record_bytes;
+  u32 remaining;
+  u32 size;
+  link_delta_digest_t digest;
+} link_delta_apply_t;
+
+u32 link_delta_weak(const void *buf, int nbyte);
+u32 link_delta_roll(u32 weak, u8 out, u8 in, int block_size);
+void link_delta_strong(const void *buf, int nbyte, u8 strong[LINK_DELTA_STRONG_SIZE]);
+
+void link_delta_digest_start(link_delta_digest_t *digest);
+void link_delta_digest_update(link_delta_digest_t *digest, const void *buf, int nbyte);
+void link_delta_digest_finish(
+  link_delta_digest_t *digest,
+  u8 result[LINK_DELTA_DIGEST_SIZE]);
+
+void link_delta_apply_init(
+  link_delta_apply_t *state,
+  link_delta_read_t read_old,
+  link_delta_write_t write_new,
+  void *context,
+  void *buffer,
+  u32 buffer_size);
+int link_delta_apply(link_delta_apply_t *state, const void *buf, int nbyte);
+int link_delta_apply_is_complete(const link_delta_apply_t *state);
+
+// host only: delta against a signature (returns the size or -1 if it won't fit)
+int link_delta_size_max(int nbyte, int block_size);
+int link_delta_create(
+  const link_delta_signature_t *signature,
+  int count,
+  int block_size,
+  const void *buf,
+  int nbyte,
+  void *delta,
+  int capacity);
+
+#endif // SOS_LINK_DELTA_H_
@@ -0,0 +1,55 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SOS_LINK_POOL_H_
+#define SOS_LINK_POOL_H_
+
+/*
+ * A pool remembers which device (serial number) is at which path and which
+ * transport version it runs, and keeps sessions open after
+ * link_pool_disconnect(). link_pool_connect() hands back an idle session
+ * without any traffic; a known device is opened at its last path and only
+ * its serial number is checked (no enumeration, no protocol resolution).
+ * Other devices are found by scanning like link_connect(), and the scan
+ * caches every device it reads. Pools are for the host only and are not
+ * thread safe.
+ */
+#define LINK_POOL_DEVICE_MAX 64
+#define LINK_POOL_SESSION_MAX 16
+#define LINK_POOL_SERIALNO_MAX 64
+#define LINK_POOL_DEFAULT_IDLE_TIMEOUT 60000 // ms an idle session stays open
+
+typedef struct {
+  char dev_name[64];
+  char serialno[LINK_POOL_SERIALNO_MAX];
+  u32 transport_version;
+} link_pool_device_t;
+
+typedef struct {
+  link_transport_mdriver_t driver; // phy handle stays open while idle
+  char serialno[LINK_POOL_SERIALNO_MAX];
+  u64 timestamp; // link_transport_gettime() when the session was parked
+} link_pool_session_t;
+
+typedef struct {
+  u32 session_count; // connects served by an idle session
+  u32 cache_count;   // connects served by the device cache
+  u32 scan_count;    // connects that scanned for the device
+} link_pool_stats_t;
+
+typedef struct {
+  link_pool_device_t device[LINK_POOL_DEVICE_MAX];
+  link_pool_session_t session[LINK_POOL_SESSION_MAX];
+  u32 idle_timeout; // ms
+  link_pool_stats_t stats;
+} link_pool_t;
+
+void link_pool_init(link_pool_t *pool);
+void link_pool_exit(link_pool_t *pool);
+int link_pool_connect(
+  link_pool_t *pool,
+  link_transport_mdriver_t *driver,
+  const char *sn);
+int link_pool_disconnect(link_pool_t *pool, link_transport_mdriver_t *driver);
+void link_pool_invalidate(link_pool_t *pool, const char *sn);
+
+#endif // SOS_LINK_POOL_H_
@@ -22,6 +22,7 @@
 #define LINK2_PACKET_DATA_SIZE (LINK2_MAX_PACKET_SIZE - LINK2_PACKET_HEADER_SIZE)
 #define LINK2_PACKET_ACK (0x07)
 #define LINK2_PACKET_NACK (0x54)
+#define LINK2_PACKET_RESEND (0x0A) // the packet failed the crc -- send it again
 
 #define LINK3_PACKET_START (18)
 #define LINK3_PACKET_HEADER_SIZE (6) // start, size, and checksum (2 bytes)
@@ -31,9 +32,36 @@
 
 #define LINK3_PACKET_ACK (0x08)
 #define LINK3_PACKET_NACK (0x55)
-
-enum link2_flags { LINK2_FLAG_IS_CHECKSUM = (1 << 0) };
-enum link3_flags { LINK3_FLAG_IS_CHECKSUM = (1 << 0) };
+#define LINK3_PACKET_RESEND (0x0B) // the packet failed the crc -- send it again
+
+// link4 is link2 with sequence numbers so the master can have a window of packets in flight
+#define LINK4_PACKET_START (19)
+#define LINK4_PACKET_HEADER_SIZE (8) // start, flags, size, sequence, reserved and checksum
+#define LINK4_PACKET_DATA_SIZE (LINK2_PACKET_DATA_SIZE)
+#define LINK4_PACKET_ACK (0x09)
+#define LINK4_PACKET_NACK (0x56)
+#define LINK4_WINDOW_MAX (8)
+#define LINK4_DEFAULT_WINDOW (4)
+#define LINK4_PROBE_TIMEOUT (50) // ms -- a link4 slave answers the probe as it reads it
+
+// packets with the IS_CRC flag carry a CRC-16/CCITT (little endian) in the checksum bytes
+#define LINK_TRANSPORT_CRC16_SEED (0xffff)
+#define LINK_TRANSPORT_CRC16_POLYNOMIAL (0x1021)
+#define LINK_TRANSPORT_RESEND_MAX (4)
+
+enum link2_flags {
+  LINK2_FLAG_IS_CHECKSUM = (1 << 0),
+  LINK2_FLAG_IS_CRC = (1 << 2) // crc in place of the checksum
+};
+enum link3_flags {
+  LINK3_FLAG_IS_CHECKSUM = (1 << 0),
+  LINK3_FLAG_IS_CRC = (1 << 2)
+};
+enum link4_flags {
+  LINK4_FLAG_IS_CHECKSUM = (1 << 0),
+  LINK4_FLAG_IS_PROBE = (1 << 1), // master is checking for link4 support
+  LINK4_FLAG_IS_CRC = (1 << 2)
+};
 
 typedef struct MCU_PACK {
   u8 ack;
@@ -53,6 +81,22 @@ typedef struct MCU_PACK {
   u8 data[LINK2_PACKET_DATA_SIZE + 2]; // 2 checksum bytes
 } link2_pkt_t;
 
+typedef struct MCU_PACK {
+  u8 start;
+  u8 o_flags;
+  u16 size;
+  u8 sequence;
+  u8 resd;
+  u8 data[LINK4_PACKET_DATA_SIZE + 2]; // 2 checksum bytes
+} link4_pkt_t;
+
+typedef struct MCU_PACK {
+  u8 ack;
+  u8 sequence; // next sequence number expected (all packets before it were received)
+  u8 selective; // bit n is set if packet sequence + 1 + n was received
+  u8 checksum;
+} link4_ack_t;
+
 #define LINK3_STATE_OPEN 0
 #define LINK3_STATE_MASTER_INFO 1
 #define LINK3_STATE_DEVICE_INFO 2
@@ -148,6 +192,9 @@ typedef struct link_transport_driver {
   u8 shared_secret[32];
   link_transport_crypto_handle_t crypto_handle;
   const link_transport_crypto_driver_t * crypto_driver;
+  // new members go last so the offsets above don't change
+  u8 window; // link4 packets in flight (0 for LINK4_DEFAULT_WINDOW)
+  u8 sequence; // link4 sequence number of the next packet
 } link_transport_driver_t;
 
 typedef struct {
@@ -206,6 +253,7 @@ int link_transport_masterwrite(
   const void *buf,
   int nbyte);
 int link_transport_masterread(link_transport_mdriver_t *driver, void *buf, int nbyte);
+int link_transport_masterpacketsize(link_transport_mdriver_t *driver);
 
 int link_transport_slavewrite(
   link_transport_driver_t *driver,
@@ -241,6 +289,8 @@ int link1_transport_slaveread(
   int (*callback)(void *, void *, int),
   void *context);
 
+u16 link_transport_crc16(u16 crc, const void *buf, int nbyte);
+
 void link1_transport_insert_checksum(link_pkt_t *pkt);
 bool link1_transport_checksum_isok(link_pkt_t *pkt);
 int link1_transport_wait_packet(
@@ -312,6 +362,31 @@ int link3_transport_wait_start(
 
 int link3_start_secure_session(link_transport_mdriver_t *driver);
 
+int link4_transport_masterprobe(link_transport_mdriver_t *driver);
+int link4_transport_masterwrite(
+  link_transport_mdriver_t *driver,
+  const void *buf,
+  int nbyte);
+int link4_transport_slavewrite(
+  link_transport_driver_t *driver,
+  const void *buf,
+  int nbyte,
+  int (*callback)(void *, void *, int),
+  void *context);
+int link4_transport_slaveread(
+  link_transport_driver_t *driver,
+  void *buf,
+  int nbyte,
+  int (*callback)(void *, void *, int),
+  void *context);
+void link4_transport_insert_checksum(link4_pkt_t *pkt);
+bool link4_transport_checksum_isok(link4_pkt_t *pkt);
+void link4_transport_insert_ack_checksum(link4_ack_t *ack);
+int link4_transport_wait_packet(
+  link_transport_driver_t *driver,
+  link4_pkt_t *pkt,
+  int timeout);
+
 #if defined __cplusplus
 }
 #endif
@@ -0,0 +1,63 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SOS_POOL_H
+#define SOS_POOL_H
+
+#include <sdk/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct _reent;
+
+/*
+ * A pool hands out objects of one size from a free list. When the
+ * pool runs out, it adds grow_count objects in one allocation from the
+ * heap of reent (NULL is the system heap). The objects are not given back
+ * to the heap. A pool with a grow_count of zero only uses memory added with
+ * sos_pool_add().
+ *
+ * sos_pool_alloc() and sos_pool_free() can be called from threads and
+ * from root code. Root code (interrupts) never grows the pool. Each piece
+ * of memory the pool is given (a region) starts with a header and a bitmap
+ * of the objects in use, so sos_pool_free() rejects (EINVAL) a pointer that
+ * isn't the start of an object in one of the regions or an object that is
+ * already free. Both calls find the region of an object in a list with one
+ * entry per sos_pool_add() or grow. Thread callers must also own the pool
+ * and the object memory (EPERM).
+ */
+typedef struct {
+  void *free; // free objects are linked through their first word
+  struct _reent *reent;
+  u16 object_size;
+  u16 grow_count;
+  u16 total;
+  u16 used;
+  void *region; // memory given to the pool
+} sos_pool_t;
+
+#define SOS_POOL_OBJECT_SIZE(size_value)                                                 \
+  ((((size_value) < sizeof(void *)) ? sizeof(void *) : (size_value) + 3) & ~3)
+
+#define SOS_POOL_INITIALIZER(object_size_value, grow_count_value)                        \
+  {                                                                                      \
+    .free = NULL, .reent = NULL,                                                         \
+    .object_size = SOS_POOL_OBJECT_SIZE(object_size_value),                              \
+    .grow_count = grow_count_value, .total = 0, .used = 0, .region = NULL                \
+  }
+
+void sos_pool_init(
+  sos_pool_t *pool,
+  u32 object_size,
+  u32 grow_count,
+  struct _reent *reent);
+int sos_pool_add(sos_pool_t *pool, void *memory, u32 size);
+void *sos_pool_alloc(sos_pool_t *pool);
+int sos_pool_free(sos_pool_t *pool, void *object);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SOS_POOL_H
@@ -10,6 +10,7 @@
 
 #include "arpa/inet.h"
 #include "sos/fs.h"
+#include "sos/pool.h"
 #include "sos/power.h"
 #include "sos/process.h"
 #include "sos/sos.h"
@@ -212,7 +213,8 @@ u32 const symbols_table[] = {
   (u32)__aeabi_unwind_cpp_pr1, (u32)__cxa_atexit, (u32)getuid, (u32)setuid, (u32)geteuid,
   (u32)seteuid, (u32)sos_trace_stack, (u32)__assert_func, (u32)setenv, (u32)pthread_exit,
   (u32)pthread_testcancel, (u32)pthread_setcancelstate, (u32)pthread_setcanceltype,
-  (u32)__aeabi_atexit, (u32)settimeofday, (u32)getppid, (u32)pthread_mutex_timedlock, 1};
+  (u32)__aeabi_atexit, (u32)settimeofday, (u32)getppid, (u32)pthread_mutex_timedlock,
+  (u32)sos_pool_init, (u32)sos_pool_add, (u32)sos_pool_alloc, (u32)sos_pool_free, 1};
 
 u32 symbols_total();
 
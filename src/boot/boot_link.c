@@ -47,6 +47,22 @@ static u8 first_page[256];
 
 static u32 hash_size = 0;
 
+static boot_event_flash_t event_args;
+
+// a write stream packet can end part way into the next page so there are two page
+// buffers. The flash is programmed synchronously between packets: the host can
+// only send one packet ahead while a page is programmed.
+typedef struct {
+  bootloader_writepage_t page[2];
+  u32 addr;
+  int current;
+  int is_full[2];
+  int err;
+  u16 crc;
+} write_stream_t;
+
+static write_stream_t write_stream;
+
 #if CONFIG_BOOT_IS_VERIFY_SIGNATURE
 static u8 ecc_context_buffer[256];
 static void *ecc_context = ecc_context_buffer;
@@ -58,6 +74,9 @@ const devfs_handle_t flash_dev = {.port = 0};
 
 static int read_flash(link_transport_driver_t *driver, int loc, int nbyte);
 static int read_flash_callback(void *context, void *buf, int nbyte);
+static int write_page(bootloader_writepage_t *wattr);
+static int write_stream_callback(void *context, void *buf, int nbyte);
+static int write_stream_pages(write_stream_t *stream);
 
 typedef struct {
   int err;
@@ -71,6 +90,8 @@ static void
 boot_link_cmd_readserialno(link_transport_driver_t *driver, link_data_t *args);
 static void boot_link_cmd_ioctl(link_transport_driver_t *driver, link_data_t *args);
 static void boot_link_cmd_read(link_transport_driver_t *driver, link_data_t *args);
+static void boot_link_cmd_write(link_transport_driver_t *driver, link_data_t *args);
+static bool is_write_stream_range_ok(u32 addr, int nbyte);
 
 static void
 boot_link_cmd_reset_bootloader(link_transport_driver_t *driver, link_data_t *args);
@@ -85,7 +106,7 @@ void (*const boot_link_cmd_func_table[LINK_BOOTLOADER_CMD_TOTAL])(
   link_transport_driver_t *,
   link_data_t *) = {
   boot_link_cmd_none, boot_link_cmd_readserialno, boot_link_cmd_ioctl,
-  boot_link_cmd_read};
+  boot_link_cmd_read, boot_link_cmd_write};
 
 void *boot_link_update(void *arg) {
 
@@ -183,7 +204,6 @@ void boot_link_cmd_ioctl(link_transport_driver_t *driver, link_data_t *args) {
   const int size = _IOCTL_SIZE(args->op.ioctl.request);
   bootloader_attr_t attr;
   bootloader_writepage_t wattr;
-  static boot_event_flash_t event_args;
 
 #if CONFIG_BOOT_IS_VERIFY_SIGNATURE
   const crypt_ecc_api_t *ecc_api =
@@ -265,61 +285,7 @@ void boot_link_cmd_ioctl(link_transport_driver_t *driver, link_data_t *args) {
       break;
     }
 
-    dstr("w:");
-    dhex(wattr.addr);
-    dstr(":");
-    dint(wattr.nbyte);
-    dstr("\n");
-
-    if (wattr.addr == sos_config.boot.program_start_address) {
-
-      if (wattr.nbyte < sizeof(first_page)) {
-        dstr("first page too small\n");
-        // this is an error
-        args->reply.err = -1;
-        args->reply.err_number = EINVAL;
-        return;
-      }
-
-#if CONFIG_BOOT_IS_VERIFY_SIGNATURE
-      ecc_api = sos_config.sys.kernel_request_api(CRYPT_ECC_ROOT_API_REQUEST);
-      sha_api = sos_config.sys.kernel_request_api(CRYPT_SHA256_ROOT_API_REQUEST);
-
-      ecc_api->init(&ecc_context);
-      sha_api->init(&sha_context);
-
-      sha_api->start(sha_context);
-      sha_api->update(sha_context, wattr.buf, wattr.nbyte);
-      hash_size = wattr.nbyte;
-#endif
-
-      memcpy(first_page, wattr.buf, sizeof(first_page));
-      wattr.addr += sizeof(first_page);
-      wattr.nbyte = wattr.nbyte - sizeof(first_page);
-      memcpy(wattr.buf, wattr.buf + sizeof(first_page), wattr.nbyte);
-
-      args->reply.err =
-        sos_config.boot.flash_write_page(&sos_config.boot.flash_handle, &wattr);
-
-    } else {
-#if CONFIG_BOOT_IS_VERIFY_SIGNATURE
-      sha_api->update(sha_context, wattr.buf, wattr.nbyte);
-      hash_size += wattr.nbyte;
-#endif
-
-      args->reply.err =
-        sos_config.boot.flash_write_page(&sos_config.boot.flash_handle, &wattr);
-
-      if (args->reply.err < 0) {
-        dstr("Failed to write flash:");
-        dhex(args->reply.err);
-        dstr("\n");
-      }
-    }
-
-    event_args.increment = wattr.nbyte;
-    event_args.bytes += event_args.increment;
-    sos_handle_event(SOS_EVENT_BOOT_WRITE_FLASH, &event_args);
+    args->reply.err = write_page(&wattr);
     break;
 
   case I_BOOTLOADER_GET_PUBLIC_KEY: {
@@ -335,13 +301,14 @@ void boot_link_cmd_ioctl(link_transport_driver_t *driver, link_data_t *args) {
   }
 
   case I_BOOTLOADER_VERIFY_SIGNATURE: {
-#if CONFIG_BOOT_IS_VERIFY_SIGNATURE
+    // the host sends the signature even if it isn't checked
     auth_signature_t signature;
     err = link_transport_slaveread(driver, signature.data, size, NULL, NULL);
     if (err < 0) {
       dstr("failed to receive signature\n");
       return;
     }
+#if CONFIG_BOOT_IS_VERIFY_SIGNATURE
     u8 hash[32];
     sha_api->finish(sha_context, hash, sizeof(hash));
     dstr("hash:"); dint(hash_size); dstr(":");
@@ -405,10 +372,202 @@ void boot_link_cmd_read(link_transport_driver_t *driver, link_data_t *args) {
 }
 
 void boot_link_cmd_write(link_transport_driver_t *driver, link_data_t *args) {
-  MCU_UNUSED_ARGUMENT(driver);
-  MCU_UNUSED_ARGUMENT(args);
-  args->reply.err = -1;
-  return;
+  write_stream_t *stream = &write_stream;
+  const int nbyte = args->op.write.nbyte;
+  int bytes = 0;
+
+  if (is_write_stream_range_ok(args->op.write.addr, nbyte) == false) {
+    // not EINVAL -- the host takes that to mean streams aren't supported
+    dstr("bad stream range\n");
+    args->reply.err = -1;
+    args->reply.err_number = EFAULT;
+    return;
+  }
+
+  // accept the stream -- the host sends the data without waiting for each page
+  if (
+    link_transport_slavewrite(driver, &args->reply, sizeof(args->reply), NULL, NULL)
+    < 0) {
+    args->op.cmd = 0;
+    return;
+  }
+
+  dstr("ws:");
+  dhex(args->op.write.addr);
+  dstr(":");
+  dint(nbyte);
+  dstr("\n");
+
+  stream->addr = args->op.write.addr;
+  stream->current = 0;
+  stream->is_full[0] = 0;
+  stream->is_full[1] = 0;
+  stream->page[0].nbyte = 0;
+  stream->err = 0;
+  stream->crc = LINK_TRANSPORT_CRC16_SEED;
+
+  while (bytes < nbyte) {
+    // each packet is acked before its page is programmed
+    const int result =
+      link_transport_slaveread(driver, NULL, 1, write_stream_callback, stream);
+    if (result <= 0) {
+      dstr("failed to read stream\n");
+      if (stream->err == 0) {
+        stream->err = -1;
+        errno = EIO;
+      }
+      break;
+    }
+    bytes += result;
+
+    // the packet is acked -- the host sends the next one while this page is
+    // programmed. If the page fails, the next packet is nacked so the host stops
+    // and reads the reply.
+    write_stream_pages(stream);
+  }
+
+  if ((stream->err == 0) && (stream->page[stream->current].nbyte > 0)) {
+    // the last page is not full
+    stream->is_full[stream->current] = 1;
+    write_stream_pages(stream);
+  }
+
+  if (stream->err < 0) {
+    args->reply.err = stream->err;
+    args->reply.err_number = errno;
+  } else {
+    // the host checks the crc of the data instead of a reply for each page
+    args->reply.err = bytes;
+    args->reply.err_number = stream->crc;
+  }
+}
+
+bool is_write_stream_range_ok(u32 addr, int nbyte) {
+  // the stream can't touch the bootloader or wrap past the end of the address space
+  return (nbyte > 0) && (addr >= sos_config.boot.program_start_address)
+         && (addr + (u32)nbyte > addr);
+}
+
+int write_page(bootloader_writepage_t *wattr) {
+  int result;
+#if CONFIG_BOOT_IS_VERIFY_SIGNATURE
+  const crypt_hash_api_t *sha_api =
+    sos_config.sys.kernel_request_api(CRYPT_SHA256_ROOT_API_REQUEST);
+#endif
+
+  dstr("w:");
+  dhex(wattr->addr);
+  dstr(":");
+  dint(wattr->nbyte);
+  dstr("\n");
+
+  if (wattr->addr == sos_config.boot.program_start_address) {
+
+    if (wattr->nbyte < sizeof(first_page)) {
+      dstr("first page too small\n");
+      errno = EINVAL;
+      return -1;
+    }
+
+#if CONFIG_BOOT_IS_VERIFY_SIGNATURE
+    const crypt_ecc_api_t *ecc_api =
+      sos_config.sys.kernel_request_api(CRYPT_ECC_ROOT_API_REQUEST);
+
+    ecc_api->init(&ecc_context);
+    sha_api->init(&sha_context);
+
+    sha_api->start(sha_context);
+    sha_api->update(sha_context, wattr->buf, wattr->nbyte);
+    hash_size = wattr->nbyte;
+#endif
+
+    // the first page is written after the signature is verified
+    memcpy(first_page, wattr->buf, sizeof(first_page));
+    wattr->addr += sizeof(first_page);
+    wattr->nbyte = wattr->nbyte - sizeof(first_page);
+    memmove(wattr->buf, wattr->buf + sizeof(first_page), wattr->nbyte);
+
+    result = sos_config.boot.flash_write_page(&sos_config.boot.flash_handle, wattr);
+
+  } else {
+#if CONFIG_BOOT_IS_VERIFY_SIGNATURE
+    sha_api->update(sha_context, wattr->buf, wattr->nbyte);
+    hash_size += wattr->nbyte;
+#endif
+
+    result = sos_config.boot.flash_write_page(&sos_config.boot.flash_handle, wattr);
+
+    if (result < 0) {
+      dstr("Failed to write flash:");
+      dhex(result);
+      dstr("\n");
+    }
+  }
+
+  event_args.increment = wattr->nbyte;
+  event_args.bytes += event_args.increment;
+  sos_handle_event(SOS_EVENT_BOOT_WRITE_FLASH, &event_args);
+  return result;
+}
+
+int write_stream_callback(void *context, void *buf, int nbyte) {
+  write_stream_t *stream = context;
+  const u8 *p = buf;
+  int bytes = 0;
+
+  if (stream->err < 0) {
+    // nack the packet so the host stops sending
+    return stream->err;
+  }
+
+  stream->crc = link_transport_crc16(stream->crc, buf, nbyte);
+
+  while (bytes < nbyte) {
+    bootloader_writepage_t *page = stream->page + stream->current;
+    if (stream->is_full[stream->current]) {
+      // both pages are waiting to be programmed
+      stream->err = -1;
+      errno = ENOSPC;
+      return -1;
+    }
+
+    if (page->nbyte == 0) {
+      page->addr = stream->addr;
+      memset(page->buf, 0xff, BOOTLOADER_WRITEPAGESIZE);
+    }
+
+    int size = BOOTLOADER_WRITEPAGESIZE - page->nbyte;
+    if (size > nbyte - bytes) {
+      size = nbyte - bytes;
+    }
+    memcpy(page->buf + page->nbyte, p + bytes, size);
+    page->nbyte += size;
+    stream->addr += size;
+    bytes += size;
+
+    if (page->nbyte == BOOTLOADER_WRITEPAGESIZE) {
+      stream->is_full[stream->current] = 1;
+      stream->current ^= 1;
+      stream->page[stream->current].nbyte = 0;
+    }
+  }
+
+  return nbyte;
+}
+
+int write_stream_pages(write_stream_t *stream) {
+  // the page after the current one is the older of the two
+  for (int i = 1; i >= 0; i--) {
+    const int index = stream->current ^ i;
+    if (stream->is_full[index] && (stream->err == 0)) {
+      const int result = write_page(stream->page + index);
+      if (result < 0) {
+        stream->err = result;
+      }
+      stream->is_full[index] = 0;
+    }
+  }
+  return stream->err;
 }
 
 void erase_flash(link_transport_driver_t *driver) {
@@ -86,6 +86,11 @@
 #define CONFIG_MALLOC_SBRK_JUMP_SIZE 128
 #endif
 
+// walk the entire heap looking for corrupt chunks on every free() (slow)
+#if !defined CONFIG_MALLOC_IS_VERIFY_HEAP
+#define CONFIG_MALLOC_IS_VERIFY_HEAP 0
+#endif
+
 // require a valid digital signature when installing applications
 #if !defined CONFIG_APPFS_IS_VERIFY_SIGNATURE
 #define CONFIG_APPFS_IS_VERIFY_SIGNATURE 1
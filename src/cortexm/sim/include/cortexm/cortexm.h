@@ -0,0 +1,17 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// the simulation is single threaded -- critical sections only count nesting
+
+#ifndef SIM_CORTEXM_CORTEXM_H_
+#define SIM_CORTEXM_CORTEXM_H_
+
+#include <sdk/types.h>
+
+extern int sim_critical_depth;
+
+static inline u32 cortexm_root_enter_critical() { return sim_critical_depth++; }
+static inline void cortexm_root_exit_critical(u32 primask) {
+  sim_critical_depth = primask;
+}
+
+#endif /* SIM_CORTEXM_CORTEXM_H_ */
@@ -0,0 +1,43 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// the task table fields used by task_ready.c plus the real task_table.h helpers
+
+#ifndef SIM_CORTEXM_TASK_H_
+#define SIM_CORTEXM_TASK_H_
+
+#include <sdk/types.h>
+
+struct _reent;
+
+typedef union {
+  volatile u32 t_atomic[2];
+  volatile u64 t;
+} task_timer_t;
+
+typedef struct {
+  int pid;
+  volatile s8 priority;
+  volatile u8 flags;
+  volatile u16 parent;
+  volatile task_timer_t timer;
+  void *global_reent;
+  void *reent;
+  volatile u8 ready_next;
+  volatile u8 ready_prev;
+  volatile u8 ready_priority;
+} task_t;
+
+#include "task_table.h"
+
+extern volatile s8 m_task_current_priority;
+
+s8 task_root_get_ready_priority();
+u8 task_root_get_ready_count(s8 priority);
+int task_root_get_ready_next();
+
+static inline int task_exec_asserted(int id) {
+  return task_ready_asserted(id)
+         && (sos_task_table[id].ready_priority == (u8)m_task_current_priority);
+}
+
+#endif /* SIM_CORTEXM_TASK_H_ */
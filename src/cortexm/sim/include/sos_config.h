@@ -0,0 +1,9 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_SOS_CONFIG_H_
+#define SIM_SOS_CONFIG_H_
+
+#define CONFIG_TASK_TOTAL 64
+#define CONFIG_SCHED_HIGHEST_PRIORITY 31
+
+#endif /* SIM_SOS_CONFIG_H_ */
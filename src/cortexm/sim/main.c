@@ -0,0 +1,225 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "sos_config.h"
+
+#include "cortexm/cortexm.h"
+#include "cortexm/task.h"
+
+volatile task_t sos_task_table[CONFIG_TASK_TOTAL];
+volatile s8 m_task_current_priority;
+volatile int m_task_current;
+int sim_critical_depth;
+
+static int failures;
+
+#define CHECK(x)                                                                         \
+  do {                                                                                   \
+    if (!(x)) {                                                                          \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #x);                       \
+      failures++;                                                                        \
+      return;                                                                            \
+    }                                                                                    \
+  } while (0)
+
+static void reset() {
+  for (int i = 1; i < CONFIG_TASK_TOTAL; i++) {
+    task_deassert_used(i);
+    sos_task_table[i].flags = 0;
+    sos_task_table[i].priority = 0;
+  }
+  m_task_current_priority = 0;
+}
+
+static void start_task(int id, int priority) {
+  sos_task_table[id].priority = priority;
+  task_assert_active(id);
+  task_assert_used(id);
+}
+
+// the previous scheduler walked the whole table to find the tasks to execute
+static int scan_exec_count(int priority) {
+  int count = 0;
+  for (int i = 1; i < CONFIG_TASK_TOTAL; i++) {
+    if (task_enabled_active_not_stopped(i) && (task_get_priority(i) == priority)) {
+      count++;
+    }
+  }
+  return count;
+}
+
+static int scan_highest_priority() {
+  int highest = -1;
+  for (int i = 1; i < CONFIG_TASK_TOTAL; i++) {
+    if (task_enabled_active_not_stopped(i) && (task_get_priority(i) > highest)) {
+      highest = task_get_priority(i);
+    }
+  }
+  return highest;
+}
+
+static void check_lists() {
+  for (int priority = 0; priority <= CONFIG_SCHED_HIGHEST_PRIORITY; priority++) {
+    const int count = scan_exec_count(priority);
+    CHECK(task_root_get_ready_count(priority) == count);
+  }
+  for (int i = 1; i < CONFIG_TASK_TOTAL; i++) {
+    CHECK(task_ready_asserted(i) == task_enabled_active_not_stopped(i));
+    if (task_ready_asserted(i)) {
+      CHECK(sos_task_table[i].ready_priority == task_get_priority(i));
+      CHECK(sos_task_table[sos_task_table[i].ready_next].ready_prev == i);
+    }
+  }
+  CHECK(task_root_get_ready_priority() == scan_highest_priority());
+  CHECK(sim_critical_depth == 0);
+}
+
+// every ready task at the current priority runs once, then task 0
+static void check_round() {
+  const int count = task_root_get_ready_count(m_task_current_priority);
+  u8 seen[CONFIG_TASK_TOTAL] = {0};
+  for (int i = 0; i < count; i++) {
+    const int id = task_root_get_ready_next();
+    CHECK(id > 0);
+    CHECK(task_exec_asserted(id));
+    CHECK(seen[id] == 0);
+    seen[id] = 1;
+  }
+  CHECK(task_root_get_ready_next() == 0);
+}
+
+static void test_random() {
+  reset();
+  srand(1);
+  for (int iteration = 0; iteration < 1000000; iteration++) {
+    const int id = 1 + rand() % (CONFIG_TASK_TOTAL - 1);
+    switch (rand() % 4) {
+    case 0:
+      task_active_asserted(id) ? task_deassert_active(id) : task_assert_active(id);
+      break;
+    case 1:
+      task_used_asserted(id) ? task_deassert_used(id) : task_assert_used(id);
+      break;
+    case 2:
+      task_stopped_asserted(id) ? task_deassert_stopped(id) : task_assert_stopped(id);
+      break;
+    case 3:
+      task_set_priority(id, rand() % (CONFIG_SCHED_HIGHEST_PRIORITY + 1));
+      break;
+    }
+
+    if ((iteration % 1000) == 0) {
+      const int failures_before = failures;
+      check_lists();
+      m_task_current_priority = task_root_get_ready_priority();
+      check_round();
+      if (failures != failures_before) {
+        printf("random: failed at iteration %d\n", iteration);
+        return;
+      }
+    }
+  }
+}
+
+static void test_hibernate() {
+  reset();
+  start_task(1, CONFIG_SCHED_HIGHEST_PRIORITY);
+  start_task(2, CONFIG_SCHED_HIGHEST_PRIORITY);
+  CHECK(task_root_get_ready_priority() == CONFIG_SCHED_HIGHEST_PRIORITY);
+  CHECK(task_root_get_ready_count(CONFIG_SCHED_HIGHEST_PRIORITY) == 2);
+
+  // hibernate() runs above every task priority -- only task 0 executes
+  m_task_current_priority = CONFIG_SCHED_HIGHEST_PRIORITY + 1;
+  CHECK(task_root_get_ready_count(m_task_current_priority) == 0);
+  CHECK(task_root_get_ready_next() == 0);
+  CHECK(task_root_get_ready_next() == 0);
+  CHECK(task_exec_asserted(1) == 0);
+
+  // a priority outside the lists is never ready
+  task_set_priority(2, CONFIG_SCHED_HIGHEST_PRIORITY + 1);
+  CHECK(task_ready_asserted(2) == 0);
+  CHECK(task_root_get_ready_count(CONFIG_SCHED_HIGHEST_PRIORITY) == 1);
+  task_set_priority(2, -1);
+  CHECK(task_ready_asserted(2) == 0);
+  task_deassert_used(2);
+
+  m_task_current_priority = CONFIG_SCHED_HIGHEST_PRIORITY;
+  CHECK(task_root_get_ready_next() == 1);
+  CHECK(task_root_get_ready_next() == 0);
+  check_lists();
+}
+
+// tasks at the same priority run in the order they became ready
+static void test_order() {
+  reset();
+  start_task(5, 3);
+  start_task(2, 3);
+  start_task(9, 3);
+  m_task_current_priority = 3;
+  CHECK(task_root_get_ready_next() == 5);
+  CHECK(task_root_get_ready_next() == 2);
+  CHECK(task_root_get_ready_next() == 9);
+  CHECK(task_root_get_ready_next() == 0);
+
+  // a task that blocks and wakes goes to the back of the list
+  task_deassert_active(2);
+  task_assert_active(2);
+  CHECK(task_root_get_ready_next() == 5);
+  CHECK(task_root_get_ready_next() == 9);
+  CHECK(task_root_get_ready_next() == 2);
+  CHECK(task_root_get_ready_next() == 0);
+}
+
+static double now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// time to find the tasks to execute with the table scan and with the ready lists
+static void bench() {
+  reset();
+  for (int i = 1; i < CONFIG_TASK_TOTAL; i++) {
+    start_task(i, i % 4);
+  }
+  const int loops = 200000;
+  volatile int sink = 0;
+
+  double start = now_ns();
+  for (int i = 0; i < loops; i++) {
+    const int priority = scan_highest_priority();
+    sink += scan_exec_count(priority);
+  }
+  const double scan = (now_ns() - start) / loops;
+
+  start = now_ns();
+  for (int i = 0; i < loops; i++) {
+    const int priority = task_root_get_ready_priority();
+    sink += task_root_get_ready_count(priority);
+    m_task_current_priority = priority;
+    sink += task_root_get_ready_next();
+  }
+  const double ready = (now_ns() - start) / loops;
+
+  printf(
+    "bench: %d tasks: table scan %.1f ns, ready lists %.1f ns\n",
+    CONFIG_TASK_TOTAL,
+    scan,
+    ready);
+}
+
+int main() {
+  test_random();
+  test_hibernate();
+  test_order();
+  if (failures) {
+    printf("FAILED (%d)\n", failures);
+    return 1;
+  }
+  bench();
+  printf("PASSED\n");
+  return 0;
+}
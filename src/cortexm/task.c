@@ -11,6 +11,9 @@
 #include "sos/symbols.h"
 #include "task_local.h"
 
+#include "../sys/scheduler/scheduler_timing.h"
+#include "../sys/scheduler/scheduler_wait_queue.h"
+
 #define SYSTICK_MIN_CYCLES 10000
 
 volatile task_t sos_task_table[CONFIG_TASK_TOTAL] MCU_SYS_MEM;
@@ -54,7 +57,7 @@ int task_init(
   system_stack = (u8 *)system_memory + system_memory_size;
 
   sos_task_table[0].sp = (u8 *)system_stack - sizeof(hw_stack_frame_t);
-  sos_task_table[0].flags = TASK_FLAGS_EXEC | TASK_FLAGS_USED | TASK_FLAGS_ROOT;
+  sos_task_table[0].flags = TASK_FLAGS_USED | TASK_FLAGS_ROOT;
   sos_task_table[0].parent = 0;
   sos_task_table[0].priority = 0;
   sos_task_table[0].pid = 0;
@@ -236,8 +239,10 @@ void task_svcall_new_task(new_task_t *task) {
 
 void task_root_delete(int id) {
   if ((id < task_get_total()) && (id >= 1)) {
-    task_deassert_used(id);
-    task_deassert_exec(id);
+    // the scheduler table entry is cleared when the task is reused -- unlink it first
+    scheduler_wait_queue_root_remove(id);
+    scheduler_timing_root_cancel_wake(id);
+    task_deassert_used(id); // also removes the task from the ready list
   }
 }
 
@@ -356,47 +361,19 @@ void switch_contexts() {
   }
 #endif
 
-  do {
-    m_task_current++;
-    if (m_task_current == task_get_total()) {
-      // The scheduler only uses OS mem -- disable the process MPU regions
-      m_task_current = 0;
-      if (sos_task_table[0].rr_time < SYSTICK_MIN_CYCLES) {
-        sos_task_table[0].rr_time = m_task_rr_reload;
-        sos_task_table[0].timer.t += (m_task_rr_reload);
-      }
-
-      // see if all tasks have used up their RR time
-      int i;
-      for (i = 1; i < task_get_total(); i++) {
-        if (task_exec_asserted(i) && (sos_task_table[i].rr_time >= SYSTICK_MIN_CYCLES)) {
-          break;
-        }
-      }
-
-      // if all executing tasks have used up their RR time -- reload the RR time for
-      // executing tasks
-      if (i == task_get_total()) {
-        for (i = 1; i < task_get_total(); i++) {
-          if (task_exec_asserted(i)) {
-            sos_task_table[i].timer.t += (m_task_rr_reload - sos_task_table[i].rr_time);
-            sos_task_table[i].rr_time = m_task_rr_reload;
-          }
-        }
-      }
+  // pick the next task in O(1) using the ready lists
+  cortexm_disable_interrupts();
+  m_task_current = task_root_get_ready_next();
+  cortexm_enable_interrupts();
 
-      break;
-    } else if (task_exec_asserted(m_task_current)) {
-      if (
-        (sos_task_table[m_task_current].rr_time >= SYSTICK_MIN_CYCLES)
-        ||                                    // is there time remaining on the RR
-        task_fifo_asserted(m_task_current)) { // is this a FIFO task
-        // check to see if task is low on memory -- kill if necessary?
-
-        break;
-      }
-    }
-  } while (1);
+  if (
+    (sos_task_table[m_task_current].rr_time < SYSTICK_MIN_CYCLES)
+    && !task_fifo_asserted(m_task_current)) {
+    // the task used up its RR time on its last turn -- reload it
+    sos_task_table[m_task_current].timer.t +=
+      (m_task_rr_reload - sos_task_table[m_task_current].rr_time);
+    sos_task_table[m_task_current].rr_time = m_task_rr_reload;
+  }
 
   // Enable the MPU for the task stack guard
 #if MPU_PRESENT || __MPU_PRESENT
@@ -488,25 +465,10 @@ void cortexm_pendsv_handler() {
   task_save_context();
 
   // disable interrupts -- Re-entrant scheduler issue #130
-  m_task_exec_count = 0;
   SOS_DEBUG_ENTER_CYCLE_SCOPE_AVERAGE();
   cortexm_disable_interrupts();
-  int i;
-  for (i = 1; i < task_get_total(); i++) {
-
-    if (
-      task_enabled_active_not_stopped(i) && // enabled, active, and not stopped
-      (task_get_priority(i)
-       == task_get_current_priority())) { // task is equal to the currently executing
-                                          // priority
-      // Enable process execution for highest active priority tasks
-      task_assert_exec(i);
-      m_task_exec_count++;
-    } else {
-      // Disable process execution for lower priority tasks
-      task_deassert_exec(i);
-    }
-  }
+  // tasks in the ready list of the current priority are the ones executing
+  m_task_exec_count = task_root_get_ready_count(task_get_current_priority());
 
   // enable interrupts -- Re-entrant scheduler issue
   cortexm_enable_interrupts();
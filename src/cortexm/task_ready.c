@@ -0,0 +1,132 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include "sos_config.h"
+
+#include "cortexm/cortexm.h"
+#include "cortexm/task.h"
+
+// one list per priority that a task can have
+#define TASK_READY_PRIORITY_TOTAL (CONFIG_SCHED_HIGHEST_PRIORITY + 1)
+
+#if TASK_READY_PRIORITY_TOTAL > 32
+#error "CONFIG_SCHED_HIGHEST_PRIORITY must be less than 32 to use the ready bitmap"
+#endif
+
+// bit n is set when the ready list for priority n is not empty
+static volatile u32 m_task_ready_bitmap MCU_SYS_MEM;
+// the task at the head of each list is the next to execute at that priority
+static volatile u8 m_task_ready_head[TASK_READY_PRIORITY_TOTAL] MCU_SYS_MEM;
+static volatile u8 m_task_ready_count[TASK_READY_PRIORITY_TOTAL] MCU_SYS_MEM;
+// number of tasks executed at m_task_round_priority since task 0 last had a turn
+static volatile u8 m_task_round_count MCU_SYS_MEM;
+static volatile s8 m_task_round_priority MCU_SYS_MEM;
+
+static int is_ready_priority(s8 priority) MCU_ROOT_EXEC_CODE;
+static void ready_insert(int id) MCU_ROOT_EXEC_CODE;
+static void ready_remove(int id) MCU_ROOT_EXEC_CODE;
+
+int is_ready_priority(s8 priority) {
+  // hibernate() executes above CONFIG_SCHED_HIGHEST_PRIORITY where no task is ready
+  return (priority >= 0) && (priority < TASK_READY_PRIORITY_TOTAL);
+}
+
+s8 task_root_get_ready_priority() {
+  const u32 bitmap = m_task_ready_bitmap;
+  if (bitmap == 0) {
+    return -1;
+  }
+  return 31 - __builtin_clz(bitmap);
+}
+
+u8 task_root_get_ready_count(s8 priority) {
+  if (is_ready_priority(priority) == 0) {
+    return 0;
+  }
+  return m_task_ready_count[priority];
+}
+
+void task_root_update_ready(int id) {
+  if (id == 0) {
+    // the scheduler task is executed when the others have had a turn
+    return;
+  }
+
+  // this can be called from within a critical section -- restore rather than enable
+  const u32 primask = cortexm_root_enter_critical();
+  const int is_ready = task_enabled_active_not_stopped(id)
+                       && is_ready_priority(task_get_priority(id));
+  if (task_ready_asserted(id)) {
+    if (is_ready && (sos_task_table[id].ready_priority == (u8)task_get_priority(id))) {
+      // already in the right list
+      cortexm_root_exit_critical(primask);
+      return;
+    }
+    ready_remove(id);
+  }
+
+  if (is_ready) {
+    ready_insert(id);
+  }
+  cortexm_root_exit_critical(primask);
+}
+
+void ready_insert(int id) {
+  const u8 priority = task_get_priority(id);
+  sos_task_table[id].ready_priority = priority;
+  if (m_task_ready_count[priority] == 0) {
+    sos_task_table[id].ready_next = id;
+    sos_task_table[id].ready_prev = id;
+    m_task_ready_head[priority] = id;
+    m_task_ready_bitmap |= (1UL << priority);
+  } else {
+    // insert just before the head so the new task is last in the round robin
+    const u8 head = m_task_ready_head[priority];
+    const u8 tail = sos_task_table[head].ready_prev;
+    sos_task_table[id].ready_next = head;
+    sos_task_table[id].ready_prev = tail;
+    sos_task_table[tail].ready_next = id;
+    sos_task_table[head].ready_prev = id;
+  }
+  m_task_ready_count[priority]++;
+  sos_task_table[id].flags |= TASK_FLAGS_READY;
+}
+
+void ready_remove(int id) {
+  const u8 priority = sos_task_table[id].ready_priority;
+  const u8 next = sos_task_table[id].ready_next;
+  const u8 prev = sos_task_table[id].ready_prev;
+  sos_task_table[id].flags &= ~TASK_FLAGS_READY;
+  m_task_ready_count[priority]--;
+  if (m_task_ready_count[priority] == 0) {
+    m_task_ready_bitmap &= ~(1UL << priority);
+    return;
+  }
+  sos_task_table[prev].ready_next = next;
+  sos_task_table[next].ready_prev = prev;
+  if (m_task_ready_head[priority] == id) {
+    m_task_ready_head[priority] = next;
+  }
+}
+
+int task_root_get_ready_next() {
+  // called with interrupts disabled
+  const s8 priority = m_task_current_priority;
+  const u8 count = task_root_get_ready_count(priority);
+  if (priority != m_task_round_priority) {
+    // a new priority level preempted (or resumed) -- start a new round
+    m_task_round_priority = priority;
+    m_task_round_count = 0;
+  }
+
+  if ((count == 0) || (m_task_round_count >= count)) {
+    // everything at this priority has had a turn -- let the scheduler run
+    m_task_round_count = 0;
+    return 0;
+  }
+
+  // take the head and rotate it to the back of the list
+  const u8 next = m_task_ready_head[priority];
+  m_task_ready_head[priority] = sos_task_table[next].ready_next;
+  m_task_round_count++;
+  return next;
+}
@@ -10,56 +10,434 @@
 #include "sos/debug.h"
 #include "cortexm/task.h"
 
+enum {
+  FLAG_PENDING = (1 << 0), // state->op is in progress
+  FLAG_FILL = (1 << 1),    // state->op reads into the cache
+  FLAG_WRITE = (1 << 2),   // state->async is a write
+  FLAG_FLUSH = (1 << 3),
+  FLAG_ATTR = (1 << 4) // state->attr is applied after the flush
+};
+
+static drive_device_cache_entry_t *
+get_entry(const drive_device_config_t *config, int i);
+static u8 *get_data(const drive_device_config_t *config, int i);
+static int find_entry(const drive_device_config_t *config, u32 block);
+static int find_dirty(const drive_device_config_t *config);
+static u32
+get_age(const drive_device_state_t *state, const drive_device_cache_entry_t *entry);
+static int find_victim(const devfs_handle_t *handle, int *count);
+static int start_op(const devfs_handle_t *handle, int is_fill, int entry, int count);
+static int finish_op(const devfs_handle_t *handle, int result);
+static int op_callback(void *context, const mcu_event_t *event);
+static int flush(const devfs_handle_t *handle);
+static int serve(const devfs_handle_t *handle);
+static int start_request(const devfs_handle_t *handle, devfs_async_t *async, u32 o_flags);
+static int apply_attr(const devfs_handle_t *handle);
+
 int drive_device_open(const devfs_handle_t *handle) {
-  const drive_device_config_t *config = handle->config;
-  return config->device.driver.open(&config->device.handle);
+  DEVFS_DRIVER_DECLARE_CONFIG_STATE(drive_device);
+  drive_info_t info;
+  int result = config->device.driver.open(&config->device.handle);
+  if ((result < 0) || (config->cache == NULL) || (state->addressable_size != 0)) {
+    return result;
+  }
+
+  result =
+    config->device.driver.ioctl(&config->device.handle, I_DRIVE_GETINFO, &info);
+  if (result < 0) {
+    return result;
+  }
+
+  memset(state, 0, sizeof(drive_device_state_t));
+  memset(
+    config->cache, 0, config->cache_block_count * sizeof(drive_device_cache_entry_t));
+  state->addressable_size = info.addressable_size ? info.addressable_size : 1;
+  state->block_count =
+    (u64)info.num_write_blocks * info.write_block_size / config->cache_block_size;
+  return 0;
 }
 
 int drive_device_read(const devfs_handle_t *handle, devfs_async_t *async) {
   const drive_device_config_t *config = handle->config;
-  return config->device.driver.read(&config->device.handle, async);
+  if (config->cache == NULL) {
+    return config->device.driver.read(&config->device.handle, async);
+  }
+  return start_request(handle, async, 0);
 }
 
 int drive_device_write(const devfs_handle_t *handle, devfs_async_t *async) {
   const drive_device_config_t *config = handle->config;
-  return config->device.driver.write(&config->device.handle, async);
+  if (config->cache == NULL) {
+    return config->device.driver.write(&config->device.handle, async);
+  }
+  return start_request(handle, async, FLAG_WRITE);
 }
 
 int drive_device_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
-  const drive_device_config_t *config = handle->config;
-  drive_attr_t *attr = ctl;
-  u32 o_flags;
+  DEVFS_DRIVER_DECLARE_CONFIG_STATE(drive_device);
+
+  if (config->cache != NULL) {
+    switch (request) {
+    case I_DRIVE_SETATTR:
+      if (state->async || (state->flags & (FLAG_PENDING | FLAG_FLUSH))) {
+        return SYSFS_SET_RETURN(EBUSY);
+      }
+      // dirty blocks are written before the drive is erased or reset
+      memcpy(&state->attr, ctl, sizeof(drive_attr_t));
+      state->flags |= FLAG_FLUSH | FLAG_ATTR;
+      return flush(handle);
+
+    case I_DRIVE_ISBUSY:
+      if (state->flags & (FLAG_PENDING | FLAG_FLUSH)) {
+        return 1;
+      }
+      break;
+    }
+  }
+
+  return config->device.driver.ioctl(&config->device.handle, request, ctl);
+}
+
+int drive_device_close(const devfs_handle_t *handle) {
+  DEVFS_DRIVER_DECLARE_CONFIG_STATE(drive_device);
+  if (
+    (config->cache != NULL) && (state->async == NULL)
+    && ((state->flags & (FLAG_PENDING | FLAG_FLUSH)) == 0)) {
+    // an asynchronous flush completes after the close
+    state->flags |= FLAG_FLUSH;
+    int result = flush(handle);
+    if (result < 0) {
+      return result;
+    }
+  }
+  return config->device.driver.close(&config->device.handle);
+}
+
+drive_device_cache_entry_t *get_entry(const drive_device_config_t *config, int i) {
+  return (drive_device_cache_entry_t *)config->cache + i;
+}
 
-  switch (request) {
-  case I_DRIVE_SETATTR:
-    o_flags = attr->o_flags;
-    if (o_flags & (DRIVE_FLAG_ERASE_BLOCKS | DRIVE_FLAG_ERASE_DEVICE)) {
+u8 *get_data(const drive_device_config_t *config, int i) {
+  return (u8 *)config->cache
+         + config->cache_block_count * sizeof(drive_device_cache_entry_t)
+         + i * config->cache_block_size;
+}
+
+int find_entry(const drive_device_config_t *config, u32 block) {
+  for (int i = 0; i < config->cache_block_count; i++) {
+    const drive_device_cache_entry_t *entry = get_entry(config, i);
+    if ((entry->o_flags & DRIVE_DEVICE_CACHE_FLAG_VALID) && (entry->block == block)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+int find_dirty(const drive_device_config_t *config) {
+  int result = -1;
+  // lowest block first so the drive sees sequential writes
+  for (int i = 0; i < config->cache_block_count; i++) {
+    const drive_device_cache_entry_t *entry = get_entry(config, i);
+    if (
+      (entry->o_flags & DRIVE_DEVICE_CACHE_FLAG_DIRTY)
+      && ((result < 0) || (entry->block < get_entry(config, result)->block))) {
+      result = i;
+    }
+  }
+  return result;
+}
 
-      if (o_flags & DRIVE_FLAG_ERASE_BLOCKS) {
+u32 get_age(
+  const drive_device_state_t *state,
+  const drive_device_cache_entry_t *entry) {
+  if ((entry->o_flags & DRIVE_DEVICE_CACHE_FLAG_VALID) == 0) {
+    return 0xffffffff;
+  }
+  return state->tick - entry->tick;
+}
+
+int find_victim(const devfs_handle_t *handle, int *count) {
+  DEVFS_DRIVER_DECLARE_CONFIG_STATE(drive_device);
+  int result = 0;
+
+  // read-ahead fills clean neighboring slots with the following blocks
+  int ahead = 0;
+  if (((state->flags & FLAG_WRITE) == 0) && (state->block == state->next_block)) {
+    ahead = config->read_ahead;
+    if (ahead > config->cache_block_count - 1) {
+      ahead = config->cache_block_count - 1;
+    }
+    for (int i = 1; i <= ahead; i++) {
+      if (
+        (state->block + i >= state->block_count)
+        || (find_entry(config, state->block + i) >= 0)) {
+        ahead = i - 1;
+        break;
       }
     }
+  }
 
-    if (o_flags & DRIVE_FLAG_INIT) {
+  for (; ahead > 0; ahead--) {
+    // the window whose most recently used slot is the oldest
+    u32 window_age = 0;
+    result = -1;
+    for (int i = 0; i + ahead < config->cache_block_count; i++) {
+      u32 age = 0xffffffff;
+      int j;
+      for (j = i; j <= i + ahead; j++) {
+        const drive_device_cache_entry_t *entry = get_entry(config, j);
+        if (entry->o_flags & DRIVE_DEVICE_CACHE_FLAG_DIRTY) {
+          break;
+        }
+        if (get_age(state, entry) < age) {
+          age = get_age(state, entry);
+        }
+      }
+      if ((j > i + ahead) && ((result < 0) || (age > window_age))) {
+        result = i;
+        window_age = age;
+      }
+    }
+    if (result >= 0) {
+      *count = ahead + 1;
+      return result;
     }
+  }
 
-    if (o_flags & DRIVE_FLAG_RESET) {
+  // least recently used
+  result = 0;
+  for (int i = 1; i < config->cache_block_count; i++) {
+    if (
+      get_age(state, get_entry(config, i))
+      > get_age(state, get_entry(config, result))) {
+      result = i;
     }
+  }
+  *count = 1;
+  return result;
+}
 
-    break;
+int start_op(const devfs_handle_t *handle, int is_fill, int entry, int count) {
+  DEVFS_DRIVER_DECLARE_CONFIG_STATE(drive_device);
+  int result;
 
-  case I_DRIVE_ISBUSY:
+  state->op.tid = state->async ? state->async->tid : 0;
+  state->op.flags = state->async ? state->async->flags : 0;
+  state->op.loc = get_entry(config, entry)->block
+                  * (config->cache_block_size / state->addressable_size);
+  state->op.buf = get_data(config, entry);
+  state->op.nbyte = count * config->cache_block_size;
+  state->op.result = 0;
+  state->op.handler.context = (void *)handle;
+  state->op.handler.callback = op_callback;
+  state->op_entry = entry;
+  state->op_count = count;
+  state->flags |= FLAG_PENDING;
 
+  if (is_fill) {
+    state->flags |= FLAG_FILL;
+    result = config->device.driver.read(&config->device.handle, &state->op);
+  } else {
+    state->flags &= ~FLAG_FILL;
+    result = config->device.driver.write(&config->device.handle, &state->op);
+  }
+
+  if (result == 0) {
     return 0;
-  case I_DRIVE_GETINFO:
+  }
+  return finish_op(handle, result);
+}
+
+int finish_op(const devfs_handle_t *handle, int result) {
+  DEVFS_DRIVER_DECLARE_CONFIG_STATE(drive_device);
+  state->flags &= ~FLAG_PENDING;
 
+  if ((result >= 0) && (result < state->op.nbyte)) {
+    result = SYSFS_SET_RETURN(EIO);
+  }
+
+  for (int i = 0; i < state->op_count; i++) {
+    drive_device_cache_entry_t *entry = get_entry(config, state->op_entry + i);
+    if (state->flags & FLAG_FILL) {
+      entry->o_flags = result < 0 ? 0 : DRIVE_DEVICE_CACHE_FLAG_VALID;
+    } else if (result >= 0) {
+      entry->o_flags &= ~DRIVE_DEVICE_CACHE_FLAG_DIRTY;
+    }
+  }
+
+  return result;
+}
+
+int op_callback(void *context, const mcu_event_t *event) {
+  const devfs_handle_t *handle = context;
+  drive_device_state_t *state = handle->state;
+  devfs_async_t *async = state->async;
+
+  // drive_sdspi reports the result in nbyte
+  int result =
+    finish_op(handle, state->op.result != 0 ? state->op.result : state->op.nbyte);
+
+  if (state->flags & FLAG_FLUSH) {
+    if (result < 0) {
+      state->flags &= ~(FLAG_FLUSH | FLAG_ATTR);
+    } else {
+      flush(handle);
+    }
+  } else if ((async != NULL) && (result < 0)) {
+    state->async = NULL;
+  }
+
+  if ((async != NULL) && (state->async != NULL) && !(state->flags & FLAG_PENDING)) {
+    result = serve(handle);
+  }
+
+  if ((async != NULL) && (state->async == NULL)) {
+    async->result = result;
+    devfs_execute_event_handler(
+      &async->handler,
+      (state->flags & FLAG_WRITE) ? MCU_EVENT_FLAG_WRITE_COMPLETE
+                                  : MCU_EVENT_FLAG_DATA_READY,
+      0);
+  }
+  return 0;
+}
+
+int flush(const devfs_handle_t *handle) {
+  DEVFS_DRIVER_DECLARE_CONFIG_STATE(drive_device);
+  int i;
+
+  while ((i = find_dirty(config)) >= 0) {
+    int result = start_op(handle, 0, i, 1);
+    if (result == 0) {
+      return 0;
+    }
+    if (result < 0) {
+      state->flags &= ~(FLAG_FLUSH | FLAG_ATTR);
+      return result;
+    }
+  }
+
+  state->flags &= ~FLAG_FLUSH;
+  if (state->flags & FLAG_ATTR) {
+    state->flags &= ~FLAG_ATTR;
+    return apply_attr(handle);
+  }
+  return 0;
+}
+
+int serve(const devfs_handle_t *handle) {
+  DEVFS_DRIVER_DECLARE_CONFIG_STATE(drive_device);
+  devfs_async_t *async = state->async;
+  const int is_write = (state->flags & FLAG_WRITE) != 0;
+
+  while ((state->done < async->nbyte) && (state->block < state->block_count)) {
+    int i = find_entry(config, state->block);
+    int size = config->cache_block_size - state->offset;
+    if (size > async->nbyte - state->done) {
+      size = async->nbyte - state->done;
+    }
+
+    if (i < 0) {
+      int count;
+      int result;
+      i = find_victim(handle, &count);
+      drive_device_cache_entry_t *entry = get_entry(config, i);
+      if (entry->o_flags & DRIVE_DEVICE_CACHE_FLAG_DIRTY) {
+        result = start_op(handle, 0, i, 1);
+      } else {
+        for (int j = 0; j < count; j++) {
+          get_entry(config, i + j)->block = state->block + j;
+          get_entry(config, i + j)->tick = state->tick;
+          get_entry(config, i + j)->o_flags = 0;
+        }
+        if (is_write && (size == (int)config->cache_block_size)) {
+          // the whole block is replaced so there is nothing to read
+          entry->o_flags = DRIVE_DEVICE_CACHE_FLAG_VALID;
+          continue;
+        }
+        result = start_op(handle, 1, i, count);
+      }
+
+      if (result == 0) {
+        return 0;
+      }
+      if (result < 0) {
+        state->async = NULL;
+        return result;
+      }
+      continue;
+    }
+
+    drive_device_cache_entry_t *entry = get_entry(config, i);
+    u8 *data = get_data(config, i) + state->offset;
+    if (is_write) {
+      memcpy(data, (const u8 *)async->buf_const + state->done, size);
+      entry->o_flags |= DRIVE_DEVICE_CACHE_FLAG_DIRTY;
+    } else {
+      memcpy((u8 *)async->buf + state->done, data, size);
+    }
+    entry->tick = ++state->tick;
+    state->next_block = state->block + 1;
+    state->done += size;
+    state->offset += size;
+    if (state->offset == config->cache_block_size) {
+      state->offset = 0;
+      state->block++;
+    }
+  }
+
+  state->async = NULL;
+  if (state->done == 0) {
+    return SYSFS_SET_RETURN(EINVAL);
+  }
+  return state->done;
+}
+
+int start_request(const devfs_handle_t *handle, devfs_async_t *async, u32 o_flags) {
+  DEVFS_DRIVER_DECLARE_CONFIG_STATE(drive_device);
+  if (state->async != NULL) {
+    return SYSFS_SET_RETURN(EBUSY);
+  }
+
+  const u64 address = (u64)async->loc * state->addressable_size;
+  state->async = async;
+  state->block = address / config->cache_block_size;
+  state->offset = address % config->cache_block_size;
+  state->done = 0;
+  state->flags = (state->flags & ~FLAG_WRITE) | o_flags;
+
+  if (state->flags & FLAG_PENDING) {
+    // served once the flush transfer completes
     return 0;
   }
-  return config->device.driver.ioctl(&config->device.handle, request, ctl);
+  return serve(handle);
 }
 
-int drive_device_close(const devfs_handle_t *handle) {
-  const drive_device_config_t *config = handle->config;
-  return config->device.driver.close(&config->device.handle);
+int apply_attr(const devfs_handle_t *handle) {
+  DEVFS_DRIVER_DECLARE_CONFIG_STATE(drive_device);
+  const drive_attr_t *attr = &state->attr;
+  u32 first = 1;
+  u32 last = 0;
+
+  if (attr->o_flags & (DRIVE_FLAG_ERASE_DEVICE | DRIVE_FLAG_INIT | DRIVE_FLAG_RESET)) {
+    first = 0;
+    last = 0xffffffff;
+  } else if (attr->o_flags & DRIVE_FLAG_ERASE_BLOCKS) {
+    first = (u64)attr->start * state->addressable_size / config->cache_block_size;
+    last = (((u64)attr->end + 1) * state->addressable_size - 1)
+           / config->cache_block_size;
+  }
+
+  // the cache is clean here so dropping blocks loses nothing
+  for (int i = 0; i < config->cache_block_count; i++) {
+    drive_device_cache_entry_t *entry = get_entry(config, i);
+    if ((entry->block >= first) && (entry->block <= last)) {
+      entry->o_flags = 0;
+    }
+  }
+
+  return config->device.driver.ioctl(
+    &config->device.handle, I_DRIVE_SETATTR, &state->attr);
 }
 
 /*! @} */
@@ -24,6 +24,7 @@
 
 #define FLAG_PROTECTED (1 << 0)
 #define FLAG_SDSC (1 << 1)
+#define FLAG_STOP_TRAN (1 << 2)
 
 static int is_sdsc(const devfs_handle_t *handle);
 
@@ -63,6 +64,11 @@ static int spi_transfer(
 static int try_read(const devfs_handle_t *handle, int first);
 static int continue_spi_read(void *handle, const mcu_event_t *ignore);
 static int continue_spi_write(void *handle, const mcu_event_t *ignore);
+static int continue_spi_busy(void *handle, const mcu_event_t *ignore);
+static int continue_spi_stop(void *handle, const mcu_event_t *ignore);
+static int write_block(const devfs_handle_t *handle);
+static int stop_read(const devfs_handle_t *handle, int err, int nbyte);
+static int stop_write(const devfs_handle_t *handle, int err, int nbyte);
 
 static void deassert_chip_select(const devfs_handle_t *handle) {
   const drive_sdspi_config_t *config = handle->config;
@@ -125,29 +131,38 @@ int continue_spi_read(void *handle, const mcu_event_t *ignore) {
     state->timeout++;
     if (state->timeout > 5000) {
       // failed to read the data
-      deassert_chip_select(handle);
-      state_callback(handle, EIO, -2);
-      return 0;
+      return stop_read(handle, EIO, -2);
     }
 
     // try again to try the start of the data
     return try_read(handle, 0);
 
   } else {
-    // the read is complete
-    int err = 0;
-    spi_transfer(handle, 0, state->cmd, CMD_FRAME_SIZE); // gobble up the CRC
+    // the block is complete
+    const char *buf = state->buf + state->block * BLOCK_SIZE;
+    if (state->block_count > 1) {
+      // the next block follows the CRC
+      spi_transfer(handle, 0, state->cmd, 2);
+    } else {
+      spi_transfer(handle, 0, state->cmd, CMD_FRAME_SIZE); // gobble up the CRC
+    }
     checksum = (state->cmd[0] << 8) + state->cmd[1];
-    checksum_calc = mcu_calc_crc16(
-      0x0000, 0x1021, (const uint8_t *)state->buf, (size_t) * (state->nbyte));
+    checksum_calc = mcu_calc_crc16(0x0000, 0x1021, (const uint8_t *)buf, BLOCK_SIZE);
     if (checksum != checksum_calc) {
       sos_debug_printf("Bad checksum 0x%04X != 0x%04X\n", checksum, checksum_calc);
-      *(state->nbyte) = -1;
-      err = EINVAL;
+      return stop_read(handle, EINVAL, -1);
+    }
+
+    state->block++;
+    if (state->block < state->block_count) {
+      // wait for the next data token without releasing the card
+      memset(state->cmd, 0xFF, CMD_FRAME_SIZE);
+      state->timeout = 0;
+      return try_read(handle, 0);
     }
 
-    // execute the callback
-    state_callback(handle, err, *(state->nbyte));
+    // the callback executes once the card is released
+    return stop_read(handle, 0, state->block_count * BLOCK_SIZE);
   }
 
   return 0;
@@ -157,11 +172,12 @@ int try_read(const devfs_handle_t *handle, int first) {
   int ret;
   const drive_sdspi_config_t *config = handle->config;
   drive_sdspi_state_t *state = handle->state;
-  state->count = parse_data(
-    (uint8_t *)state->buf, *(state->nbyte), -1, SDSPI_START_BLOCK_TOKEN, state->cmd);
+  char *buf = (char *)state->buf + state->block * BLOCK_SIZE;
+  state->count =
+    parse_data((uint8_t *)buf, BLOCK_SIZE, -1, SDSPI_START_BLOCK_TOKEN, state->cmd);
   if (state->count >= 0) {
-    state->op.nbyte = *(state->nbyte) - state->count;
-    state->op.buf = (void *)&(state->buf[state->count]);
+    state->op.nbyte = BLOCK_SIZE - state->count;
+    state->op.buf = buf + state->count;
   } else {
     state->op.nbyte = CMD_FRAME_SIZE;
     state->op.buf = state->cmd;
@@ -180,9 +196,8 @@ int try_read(const devfs_handle_t *handle, int first) {
   }
 
   if ((ret = config->device.driver.read(&config->device.handle, &(state->op))) != 0) {
-    state_callback(handle, EINVAL, -5);
     sos_debug_printf("BAD SPI READ\n");
-    return 0;
+    return stop_read(handle, EINVAL, -5);
   }
   return 1;
 }
@@ -193,7 +208,7 @@ int drive_sdspi_read(const devfs_handle_t *handle, devfs_async_t *rop) {
   drive_sdspi_r1_t r1;
   u32 loc;
 
-  if (rop->nbyte != BLOCK_SIZE) {
+  if ((rop->nbyte <= 0) || (rop->nbyte % BLOCK_SIZE != 0)) {
     return SYSFS_SET_RETURN(EINVAL);
   }
 
@@ -205,6 +220,8 @@ int drive_sdspi_read(const devfs_handle_t *handle, devfs_async_t *rop) {
   state->handler.callback = rop->handler.callback;
   state->nbyte = &(rop->nbyte);
   state->buf = rop->buf;
+  state->block = 0;
+  state->block_count = rop->nbyte / BLOCK_SIZE;
   state->timeout = 0;
   state->op.tid = rop->tid;
 
@@ -214,7 +231,12 @@ int drive_sdspi_read(const devfs_handle_t *handle, devfs_async_t *rop) {
     loc = rop->loc;
   }
 
-  r1 = exec_cmd_r1(handle, SDSPI_CMD17_READ_SINGLE_BLOCK, loc, state->cmd);
+  // the card streams consecutive blocks until CMD12
+  r1 = exec_cmd_r1(
+    handle,
+    state->block_count > 1 ? SDSPI_CMD18_READ_MULTIPLE_BLOCK
+                           : SDSPI_CMD17_READ_SINGLE_BLOCK,
+    loc, state->cmd);
   if (r1.u8 != 0x00) {
     if ((r1.param_error)) {
       return SYSFS_SET_RETURN(EINVAL);
@@ -252,7 +274,8 @@ int continue_spi_write(void *handle, const mcu_event_t *ignore) {
   uint16_t checksum;
 
   // calculate and write the checksum
-  checksum = mcu_calc_crc16(0x0000, 0x1021, (const uint8_t *)state->buf, *(state->nbyte));
+  checksum = mcu_calc_crc16(
+    0x0000, 0x1021, (const uint8_t *)state->buf + state->block * BLOCK_SIZE, BLOCK_SIZE);
 
   // finish the write
   state->cmd[0] = checksum >> 8;
@@ -261,26 +284,152 @@ int continue_spi_write(void *handle, const mcu_event_t *ignore) {
   state->cmd[3] = 0xFF;
   state->cmd[4] = 0xFF;
   spi_transfer(handle, state->cmd, state->cmd, 5); // send dummy CRC
-  deassert_chip_select(handle);
 
-  if ((state->cmd[2] & 0x1F) == 0x05) {
-    // data was accepted
-    state_callback(handle, 0, *(state->nbyte));
-  } else {
+  // the card holds the data line low while it programs the block
+  state->timeout = 0;
+  state->cmd[CMD_FRAME_SIZE - 1] = state->cmd[4];
+
+  if ((state->cmd[2] & 0x1F) != 0x05) {
     // data was not accepted
-    state_callback(handle, EIO, -1);
+    return stop_write(handle, EIO, -1);
+  }
+
+  if (state->block_count == 1) {
+    // data was accepted
+    deassert_chip_select(handle);
+    state_callback(handle, 0, BLOCK_SIZE);
+    return 0;
+  }
+
+  state->block++;
+  return continue_spi_busy(handle, 0);
+}
+
+int continue_spi_busy(void *handle, const mcu_event_t *ignore) {
+  MCU_UNUSED_ARGUMENT(ignore);
+  const drive_sdspi_config_t *config = ((const devfs_handle_t *)handle)->config;
+  drive_sdspi_state_t *state = ((const devfs_handle_t *)handle)->state;
+
+  if (state->cmd[CMD_FRAME_SIZE - 1] != 0xFF) {
+    state->timeout++;
+    if (state->timeout > 5000) {
+      return stop_write(handle, EIO, -2);
+    }
+
+    state->op.nbyte = CMD_FRAME_SIZE;
+    state->op.buf = state->cmd;
+    state->op.handler.context = handle;
+    state->op.handler.callback = continue_spi_busy;
+    if (config->device.driver.read(&config->device.handle, &(state->op)) != 0) {
+      return stop_write(handle, EINVAL, -5);
+    }
+    return 0;
+  }
+
+  if (state->block < state->block_count) {
+    // chain the next block on the same command
+    if (write_block(handle) != 0) {
+      return stop_write(handle, EINVAL, -5);
+    }
+    return 0;
+  }
+
+  return stop_write(handle, 0, state->block_count * BLOCK_SIZE);
+}
+
+int write_block(const devfs_handle_t *handle) {
+  const drive_sdspi_config_t *config = handle->config;
+  drive_sdspi_state_t *state = handle->state;
+
+  state->cmd[0] = 0xFF; // busy byte
+  state->cmd[1] = state->block_count > 1 ? SDSPI_START_BLOCK_WRITE_MULTIPLE_TOKEN
+                                         : SDSPI_START_BLOCK_TOKEN;
+  spi_transfer(handle, state->cmd, 0, 2);
+
+  state->op.nbyte = BLOCK_SIZE;
+  state->op.buf = (void *)(state->buf + state->block * BLOCK_SIZE);
+  state->op.handler.context = (void *)handle;
+  state->op.handler.callback = continue_spi_write;
+
+  return config->device.driver.write(&config->device.handle, &(state->op));
+}
+
+int stop_read(const devfs_handle_t *handle, int err, int nbyte) {
+  drive_sdspi_state_t *state = handle->state;
+
+  state->result = nbyte;
+  state->result_errno = err;
+  if (state->block_count > 1) {
+    // the card keeps sending data while CMD12 is clocked out
+    memset(state->cmd, 0xFF, CMD_FRAME_SIZE);
+    state->cmd[0] = 0x40 | SDSPI_CMD12_STOP_TRANSMISSION;
+    state->cmd[1] = 0;
+    state->cmd[2] = 0;
+    state->cmd[3] = 0;
+    state->cmd[4] = 0;
+    state->cmd[5] = mcu_calc_crc7(0, 0x09, state->cmd, 5);
+    spi_transfer(handle, state->cmd, state->cmd, CMD_FRAME_SIZE);
+
+    // R1b -- wait for the card to release the data line
+    state->timeout = 0;
+    return continue_spi_stop((void *)handle, 0);
+  }
+
+  deassert_chip_select(handle);
+  state_callback(handle, err, nbyte);
+  return 0;
+}
+
+int stop_write(const devfs_handle_t *handle, int err, int nbyte) {
+  drive_sdspi_state_t *state = handle->state;
+
+  state->result = nbyte;
+  state->result_errno = err;
+  if (state->block_count > 1) {
+    // the token is ignored while the card is programming a block
+    state->flags |= FLAG_STOP_TRAN;
+    return continue_spi_stop((void *)handle, 0);
+  }
+
+  deassert_chip_select(handle);
+  state_callback(handle, err, nbyte);
+  return 0;
+}
+
+int continue_spi_stop(void *handle, const mcu_event_t *ignore) {
+  MCU_UNUSED_ARGUMENT(ignore);
+  const drive_sdspi_config_t *config = ((const devfs_handle_t *)handle)->config;
+  drive_sdspi_state_t *state = ((const devfs_handle_t *)handle)->state;
+
+  if ((state->cmd[CMD_FRAME_SIZE - 1] != 0xFF) && (state->timeout++ < 5000)) {
+    state->op.nbyte = CMD_FRAME_SIZE;
+    state->op.buf = state->cmd;
+    state->op.handler.context = handle;
+    state->op.handler.callback = continue_spi_stop;
+    if (config->device.driver.read(&config->device.handle, &(state->op)) == 0) {
+      return 0;
+    }
+  }
+
+  if (state->flags & FLAG_STOP_TRAN) {
+    // the card is busy after the token which is checked by the next request
+    state->flags &= ~FLAG_STOP_TRAN;
+    state->cmd[0] = SDSPI_STOP_TRAN_TOKEN;
+    state->cmd[1] = 0xFF;
+    spi_transfer(handle, state->cmd, 0, 2);
   }
 
+  deassert_chip_select(handle);
+  state_callback(handle, state->result_errno, state->result);
   return 0;
 }
 
 int drive_sdspi_write(const devfs_handle_t *handle, devfs_async_t *wop) {
-  const drive_sdspi_config_t *config = handle->config;
   drive_sdspi_state_t *state = handle->state;
   drive_sdspi_r1_t r1;
   u32 loc;
 
-  if (wop->nbyte != BLOCK_SIZE) {
+  if ((wop->nbyte <= 0) || (wop->nbyte % BLOCK_SIZE != 0)) {
     return SYSFS_SET_RETURN(EINVAL);
   }
 
@@ -293,7 +442,10 @@ int drive_sdspi_write(const devfs_handle_t *handle, devfs_async_t *wop) {
   state->handler.callback = wop->handler.callback;
   state->nbyte = &(wop->nbyte);
   state->buf = wop->buf;
+  state->block = 0;
+  state->block_count = wop->nbyte / BLOCK_SIZE;
   state->timeout = 0;
+  state->op.tid = wop->tid;
 
   if (is_sdsc(handle)) {
     loc = wop->loc * BLOCK_SIZE;
@@ -301,7 +453,20 @@ int drive_sdspi_write(const devfs_handle_t *handle, devfs_async_t *wop) {
     loc = wop->loc;
   }
 
-  r1 = exec_cmd_r1(handle, SDSPI_CMD24_WRITE_SINGLE_BLOCK, loc, state->cmd);
+  if (state->block_count > 1) {
+    // pre-erase hint -- the write works without it
+    r1 = exec_cmd_r1(handle, SDSPI_CMD55_APP_CMD, 0, state->cmd);
+    if (r1.u8 == 0x00) {
+      exec_cmd_r1(
+        handle, SDSPI_ACMD23_SET_WR_BLK_ERASE_COUNT, state->block_count, state->cmd);
+    }
+  }
+
+  r1 = exec_cmd_r1(
+    handle,
+    state->block_count > 1 ? SDSPI_CMD25_WRITE_MULTIPLE_BLOCK
+                           : SDSPI_CMD24_WRITE_SINGLE_BLOCK,
+    loc, state->cmd);
   if (r1.u8 != 0x00) {
     if ((r1.addr_error) || (r1.param_error)) {
       return SYSFS_SET_RETURN(EINVAL);
@@ -310,20 +475,10 @@ int drive_sdspi_write(const devfs_handle_t *handle, devfs_async_t *wop) {
     return SYSFS_SET_RETURN(EIO);
   }
 
-  state->cmd[0] = 0xFF; // busy byte
-  state->cmd[1] = SDSPI_START_BLOCK_TOKEN;
-
   assert_chip_select(handle);
   cortexm_delay_us(LONG_DELAY);
-  spi_transfer(handle, state->cmd, 0, 2);
 
-  state->op.nbyte = wop->nbyte;
-  state->op.buf = wop->buf;
-  state->op.handler.context = (void *)handle;
-  state->op.handler.callback = continue_spi_write;
-  state->op.tid = wop->tid;
-
-  return config->device.driver.write(&config->device.handle, &(state->op));
+  return write_block(handle);
 }
 
 int drive_sdspi_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
@@ -804,7 +959,7 @@ exec_cmd_r1(const devfs_handle_t *handle, uint8_t cmd, uint32_t arg, uint8_t *r)
   }
   drive_sdspi_r_t ret;
   send_cmd(handle, cmd, arg, response);
-  memset(r, 0xFF, sizeof(drive_sdspi_r_t));
+  memset(&ret, 0xFF, sizeof(drive_sdspi_r_t));
   if (parse_response(response, 1, &ret, 0) == false) {
     memset(&ret, 0xFF, sizeof(drive_sdspi_r_t));
   }
@@ -3,6 +3,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <stddef.h>
+#include <string.h>
 
 #include "device/fifo.h"
 #include "sos/debug.h"
@@ -77,12 +78,12 @@ int fifo_read_buffer(
   fifo_state_t *state,
   char *buf,
   int nbyte) {
-  int i;
+  int i = 0;
   u16 size = config->size;
   int read_was_clobbered = 0;
   char *dest_buffer = config->buffer;
   fifo_atomic_position_t atomic_position;
-  for (i = 0; i < nbyte; i++) {
+  while (i < nbyte) {
 
     state->o_flags |= FIFO_FLAG_IS_READ_BUSY;
     atomic_position.atomic_access =
@@ -94,8 +95,16 @@ int fifo_read_buffer(
         // buffer is full -- restore tail position
         atomic_position.access.tail = atomic_position.access.head;
       }
-      buf[i] = dest_buffer[atomic_position.access.tail];
-      atomic_position.access.tail++;
+
+      // copy up to the head or the end of the buffer (whichever comes first)
+      int count = (atomic_position.access.head > atomic_position.access.tail)
+                    ? atomic_position.access.head - atomic_position.access.tail
+                    : size - atomic_position.access.tail;
+      if (count > nbyte - i) {
+        count = nbyte - i;
+      }
+      memcpy(buf + i, dest_buffer + atomic_position.access.tail, count);
+      atomic_position.access.tail += count;
       if (atomic_position.access.tail == size) {
         atomic_position.access.tail = 0;
       }
@@ -114,6 +123,8 @@ int fifo_read_buffer(
         return i;
       }
 
+      i += count;
+
     } else {
       state->o_flags &= ~(FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY | FIFO_FLAG_IS_READ_BUSY);
       break;
@@ -128,16 +139,40 @@ int fifo_write_buffer(
   const char *buf,
   int nbyte,
   int non_blocking) {
-  int i;
+  int i = 0;
   int size = cfgp->size;
   int writeblock = 1;
   if (non_blocking == 0) {
     writeblock = fifo_is_writeblock(state);
   }
-  for (i = 0; i < nbyte; i++) {
+  while (i < nbyte) {
     if (fifo_is_write_ok(state, size, writeblock)) {
-      cfgp->buffer[state->atomic_position.access.head] = buf[i];
-      fifo_inc_head(state, size);
+      fifo_atomic_position_t atomic_position;
+      atomic_position.atomic_access =
+        state->atomic_position
+          .atomic_access; // cppcheck-suppress[unreadVariable] read as union
+
+      // copy up to the tail or the end of the buffer (whichever comes first)
+      // when the buffer is full (overflow), the oldest data is overwritten
+      int count = (atomic_position.access.tail > atomic_position.access.head)
+                    ? atomic_position.access.tail - atomic_position.access.head
+                    : size - atomic_position.access.head;
+      if (count > nbyte - i) {
+        count = nbyte - i;
+      }
+      memcpy(cfgp->buffer + atomic_position.access.head, buf + i, count);
+
+      // publish the new head once for the whole span
+      atomic_position.access.head += count;
+      if (atomic_position.access.head == size) {
+        atomic_position.access.head = 0;
+      }
+      state->atomic_position.access.head = atomic_position.access.head;
+      if (atomic_position.access.head == state->atomic_position.access.tail) {
+        // set tail to size when full
+        state->atomic_position.access.tail = size;
+      }
+      i += count;
     } else {
       break;
     }
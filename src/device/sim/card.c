@@ -0,0 +1,225 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "card.h"
+#include "mcu/crc.h"
+
+#define QUEUE_SIZE 4096
+
+enum {
+  CARD_STATE_IDLE,
+  CARD_STATE_READ_STREAM, // CMD18 until CMD12
+  CARD_STATE_WRITE_TOKEN, // CMD24/CMD25 waiting for a start (or stop) token
+  CARD_STATE_WRITE_DATA,
+  CARD_STATE_BUSY // data line held low
+};
+
+card_t card = {.busy_max = 40, .gap_max = 24};
+u8 card_memory[CARD_BLOCK_COUNT][CARD_BLOCK_SIZE];
+
+static int m_state;
+static int m_next_state; // after busy
+static int m_busy;
+static int m_is_multiple;
+static int m_is_app;
+static u32 m_block;
+static u8 m_command[6];
+static int m_command_size;
+static u8 m_data[CARD_BLOCK_SIZE + 2];
+static int m_data_size;
+
+// bytes waiting to be sent
+static u8 m_queue[QUEUE_SIZE];
+static int m_head;
+static int m_tail;
+
+// the bitwise versions of the mcu library functions
+u16 mcu_calc_crc16(u16 seed, u16 polynomial, const u8 *buffer, u32 nbyte) {
+  u16 crc = seed;
+  for (u32 i = 0; i < nbyte; i++) {
+    crc ^= buffer[i] << 8;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ polynomial : crc << 1;
+    }
+  }
+  return crc;
+}
+
+u8 mcu_calc_crc7(u8 seed, u8 polynomial, const u8 *chr, u32 len) {
+  u8 crc = seed;
+  for (u32 i = 0; i < len; i++) {
+    u8 c = chr[i];
+    for (int bit = 0; bit < 8; bit++) {
+      crc <<= 1;
+      if ((c ^ crc) & 0x80) {
+        crc ^= polynomial;
+      }
+      c <<= 1;
+    }
+  }
+  return (crc << 1) | 1;
+}
+
+static void push(u8 value) { m_queue[m_tail++ % QUEUE_SIZE] = value; }
+
+static void push_block(u32 block) {
+  const u8 *data = card_memory[block % CARD_BLOCK_COUNT];
+  const int gap = rand() % (card.gap_max + 1);
+  u16 crc = mcu_calc_crc16(0, 0x1021, data, CARD_BLOCK_SIZE);
+  if (card.corrupt_read && (rand() % card.corrupt_read == 0)) {
+    crc ^= 1;
+  }
+  for (int i = 0; i < gap; i++) {
+    push(0xFF);
+  }
+  push(0xFE);
+  for (int i = 0; i < CARD_BLOCK_SIZE; i++) {
+    push(data[i]);
+  }
+  push(crc >> 8);
+  push(crc);
+}
+
+static void start_busy(int next_state) {
+  m_state = CARD_STATE_BUSY;
+  m_busy = rand() % (card.busy_max + 1);
+  m_next_state = next_state;
+}
+
+static void execute_command() {
+  const u8 command = m_command[0] & 0x3F;
+  const u32 arg = ((u32)m_command[1] << 24) | (m_command[2] << 16) | (m_command[3] << 8)
+                  | m_command[4];
+  const int is_app = m_is_app;
+
+  card.command_count[command]++;
+  if (mcu_calc_crc7(0, 0x09, m_command, 5) != m_command[5]) {
+    push(0xFF);
+    push(0x08); // CRC error
+    return;
+  }
+
+  if (command == 12) {
+    if (m_state != CARD_STATE_READ_STREAM) {
+      push(0xFF);
+      push(0x04);
+      return;
+    }
+    // a stuff byte replaces the data in flight then R1b
+    m_head = m_tail = 0;
+    push(0x3C);
+    push(0x00);
+    start_busy(CARD_STATE_IDLE);
+    return;
+  }
+
+  if (m_state == CARD_STATE_READ_STREAM) {
+    card.error_count++;
+    return;
+  }
+
+  m_is_app = 0;
+  push(0xFF);
+  switch (command) {
+  case 17:
+    push(0x00);
+    push_block(arg);
+    break;
+  case 18:
+    push(0x00);
+    m_block = arg;
+    m_state = CARD_STATE_READ_STREAM;
+    break;
+  case 24:
+  case 25:
+    push(0x00);
+    m_block = arg;
+    m_is_multiple = command == 25;
+    m_state = CARD_STATE_WRITE_TOKEN;
+    break;
+  case 55:
+    push(0x00);
+    m_is_app = 1;
+    break;
+  case 23:
+    push(is_app ? 0x00 : 0x04);
+    break;
+  default:
+    push(0x04); // illegal command
+    break;
+  }
+}
+
+static void receive_data(u8 value) {
+  m_data[m_data_size++] = value;
+  if (m_data_size < (int)sizeof(m_data)) {
+    return;
+  }
+
+  const u16 crc = (m_data[CARD_BLOCK_SIZE] << 8) | m_data[CARD_BLOCK_SIZE + 1];
+  if (
+    (crc == mcu_calc_crc16(0, 0x1021, m_data, CARD_BLOCK_SIZE))
+    && ((card.reject_write == 0) || (rand() % card.reject_write != 0))) {
+    memcpy(card_memory[m_block++ % CARD_BLOCK_COUNT], m_data, CARD_BLOCK_SIZE);
+    push(0xE5); // data accepted
+  } else {
+    push(0xEB); // CRC error
+  }
+  start_busy(m_is_multiple ? CARD_STATE_WRITE_TOKEN : CARD_STATE_IDLE);
+}
+
+u8 card_swap(u8 value) {
+  u8 result = 0xFF;
+  card.byte_count++;
+
+  if (m_head != m_tail) {
+    result = m_queue[m_head++ % QUEUE_SIZE];
+  } else if (m_state == CARD_STATE_BUSY) {
+    if (m_busy > 0) {
+      m_busy--;
+      result = 0x00;
+    } else {
+      m_state = m_next_state;
+    }
+  } else if (m_state == CARD_STATE_READ_STREAM) {
+    push_block(m_block++);
+    result = m_queue[m_head++ % QUEUE_SIZE];
+  }
+  if (m_head == m_tail) {
+    m_head = m_tail = 0;
+  }
+
+  switch (m_state) {
+  case CARD_STATE_IDLE:
+  case CARD_STATE_READ_STREAM:
+    if ((m_command_size > 0) || ((value & 0xC0) == 0x40)) {
+      m_command[m_command_size++] = value;
+      if (m_command_size == sizeof(m_command)) {
+        m_command_size = 0;
+        execute_command();
+      }
+    }
+    break;
+  case CARD_STATE_WRITE_TOKEN:
+    if (value == (m_is_multiple ? 0xFC : 0xFE)) {
+      m_state = CARD_STATE_WRITE_DATA;
+      m_data_size = 0;
+    } else if (m_is_multiple && (value == 0xFD)) {
+      push(0xFF);
+      start_busy(CARD_STATE_IDLE);
+    } else if (value != 0xFF) {
+      card.error_count++;
+    }
+    break;
+  case CARD_STATE_WRITE_DATA:
+    receive_data(value);
+    break;
+  }
+  return result;
+}
+
+int card_is_idle() {
+  return (m_state == CARD_STATE_IDLE) && (m_head == m_tail) && (m_command_size == 0);
+}
@@ -0,0 +1,35 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// byte level model of an SDHC card in SPI mode for the drive_sdspi simulation
+
+#ifndef SIM_CARD_H_
+#define SIM_CARD_H_
+
+#include <sdk/types.h>
+
+#define CARD_BLOCK_SIZE 512
+#define CARD_BLOCK_COUNT 8192
+
+typedef struct {
+  // settings
+  int busy_max;     // bytes the card holds the data line low after a block or CMD12
+  int gap_max;      // 0xFF bytes before a data token
+  int corrupt_read; // 1 in corrupt_read blocks is sent with a bad CRC (0 for none)
+  int reject_write; // 1 in reject_write blocks is rejected (0 for none)
+
+  // counters
+  u32 byte_count; // bytes swapped on the bus
+  u32 command_count[64];
+  u32 error_count; // bytes or commands the card didn't expect
+} card_t;
+
+extern card_t card;
+extern u8 card_memory[CARD_BLOCK_COUNT][CARD_BLOCK_SIZE];
+
+// the byte the card sends while it receives value
+u8 card_swap(u8 value);
+
+// 1 when the card is waiting for a command -- not streaming, receiving or busy
+int card_is_idle();
+
+#endif /* SIM_CARD_H_ */
@@ -0,0 +1,302 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "device/drive_device.h"
+#include "device/drive_ram.h"
+
+#define DRIVE_SIZE (1024 * 1024)
+#define BLOCK_SIZE 512
+#define BLOCK_COUNT 64
+#define FUZZ_ROUNDS 20000
+
+static int failures;
+
+#define CHECK(x)                                                                         \
+  do {                                                                                   \
+    if (!(x)) {                                                                          \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #x);                       \
+      failures++;                                                                        \
+      return;                                                                            \
+    }                                                                                    \
+  } while (0)
+
+enum {
+  MODEL_FLAG_IS_ASYNC = (1 << 0),
+  // completes like drive_sdspi: the result in nbyte and no event
+  MODEL_FLAG_IS_SDSPI_STYLE = (1 << 1),
+  MODEL_FLAG_IS_BUSY = (1 << 2)
+};
+
+// drive_ram behind a latency model -- each transfer costs 100 us for the command
+// and 1 us for every 4 bytes
+typedef struct {
+  u32 o_flags;
+  u32 cost_us;
+  u32 transfer_count;
+  u32 ioctl_count;
+  devfs_async_t *pending;
+  int pending_result;
+} model_state_t;
+
+static u8 m_memory[DRIVE_SIZE];
+static u8 m_shadow[DRIVE_SIZE];
+static u8 m_cache[DRIVE_DEVICE_CACHE_SIZE(BLOCK_COUNT, BLOCK_SIZE)];
+static const drive_ram_config_t m_ram_config = {.memory = m_memory, .size = DRIVE_SIZE};
+static const devfs_handle_t m_ram_handle = {.config = &m_ram_config};
+static model_state_t m_model;
+
+int devfs_execute_event_handler(mcu_event_handler_t *handler, u32 o_events, void *data) {
+  mcu_event_t event = {.o_events = o_events, .data = data};
+  return handler->callback ? handler->callback(handler->context, &event) : 0;
+}
+
+static int model_open(const devfs_handle_t *handle) { return 0; }
+
+static int model_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
+  m_model.ioctl_count++;
+  if (request == I_DRIVE_ISBUSY) {
+    return (m_model.o_flags & MODEL_FLAG_IS_BUSY) != 0;
+  }
+  return drive_ram_ioctl(&m_ram_handle, request, ctl);
+}
+
+static int model_transfer(devfs_async_t *async, int is_write) {
+  if (m_model.pending) {
+    printf("drive: a transfer started before the last one completed\n");
+    exit(1);
+  }
+  const int result = is_write ? drive_ram_write(&m_ram_handle, async)
+                              : drive_ram_read(&m_ram_handle, async);
+  if (result > 0) {
+    m_model.cost_us += 100 + result / 4;
+    m_model.transfer_count++;
+  }
+  if ((result < 0) || ((m_model.o_flags & MODEL_FLAG_IS_ASYNC) == 0)) {
+    return result;
+  }
+  m_model.pending = async;
+  m_model.pending_result = result;
+  return 0;
+}
+
+static int model_read(const devfs_handle_t *handle, devfs_async_t *async) {
+  return model_transfer(async, 0);
+}
+
+static int model_write(const devfs_handle_t *handle, devfs_async_t *async) {
+  return model_transfer(async, 1);
+}
+
+static int model_close(const devfs_handle_t *handle) { return 0; }
+
+// stands in for the interrupt that ends an asynchronous transfer
+static int model_complete() {
+  devfs_async_t *async = m_model.pending;
+  if (async == NULL) {
+    return 0;
+  }
+  m_model.pending = NULL;
+  if (m_model.o_flags & MODEL_FLAG_IS_SDSPI_STYLE) {
+    async->nbyte = m_model.pending_result;
+    async->handler.callback(async->handler.context, NULL);
+  } else {
+    mcu_event_t event = {0};
+    async->result = m_model.pending_result;
+    async->handler.callback(async->handler.context, &event);
+  }
+  return 1;
+}
+
+static drive_device_state_t m_state;
+static drive_device_config_t m_config = {
+  .device = {
+    .driver = {model_open, model_ioctl, model_read, model_write, model_close}},
+  .cache_block_size = BLOCK_SIZE,
+  .cache_block_count = BLOCK_COUNT};
+static const devfs_handle_t m_handle = {.config = &m_config, .state = &m_state};
+
+static int m_is_done;
+
+static int handle_done(void *context, const mcu_event_t *event) {
+  m_is_done = 1;
+  return 0;
+}
+
+static int transfer(int is_write, int loc, void *buf, int nbyte) {
+  devfs_async_t async = {
+    .loc = loc, .buf = buf, .nbyte = nbyte, .handler = {handle_done, NULL}};
+  m_is_done = 0;
+  const int result = is_write ? drive_device_write(&m_handle, &async)
+                              : drive_device_read(&m_handle, &async);
+  if (result != 0) {
+    return result;
+  }
+  while (m_is_done == 0) {
+    if (model_complete() == 0) {
+      printf("drive: a transfer never completed\n");
+      exit(1);
+    }
+  }
+  return async.result;
+}
+
+static void wait_not_busy() {
+  while (drive_device_ioctl(&m_handle, I_DRIVE_ISBUSY, NULL) == 1) {
+    if (model_complete() == 0) {
+      printf("drive: a flush never completed\n");
+      exit(1);
+    }
+  }
+}
+
+static int set_attr(const drive_attr_t *attr) {
+  const int result = drive_device_ioctl(&m_handle, I_DRIVE_SETATTR, (void *)attr);
+  wait_not_busy();
+  return result;
+}
+
+static int flush() {
+  const drive_attr_t attr = {0};
+  return set_attr(&attr);
+}
+
+static void reset(void *cache, int read_ahead) {
+  memset(&m_state, 0, sizeof(m_state));
+  m_config.cache = cache;
+  m_config.read_ahead = read_ahead;
+  drive_device_open(&m_handle);
+  m_model.cost_us = 0;
+  m_model.transfer_count = 0;
+  m_model.ioctl_count = 0;
+}
+
+// random reads, writes, flushes and erases against a copy of what the drive holds
+static void fuzz() {
+  static u8 buffer[8192];
+  for (int round = 0; round < FUZZ_ROUNDS; round++) {
+    const int op = rand() % 100;
+    int loc = rand() % DRIVE_SIZE;
+    int nbyte = 1 + rand() % (rand() % 4 ? 600 : 8000);
+    if (rand() % 3 == 0) {
+      // most of the traffic goes to a few blocks
+      loc = (rand() % 64) * 4096 + rand() % 700;
+    }
+    if (loc + nbyte > DRIVE_SIZE) {
+      nbyte = DRIVE_SIZE - loc;
+    }
+
+    if (op < 45) {
+      for (int i = 0; i < nbyte; i++) {
+        buffer[i] = rand();
+      }
+      CHECK(transfer(1, loc, buffer, nbyte) == nbyte);
+      memcpy(m_shadow + loc, buffer, nbyte);
+    } else if (op < 97) {
+      CHECK(transfer(0, loc, buffer, nbyte) == nbyte);
+      CHECK(memcmp(buffer, m_shadow + loc, nbyte) == 0);
+    } else if ((op < 98) && (m_model.o_flags & MODEL_FLAG_IS_ASYNC)) {
+      // a read that arrives while a flush is running
+      const drive_attr_t attr = {0};
+      drive_device_ioctl(&m_handle, I_DRIVE_SETATTR, (void *)&attr);
+      CHECK(transfer(0, loc, buffer, nbyte) == nbyte);
+      CHECK(memcmp(buffer, m_shadow + loc, nbyte) == 0);
+      wait_not_busy();
+    } else if (op < 99) {
+      CHECK(flush() == 0);
+      CHECK(memcmp(m_memory, m_shadow, DRIVE_SIZE) == 0);
+    } else {
+      const drive_attr_t attr = {
+        .o_flags = DRIVE_FLAG_ERASE_BLOCKS, .start = loc, .end = loc + nbyte - 1};
+      CHECK(set_attr(&attr) >= 0);
+      memset(m_shadow + loc, 0xff, nbyte);
+    }
+  }
+  CHECK(flush() == 0);
+  CHECK(memcmp(m_memory, m_shadow, DRIVE_SIZE) == 0);
+}
+
+// synchronous and asynchronous drives, both completion styles, with and without
+// read ahead
+static void test_cache() {
+  for (int mode = 0; mode < 8; mode++) {
+    const int read_ahead = (mode & 4) ? 4 : 0;
+    m_model.o_flags = mode & (MODEL_FLAG_IS_ASYNC | MODEL_FLAG_IS_SDSPI_STYLE);
+    for (int i = 0; i < DRIVE_SIZE; i++) {
+      m_memory[i] = m_shadow[i] = i * 7;
+    }
+    reset(m_cache, read_ahead);
+    srand(mode + 1);
+    const int start_failures = failures;
+    fuzz();
+    if (failures != start_failures) {
+      printf("cache: mode %d (read ahead %d) failed\n", mode, read_ahead);
+      return;
+    }
+  }
+}
+
+// without a cache every request goes to the wrapped drive
+static void test_pass_through() {
+  drive_info_t info;
+  m_model.o_flags = MODEL_FLAG_IS_BUSY;
+  reset(NULL, 0);
+  CHECK(drive_device_ioctl(&m_handle, I_DRIVE_ISBUSY, NULL) == 1);
+  m_model.o_flags = 0;
+  CHECK(drive_device_ioctl(&m_handle, I_DRIVE_ISBUSY, NULL) == 0);
+
+  memset(&info, 0, sizeof(info));
+  CHECK(drive_device_ioctl(&m_handle, I_DRIVE_GETINFO, &info) == 0);
+  CHECK((u64)info.num_write_blocks * info.write_block_size == DRIVE_SIZE);
+  CHECK(m_model.ioctl_count == 3);
+}
+
+// transfer time the latency model adds up for typical file system traffic
+static void bench_drive(const char *name, void *cache, int read_ahead) {
+  static u8 buffer[256];
+  reset(cache, read_ahead);
+
+  // a few small records read again and again (directory entries, allocation table)
+  for (int i = 0; i < 2000; i++) {
+    transfer(0, (i % 8) * 4096 + (i % 3) * 64, buffer, 64);
+  }
+  const u32 metadata = m_model.cost_us;
+  m_model.cost_us = 0;
+
+  for (int loc = 0; loc < 256 * 1024; loc += sizeof(buffer)) {
+    transfer(0, loc, buffer, sizeof(buffer));
+  }
+  const u32 sequential = m_model.cost_us;
+  m_model.cost_us = 0;
+
+  for (int i = 0; i < 2000; i++) {
+    transfer(1, 300000 + (i % 16) * 32, buffer, 32);
+  }
+  flush();
+  printf(
+    "bench: %-20s metadata %7u us, sequential 256 KiB %7u us, 2000 small writes %7u "
+    "us\n",
+    name, metadata, sequential, m_model.cost_us);
+}
+
+static void bench() {
+  m_model.o_flags = MODEL_FLAG_IS_ASYNC;
+  bench_drive("no cache", NULL, 0);
+  bench_drive("cache", m_cache, 0);
+  bench_drive("cache, read ahead 4", m_cache, 4);
+  bench_drive("cache, read ahead 8", m_cache, 8);
+}
+
+int main() {
+  test_cache();
+  test_pass_through();
+  if (failures) {
+    printf("FAILED (%d)\n", failures);
+    return 1;
+  }
+  bench();
+  printf("PASSED\n");
+  return 0;
+}
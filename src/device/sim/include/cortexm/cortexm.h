@@ -0,0 +1,12 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// host build stand-in for the delay used by drive_sdspi -- the simulation keeps time
+
+#ifndef SIM_CORTEXM_CORTEXM_H_
+#define SIM_CORTEXM_CORTEXM_H_
+
+#include <sdk/types.h>
+
+void cortexm_delay_us(u32 us);
+
+#endif /* SIM_CORTEXM_CORTEXM_H_ */
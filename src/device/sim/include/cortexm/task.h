@@ -0,0 +1,18 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// host build stand-in for the task table -- drive_sdspi sets errno on a failure
+
+#ifndef SIM_CORTEXM_TASK_H_
+#define SIM_CORTEXM_TASK_H_
+
+struct _reent {
+  int _errno;
+};
+
+typedef struct {
+  struct _reent *reent;
+} task_t;
+
+extern task_t sos_task_table[];
+
+#endif /* SIM_CORTEXM_TASK_H_ */
@@ -0,0 +1,8 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// the drives don't use anything from the real header on the host
+
+#ifndef SIM_MCU_CORE_H_
+#define SIM_MCU_CORE_H_
+
+#endif /* SIM_MCU_CORE_H_ */
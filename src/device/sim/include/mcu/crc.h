@@ -0,0 +1,13 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// host build stand-in for the crc functions that drive_sdspi uses
+
+#ifndef SIM_MCU_CRC_H_
+#define SIM_MCU_CRC_H_
+
+#include <sdk/types.h>
+
+u16 mcu_calc_crc16(u16 seed, u16 polynomial, const u8 *buffer, u32 nbyte);
+u8 mcu_calc_crc7(u8 seed, u8 polynomial, const u8 *chr, u32 len);
+
+#endif /* SIM_MCU_CRC_H_ */
@@ -0,0 +1,10 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// drive_sdspi only needs the pio attributes from the real header on the host
+
+#ifndef SIM_MCU_PIO_H_
+#define SIM_MCU_PIO_H_
+
+#include "sos/dev/pio.h"
+
+#endif /* SIM_MCU_PIO_H_ */
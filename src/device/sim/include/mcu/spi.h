@@ -0,0 +1,11 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// drive_sdspi only needs the spi attributes and requests from the real header on the
+// host
+
+#ifndef SIM_MCU_SPI_H_
+#define SIM_MCU_SPI_H_
+
+#include "sos/dev/spi.h"
+
+#endif /* SIM_MCU_SPI_H_ */
@@ -0,0 +1,10 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// host build stand-in for the watchdog -- there is none
+
+#ifndef SIM_MCU_WDT_H_
+#define SIM_MCU_WDT_H_
+
+#define mcu_wdt_root_reset(args)
+
+#endif /* SIM_MCU_WDT_H_ */
@@ -0,0 +1,10 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// the simulated drivers don't log
+
+#ifndef SIM_SOS_DEBUG_H_
+#define SIM_SOS_DEBUG_H_
+
+#define sos_debug_printf(...)
+
+#endif /* SIM_SOS_DEBUG_H_ */
@@ -0,0 +1,118 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// host build stand-in for the devfs and mcu types used by the fifo and the drives
+
+#ifndef SIM_SOS_FS_DEVFS_H_
+#define SIM_SOS_FS_DEVFS_H_
+
+#include <errno.h>
+#include <sdk/types.h>
+
+#define SYSFS_SET_RETURN(error_number) (-1 * (error_number | (__LINE__ << 8)))
+#define SYSFS_GET_RETURN_ERRNO(value) ((-1 * value) & 0xff)
+#define SYSFS_GET_RETURN(value) (-1 * ((-1 * value) >> 8))
+
+enum {
+  MCU_EVENT_FLAG_DATA_READY = (1 << 1),
+  MCU_EVENT_FLAG_WRITE_COMPLETE = (1 << 2),
+  MCU_EVENT_FLAG_CANCELED = (1 << 15)
+};
+
+typedef struct {
+  u32 o_events;
+  void *data;
+} mcu_event_t;
+
+typedef int (*mcu_callback_t)(void *context, const mcu_event_t *data);
+
+typedef struct {
+  mcu_callback_t callback;
+  void *context;
+} mcu_event_handler_t;
+
+typedef struct {
+  u8 channel;
+  s8 prio;
+  u32 o_events;
+  mcu_event_handler_t handler;
+} mcu_action_t;
+
+#define I_MCU_SETACTION _IOCTLW('m', 2, mcu_action_t)
+
+typedef struct {
+  u32 port;
+  const void *config;
+  void *state;
+} devfs_handle_t;
+
+typedef struct {
+  int tid;
+  int flags;
+  int loc;
+  union {
+    const void *buf_const;
+    void *buf;
+  };
+  int nbyte;
+  int result;
+  mcu_event_handler_t handler;
+} devfs_async_t;
+
+typedef struct {
+  devfs_async_t *read;
+  devfs_async_t *write;
+} devfs_transfer_handler_t;
+
+typedef struct {
+  int (*open)(const devfs_handle_t *);
+  int (*ioctl)(const devfs_handle_t *, int, void *);
+  int (*read)(const devfs_handle_t *, devfs_async_t *);
+  int (*write)(const devfs_handle_t *, devfs_async_t *);
+  int (*close)(const devfs_handle_t *);
+} devfs_driver_t;
+
+typedef struct {
+  char name[24];
+  u16 uid;
+  u16 mode;
+  devfs_driver_t driver;
+  devfs_handle_t handle;
+  u32 size;
+} devfs_device_t;
+
+#define DEVFS_DRIVER_DECLARE_CONFIG_STATE(object)                                        \
+  const object##_config_t *config = handle->config;                                      \
+  object##_state_t *state = (object##_state_t *)handle->state
+
+#define DEVFS_DRIVER_DECLARTION(driver_name)                                             \
+  int driver_name##_open(const devfs_handle_t *);                                        \
+  int driver_name##_close(const devfs_handle_t *);                                       \
+  int driver_name##_ioctl(const devfs_handle_t *, int, void *);                          \
+  int driver_name##_read(const devfs_handle_t *, devfs_async_t *);                       \
+  int driver_name##_write(const devfs_handle_t *, devfs_async_t *)
+
+#define DEVFS_DRIVER_DECLARTION_IOCTL_REQUEST(driver_name, request)                      \
+  int driver_name##_##request(const devfs_handle_t *, void *)
+
+#define DEVFS_DRIVER_IS_BUSY(transfer, async)                                            \
+  if (transfer) {                                                                        \
+    return SYSFS_SET_RETURN(EBUSY);                                                      \
+  }                                                                                      \
+  if (async->nbyte == 0) {                                                               \
+    return 0;                                                                            \
+  }                                                                                      \
+  transfer = async
+
+int devfs_execute_event_handler(mcu_event_handler_t *handler, u32 o_events, void *data);
+int devfs_execute_read_handler(
+  devfs_transfer_handler_t *transfer_handler,
+  void *data,
+  int nbyte,
+  u32 o_flags);
+int devfs_execute_write_handler(
+  devfs_transfer_handler_t *transfer_handler,
+  void *data,
+  int nbyte,
+  u32 o_flags);
+
+#endif /* SIM_SOS_FS_DEVFS_H_ */
@@ -0,0 +1,23 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// host build stand-in for the parts of sos_config that the drives use
+
+#ifndef SIM_SOS_SOS_H_
+#define SIM_SOS_SOS_H_
+
+#include <string.h>
+
+#include "sos/dev/pio.h"
+
+typedef struct {
+  void (*pio_set_attributes)(int port, const pio_attr_t *attr);
+  void (*pio_write)(int port, u32 mask, int value);
+} sos_sys_config_t;
+
+typedef struct {
+  sos_sys_config_t sys;
+} sos_config_t;
+
+extern const sos_config_t sos_config;
+
+#endif /* SIM_SOS_SOS_H_ */
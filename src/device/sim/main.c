@@ -0,0 +1,209 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "device/fifo.h"
+
+static int failures;
+
+#define CHECK(x)                                                                         \
+  do {                                                                                   \
+    if (!(x)) {                                                                          \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #x);                       \
+      failures++;                                                                        \
+      return;                                                                            \
+    }                                                                                    \
+  } while (0)
+
+int devfs_execute_read_handler(
+  devfs_transfer_handler_t *transfer_handler,
+  void *data,
+  int nbyte,
+  u32 o_flags) {
+  transfer_handler->read = NULL;
+  return 0;
+}
+
+int devfs_execute_write_handler(
+  devfs_transfer_handler_t *transfer_handler,
+  void *data,
+  int nbyte,
+  u32 o_flags) {
+  transfer_handler->write = NULL;
+  return 0;
+}
+
+void sos_handle_event(int event, void *args) {}
+
+// the previous fifo copied one byte at a time -- the spans must behave the same way
+static int ref_read_buffer(
+  const fifo_config_t *config,
+  fifo_state_t *state,
+  char *buf,
+  int nbyte) {
+  int i;
+  u16 size = config->size;
+  fifo_atomic_position_t position;
+  for (i = 0; i < nbyte; i++) {
+    position.atomic_access = state->atomic_position.atomic_access;
+    if (position.access.head == position.access.tail) {
+      break;
+    }
+    if (position.access.tail == size) {
+      position.access.tail = position.access.head;
+    }
+    buf[i] = config->buffer[position.access.tail];
+    position.access.tail++;
+    if (position.access.tail == size) {
+      position.access.tail = 0;
+    }
+    state->atomic_position.access.tail = position.access.tail;
+  }
+  state->o_flags &= ~(FIFO_FLAG_IS_WRITE_WHILE_READ_BUSY | FIFO_FLAG_IS_READ_BUSY);
+  return i;
+}
+
+static int ref_write_buffer(
+  const fifo_config_t *config,
+  fifo_state_t *state,
+  const char *buf,
+  int nbyte,
+  int non_blocking) {
+  int i;
+  const int writeblock = non_blocking ? 1 : fifo_is_writeblock(state);
+  for (i = 0; i < nbyte; i++) {
+    if (fifo_is_write_ok(state, config->size, writeblock) == 0) {
+      break;
+    }
+    config->buffer[state->atomic_position.access.head] = buf[i];
+    fifo_inc_head(state, config->size);
+  }
+  return i;
+}
+
+#define BUFFER_MAX 128
+
+// random reads and writes on every fifo size give the same results as the byte copies
+static void test_random() {
+  for (int size = 1; size < 70; size++) {
+    for (int writeblock = 0; writeblock < 2; writeblock++) {
+      char ref_buffer[BUFFER_MAX];
+      char buffer[BUFFER_MAX];
+      const fifo_config_t ref_config = {.size = size, .buffer = ref_buffer};
+      const fifo_config_t config = {.size = size, .buffer = buffer};
+      fifo_state_t ref_state = {0};
+      fifo_state_t state = {0};
+      fifo_set_writeblock(&ref_state, writeblock);
+      fifo_set_writeblock(&state, writeblock);
+
+      srand(size);
+      for (int step = 0; step < 20000; step++) {
+        char data[2 * BUFFER_MAX];
+        char ref_out[2 * BUFFER_MAX];
+        char out[2 * BUFFER_MAX];
+        const int nbyte = rand() % (2 * size + 3);
+        for (int i = 0; i < nbyte; i++) {
+          data[i] = rand();
+        }
+
+        int ref_result;
+        int result;
+        if (rand() % 2) {
+          const int non_blocking = rand() % 2;
+          ref_result = ref_write_buffer(&ref_config, &ref_state, data, nbyte, non_blocking);
+          result = fifo_write_buffer(&config, &state, data, nbyte, non_blocking);
+        } else {
+          ref_result = ref_read_buffer(&ref_config, &ref_state, ref_out, nbyte);
+          result = fifo_read_buffer(&config, &state, out, nbyte);
+          CHECK(result != ref_result || memcmp(out, ref_out, result) == 0);
+        }
+
+        if (
+          (result != ref_result)
+          || (state.atomic_position.atomic_access
+              != ref_state.atomic_position.atomic_access)
+          || (state.o_flags != ref_state.o_flags)) {
+          printf("random: size %d step %d: %d != %d\n", size, step, result, ref_result);
+          failures++;
+          return;
+        }
+      }
+    }
+  }
+}
+
+// a full fifo overflows unless writes block
+static void test_full() {
+  char buffer[8];
+  const fifo_config_t config = {.size = sizeof(buffer), .buffer = buffer};
+  fifo_state_t state = {0};
+  char out[16];
+
+  CHECK(fifo_write_buffer(&config, &state, "0123456789", 10, 0) == 10);
+  CHECK(fifo_is_overflow(&state));
+  CHECK(fifo_read_buffer(&config, &state, out, sizeof(out)) == 8);
+  CHECK(memcmp(out, "23456789", 8) == 0);
+
+  fifo_flush(&state);
+  fifo_set_overflow(&state, 0);
+  CHECK(fifo_write_buffer(&config, &state, "0123456789", 10, 1) == 8);
+  CHECK(fifo_is_overflow(&state) == 0);
+  CHECK(fifo_read_buffer(&config, &state, out, 3) == 3);
+  CHECK(fifo_write_buffer(&config, &state, "abcd", 4, 1) == 3);
+  CHECK(fifo_read_buffer(&config, &state, out, sizeof(out)) == 8);
+  CHECK(memcmp(out, "34567abc", 8) == 0);
+}
+
+static double now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// half the fifo written then read back, byte copies against spans
+static void bench() {
+  static const int sizes[] = {64, 256, 1024, 4096};
+  static char data[4096];
+  static char out[4096];
+  const int loops = 100000;
+
+  for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    const int size = sizes[s];
+    char *buffer = malloc(size);
+    const fifo_config_t config = {.size = size, .buffer = buffer};
+    double rate[2];
+    for (int is_span = 0; is_span < 2; is_span++) {
+      fifo_state_t state = {0};
+      long total = 0;
+      const double start = now_ns();
+      for (int i = 0; i < loops; i++) {
+        const int chunk = size / 2 + (i % 7);
+        if (is_span) {
+          total += fifo_write_buffer(&config, &state, data, chunk, 0);
+          fifo_read_buffer(&config, &state, out, chunk);
+        } else {
+          total += ref_write_buffer(&config, &state, data, chunk, 0);
+          ref_read_buffer(&config, &state, out, chunk);
+        }
+      }
+      rate[is_span] = total / (now_ns() - start) * 1e3;
+    }
+    printf("bench: %5d byte fifo: bytes %.0f MB/s, spans %.0f MB/s\n", size, rate[0], rate[1]);
+    free(buffer);
+  }
+}
+
+int main() {
+  test_random();
+  test_full();
+  if (failures) {
+    printf("FAILED (%d)\n", failures);
+    return 1;
+  }
+  bench();
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,327 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "card.h"
+#include "cortexm/task.h"
+#include "device/drive_sdspi.h"
+#include "sos/sos.h"
+
+#define BUFFER_BLOCKS 64
+#define RANDOM_ROUNDS 3000
+#define ERROR_ROUNDS 400
+#define STOP_ROUNDS 200
+#define BUSY_MAX 2000
+
+static int failures;
+
+#define CHECK(x)                                                                         \
+  do {                                                                                   \
+    if (!(x)) {                                                                          \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #x);                       \
+      failures++;                                                                        \
+      return;                                                                            \
+    }                                                                                    \
+  } while (0)
+
+// the spi driver swaps the bytes of an asynchronous transfer when it completes -- like
+// dma followed by the interrupt
+typedef struct {
+  devfs_async_t *pending;
+  int is_write;
+  int fail_countdown; // the transfer that brings this to zero fails
+  u32 callback_bytes; // most bytes swapped from inside one completion callback
+} spi_model_t;
+
+static spi_model_t m_spi;
+static int m_is_selected;
+static u64 m_delay_us;
+static struct _reent m_reent;
+static u8 m_shadow[CARD_BLOCK_COUNT][CARD_BLOCK_SIZE];
+
+task_t sos_task_table[1] = {{&m_reent}};
+
+void cortexm_delay_us(u32 us) { m_delay_us += us; }
+
+static void pio_set_attributes(int port, const pio_attr_t *attr) {}
+
+static void pio_write(int port, u32 mask, int value) { m_is_selected = value == 0; }
+
+const sos_config_t sos_config = {
+  .sys = {.pio_set_attributes = pio_set_attributes, .pio_write = pio_write}};
+
+static int spi_open(const devfs_handle_t *handle) { return 0; }
+
+static int spi_ioctl(const devfs_handle_t *handle, int request, void *ctl) {
+  if (request == I_SPI_SWAP) {
+    return card_swap((u8)(ssize_t)ctl);
+  }
+  return 0;
+}
+
+static int spi_transfer(devfs_async_t *async, int is_write) {
+  if (m_spi.pending) {
+    printf("sdspi: a transfer started before the last one completed\n");
+    exit(1);
+  }
+  if (m_spi.fail_countdown && (--m_spi.fail_countdown == 0)) {
+    return SYSFS_SET_RETURN(EIO);
+  }
+  m_spi.pending = async;
+  m_spi.is_write = is_write;
+  return 0;
+}
+
+static int spi_read(const devfs_handle_t *handle, devfs_async_t *async) {
+  return spi_transfer(async, 0);
+}
+
+static int spi_write(const devfs_handle_t *handle, devfs_async_t *async) {
+  return spi_transfer(async, 1);
+}
+
+static int spi_close(const devfs_handle_t *handle) { return 0; }
+
+static int spi_complete() {
+  devfs_async_t *async = m_spi.pending;
+  if (async == NULL) {
+    return 0;
+  }
+  m_spi.pending = NULL;
+  for (int i = 0; i < async->nbyte; i++) {
+    if (m_spi.is_write) {
+      card_swap(((const u8 *)async->buf_const)[i]);
+    } else {
+      ((u8 *)async->buf)[i] = card_swap(0xFF);
+    }
+  }
+
+  const u32 start = card.byte_count;
+  mcu_event_t event = {0};
+  async->handler.callback(async->handler.context, &event);
+  if (card.byte_count - start > m_spi.callback_bytes) {
+    m_spi.callback_bytes = card.byte_count - start;
+  }
+  return 1;
+}
+
+static drive_sdspi_state_t m_state;
+static const drive_sdspi_config_t m_config = {
+  .device = {.driver = {spi_open, spi_ioctl, spi_read, spi_write, spi_close}}};
+static const devfs_handle_t m_handle = {.config = &m_config, .state = &m_state};
+
+static int m_is_done;
+
+static int handle_done(void *context, const mcu_event_t *event) {
+  m_is_done = 1;
+  return 0;
+}
+
+// count blocks from block -- the result is the number of bytes or less than zero
+static int transfer(int is_write, int block, void *buf, int count) {
+  devfs_async_t async = {
+    .loc = block,
+    .buf = buf,
+    .nbyte = count * CARD_BLOCK_SIZE,
+    .handler = {handle_done, NULL}};
+  int result;
+  int tries = 0;
+  m_is_done = 0;
+  do {
+    // a write leaves the card busy for the next request to check
+    result = is_write ? drive_sdspi_write(&m_handle, &async)
+                      : drive_sdspi_read(&m_handle, &async);
+  } while ((result < 0) && (SYSFS_GET_RETURN_ERRNO(result) == EBUSY) && (++tries < 10000));
+  if (result != 0) {
+    return result;
+  }
+  while (m_is_done == 0) {
+    if (spi_complete() == 0) {
+      printf("sdspi: a transfer never completed\n");
+      exit(1);
+    }
+  }
+  return async.nbyte;
+}
+
+static void fill(u8 *buffer, int count) {
+  for (int i = 0; i < count * CARD_BLOCK_SIZE; i++) {
+    buffer[i] = rand();
+  }
+}
+
+static void reset_card() {
+  for (int block = 0; block < CARD_BLOCK_COUNT; block++) {
+    for (int i = 0; i < CARD_BLOCK_SIZE; i++) {
+      card_memory[block][i] = m_shadow[block][i] = block * 3 + i;
+    }
+  }
+}
+
+// single and multiple block requests against a copy of what the card holds
+static void test_random() {
+  static u8 buffer[BUFFER_BLOCKS * CARD_BLOCK_SIZE];
+  for (int round = 0; round < RANDOM_ROUNDS; round++) {
+    const int count = 1 + (rand() % 4 ? rand() % 4 : rand() % BUFFER_BLOCKS);
+    const int block = rand() % (CARD_BLOCK_COUNT - count);
+    const int nbyte = count * CARD_BLOCK_SIZE;
+    if (rand() % 2) {
+      fill(buffer, count);
+      CHECK(transfer(1, block, buffer, count) == nbyte);
+      memcpy(m_shadow[block], buffer, nbyte);
+    } else {
+      CHECK(transfer(0, block, buffer, count) == nbyte);
+      CHECK(memcmp(buffer, m_shadow[block], nbyte) == 0);
+    }
+    CHECK(m_is_selected == 0);
+  }
+  CHECK(memcmp(card_memory, m_shadow, sizeof(m_shadow)) == 0);
+  CHECK(card.error_count == 0);
+}
+
+// the card is usable after requests that fail
+static void check_usable(u8 *buffer) {
+  fill(buffer, 1);
+  CHECK(transfer(1, 100, buffer, 1) == CARD_BLOCK_SIZE);
+  memcpy(m_shadow[100], buffer, CARD_BLOCK_SIZE);
+  CHECK(transfer(0, 90, buffer, 32) == 32 * CARD_BLOCK_SIZE);
+  CHECK(memcmp(buffer, m_shadow[90], 32 * CARD_BLOCK_SIZE) == 0);
+  CHECK(card.error_count == 0);
+}
+
+// bad read CRCs and rejected writes fail the request -- bad data is never returned
+static void test_errors() {
+  static u8 buffer[BUFFER_BLOCKS * CARD_BLOCK_SIZE];
+  int failed = 0;
+  card.corrupt_read = 40;
+  card.reject_write = 40;
+  for (int round = 0; round < ERROR_ROUNDS; round++) {
+    const int count = 1 + rand() % 16;
+    const int block = rand() % (CARD_BLOCK_COUNT - count);
+    const int nbyte = count * CARD_BLOCK_SIZE;
+    int result;
+    if (rand() % 2) {
+      fill(buffer, count);
+      result = transfer(1, block, buffer, count);
+      // blocks before the rejected one are written
+      memcpy(m_shadow[block], result == nbyte ? buffer : card_memory[block], nbyte);
+    } else {
+      result = transfer(0, block, buffer, count);
+      CHECK((result < 0) || (memcmp(buffer, m_shadow[block], nbyte) == 0));
+    }
+    CHECK((result == nbyte) || ((result < 0) && (m_reent._errno != 0)));
+    CHECK(m_is_selected == 0);
+    failed += result < 0;
+  }
+  card.corrupt_read = 0;
+  card.reject_write = 0;
+  CHECK(failed > 0);
+  check_usable(buffer);
+}
+
+// the busy time after a block, CMD12 and a failure is polled by asynchronous reads
+// instead of from inside the completion callback
+static void test_stop() {
+  static u8 buffer[BUFFER_BLOCKS * CARD_BLOCK_SIZE];
+  card.busy_max = BUSY_MAX;
+  card.corrupt_read = 20;
+  card.reject_write = 20;
+  m_spi.callback_bytes = 0;
+  for (int round = 0; round < STOP_ROUNDS; round++) {
+    const int count = 2 + rand() % 15;
+    const int block = rand() % (CARD_BLOCK_COUNT - count);
+    const int nbyte = count * CARD_BLOCK_SIZE;
+    if (rand() % 2) {
+      fill(buffer, count);
+      const int result = transfer(1, block, buffer, count);
+      memcpy(m_shadow[block], result == nbyte ? buffer : card_memory[block], nbyte);
+    } else {
+      const int result = transfer(0, block, buffer, count);
+      CHECK((result < 0) || (memcmp(buffer, m_shadow[block], nbyte) == 0));
+    }
+    CHECK(m_is_selected == 0);
+  }
+  card.busy_max = 40;
+  card.corrupt_read = 0;
+  card.reject_write = 0;
+  printf(
+    "stop: busy for up to %d bytes: %u bytes swapped in one completion callback\n", BUSY_MAX,
+    m_spi.callback_bytes);
+  CHECK(m_spi.callback_bytes <= 2 * 16);
+  check_usable(buffer);
+}
+
+// an spi read that fails in the middle of CMD18 stops the card and releases it
+static void test_read_failure() {
+  static u8 buffer[8 * CARD_BLOCK_SIZE];
+  for (int countdown = 2; countdown < 10; countdown++) {
+    const u32 stop_count = card.command_count[12];
+    m_reent._errno = 0;
+    m_spi.fail_countdown = countdown;
+    const int result = transfer(0, 200, buffer, 8);
+    m_spi.fail_countdown = 0;
+    CHECK(result < 0);
+    CHECK(m_reent._errno == EINVAL);
+    CHECK(card.command_count[12] == stop_count + 1);
+    CHECK(m_is_selected == 0);
+    CHECK(transfer(0, 300, buffer, 8) == 8 * CARD_BLOCK_SIZE);
+    CHECK(memcmp(buffer, m_shadow[300], 8 * CARD_BLOCK_SIZE) == 0);
+  }
+  CHECK(card.error_count == 0);
+}
+
+static u32 get_command_count() {
+  u32 result = 0;
+  for (int i = 0; i < 64; i++) {
+    result += card.command_count[i];
+  }
+  return result;
+}
+
+// 1 MiB written and read back in single block and in 8 KiB requests: commands and the
+// time at a 25 MHz clock plus the driver's delays
+static void bench() {
+  static u8 buffer[16 * CARD_BLOCK_SIZE];
+  const int sizes[] = {1, 16};
+  for (int i = 0; i < 2; i++) {
+    const int count = sizes[i];
+    u32 commands = get_command_count();
+    u32 bytes = card.byte_count;
+    u64 delay_us = m_delay_us;
+    for (int block = 0; block < 2048; block += count) {
+      transfer(1, 4096 + block, buffer, count);
+    }
+    const u32 write_commands = get_command_count() - commands;
+    const double write_ms = ((card.byte_count - bytes) * 0.32 + m_delay_us - delay_us) / 1000;
+
+    commands = get_command_count();
+    bytes = card.byte_count;
+    delay_us = m_delay_us;
+    for (int block = 0; block < 2048; block += count) {
+      transfer(0, 4096 + block, buffer, count);
+    }
+    printf(
+      "bench: 1 MiB in %5d byte requests: write %4u commands %6.0f ms, read %4u "
+      "commands %6.0f ms\n",
+      count * CARD_BLOCK_SIZE, write_commands, write_ms, get_command_count() - commands,
+      ((card.byte_count - bytes) * 0.32 + m_delay_us - delay_us) / 1000);
+  }
+}
+
+int main() {
+  srand(1);
+  reset_card();
+  test_random();
+  test_errors();
+  test_stop();
+  test_read_failure();
+  if (failures) {
+    printf("FAILED (%d)\n", failures);
+    return 1;
+  }
+  bench();
+  printf("PASSED\n");
+  return 0;
+}
@@ -60,7 +60,6 @@ int link_connect(link_transport_mdriver_t *driver, const char *sn) {
   char serialno[LINK_MAX_SN_SIZE];
   char last[LINK_PHY_NAME_MAX];
   int err;
-  int len;
 
   memset(last, 0, LINK_PHY_NAME_MAX);
 
@@ -84,25 +83,7 @@ int link_connect(link_transport_mdriver_t *driver, const char *sn) {
         memset(driver->dev_name, 0, 64);
         strncpy(driver->dev_name, name, 63);
 
-        if ((sn == NULL) || (strlen(sn) == 0) || (strcmp(sn, serialno) == 0)) {
-          link_debug(LINK_DEBUG_MESSAGE, "Open Anon at %p", driver->phy_driver.handle);
-          return 0;
-        }
-
-        if ((strcmp(sn, serialno) == 0)) {
-          link_debug(LINK_DEBUG_MESSAGE, "Open %s at %p", sn, driver->phy_driver.handle);
-          return 0;
-        }
-
-        // check for half the serial number for compatibility to old serial number format
-        len = strlen(sn);
-        if (strcmp(&(sn[len / 2]), serialno) == 0) {
-          link_debug(LINK_DEBUG_MESSAGE, "Open SN at %p", driver->phy_driver.handle);
-          return 0;
-        }
-
-        len = strlen(serialno);
-        if (strcmp(sn, &(serialno[len / 2])) == 0) {
+        if (link_is_serialno_match(sn, serialno)) {
           link_debug(LINK_DEBUG_MESSAGE, "Open SN at %p", driver->phy_driver.handle);
           return 0;
         }
@@ -123,14 +104,42 @@ int link_connect(link_transport_mdriver_t *driver, const char *sn) {
   return -1;
 }
 
+int link_is_serialno_match(const char *sn, const char *serialno) {
+  int len;
+
+  // a NULL or empty sn matches any device
+  if ((sn == NULL) || (strlen(sn) == 0) || (strcmp(sn, serialno) == 0)) {
+    return 1;
+  }
+
+  // check for half the serial number for compatibility to old serial number format
+  len = strlen(sn);
+  if (strcmp(&(sn[len / 2]), serialno) == 0) {
+    return 1;
+  }
+
+  len = strlen(serialno);
+  if (strcmp(sn, &(serialno[len / 2])) == 0) {
+    return 1;
+  }
+
+  return 0;
+}
+
 int link_readserialno(link_transport_mdriver_t *driver, char *serialno, int len) {
+  // reset the protocol version in case the new device is using a different version
+  driver->transport_version = 0;
+  return link_readserialno_noreset(driver, serialno, len);
+}
+
+int link_readserialno_noreset(
+  link_transport_mdriver_t *driver,
+  char *serialno,
+  int len) {
   link_op_t op;
   link_reply_t reply;
   int err;
 
-  // reset the protocol version in case the new device is using a different version
-  driver->transport_version = 0;
-
   op.cmd = LINK_CMD_READSERIALNO;
 
   link_debug(
@@ -1,5 +1,6 @@
 // Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
 
+#include <errno.h>
 #include <stdarg.h>
 #include <string.h>
 
@@ -7,6 +8,16 @@
 #include "sos/dev/bootloader.h"
 
 static int reset_device(link_transport_mdriver_t *driver, int invoke_bootloader);
+static int write_flash_stream(
+  link_transport_mdriver_t *driver,
+  int addr,
+  const void *buf,
+  int nbyte);
+static int write_flash_pages(
+  link_transport_mdriver_t *driver,
+  int addr,
+  const void *buf,
+  int nbyte);
 
 int link_bootloader_attr(
   link_transport_mdriver_t *driver,
@@ -238,6 +249,92 @@ int link_readflash(link_transport_mdriver_t *driver, int addr, void *buf, int nb
 }
 
 int link_writeflash(
+  link_transport_mdriver_t *driver,
+  int addr,
+  const void *buf,
+  int nbyte) {
+  if (nbyte > 0) {
+    const int result = write_flash_stream(driver, addr, buf, nbyte);
+    if (result != 0) {
+      return result;
+    }
+  }
+
+  // the bootloader can't stream -- write one page per request
+  return write_flash_pages(driver, addr, buf, nbyte);
+}
+
+int write_flash_stream(
+  link_transport_mdriver_t *driver,
+  int addr,
+  const void *buf,
+  int nbyte) {
+  link_op_t op;
+  link_reply_t reply;
+  int err;
+
+  op.write.cmd = LINK_CMD_WRITE;
+  op.write.addr = addr;
+  op.write.nbyte = nbyte;
+
+  link_debug(LINK_DEBUG_MESSAGE, "write flash stream op");
+  err = link_transport_masterwrite(driver, &op, sizeof(link_write_t));
+  if (err < 0) {
+    return err;
+  }
+
+  err = link_transport_masterread(driver, &reply, sizeof(reply));
+  if (err < 0) {
+    return err;
+  }
+
+  if ((reply.err < 0) && (reply.err_number == EINVAL)) {
+    link_debug(LINK_DEBUG_MESSAGE, "bootloader does not stream");
+    return 0;
+  }
+
+  if (reply.err < 0) {
+    // the bootloader refused the address range
+    link_errno = reply.err_number;
+    link_error("flash stream refused (%d)", link_errno);
+    return reply.err;
+  }
+
+  // each page is programmed while the next packet is sent
+  link_transport_mastersettimeout(driver, 5000);
+  const int write_result = link_transport_masterwrite(driver, buf, nbyte);
+
+  // a page that fails to program stops the stream but the reply still comes
+  err = link_transport_masterread(driver, &reply, sizeof(reply));
+  link_transport_mastersettimeout(driver, 0);
+  if (err < 0) {
+    if (write_result < 0) {
+      link_error("failed to stream flash data");
+      return LINK_TRANSFER_ERR;
+    }
+    return err;
+  }
+
+  if (reply.err < 0) {
+    link_errno = reply.err_number;
+    link_error("flash stream failed (%d)", link_errno);
+    return reply.err;
+  }
+
+  const u16 crc = link_transport_crc16(LINK_TRANSPORT_CRC16_SEED, buf, nbyte);
+  if ((reply.err != nbyte) || ((u16)reply.err_number != crc)) {
+    link_error(
+      "flash stream check failed %d of %d bytes crc 0x%04X != 0x%04X", reply.err, nbyte,
+      (u16)reply.err_number, crc);
+    link_errno = EIO;
+    return LINK_TRANSFER_ERR;
+  }
+
+  link_debug(LINK_DEBUG_MESSAGE, "Streamed %d bytes to flash", nbyte);
+  return nbyte;
+}
+
+int write_flash_pages(
   link_transport_mdriver_t *driver,
   int addr,
   const void *buf,
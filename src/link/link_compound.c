@@ -0,0 +1,350 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+
+#include "link_local.h"
+
+static int add_op(
+  link_compound_request_t *request,
+  const link_op_t *op,
+  const void *payload,
+  u32 payload_size,
+  u32 result_max);
+static int add_path_op(
+  link_compound_request_t *request,
+  link_op_t *op,
+  const char *path,
+  u32 result_max);
+static int get_data_size(
+  const link_compound_request_t *request,
+  int index,
+  const link_reply_t *reply,
+  int offset);
+
+void link_compound_init(link_compound_request_t *request, u32 o_flags) {
+  request->o_flags = o_flags;
+  request->count = 0;
+  request->size = 0;
+  request->result_max = 0;
+  request->result_count = 0;
+  request->result_size = 0;
+}
+
+int link_compound_add_open(
+  link_compound_request_t *request,
+  const char *path,
+  int flags,
+  int mode) {
+  link_op_t op = {};
+  op.open.cmd = LINK_CMD_OPEN;
+  op.open.flags = (u32)link_convert_open_flags(flags) | LINK_O_NONBLOCK;
+  op.open.mode = mode;
+  return add_path_op(request, &op, path, 0);
+}
+
+int link_compound_add_close(link_compound_request_t *request, int fildes) {
+  link_op_t op = {};
+  op.close.cmd = LINK_CMD_CLOSE;
+  op.close.fildes = fildes;
+  return add_op(request, &op, NULL, 0, 0);
+}
+
+int link_compound_add_read(link_compound_request_t *request, int fildes, int nbyte) {
+  link_op_t op = {};
+  if (nbyte < 0) {
+    return -1;
+  }
+  op.read.cmd = LINK_CMD_READ;
+  op.read.fildes = fildes;
+  op.read.nbyte = nbyte;
+  return add_op(request, &op, NULL, 0, nbyte);
+}
+
+int link_compound_add_write(
+  link_compound_request_t *request,
+  int fildes,
+  const void *buf,
+  int nbyte) {
+  link_op_t op = {};
+  if (nbyte < 0) {
+    return -1;
+  }
+  op.write.cmd = LINK_CMD_WRITE;
+  op.write.fildes = fildes;
+  op.write.nbyte = nbyte;
+  return add_op(request, &op, buf, nbyte, 0);
+}
+
+int link_compound_add_lseek(
+  link_compound_request_t *request,
+  int fildes,
+  s32 offset,
+  int whence) {
+  link_op_t op = {};
+  op.lseek.cmd = LINK_CMD_LSEEK;
+  op.lseek.fildes = fildes;
+  op.lseek.offset = offset;
+  op.lseek.whence = whence;
+  return add_op(request, &op, NULL, 0, 0);
+}
+
+int link_compound_add_stat(link_compound_request_t *request, const char *path) {
+  link_op_t op = {};
+  op.stat.cmd = LINK_CMD_STAT;
+  return add_path_op(request, &op, path, sizeof(struct link_stat));
+}
+
+int link_compound_add_fstat(link_compound_request_t *request, int fildes) {
+  link_op_t op = {};
+  op.fstat.cmd = LINK_CMD_FSTAT;
+  op.fstat.fildes = fildes;
+  return add_op(request, &op, NULL, 0, sizeof(struct link_stat));
+}
+
+int link_compound_add_unlink(link_compound_request_t *request, const char *path) {
+  link_op_t op = {};
+  op.unlink.cmd = LINK_CMD_UNLINK;
+  return add_path_op(request, &op, path, 0);
+}
+
+int link_compound_add_mkdir(link_compound_request_t *request, const char *path, int mode) {
+  link_op_t op = {};
+  op.mkdir.cmd = LINK_CMD_MKDIR;
+  op.mkdir.mode = mode;
+  return add_path_op(request, &op, path, 0);
+}
+
+int link_compound_add_rmdir(link_compound_request_t *request, const char *path) {
+  link_op_t op = {};
+  op.rmdir.cmd = LINK_CMD_RMDIR;
+  return add_path_op(request, &op, path, 0);
+}
+
+int link_compound_add_opendir(link_compound_request_t *request, const char *path) {
+  link_op_t op = {};
+  op.opendir.cmd = LINK_CMD_OPENDIR;
+  return add_path_op(request, &op, path, 0);
+}
+
+int link_compound_add_readdir(link_compound_request_t *request, int dirp) {
+  link_op_t op = {};
+  op.readdir.cmd = LINK_CMD_READDIR;
+  op.readdir.dirp = dirp;
+  return add_op(request, &op, NULL, 0, sizeof(struct link_dirent));
+}
+
+int link_compound_add_closedir(link_compound_request_t *request, int dirp) {
+  link_op_t op = {};
+  op.closedir.cmd = LINK_CMD_CLOSEDIR;
+  op.closedir.dirp = dirp;
+  return add_op(request, &op, NULL, 0, 0);
+}
+
+int link_compound_execute(
+  link_transport_mdriver_t *driver,
+  link_compound_request_t *request) {
+  link_op_t op;
+  link_reply_t reply;
+  int err;
+
+  request->result_count = 0;
+  request->result_size = 0;
+
+  if (driver == NULL) {
+    link_errno = EINVAL;
+    return -1;
+  }
+
+  if (request->count == 0) {
+    return 0;
+  }
+
+  link_debug(
+    LINK_DEBUG_INFO, "call with %d ops (%d bytes) and handle %p", request->count,
+    request->size, driver->phy_driver.handle);
+
+  op.compound.cmd = LINK_CMD_COMPOUND;
+  op.compound.count = request->count;
+  op.compound.size = request->size;
+  op.compound.o_flags = request->o_flags;
+
+  err = link_transport_masterwrite(driver, &op, sizeof(link_compound_t));
+  if (err < 0) {
+    link_error("failed to write compound op");
+    return link_handle_err(driver, err);
+  }
+
+  // the device accepts the request before it is sent
+  err = link_transport_masterread(driver, &reply, sizeof(reply));
+  if (err < 0) {
+    link_error("failed to read the reply");
+    return link_handle_err(driver, err);
+  }
+
+  if (reply.err < 0) {
+    // devices without compound commands reply with EINVAL
+    link_errno = reply.err_number;
+    link_debug(LINK_DEBUG_WARNING, "Failed to start compound (%d)", link_errno);
+    return reply.err;
+  }
+
+  err = link_transport_masterwrite(driver, request->request, request->size);
+  if (err < 0) {
+    link_error("failed to write compound request");
+    return link_handle_err(driver, err);
+  }
+
+  // give extra time for the device to run all the operations
+  link_transport_mastersettimeout(driver, 5000);
+  err = link_transport_masterread(driver, &reply, sizeof(reply));
+  link_transport_mastersettimeout(driver, 0);
+  if (err < 0) {
+    link_error("failed to read the compound reply");
+    return link_handle_err(driver, err);
+  }
+
+  if (
+    (reply.err < 0) || (reply.err > request->count)
+    || (reply.err_number > (int)sizeof(request->result))) {
+    link_error("bad compound reply %d %d", reply.err, reply.err_number);
+    return LINK_PROT_ERROR;
+  }
+
+  if (reply.err_number > 0) {
+    err = link_transport_masterread(driver, request->result, reply.err_number);
+    if (err < 0) {
+      link_error("failed to read the compound results");
+      return link_handle_err(driver, err);
+    }
+  }
+
+  // find where each result starts
+  int offset = 0;
+  for (int i = 0; i < reply.err; i++) {
+    link_reply_t result;
+    if (offset + (int)sizeof(result) > reply.err_number) {
+      link_error("compound result %d is missing", i);
+      return LINK_PROT_ERROR;
+    }
+    memcpy(&result, request->result + offset, sizeof(result));
+    request->result_offset[i] = offset;
+    offset += sizeof(result) + get_data_size(request, i, &result, offset);
+  }
+
+  if (offset > reply.err_number) {
+    link_error("compound results are truncated");
+    return LINK_PROT_ERROR;
+  }
+
+  request->result_count = reply.err;
+  request->result_size = reply.err_number;
+  link_debug(
+    LINK_DEBUG_MESSAGE, "executed %d of %d ops", request->result_count, request->count);
+  return reply.err;
+}
+
+int link_compound_get_result(
+  const link_compound_request_t *request,
+  int index,
+  void *data,
+  int nbyte) {
+  link_reply_t reply;
+
+  if ((index < 0) || (index >= request->result_count)) {
+    // the operation was not executed
+    link_errno = EAGAIN;
+    return -1;
+  }
+
+  const int offset = request->result_offset[index];
+  memcpy(&reply, request->result + offset, sizeof(reply));
+  if (reply.err < 0) {
+    link_errno = reply.err_number;
+    return reply.err;
+  }
+
+  if (data != NULL) {
+    int size = get_data_size(request, index, &reply, offset);
+    if (request->cmd[index] == LINK_CMD_READDIR) {
+      // the name is sent without the unused bytes
+      memset(data, 0, nbyte);
+    }
+    if (size > nbyte) {
+      size = nbyte;
+    }
+    memcpy(data, request->result + offset + sizeof(reply), size);
+  }
+  return reply.err;
+}
+
+int add_op(
+  link_compound_request_t *request,
+  const link_op_t *op,
+  const void *payload,
+  u32 payload_size,
+  u32 result_max) {
+  const u32 size = sizeof(link_op_t) + payload_size;
+  result_max += sizeof(link_reply_t);
+  if (
+    (request->count == LINK_COMPOUND_OP_MAX)
+    || (request->size + size > LINK_COMPOUND_REQUEST_MAX)
+    || (request->result_max + result_max > LINK_COMPOUND_REPLY_MAX)) {
+    // execute the request and start a new one
+    link_errno = ENOSPC;
+    return -1;
+  }
+
+  memcpy(request->request + request->size, op, sizeof(link_op_t));
+  if (payload_size) {
+    memcpy(request->request + request->size + sizeof(link_op_t), payload, payload_size);
+  }
+  request->size += size;
+  request->result_max += result_max;
+  request->cmd[request->count] = op->cmd;
+  return request->count++;
+}
+
+int add_path_op(
+  link_compound_request_t *request,
+  link_op_t *op,
+  const char *path,
+  u32 result_max) {
+  // path_size is in the same place for all operations with a path
+  op->open.path_size = strnlen(path, LINK_PATH_MAX_LARGE) + 1;
+  if (op->open.path_size > LINK_PATH_MAX_LARGE) {
+    link_errno = ENAMETOOLONG;
+    return -1;
+  }
+  return add_op(request, op, path, op->open.path_size, result_max);
+}
+
+int get_data_size(
+  const link_compound_request_t *request,
+  int index,
+  const link_reply_t *reply,
+  int offset) {
+  if (reply->err < 0) {
+    return 0;
+  }
+
+  switch (request->cmd[index]) {
+  case LINK_CMD_READ:
+    return reply->err;
+  case LINK_CMD_STAT:
+  case LINK_CMD_FSTAT:
+    return sizeof(struct link_stat);
+  case LINK_CMD_READDIR: {
+    // d_ino followed by the null terminated name
+    const int name_offset = offset + sizeof(link_reply_t) + sizeof(u32);
+    const int name_max = (int)sizeof(request->result) - name_offset;
+    if (name_max <= 0) {
+      return sizeof(u32);
+    }
+    return sizeof(u32)
+           + strnlen((const char *)request->result + name_offset, name_max) + 1;
+  }
+  }
+  return 0;
+}
@@ -0,0 +1,409 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "link_local.h"
+
+typedef struct {
+  u8 *delta;
+  int capacity;
+  int size;
+  int last_copy; // offset of the last copy record or -1
+} delta_builder_t;
+
+static int get_signature(
+  link_transport_mdriver_t *driver,
+  int fildes,
+  int block_size,
+  link_delta_signature_t **signature);
+static int apply_delta(
+  link_transport_mdriver_t *driver,
+  int old_fildes,
+  int fildes,
+  const void *delta,
+  int size,
+  link_reply_t *reply,
+  u8 *digest);
+static int find_block(
+  const link_delta_signature_t *signature,
+  const int *table,
+  const int *next,
+  int mask,
+  u32 weak,
+  const u8 *block,
+  int block_size,
+  int expected);
+static int add_literal(delta_builder_t *builder, const u8 *buf, int nbyte);
+static int add_copy(delta_builder_t *builder, u32 offset, int nbyte);
+
+int link_write_delta(
+  link_transport_mdriver_t *driver,
+  int old_fildes,
+  int fildes,
+  const void *buf,
+  int nbyte) {
+  link_delta_signature_t *signature = NULL;
+  const int block_size = LINK_DELTA_DEFAULT_BLOCK_SIZE;
+
+  if (driver == NULL) {
+    link_errno = EINVAL;
+    return -1;
+  }
+
+  link_debug(
+    LINK_DEBUG_INFO, "call with (%d, %d, %p, %d) and handle %p", old_fildes, fildes, buf,
+    nbyte, driver->phy_driver.handle);
+
+  const int count = get_signature(driver, old_fildes, block_size, &signature);
+  if (count < 0) {
+    if (count != LINK_DEV_ERROR) {
+      return link_handle_err(driver, count);
+    }
+    // the device can't do deltas (or the old file can't be read)
+    return link_write(driver, fildes, buf, nbyte);
+  }
+
+  const int capacity = link_delta_size_max(nbyte, block_size);
+  u8 *delta = malloc(capacity);
+  if (delta == NULL) {
+    free(signature);
+    link_errno = ENOMEM;
+    return -1;
+  }
+
+  const int size =
+    link_delta_create(signature, count, block_size, buf, nbyte, delta, capacity);
+  free(signature);
+
+  link_debug(
+    LINK_DEBUG_MESSAGE, "delta is %d bytes for %d bytes (%d old blocks)", size, nbyte,
+    count);
+
+  if ((size < 0) || (size + count * (int)sizeof(link_delta_signature_t) >= nbyte)) {
+    // nothing to gain
+    free(delta);
+    return link_write(driver, fildes, buf, nbyte);
+  }
+
+  link_reply_t reply;
+  u8 digest[LINK_DELTA_DIGEST_SIZE];
+  const int result =
+    apply_delta(driver, old_fildes, fildes, delta, size, &reply, digest);
+  free(delta);
+  if (result < 0) {
+    return link_handle_err(driver, result);
+  }
+
+  if (reply.err < 0) {
+    link_errno = reply.err_number;
+    link_error("failed to apply the delta (%d)", link_errno);
+    return reply.err;
+  }
+
+  link_delta_digest_t expected;
+  u8 expected_digest[LINK_DELTA_DIGEST_SIZE];
+  link_delta_digest_start(&expected);
+  link_delta_digest_update(&expected, buf, nbyte);
+  link_delta_digest_finish(&expected, expected_digest);
+  if (
+    (reply.err != nbyte)
+    || memcmp(digest, expected_digest, LINK_DELTA_DIGEST_SIZE)) {
+    link_error("delta check failed %d of %d bytes", reply.err, nbyte);
+    link_errno = EIO;
+    return LINK_TRANSFER_ERR;
+  }
+
+  return nbyte;
+}
+
+int link_delta_size_max(int nbyte, int block_size) {
+  // every copy is at least one block and has at most one literal before it
+  return nbyte + (2 * (nbyte / block_size) + 2) * sizeof(link_delta_record_t);
+}
+
+int link_delta_create(
+  const link_delta_signature_t *signature,
+  int count,
+  int block_size,
+  const void *buf,
+  int nbyte,
+  void *delta,
+  int capacity) {
+  const u8 *p = buf;
+  delta_builder_t builder = {
+    .delta = delta, .capacity = capacity, .size = 0, .last_copy = -1};
+  int *table = NULL;
+  int *next = NULL;
+  int mask = 0;
+
+  if (count > 0) {
+    // hash table of the weak hashes -- blocks with the same hash are chained
+    int table_size = 1;
+    while (table_size < count * 2) {
+      table_size <<= 1;
+    }
+    mask = table_size - 1;
+    table = malloc(table_size * sizeof(int));
+    next = malloc(count * sizeof(int));
+    if ((table == NULL) || (next == NULL)) {
+      free(table);
+      free(next);
+      return -1;
+    }
+    memset(table, 0xff, table_size * sizeof(int));
+    for (int i = count - 1; i >= 0; i--) {
+      const int slot = (signature[i].weak ^ (signature[i].weak >> 16)) & mask;
+      next[i] = table[slot];
+      table[slot] = i;
+    }
+  }
+
+  int literal = 0;
+  int position = 0;
+  int expected = 0;
+  u32 weak = 0;
+  if ((count > 0) && (nbyte >= block_size)) {
+    weak = link_delta_weak(p, block_size);
+  }
+
+  while ((count > 0) && (position + block_size <= nbyte)) {
+    const int index = find_block(
+      signature, table, next, mask, weak, p + position, block_size, expected);
+
+    if (index < 0) {
+      if (position + block_size < nbyte) {
+        weak = link_delta_roll(weak, p[position], p[position + block_size], block_size);
+      }
+      position++;
+      continue;
+    }
+
+    if (
+      (add_literal(&builder, p + literal, position - literal) < 0)
+      || (add_copy(&builder, index * block_size, block_size) < 0)) {
+      free(table);
+      free(next);
+      return -1;
+    }
+
+    position += block_size;
+    literal = position;
+    expected = index + 1;
+    if (position + block_size <= nbyte) {
+      weak = link_delta_weak(p + position, block_size);
+    }
+  }
+
+  free(table);
+  free(next);
+
+  if (add_literal(&builder, p + literal, nbyte - literal) < 0) {
+    return -1;
+  }
+  return builder.size;
+}
+
+int get_signature(
+  link_transport_mdriver_t *driver,
+  int fildes,
+  int block_size,
+  link_delta_signature_t **signature) {
+  link_op_t op;
+  link_reply_t reply;
+  int err;
+
+  op.delta.cmd = LINK_CMD_DELTA_SIGNATURE;
+  op.delta.fildes = fildes;
+  op.delta.new_fildes = -1;
+  op.delta.block_size = block_size;
+  op.delta.nbyte = 0;
+
+  link_debug(LINK_DEBUG_MESSAGE, "write delta signature op");
+  err = link_transport_masterwrite(driver, &op, sizeof(link_delta_t));
+  if (err < 0) {
+    link_error("failed to write delta signature op");
+    return err;
+  }
+
+  err = link_transport_masterread(driver, &reply, sizeof(reply));
+  if (err < 0) {
+    link_error("failed to read the reply");
+    return err;
+  }
+
+  if (reply.err < 0) {
+    link_debug(LINK_DEBUG_MESSAGE, "no delta signature (%d)", reply.err_number);
+    return LINK_DEV_ERROR;
+  }
+
+  const int size = reply.err * sizeof(link_delta_signature_t);
+  *signature = malloc(size ? size : 1);
+  if (*signature == NULL) {
+    // the device sends the signature anyway
+    link_errno = ENOMEM;
+    return LINK_PROT_ERROR;
+  }
+
+  if (size > 0) {
+    // the device hashes the old file as it sends the signature
+    link_transport_mastersettimeout(driver, 5000);
+    err = link_transport_masterread(driver, *signature, size);
+    link_transport_mastersettimeout(driver, 0);
+    if (err < 0) {
+      free(*signature);
+      link_error("failed to read the delta signature");
+      return err;
+    }
+
+    if (err != size) {
+      // the device could not read the old file -- the stream ended early
+      free(*signature);
+      return LINK_DEV_ERROR;
+    }
+  }
+
+  return reply.err;
+}
+
+int apply_delta(
+  link_transport_mdriver_t *driver,
+  int old_fildes,
+  int fildes,
+  const void *delta,
+  int size,
+  link_reply_t *reply,
+  u8 *digest) {
+  link_op_t op;
+  int err;
+
+  op.delta.cmd = LINK_CMD_DELTA_APPLY;
+  op.delta.fildes = old_fildes;
+  op.delta.new_fildes = fildes;
+  op.delta.block_size = 0;
+  op.delta.nbyte = size;
+
+  link_debug(LINK_DEBUG_MESSAGE, "write delta apply op");
+  err = link_transport_masterwrite(driver, &op, sizeof(link_delta_t));
+  if (err < 0) {
+    link_error("failed to write delta apply op");
+    return err;
+  }
+
+  err = link_transport_masterread(driver, reply, sizeof(link_reply_t));
+  if (err < 0) {
+    link_error("failed to read the reply");
+    return err;
+  }
+
+  if (reply->err < 0) {
+    return 0;
+  }
+
+  // the device copies from the old file while it receives the records
+  link_transport_mastersettimeout(driver, 5000);
+  err = link_transport_masterwrite(driver, delta, size);
+  if (err < 0) {
+    link_transport_mastersettimeout(driver, 0);
+    link_error("failed to write the delta");
+    return err;
+  }
+
+  err = link_transport_masterread(driver, reply, sizeof(link_reply_t));
+  link_transport_mastersettimeout(driver, 0);
+  if (err < 0) {
+    link_error("failed to read the delta reply");
+    return err;
+  }
+
+  if (reply->err < 0) {
+    return 0;
+  }
+
+  err = link_transport_masterread(driver, digest, LINK_DELTA_DIGEST_SIZE);
+  if (err < 0) {
+    link_error("failed to read the delta digest");
+    return err;
+  }
+
+  return 0;
+}
+
+int find_block(
+  const link_delta_signature_t *signature,
+  const int *table,
+  const int *next,
+  int mask,
+  u32 weak,
+  const u8 *block,
+  int block_size,
+  int expected) {
+  int index = table[(weak ^ (weak >> 16)) & mask];
+  int result = -1;
+  u8 strong[LINK_DELTA_STRONG_SIZE];
+  int is_strong_ready = 0;
+
+  while (index >= 0) {
+    if (signature[index].weak == weak) {
+      if (is_strong_ready == 0) {
+        // only hash the block when the weak hash matches
+        link_delta_strong(block, block_size, strong);
+        is_strong_ready = 1;
+      }
+      if (memcmp(signature[index].strong, strong, LINK_DELTA_STRONG_SIZE) == 0) {
+        if (index == expected) {
+          // the next old block continues the last copy
+          return index;
+        }
+        if (result < 0) {
+          result = index;
+        }
+      }
+    }
+    index = next[index];
+  }
+  return result;
+}
+
+int add_literal(delta_builder_t *builder, const u8 *buf, int nbyte) {
+  if (nbyte == 0) {
+    return 0;
+  }
+
+  if (builder->size + (int)sizeof(link_delta_record_t) + nbyte > builder->capacity) {
+    return -1;
+  }
+
+  const link_delta_record_t record = {.offset = LINK_DELTA_LITERAL, .nbyte = nbyte};
+  memcpy(builder->delta + builder->size, &record, sizeof(record));
+  memcpy(builder->delta + builder->size + sizeof(record), buf, nbyte);
+  builder->size += sizeof(record) + nbyte;
+  builder->last_copy = -1;
+  return 0;
+}
+
+int add_copy(delta_builder_t *builder, u32 offset, int nbyte) {
+  link_delta_record_t record;
+
+  if (builder->last_copy >= 0) {
+    memcpy(&record, builder->delta + builder->last_copy, sizeof(record));
+    if (record.offset + record.nbyte == offset) {
+      // one record for a run of old blocks
+      record.nbyte += nbyte;
+      memcpy(builder->delta + builder->last_copy, &record, sizeof(record));
+      return 0;
+    }
+  }
+
+  if (builder->size + (int)sizeof(record) > builder->capacity) {
+    return -1;
+  }
+
+  record.offset = offset;
+  record.nbyte = nbyte;
+  memcpy(builder->delta + builder->size, &record, sizeof(record));
+  builder->last_copy = builder->size;
+  builder->size += sizeof(record);
+  return 0;
+}
@@ -1,6 +1,7 @@
 // Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
 
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "link_local.h"
@@ -32,6 +33,12 @@
 #define posix_nbyte_t int
 #endif
 
+// full packets in each chunk of a stream
+#define STREAM_PACKET_COUNT 64
+#define STREAM_LOCAL_CHUNK_SIZE 65536
+
+static int get_stream_chunk_size(link_transport_mdriver_t *driver);
+
 static void convert_stat(struct stat *dest, const struct link_stat *source) {
   // dest->st_blksize = source->st_blksize;
   // dest->st_blocks = source->st_blocks;
@@ -47,7 +54,7 @@ static void convert_stat(struct stat *dest, const struct link_stat *source) {
   dest->st_ctime = source->st_ctime_;
 }
 
-static int convert_flags(int link_flags) {
+int link_convert_open_flags(int link_flags) {
   int result = 0;
   if (link_flags & O_CREAT) {
     result |= LINK_O_CREAT;
@@ -103,7 +110,7 @@ int link_open(link_transport_mdriver_t *driver, const char *path, int flags, ...
 
   link_debug(
     LINK_DEBUG_INFO, "convert flags 0x%X -> 0x%X", flags,
-    convert_flags(flags) | POSIX_OPEN_FLAGS);
+    link_convert_open_flags(flags) | POSIX_OPEN_FLAGS);
 
   link_debug(
     LINK_DEBUG_INFO, "call with (%s, 0x%X, %o) and handle %p", path, mode, flags,
@@ -111,7 +118,7 @@ int link_open(link_transport_mdriver_t *driver, const char *path, int flags, ...
 
   op.open.cmd = LINK_CMD_OPEN;
   op.open.path_size = strnlen(path, LINK_PATH_MAX) + 1;
-  op.open.flags = (u32)convert_flags(flags) | LINK_O_NONBLOCK;
+  op.open.flags = (u32)link_convert_open_flags(flags) | LINK_O_NONBLOCK;
   op.open.mode = mode;
 
   if (op.open.path_size > driver->path_max) {
@@ -376,6 +383,222 @@ int link_write(link_transport_mdriver_t *driver, int fildes, const void *buf, in
   return reply.err;
 }
 
+int link_read_stream(
+  link_transport_mdriver_t *driver,
+  int fildes,
+  int nbyte,
+  link_stream_callback_t callback,
+  void *context) {
+  link_op_t op;
+  link_reply_t reply;
+  int err;
+
+  const int chunk_size = get_stream_chunk_size(driver);
+  if (chunk_size < 0) {
+    return link_handle_err(driver, chunk_size);
+  }
+
+  u8 *buffer = malloc(chunk_size);
+  if (buffer == NULL) {
+    link_errno = ENOMEM;
+    return -1;
+  }
+
+  int bytes = 0;
+  int callback_result = 0;
+  int callback_errno = 0;
+
+  if (driver == NULL) {
+    int result;
+    do {
+      const int page = (nbyte - bytes) > chunk_size ? chunk_size : nbyte - bytes;
+      result = posix_read(fildes, buffer, (posix_nbyte_t)page);
+      if (result > 0) {
+        callback_result = callback(context, buffer, result);
+        bytes += result;
+      }
+      if (result < page) {
+        break;
+      }
+    } while ((callback_result >= 0) && (bytes < nbyte));
+    link_errno = errno;
+    free(buffer);
+    if ((result < 0) || (callback_result < 0)) {
+      return -1;
+    }
+    return bytes;
+  }
+
+  op.read.cmd = LINK_CMD_READ;
+  op.read.fildes = fildes;
+  op.read.nbyte = (u32)nbyte;
+
+  link_debug(
+    LINK_DEBUG_INFO, "call with (%d, %d) and handle %p", fildes, nbyte,
+    driver->phy_driver.handle);
+
+  err = link_transport_masterwrite(driver, &op, sizeof(link_read_t));
+  if (err < 0) {
+    free(buffer);
+    link_error("failed to write op");
+    return link_handle_err(driver, err);
+  }
+
+  // the device sends full packets until the file ends or nbyte is reached
+  int page;
+  do {
+    page = (nbyte - bytes) > chunk_size ? chunk_size : nbyte - bytes;
+    err = link_transport_masterread(driver, buffer, page);
+    if (err < 0) {
+      free(buffer);
+      link_error("failed to read data");
+      return link_handle_err(driver, err);
+    }
+
+    // the rest of the stream is still read if the callback fails
+    if ((callback_result >= 0) && (err > 0)) {
+      callback_result = callback(context, buffer, err);
+      if (callback_result < 0) {
+        callback_errno = errno;
+      }
+    }
+    bytes += err;
+  } while ((err == page) && (bytes < nbyte));
+
+  free(buffer);
+  link_debug(LINK_DEBUG_MESSAGE, "streamed %d of %d bytes", bytes, nbyte);
+  err = link_transport_masterread(driver, &reply, sizeof(reply));
+  if (err < 0) {
+    link_error("failed to read reply");
+    return link_handle_err(driver, err);
+  }
+
+  if (reply.err < 0) {
+    link_errno = reply.err_number;
+    link_debug(LINK_DEBUG_WARNING, "Failed to read file (%d)", link_errno);
+    return reply.err;
+  }
+
+  if (callback_result < 0) {
+    link_errno = callback_errno;
+    return -1;
+  }
+
+  return reply.err;
+}
+
+int link_write_stream(
+  link_transport_mdriver_t *driver,
+  int fildes,
+  int nbyte,
+  link_stream_callback_t callback,
+  void *context) {
+  link_op_t op;
+  link_reply_t reply;
+  int err;
+
+  const int chunk_size = get_stream_chunk_size(driver);
+  if (chunk_size < 0) {
+    return link_handle_err(driver, chunk_size);
+  }
+
+  u8 *buffer = malloc(chunk_size);
+  if (buffer == NULL) {
+    link_errno = ENOMEM;
+    return -1;
+  }
+
+  int bytes = 0;
+  int result;
+  int page;
+  int callback_errno = 0;
+
+  if (driver == NULL) {
+    do {
+      page = (nbyte - bytes) > chunk_size ? chunk_size : nbyte - bytes;
+      result = callback(context, buffer, page);
+      if (result <= 0) {
+        break;
+      }
+      const int written = posix_write(fildes, buffer, (posix_nbyte_t)result);
+      if (written != result) {
+        result = -1;
+        break;
+      }
+      bytes += result;
+    } while ((result == page) && (bytes < nbyte));
+    link_errno = errno;
+    free(buffer);
+    return result < 0 ? -1 : bytes;
+  }
+
+  op.write.cmd = LINK_CMD_WRITE;
+  op.write.fildes = fildes;
+  op.write.nbyte = (u32)nbyte;
+
+  link_debug(
+    LINK_DEBUG_INFO, "call with (%d, %d) and handle %p", fildes, nbyte,
+    driver->phy_driver.handle);
+
+  err = link_transport_masterwrite(driver, &op, sizeof(link_write_t));
+  if (err < 0) {
+    free(buffer);
+    link_error("failed to write op");
+    return link_handle_err(driver, err);
+  }
+
+  do {
+    page = (nbyte - bytes) > chunk_size ? chunk_size : nbyte - bytes;
+    result = callback(context, buffer, page);
+    if (result < 0) {
+      // end the stream with what has been sent
+      callback_errno = errno;
+      result = 0;
+    } else if (result > page) {
+      result = page;
+    }
+
+    err = link_transport_masterwrite(driver, buffer, result);
+    if (err < 0) {
+      free(buffer);
+      link_error("failed to write data");
+      return link_handle_err(driver, err);
+    }
+    bytes += result;
+  } while ((result == page) && (bytes < nbyte) && (callback_errno == 0));
+
+  if ((bytes < nbyte) && (result > 0) && (result % (chunk_size / STREAM_PACKET_COUNT) == 0)) {
+    // the last packet was full -- an empty packet tells the device the data has ended
+    err = link_transport_masterwrite(driver, buffer, 0);
+    if (err < 0) {
+      free(buffer);
+      link_error("failed to end data");
+      return link_handle_err(driver, err);
+    }
+  }
+
+  free(buffer);
+  link_debug(LINK_DEBUG_MESSAGE, "streamed %d of %d bytes", bytes, nbyte);
+  err = link_transport_masterread(driver, &reply, sizeof(reply));
+  if (err < 0) {
+    link_error("failed to read reply");
+    return link_handle_err(driver, err);
+  }
+
+  if (reply.err < 0) {
+    link_errno = reply.err_number;
+    link_debug(LINK_DEBUG_WARNING, "Failed to write file (%d)", link_errno);
+    return reply.err;
+  }
+
+  if (callback_errno) {
+    link_errno = callback_errno;
+    return -1;
+  }
+
+  return reply.err;
+}
+
 int link_close(link_transport_mdriver_t *driver, int fildes) {
   if (driver == NULL) {
     link_debug(LINK_DEBUG_DEBUG, "closing fileno:%d", fildes);
@@ -857,3 +1080,16 @@ int link_chmod(link_transport_mdriver_t *driver, const char *path, int mode) {
 }
 
 /*! @} */
+
+int get_stream_chunk_size(link_transport_mdriver_t *driver) {
+  if (driver == NULL) {
+    return STREAM_LOCAL_CHUNK_SIZE;
+  }
+
+  // a chunk must be full packets so the device doesn't see the end of the stream
+  const int packet_size = link_transport_masterpacketsize(driver);
+  if (packet_size < 0) {
+    return packet_size;
+  }
+  return packet_size * STREAM_PACKET_COUNT;
+}
@@ -20,6 +20,10 @@ extern "C" {
 #define LINK_DEVICE_PRESENT_BUT_NOT_BOOTLOADER (-8183650)
 
 int link_handle_err(link_transport_mdriver_t * driver, int err);
+int link_is_serialno_match(const char *sn, const char *serialno);
+// uses the transport version that is already set (0 resolves it)
+int link_readserialno_noreset(link_transport_mdriver_t * driver, char * serialno, int len);
+int link_convert_open_flags(int flags);
 int link_ioctl_delay(link_transport_mdriver_t * driver, int fildes, int request, void * argp, int arg, int delay);
 
 
@@ -286,18 +286,28 @@ void link_phy_flush(link_transport_phy_t handle) {
 
 #if defined __macosx || defined __linux
 #include <dirent.h>
+#include <poll.h>
 #include <string.h>
 #include <sys/ioctl.h>
 #include <sys/types.h>
 #include <termios.h>
 
 #define BAUDRATE 460800
+#define READ_BUFFER_SIZE 4096
+#define READ_POLL_TIMEOUT 1 // ms -- callers count empty reads against their own timeout
 
 typedef struct {
   int fd;
   char device_path[MAX_DEVICE_PATH];
+  // reads are buffered so the one byte reads used to find packet starts don't each
+  // need a system call
+  int read_offset;
+  int read_count;
+  u8 read_buffer[READ_BUFFER_SIZE];
 } link_phy_container_t;
 
+static int phy_error(link_phy_container_t *phy);
+
 // This is the mac osx prefix -- this needs to be in a list so it can also check bluetooth
 #ifdef __macosx
 #define TTY_DEV_PREFIX "tty.usbmodem"
@@ -471,6 +481,8 @@ link_transport_phy_t link_phy_open(const char *name, const void *s_options) {
 
   container->fd = fd;
   strncpy(container->device_path, name, MAX_DEVICE_PATH);
+  container->read_offset = 0;
+  container->read_count = 0;
 
   link_phy_flush(phy);
   return phy;
@@ -501,10 +513,6 @@ int link_phy_write(link_transport_phy_t handle, const void *buf, int nbyte) {
     return LINK_PHY_ERROR;
   }
 
-  if (link_phy_status(handle) < 0) {
-    return LINK_PHY_ERROR;
-  }
-
   do {
     if (nbyte - bytes_written > max_page_size) {
       page_size = max_page_size;
@@ -520,7 +528,7 @@ int link_phy_write(link_transport_phy_t handle, const void *buf, int nbyte) {
         errno = tmp;
         return 0;
       }
-      return LINK_PHY_ERROR;
+      return phy_error(phy);
     }
 
     if (page_size == max_page_size) {
@@ -542,33 +550,68 @@ int link_phy_read(link_transport_phy_t handle, void *buf, int nbyte) {
   int ret;
   int tmp;
   link_phy_container_t *phy = handle;
+  struct pollfd pfd;
 
   if (handle == LINK_PHY_OPEN_ERROR) {
     return LINK_PHY_ERROR;
   }
 
-  tmp = errno;
-
-  if (link_phy_status(handle) < 0) {
-    return LINK_PHY_ERROR;
-  }
+  if (phy->read_count == 0) {
+    // wait for data rather than sleeping -- this returns as soon as bytes arrive
+    pfd.fd = phy->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    ret = poll(&pfd, 1, READ_POLL_TIMEOUT);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        return 0;
+      }
+      return phy_error(phy);
+    }
 
-  ret = read(phy->fd, buf, nbyte);
-  if (ret < 0) {
-    if (errno == EAGAIN) {
-      errno = tmp;
-      link_phy_wait(1);
+    if (ret == 0) {
       return 0;
     }
-    return LINK_PHY_ERROR;
-  }
 
-  if (ret != 0) {
+    if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+      return phy_error(phy);
+    }
+
+    tmp = errno;
+    ret = read(phy->fd, phy->read_buffer, READ_BUFFER_SIZE);
+    if (ret < 0) {
+      if (errno == EAGAIN) {
+        errno = tmp;
+        return 0;
+      }
+      return phy_error(phy);
+    }
+
+    if (ret == 0) {
+      // readable with nothing to read -- the device has gone away
+      return phy_error(phy);
+    }
+
     link_debug(LINK_DEBUG_DEBUG, "Rx'd %d bytes", ret);
-  } else {
-    link_phy_wait(1);
+    phy->read_offset = 0;
+    phy->read_count = ret;
+  }
+
+  if (nbyte > phy->read_count) {
+    nbyte = phy->read_count;
   }
-  return ret;
+  memcpy(buf, phy->read_buffer + phy->read_offset, nbyte);
+  phy->read_offset += nbyte;
+  phy->read_count -= nbyte;
+  return nbyte;
+}
+
+int phy_error(link_phy_container_t *phy) {
+  // the device path is only checked when something goes wrong
+  if (link_phy_status(phy) < 0) {
+    link_error("device %s is gone", phy->device_path);
+  }
+  return LINK_PHY_ERROR;
 }
 
 int link_phy_close(link_transport_phy_t *handle) {
@@ -590,8 +633,14 @@ int link_phy_close(link_transport_phy_t *handle) {
 void link_phy_wait(int msec) { usleep(msec * 1000); }
 
 void link_phy_flush(link_transport_phy_t handle) {
-  unsigned char c;
-  while (link_phy_read(handle, &c, 1) == 1) {
+  link_phy_container_t *phy = handle;
+  if (handle == LINK_PHY_OPEN_ERROR) {
+    return;
+  }
+
+  unsigned char buffer[64];
+  phy->read_count = 0;
+  while (link_phy_read(handle, buffer, sizeof(buffer)) > 0) {
     ;
   }
 }
@@ -0,0 +1,329 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "link_local.h"
+
+static int connect_session(
+  link_pool_t *pool,
+  link_transport_mdriver_t *driver,
+  const char *sn);
+static int connect_cached(
+  link_pool_t *pool,
+  link_transport_mdriver_t *driver,
+  const char *sn);
+static int connect_scan(
+  link_pool_t *pool,
+  link_transport_mdriver_t *driver,
+  const char *sn);
+static int open_device(
+  link_transport_mdriver_t *driver,
+  const char *name,
+  u32 transport_version,
+  char *serialno);
+static void close_device(link_transport_mdriver_t *driver);
+static void close_session(link_pool_session_t *session);
+static void close_idle_sessions(link_pool_t *pool);
+static link_pool_device_t *find_device(link_pool_t *pool, const char *sn);
+static void
+update_device(link_pool_t *pool, const char *name, const char *serialno, u32 version);
+
+void link_pool_init(link_pool_t *pool) {
+  memset(pool, 0, sizeof(link_pool_t));
+  pool->idle_timeout = LINK_POOL_DEFAULT_IDLE_TIMEOUT;
+  for (int i = 0; i < LINK_POOL_SESSION_MAX; i++) {
+    pool->session[i].driver.phy_driver.handle = LINK_PHY_OPEN_ERROR;
+  }
+}
+
+void link_pool_exit(link_pool_t *pool) {
+  for (int i = 0; i < LINK_POOL_SESSION_MAX; i++) {
+    close_session(pool->session + i);
+  }
+}
+
+int link_pool_connect(
+  link_pool_t *pool,
+  link_transport_mdriver_t *driver,
+  const char *sn) {
+
+  if ((pool == NULL) || (driver == NULL)) {
+    link_errno = EINVAL;
+    return -1;
+  }
+
+  close_idle_sessions(pool);
+
+  if ((sn != NULL) && (strlen(sn) > 0)) {
+    if (connect_session(pool, driver, sn) == 0) {
+      pool->stats.session_count++;
+      return 0;
+    }
+
+    if (connect_cached(pool, driver, sn) == 0) {
+      pool->stats.cache_count++;
+      return 0;
+    }
+  }
+
+  pool->stats.scan_count++;
+  return connect_scan(pool, driver, sn);
+}
+
+int link_pool_disconnect(link_pool_t *pool, link_transport_mdriver_t *driver) {
+  if ((pool == NULL) || (driver == NULL)) {
+    link_errno = EINVAL;
+    return -1;
+  }
+
+  if (driver->phy_driver.handle == LINK_PHY_OPEN_ERROR) {
+    return 0;
+  }
+
+  link_pool_device_t *device = NULL;
+  for (int i = 0; i < LINK_POOL_DEVICE_MAX; i++) {
+    if (
+      (pool->device[i].transport_version != 0)
+      && (strcmp(pool->device[i].dev_name, driver->dev_name) == 0)) {
+      device = pool->device + i;
+      break;
+    }
+  }
+
+  if ((device == NULL) || (driver->transport_version == 0)) {
+    // only sessions with a known serial number can be handed out again
+    return link_disconnect(driver);
+  }
+
+  // park the session in a free slot or in place of the oldest one
+  link_pool_session_t *session = pool->session;
+  for (int i = 0; i < LINK_POOL_SESSION_MAX; i++) {
+    if (pool->session[i].driver.phy_driver.handle == LINK_PHY_OPEN_ERROR) {
+      session = pool->session + i;
+      break;
+    }
+    if (pool->session[i].timestamp < session->timestamp) {
+      session = pool->session + i;
+    }
+  }
+  close_session(session);
+
+  link_debug(LINK_DEBUG_MESSAGE, "park %s (%s)", device->serialno, driver->dev_name);
+  memcpy(&session->driver, driver, sizeof(link_transport_mdriver_t));
+  strcpy(session->serialno, device->serialno);
+  session->timestamp = link_transport_gettime();
+
+  // the pool owns the handle now
+  driver->phy_driver.handle = LINK_PHY_OPEN_ERROR;
+  driver->transport_version = 0;
+  return 0;
+}
+
+void link_pool_invalidate(link_pool_t *pool, const char *sn) {
+  link_pool_device_t *device;
+
+  // forget a device that was reset or moved (NULL forgets all of them)
+  for (int i = 0; i < LINK_POOL_SESSION_MAX; i++) {
+    if ((sn == NULL) || link_is_serialno_match(sn, pool->session[i].serialno)) {
+      close_session(pool->session + i);
+    }
+  }
+
+  while ((device = find_device(pool, sn)) != NULL) {
+    memset(device, 0, sizeof(link_pool_device_t));
+  }
+}
+
+int connect_session(
+  link_pool_t *pool,
+  link_transport_mdriver_t *driver,
+  const char *sn) {
+  for (int i = 0; i < LINK_POOL_SESSION_MAX; i++) {
+    link_pool_session_t *session = pool->session + i;
+    if (
+      (session->driver.phy_driver.handle == LINK_PHY_OPEN_ERROR)
+      || (link_is_serialno_match(sn, session->serialno) == 0)) {
+      continue;
+    }
+
+    if (session->driver.status(session->driver.phy_driver.handle) < 0) {
+      // unplugged while idle
+      close_session(session);
+      continue;
+    }
+
+    link_debug(
+      LINK_DEBUG_MESSAGE, "reuse %s (%s)", session->serialno,
+      session->driver.dev_name);
+    memcpy(driver, &session->driver, sizeof(link_transport_mdriver_t));
+    session->driver.phy_driver.handle = LINK_PHY_OPEN_ERROR;
+    driver->phy_driver.flush(driver->phy_driver.handle);
+    return 0;
+  }
+  return -1;
+}
+
+int connect_cached(
+  link_pool_t *pool,
+  link_transport_mdriver_t *driver,
+  const char *sn) {
+  char serialno[LINK_POOL_SERIALNO_MAX];
+  link_pool_device_t *device = find_device(pool, sn);
+
+  if (device == NULL) {
+    return -1;
+  }
+
+  // the serial number is still checked in case another device has the path
+  if (
+    (open_device(driver, device->dev_name, device->transport_version, serialno) == 0)
+    && (strcmp(serialno, device->serialno) == 0)) {
+    link_debug(LINK_DEBUG_MESSAGE, "cached %s at %s", serialno, device->dev_name);
+    return 0;
+  }
+
+  link_debug(LINK_DEBUG_MESSAGE, "%s is no longer at %s", sn, device->dev_name);
+  close_device(driver);
+  memset(device, 0, sizeof(link_pool_device_t));
+  return -1;
+}
+
+int connect_scan(
+  link_pool_t *pool,
+  link_transport_mdriver_t *driver,
+  const char *sn) {
+  char name[LINK_PHY_NAME_MAX];
+  char last[LINK_PHY_NAME_MAX];
+  char serialno[LINK_POOL_SERIALNO_MAX];
+
+  memset(last, 0, LINK_PHY_NAME_MAX);
+
+  while (driver->getname(name, last, LINK_PHY_NAME_MAX) == 0) {
+    if (open_device(driver, name, 0, serialno) == 0) {
+      // every device that answers goes in the cache
+      update_device(pool, name, serialno, driver->transport_version);
+      if (link_is_serialno_match(sn, serialno)) {
+        link_debug(LINK_DEBUG_MESSAGE, "found %s at %s", serialno, name);
+        return 0;
+      }
+    }
+    close_device(driver);
+    strcpy(last, name);
+  }
+
+  memset(driver->dev_name, 0, 64);
+  link_error("Device not found");
+  return -1;
+}
+
+int open_device(
+  link_transport_mdriver_t *driver,
+  const char *name,
+  u32 transport_version,
+  char *serialno) {
+
+  driver->transport_version = 0;
+  driver->phy_driver.handle = driver->phy_driver.open(name, driver->options);
+  if (driver->phy_driver.handle == LINK_PHY_OPEN_ERROR) {
+    return -1;
+  }
+
+  snprintf(driver->dev_name, sizeof(driver->dev_name), "%s", name);
+
+  if (transport_version == 3) {
+    // link3 needs a new session on every open
+    driver->transport_version = 3;
+    if (link3_start_secure_session(driver) < 0) {
+      return -1;
+    }
+  } else if (transport_version == 4) {
+    // link4 still needs the slave's sequence number
+    if (link4_transport_masterprobe(driver) <= 0) {
+      return -1;
+    }
+    driver->transport_version = 4;
+  } else {
+    // skips protocol resolution (0 resolves it)
+    driver->transport_version = transport_version;
+  }
+
+  memset(serialno, 0, LINK_POOL_SERIALNO_MAX);
+  if (link_readserialno_noreset(driver, serialno, LINK_POOL_SERIALNO_MAX - 1) < 0) {
+    return -1;
+  }
+  return driver->transport_version == 0 ? -1 : 0;
+}
+
+void close_device(link_transport_mdriver_t *driver) {
+  if (driver->phy_driver.handle != LINK_PHY_OPEN_ERROR) {
+    driver->phy_driver.close(&(driver->phy_driver.handle));
+  }
+  driver->phy_driver.handle = LINK_PHY_OPEN_ERROR;
+  driver->transport_version = 0;
+}
+
+void close_session(link_pool_session_t *session) {
+  close_device(&session->driver);
+  memset(session->serialno, 0, LINK_POOL_SERIALNO_MAX);
+}
+
+void close_idle_sessions(link_pool_t *pool) {
+  const u64 now = link_transport_gettime();
+  for (int i = 0; i < LINK_POOL_SESSION_MAX; i++) {
+    link_pool_session_t *session = pool->session + i;
+    if (
+      (session->driver.phy_driver.handle != LINK_PHY_OPEN_ERROR)
+      && (now - session->timestamp > pool->idle_timeout * 1000ULL)) {
+      close_session(session);
+    }
+  }
+}
+
+link_pool_device_t *find_device(link_pool_t *pool, const char *sn) {
+  for (int i = 0; i < LINK_POOL_DEVICE_MAX; i++) {
+    link_pool_device_t *device = pool->device + i;
+    if (
+      (device->transport_version != 0)
+      && ((sn == NULL) || link_is_serialno_match(sn, device->serialno))) {
+      return device;
+    }
+  }
+  return NULL;
+}
+
+void update_device(
+  link_pool_t *pool,
+  const char *name,
+  const char *serialno,
+  u32 version) {
+  link_pool_device_t *device = NULL;
+
+  // one entry per path and per serial number
+  for (int i = 0; i < LINK_POOL_DEVICE_MAX; i++) {
+    link_pool_device_t *entry = pool->device + i;
+    if (
+      (entry->transport_version != 0)
+      && ((strcmp(entry->dev_name, name) == 0)
+          || (strcmp(entry->serialno, serialno) == 0))) {
+      memset(entry, 0, sizeof(link_pool_device_t));
+    }
+    if ((device == NULL) && (entry->transport_version == 0)) {
+      device = entry;
+    }
+  }
+
+  if (device == NULL) {
+    // full -- the first entry makes room
+    memmove(
+      pool->device, pool->device + 1,
+      (LINK_POOL_DEVICE_MAX - 1) * sizeof(link_pool_device_t));
+    device = pool->device + LINK_POOL_DEVICE_MAX - 1;
+  }
+
+  snprintf(device->dev_name, sizeof(device->dev_name), "%s", name);
+  snprintf(device->serialno, sizeof(device->serialno), "%s", serialno);
+  device->transport_version = version;
+}
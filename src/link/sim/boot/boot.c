@@ -0,0 +1,227 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// The bootloader end of the simulation: boot_link_update() from src/boot serving
+// the far end of a pty with the link2 slave transport. The flash is an array that
+// only clears bits until it is erased and takes flash page us to program a page
+// (the device does nothing else while it programs). A legacy bootloader has no
+// LINK_CMD_WRITE like the ones before it. Resets aren't simulated.
+//
+//   boot_device_sim <pty fd> <flash page us> [turnaround us] [legacy]
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "boot_config.h"
+#include "boot_link.h"
+#include "cortexm/cortexm.h"
+#include "sos/led.h"
+#include "sos/sos.h"
+
+#include "../sim_boot.h"
+
+static u8 m_flash[SIM_BOOT_FLASH_SIZE];
+
+static int m_fd;
+static pid_t m_host_pid;
+static int m_page_us;
+static int m_delay_us;
+static bool m_is_turnaround;
+static bool m_is_legacy;
+
+static void get_serial_number(mcu_sn_t *serial_number) {
+  memset(serial_number, 0, sizeof(mcu_sn_t));
+  serial_number->sn[0] = getpid();
+}
+
+static void event_handler(int event, void *args) {
+  fprintf(stderr, "boot: fatal event %d (%s)\n", event, (const char *)args);
+  exit(1);
+}
+
+static int flash_write_page(const devfs_handle_t *handle, void *ctl) {
+  const bootloader_writepage_t *page = ctl;
+  if (
+    (page->addr < SIM_BOOT_PROGRAM_START) || (page->nbyte > BOOTLOADER_WRITEPAGESIZE)
+    || (page->addr + page->nbyte > SIM_BOOT_FLASH_SIZE)) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  for (u32 i = 0; i < page->nbyte; i++) {
+    u8 *dest = m_flash + page->addr + i;
+    if ((*dest | page->buf[i]) != *dest) {
+      fprintf(stderr, "boot: 0x%X is written without an erase\n", page->addr + i);
+      exit(1);
+    }
+    *dest = page->buf[i];
+  }
+  usleep(m_page_us);
+  return page->nbyte;
+}
+
+// returns an error for the bootloader's pages and past the end of the flash
+static int flash_erase_page(const devfs_handle_t *handle, void *ctl) {
+  const u32 addr = (u32)(uintptr_t)ctl * SIM_BOOT_ERASE_SIZE;
+  if ((addr < SIM_BOOT_PROGRAM_START) || (addr >= SIM_BOOT_FLASH_SIZE)) {
+    return SYSFS_SET_RETURN(EINVAL);
+  }
+  memset(m_flash + addr, 0xff, SIM_BOOT_ERASE_SIZE);
+  return 0;
+}
+
+const sos_config_t sos_config = {
+  .sys = {.get_serial_number = get_serial_number},
+  .boot =
+    {.program_start_address = SIM_BOOT_PROGRAM_START,
+     .flash_erase_page = flash_erase_page,
+     .flash_write_page = flash_write_page},
+  .event_handler = event_handler};
+
+// the flash is read from the array rather than its address
+int mcu_sync_io(
+  const devfs_handle_t *handle,
+  int (*func)(const devfs_handle_t *handle, devfs_async_t *op),
+  int loc,
+  const void *buf,
+  int nbyte,
+  int flags) {
+  if ((loc < 0) || (nbyte < 0) || (loc + nbyte > SIM_BOOT_FLASH_SIZE)) {
+    errno = EINVAL;
+    return -1;
+  }
+  memcpy((void *)buf, m_flash + loc, nbyte);
+  return nbyte;
+}
+
+void sos_handle_event(int event, void *args) {}
+
+// no led
+void sos_led_svcall_enable(void *args) {}
+void sos_led_svcall_disable(void *args) {}
+void sos_led_root_enable() {}
+void sos_led_root_disable() {}
+
+u32 cortexm_get_hardware_id() { return 0x00000001; }
+
+void cortexm_reset(void *args) { exit(0); }
+
+// sim_device.h counts copies for link_device_sim
+void *sim_memcpy(void *dest, const void *src, size_t n) {
+  return __builtin_memcpy(dest, src, n);
+}
+
+u16 mcu_calc_crc16(u16 seed, u16 polynomial, const u8 *buffer, u32 nbyte) {
+  u16 crc = seed;
+  for (u32 i = 0; i < nbyte; i++) {
+    crc ^= buffer[i] << 8;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ polynomial : crc << 1;
+    }
+  }
+  return crc;
+}
+
+static link_transport_phy_t phy_open(const char *name, const void *options) {
+  return m_fd;
+}
+
+static int phy_read(link_transport_phy_t handle, void *buf, int nbyte) {
+  struct pollfd pfd = {.fd = handle, .events = POLLIN};
+  if (poll(&pfd, 1, -1) < 0) {
+    return 0;
+  }
+  if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+    if (getppid() != m_host_pid) {
+      exit(0);
+    }
+    usleep(1000);
+    return 0;
+  }
+  const int result = read(handle, buf, nbyte);
+  if (result > 0) {
+    m_is_turnaround = true;
+  }
+  return result < 0 ? 0 : result;
+}
+
+static int phy_write(link_transport_phy_t handle, const void *buf, int nbyte) {
+  const u8 *p = buf;
+  int bytes = 0;
+  if (m_delay_us && m_is_turnaround) {
+    usleep(m_delay_us);
+  }
+  m_is_turnaround = false;
+  while (bytes < nbyte) {
+    const int result = write(handle, p + bytes, nbyte - bytes);
+    if (result < 0) {
+      return -1;
+    }
+    bytes += result;
+  }
+  return nbyte;
+}
+
+static void phy_flush(link_transport_phy_t handle) {
+  u8 buffer[256];
+  struct pollfd pfd = {.fd = handle, .events = POLLIN};
+  while ((poll(&pfd, 1, 1) > 0) && (pfd.revents & POLLIN)) {
+    if (read(handle, buffer, sizeof(buffer)) <= 0) {
+      break;
+    }
+  }
+}
+
+static void phy_wait(int msec) { usleep(msec * 1000); }
+
+static int transport_read(
+  link_transport_driver_t *driver,
+  void *buf,
+  int nbyte,
+  int (*callback)(void *, void *, int),
+  void *context) {
+  const int result = link2_transport_slaveread(driver, buf, nbyte, callback, context);
+  link_op_t *op = buf;
+  if (
+    m_is_legacy && (result > 0) && (nbyte == sizeof(link_op_t))
+    && (op->cmd == LINK_CMD_WRITE)) {
+    // the command table ended before LINK_CMD_WRITE
+    op->cmd = LINK_BOOTLOADER_CMD_TOTAL;
+  }
+  return result;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    fprintf(
+      stderr, "usage: boot_device_sim <pty fd> <flash page us> [turnaround us] [legacy]\n");
+    return 1;
+  }
+
+  m_fd = atoi(argv[1]);
+  m_host_pid = getppid();
+  m_page_us = atoi(argv[2]);
+  m_delay_us = argc > 3 ? atoi(argv[3]) : 0;
+  m_is_legacy = (argc > 4) && (strcmp(argv[4], "legacy") == 0);
+
+  // the bootloader is a pattern the host can check
+  for (int i = 0; i < SIM_BOOT_FLASH_SIZE; i++) {
+    m_flash[i] = i < SIM_BOOT_PROGRAM_START ? (u8)(i * 7) : 0xff;
+  }
+
+  link_transport_driver_t driver = {
+    .open = phy_open,
+    .read = phy_read,
+    .write = phy_write,
+    .flush = phy_flush,
+    .wait = phy_wait,
+    .transport_read = transport_read,
+    .transport_write = link2_transport_slavewrite,
+    .timeout = 500,
+    .o_flags = LINK2_FLAG_IS_CHECKSUM};
+  boot_link_update(&driver);
+  return 0;
+}
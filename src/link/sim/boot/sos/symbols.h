@@ -0,0 +1,3 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// boot_link.c uses nothing from the kernel symbol table
@@ -0,0 +1,177 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+#include "sim_boot.h"
+#include "sos/dev/bootloader.h"
+
+#define IMAGE_SIZE (256 * 1024)
+#define TEST_PAGE_US 100
+
+static u8 m_image[IMAGE_SIZE];
+static u8 m_out[SIM_BOOT_FLASH_SIZE];
+
+// the bootloader is untouched and nothing past the image is programmed
+static int check_flash(sim_device_t *device, int image_size) {
+  if (
+    link_readflash(&device->driver, 0, m_out, SIM_BOOT_FLASH_SIZE)
+    != SIM_BOOT_FLASH_SIZE) {
+    return -1;
+  }
+  for (int i = 0; i < SIM_BOOT_PROGRAM_START; i++) {
+    if (m_out[i] != (u8)(i * 7)) {
+      return -1;
+    }
+  }
+  if (memcmp(m_out + SIM_BOOT_PROGRAM_START, m_image, image_size)) {
+    return -1;
+  }
+  for (int i = SIM_BOOT_PROGRAM_START + image_size; i < SIM_BOOT_FLASH_SIZE; i++) {
+    if (m_out[i] != 0xff) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+// erases, writes and verifies the image the way an update does
+static int update(sim_device_t *device, const bootloader_attr_t *attr, int size) {
+  const auth_signature_t signature = {};
+  if (link_eraseflash(&device->driver) < 0) {
+    return -1;
+  }
+  if (link_writeflash(&device->driver, SIM_BOOT_PROGRAM_START, m_image, size) != size) {
+    return -1;
+  }
+  // the first page is programmed once the signature is checked
+  return link_verify_signature(&device->driver, attr, &signature);
+}
+
+// a stream that would overwrite the bootloader or wrap past the end of the address
+// space is refused before any data is sent
+static void test_range(sim_device_t *device) {
+  static const struct {
+    u32 addr;
+    int nbyte;
+  } ranges[] = {
+    {SIM_BOOT_PROGRAM_START - BOOTLOADER_WRITEPAGESIZE, 4 * BOOTLOADER_WRITEPAGESIZE},
+    {SIM_BOOT_PROGRAM_START - 1, 2},
+    {0, SIM_BOOT_PROGRAM_START + 1},
+    {0xfffffc00, 4 * BOOTLOADER_WRITEPAGESIZE},
+    {0xffffffff, 2}};
+
+  CHECK(link_eraseflash(&device->driver) == 0);
+  for (unsigned int i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+    link_errno = 0;
+    CHECK(
+      link_writeflash(&device->driver, (int)ranges[i].addr, m_image, ranges[i].nbyte) < 0);
+    CHECK(link_errno == EFAULT);
+  }
+  CHECK(check_flash(device, 0) == 0);
+
+  // past the end of the flash -- the range is accepted and the second page fails to
+  // program. The packet after it is nacked and the host gets the flash's error.
+  link_errno = 0;
+  CHECK(
+    link_writeflash(
+      &device->driver, SIM_BOOT_FLASH_SIZE - BOOTLOADER_WRITEPAGESIZE, m_image,
+      4 * BOOTLOADER_WRITEPAGESIZE)
+    < 0);
+  CHECK(link_errno == EINVAL);
+
+  // the connection is still in sync
+  bootloader_attr_t attr;
+  CHECK(link_bootloader_attr(&device->driver, &attr, 0) == 0);
+  CHECK(attr.startaddr == SIM_BOOT_PROGRAM_START);
+}
+
+static void test_device(bool is_legacy) {
+  sim_device_t device;
+  bootloader_attr_t attr;
+  // the page requests write whole pages
+  const int sizes[] = {300, 1024, 5000, 70001, IMAGE_SIZE};
+  const int legacy_sizes[] = {1024, 5 * 1024, IMAGE_SIZE};
+
+  if (sim_bootloader_start(&device, TEST_PAGE_US, 0, is_legacy) < 0) {
+    printf("bootloader: failed to start the device\n");
+    sim_failures++;
+    sim_device_stop(&device);
+    return;
+  }
+
+  if (link_isbootloader(&device.driver) != 1) {
+    printf("bootloader: not a bootloader\n");
+    sim_failures++;
+  } else if (link_bootloader_attr(&device.driver, &attr, 0) < 0) {
+    printf("bootloader: no attributes\n");
+    sim_failures++;
+  } else {
+    const int *size = is_legacy ? legacy_sizes : sizes;
+    const int count = is_legacy ? sizeof(legacy_sizes) / sizeof(legacy_sizes[0])
+                                : sizeof(sizes) / sizeof(sizes[0]);
+    for (int i = 0; i < count; i++) {
+      if ((update(&device, &attr, size[i]) < 0) || (check_flash(&device, size[i]) < 0)) {
+        printf(
+          "%s:%d: %s image of %d bytes failed\n", __FILE__, __LINE__,
+          is_legacy ? "legacy" : "stream", size[i]);
+        sim_failures++;
+      }
+    }
+    if (is_legacy == false) {
+      test_range(&device);
+    }
+  }
+
+  sim_device_stop(&device);
+}
+
+void test_bootloader() {
+  srand(1);
+  for (int i = 0; i < IMAGE_SIZE; i++) {
+    m_image[i] = rand();
+  }
+  test_device(false);
+  test_device(true);
+}
+
+// seconds to write the image
+static double bench_update(int flash_page_us, int turnaround_us, bool is_legacy) {
+  sim_device_t device;
+  bootloader_attr_t attr;
+  double result = -1;
+  if (
+    (sim_bootloader_start(&device, flash_page_us, turnaround_us, is_legacy) == 0)
+    && (link_bootloader_attr(&device.driver, &attr, 0) == 0)
+    && (link_eraseflash(&device.driver) == 0)) {
+    const double start = sim_now_us();
+    if (
+      link_writeflash(&device.driver, SIM_BOOT_PROGRAM_START, m_image, IMAGE_SIZE)
+      == IMAGE_SIZE) {
+      result = (sim_now_us() - start) / 1e6;
+    }
+  }
+  sim_device_stop(&device);
+  return result;
+}
+
+// one request per page against the stream
+void bench_bootloader() {
+  static const struct {
+    int flash_page_us;
+    int turnaround_us;
+  } cases[] = {{3000, 0}, {3000, 1000}, {1000, 1000}};
+  for (unsigned int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    const double pages = bench_update(cases[i].flash_page_us, cases[i].turnaround_us, true);
+    const double stream =
+      bench_update(cases[i].flash_page_us, cases[i].turnaround_us, false);
+    printf(
+      "bench: bootloader: %d KiB, %d us/page, %d us turnaround: pages %.2f s, stream "
+      "%.2f s (x%.2f, flash alone %.2f s)\n",
+      IMAGE_SIZE / 1024, cases[i].flash_page_us, cases[i].turnaround_us, pages, stream,
+      pages / stream,
+      (IMAGE_SIZE / BOOTLOADER_WRITEPAGESIZE) * cases[i].flash_page_us / 1e6);
+  }
+}
@@ -0,0 +1,235 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+#define FILE_COUNT 10
+
+static int m_write_count;
+static int (*m_phy_write)(link_transport_phy_t, const void *, int);
+
+// each transport transaction starts with a host write
+static int count_write(link_transport_phy_t handle, const void *buf, int nbyte) {
+  m_write_count++;
+  return m_phy_write(handle, buf, nbyte);
+}
+
+static void count_writes(sim_device_t *device) {
+  m_phy_write = device->driver.phy_driver.write;
+  device->driver.phy_driver.write = count_write;
+}
+
+static void create_files(const sim_device_t *device) {
+  for (int i = 0; i < FILE_COUNT; i++) {
+    char path[64];
+    sprintf(path, "%s/f%d", device->root, i);
+    FILE *f = fopen(path, "w");
+    fprintf(f, "file %d contents", i);
+    fclose(f);
+  }
+}
+
+static void test_list(sim_device_t *device) {
+  link_compound_request_t request;
+  link_compound_init(&request, 0);
+  const int first = link_compound_add_opendir(&request, ".");
+  CHECK(first == 0);
+  for (int i = 0; i < FILE_COUNT + 4; i++) {
+    CHECK(link_compound_add_readdir(&request, LINK_COMPOUND_FILDES) == i + 1);
+  }
+  const int last = link_compound_add_closedir(&request, LINK_COMPOUND_FILDES);
+
+  m_write_count = 0;
+  CHECK(link_compound_execute(&device->driver, &request) == last + 1);
+  printf("compound: listing %d files: %d host writes\n", FILE_COUNT, m_write_count);
+  CHECK(m_write_count <= 4);
+
+  CHECK(link_compound_get_result(&request, first, NULL, 0) >= 0);
+  int seen = 0;
+  int entries = 0;
+  for (int i = 1; i < last; i++) {
+    struct link_dirent entry;
+    if (link_compound_get_result(&request, i, &entry, sizeof(entry)) < 0) {
+      // the end of the directory is reported as an error
+      CHECK(link_errno == ENOENT);
+      continue;
+    }
+    entries++;
+    int number;
+    if (sscanf(entry.d_name, "f%d", &number) == 1) {
+      CHECK(number >= 0 && number < FILE_COUNT);
+      seen |= 1 << number;
+    }
+  }
+  CHECK(entries == FILE_COUNT + 2);
+  CHECK(seen == (1 << FILE_COUNT) - 1);
+  CHECK(link_compound_get_result(&request, last, NULL, 0) == 0);
+}
+
+// stat then open/fstat/read/close for every file in one request
+static void test_files(sim_device_t *device) {
+  link_compound_request_t request;
+  link_compound_init(&request, 0);
+  for (int i = 0; i < FILE_COUNT; i++) {
+    char path[16];
+    sprintf(path, "f%d", i);
+    CHECK(link_compound_add_stat(&request, path) == i * 5);
+    CHECK(link_compound_add_open(&request, path, O_RDONLY, 0) >= 0);
+    CHECK(link_compound_add_fstat(&request, LINK_COMPOUND_FILDES) >= 0);
+    CHECK(link_compound_add_read(&request, LINK_COMPOUND_FILDES, 64) >= 0);
+    CHECK(link_compound_add_close(&request, LINK_COMPOUND_FILDES) >= 0);
+  }
+
+  m_write_count = 0;
+  CHECK(link_compound_execute(&device->driver, &request) == FILE_COUNT * 5);
+  printf(
+    "compound: %d operations on %d files: %d host writes\n", FILE_COUNT * 5, FILE_COUNT,
+    m_write_count);
+  CHECK(m_write_count <= 4);
+
+  for (int i = 0; i < FILE_COUNT; i++) {
+    char expected[32];
+    const int size = sprintf(expected, "file %d contents", i);
+    struct link_stat st;
+    struct link_stat fst;
+    char data[64];
+    CHECK(link_compound_get_result(&request, i * 5, &st, sizeof(st)) == 0);
+    CHECK(st.st_size == size);
+    CHECK(link_compound_get_result(&request, i * 5 + 1, NULL, 0) >= 0);
+    CHECK(link_compound_get_result(&request, i * 5 + 2, &fst, sizeof(fst)) == 0);
+    CHECK(fst.st_size == size);
+    CHECK(link_compound_get_result(&request, i * 5 + 3, data, sizeof(data)) == size);
+    CHECK(memcmp(data, expected, size) == 0);
+    CHECK(link_compound_get_result(&request, i * 5 + 4, NULL, 0) == 0);
+  }
+}
+
+static void test_stop_on_error(sim_device_t *device) {
+  link_compound_request_t request;
+  struct link_stat st;
+
+  link_compound_init(&request, LINK_COMPOUND_FLAG_IS_STOP_ON_ERROR);
+  link_compound_add_stat(&request, "missing");
+  link_compound_add_stat(&request, "f0");
+  CHECK(link_compound_execute(&device->driver, &request) == 1);
+  CHECK(link_compound_get_result(&request, 0, &st, sizeof(st)) < 0);
+  CHECK(link_errno == ENOENT);
+  CHECK(link_compound_get_result(&request, 1, &st, sizeof(st)) < 0);
+  CHECK(link_errno == EAGAIN);
+
+  // without the flag the rest of the request runs
+  link_compound_init(&request, 0);
+  link_compound_add_stat(&request, "missing");
+  link_compound_add_stat(&request, "f0");
+  CHECK(link_compound_execute(&device->driver, &request) == 2);
+  CHECK(link_compound_get_result(&request, 1, &st, sizeof(st)) == 0);
+}
+
+static void test_write(sim_device_t *device) {
+  link_compound_request_t request;
+  char path[64];
+  sprintf(path, "%s/new", device->root);
+
+  link_compound_init(&request, LINK_COMPOUND_FLAG_IS_STOP_ON_ERROR);
+  link_compound_add_mkdir(&request, "dir", 0777);
+  link_compound_add_open(&request, "new", O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  link_compound_add_write(&request, LINK_COMPOUND_FILDES, "written", 7);
+  link_compound_add_close(&request, LINK_COMPOUND_FILDES);
+  CHECK(link_compound_execute(&device->driver, &request) == 4);
+  CHECK(link_compound_get_result(&request, 2, NULL, 0) == 7);
+
+  char data[16] = {0};
+  FILE *f = fopen(path, "r");
+  CHECK(f != NULL);
+  CHECK(fread(data, 1, sizeof(data), f) == 7);
+  fclose(f);
+  CHECK(strcmp(data, "written") == 0);
+
+  link_compound_init(&request, LINK_COMPOUND_FLAG_IS_STOP_ON_ERROR);
+  link_compound_add_unlink(&request, "new");
+  link_compound_add_rmdir(&request, "dir");
+  CHECK(link_compound_execute(&device->driver, &request) == 2);
+  CHECK(access(path, F_OK) < 0);
+}
+
+// the same operations one link call at a time
+static void test_separate(sim_device_t *device) {
+  m_write_count = 0;
+  for (int i = 0; i < FILE_COUNT; i++) {
+    char path[16];
+    char data[64];
+    struct stat st;
+    sprintf(path, "f%d", i);
+    CHECK(link_stat(&device->driver, path, &st) == 0);
+    const int fd = link_open(&device->driver, path, O_RDONLY);
+    CHECK(fd >= 0);
+    CHECK(link_fstat(&device->driver, fd, &st) == 0);
+    CHECK(link_read(&device->driver, fd, data, sizeof(data)) == st.st_size);
+    CHECK(link_close(&device->driver, fd) == 0);
+  }
+  printf(
+    "compound: the same operations one at a time: %d host writes\n", m_write_count);
+}
+
+void test_compound() {
+  sim_device_t device;
+  CHECK(sim_device_start(&device, 0, 0) == 0);
+  count_writes(&device);
+  create_files(&device);
+
+  test_list(&device);
+  test_files(&device);
+  test_stop_on_error(&device);
+  test_write(&device);
+  test_separate(&device);
+
+  sim_device_stop(&device);
+}
+
+// a device that takes 1 ms to turn around -- the cost is in the round trips
+void bench_compound() {
+  sim_device_t device;
+  if (sim_device_start(&device, 1000, 0) < 0) {
+    return;
+  }
+  create_files(&device);
+
+  double start = sim_now_us();
+  for (int i = 0; i < FILE_COUNT; i++) {
+    char path[16];
+    char data[64];
+    struct stat st;
+    sprintf(path, "f%d", i);
+    link_stat(&device.driver, path, &st);
+    const int fd = link_open(&device.driver, path, O_RDONLY);
+    link_fstat(&device.driver, fd, &st);
+    link_read(&device.driver, fd, data, sizeof(data));
+    link_close(&device.driver, fd);
+  }
+  const double separate = sim_now_us() - start;
+
+  start = sim_now_us();
+  link_compound_request_t request;
+  link_compound_init(&request, 0);
+  for (int i = 0; i < FILE_COUNT; i++) {
+    char path[16];
+    sprintf(path, "f%d", i);
+    link_compound_add_stat(&request, path);
+    link_compound_add_open(&request, path, O_RDONLY, 0);
+    link_compound_add_fstat(&request, LINK_COMPOUND_FILDES);
+    link_compound_add_read(&request, LINK_COMPOUND_FILDES, 64);
+    link_compound_add_close(&request, LINK_COMPOUND_FILDES);
+  }
+  link_compound_execute(&device.driver, &request);
+  const double compound = sim_now_us() - start;
+
+  printf(
+    "bench: compound: %d files, 1 ms turnaround: separate calls %.1f ms, compound %.1f ms\n",
+    FILE_COUNT, separate / 1000, compound / 1000);
+  sim_device_stop(&device);
+}
@@ -0,0 +1,99 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include "sim_stats.h"
+
+#define TRANSFER_SIZE (64 * 1024)
+#define COMPOUND_WRITE_SIZE 512
+
+static volatile sim_stats_t *m_stats;
+
+static void get_stats(sim_stats_t *stats) {
+  stats->copy_bytes = m_stats->copy_bytes;
+  stats->file_bytes = m_stats->file_bytes;
+}
+
+static void print_copies(const char *name, int nbyte, const sim_stats_t *start) {
+  printf(
+    "copy: %s %d bytes: %u bytes copied by the device, %u to or from files\n", name,
+    nbyte, m_stats->copy_bytes - start->copy_bytes,
+    m_stats->file_bytes - start->file_bytes);
+}
+
+static void test_transfers(sim_device_t *device, const u8 *data, u8 *out) {
+  sim_stats_t start;
+  const int fd = link_open(&device->driver, "copy", O_RDWR | O_CREAT | O_TRUNC, 0666);
+  CHECK(fd >= 0);
+
+  // packet data goes to the file system without another copy
+  get_stats(&start);
+  CHECK(link_write(&device->driver, fd, data, TRANSFER_SIZE) == TRANSFER_SIZE);
+  print_copies("link_write()", TRANSFER_SIZE, &start);
+  CHECK(m_stats->file_bytes - start.file_bytes == TRANSFER_SIZE);
+  CHECK(m_stats->copy_bytes - start.copy_bytes < TRANSFER_SIZE / 64);
+
+  CHECK(link_lseek(&device->driver, fd, 0, SEEK_SET) == 0);
+  get_stats(&start);
+  CHECK(link_read(&device->driver, fd, out, TRANSFER_SIZE) == TRANSFER_SIZE);
+  print_copies("link_read()", TRANSFER_SIZE, &start);
+  CHECK(memcmp(out, data, TRANSFER_SIZE) == 0);
+  CHECK(m_stats->file_bytes - start.file_bytes == TRANSFER_SIZE);
+  CHECK(m_stats->copy_bytes - start.copy_bytes < TRANSFER_SIZE / 64);
+  CHECK(link_close(&device->driver, fd) == 0);
+
+  // a compound request is staged whole before any of it runs
+  link_compound_request_t request;
+  link_compound_init(&request, 0);
+  link_compound_add_open(&request, "copy", O_WRONLY | O_TRUNC, 0);
+  link_compound_add_write(&request, LINK_COMPOUND_FILDES, data, COMPOUND_WRITE_SIZE);
+  link_compound_add_close(&request, LINK_COMPOUND_FILDES);
+  get_stats(&start);
+  CHECK(link_compound_execute(&device->driver, &request) == 3);
+  print_copies("compound write", COMPOUND_WRITE_SIZE, &start);
+  CHECK(link_compound_get_result(&request, 1, NULL, 0) == COMPOUND_WRITE_SIZE);
+  CHECK(m_stats->file_bytes - start.file_bytes == COMPOUND_WRITE_SIZE);
+  CHECK(m_stats->copy_bytes - start.copy_bytes >= request.size);
+}
+
+void test_copy() {
+  sim_device_t device;
+  char path[] = "/tmp/link_sim_stats.XXXXXX";
+  const int fd = mkstemp(path);
+  if ((fd < 0) || (ftruncate(fd, sizeof(sim_stats_t)) < 0)) {
+    printf("copy: failed to create %s\n", path);
+    sim_failures++;
+    return;
+  }
+  m_stats = mmap(NULL, sizeof(sim_stats_t), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  u8 *data = malloc(TRANSFER_SIZE);
+  u8 *out = malloc(TRANSFER_SIZE);
+  for (int i = 0; i < TRANSFER_SIZE; i++) {
+    data[i] = i * 7;
+  }
+
+  // the device maps the same file
+  setenv(SIM_STATS_ENV, path, 1);
+  if ((m_stats != MAP_FAILED) && (sim_device_start(&device, 0, 0) == 0)) {
+    test_transfers(&device, data, out);
+  } else {
+    printf("copy: failed to start the device\n");
+    sim_failures++;
+  }
+  unsetenv(SIM_STATS_ENV);
+
+  sim_device_stop(&device);
+  if (m_stats != MAP_FAILED) {
+    munmap((void *)m_stats, sizeof(sim_stats_t));
+  }
+  unlink(path);
+  free(data);
+  free(out);
+}
@@ -0,0 +1,160 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+
+#define FILE_SIZE (64 * 1024)
+#define SHIFT_SIZE 100
+
+static int m_write_bytes;
+static int (*m_phy_write)(link_transport_phy_t, const void *, int);
+
+static int count_write(link_transport_phy_t handle, const void *buf, int nbyte) {
+  m_write_bytes += nbyte;
+  return m_phy_write(handle, buf, nbyte);
+}
+
+static int digest_is(const void *buf, int nbyte, const char *expected) {
+  link_delta_digest_t digest;
+  u8 result[LINK_DELTA_DIGEST_SIZE];
+  char hex[LINK_DELTA_DIGEST_SIZE * 2 + 1];
+  link_delta_digest_start(&digest);
+  // odd sized pieces cross the 64 byte blocks
+  for (int offset = 0; offset < nbyte; offset += 37) {
+    link_delta_digest_update(
+      &digest, (const u8 *)buf + offset, nbyte - offset < 37 ? nbyte - offset : 37);
+  }
+  link_delta_digest_finish(&digest, result);
+  for (int i = 0; i < LINK_DELTA_DIGEST_SIZE; i++) {
+    sprintf(hex + i * 2, "%02x", result[i]);
+  }
+  return strcmp(hex, expected) == 0;
+}
+
+// the FIPS 180-2 examples
+static void test_digest() {
+  CHECK(digest_is(
+    "", 0, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"));
+  CHECK(digest_is(
+    "abc", 3, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"));
+  CHECK(digest_is(
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 56,
+    "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"));
+  char *a = malloc(1000000);
+  memset(a, 'a', 1000000);
+  const int is_ok = digest_is(
+    a, 1000000, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+  free(a);
+  CHECK(is_ok);
+}
+
+static int write_old(const sim_device_t *device, const u8 *data, int nbyte) {
+  char path[64];
+  sprintf(path, "%s/old", device->root);
+  FILE *f = fopen(path, "w");
+  if (f == NULL) {
+    return -1;
+  }
+  const int result = fwrite(data, 1, nbyte, f);
+  fclose(f);
+  return result == nbyte ? 0 : -1;
+}
+
+static int new_is(const sim_device_t *device, const u8 *data, int nbyte) {
+  char path[64];
+  sprintf(path, "%s/new", device->root);
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    return 0;
+  }
+  u8 *buffer = malloc(nbyte + 1);
+  const int result = fread(buffer, 1, nbyte + 1, f);
+  fclose(f);
+  const int is_same = (result == nbyte) && (memcmp(buffer, data, nbyte) == 0);
+  free(buffer);
+  return is_same;
+}
+
+// rebuilds new from old on the device and returns the bytes the host sent
+static int write_delta(
+  sim_device_t *device,
+  const u8 *old,
+  int old_size,
+  const u8 *data,
+  int nbyte) {
+  if (write_old(device, old, old_size) < 0) {
+    return -1;
+  }
+  const int old_fd = link_open(&device->driver, "old", O_RDONLY);
+  const int fd = link_open(&device->driver, "new", O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if ((old_fd < 0) || (fd < 0)) {
+    return -1;
+  }
+  m_write_bytes = 0;
+  const int result = link_write_delta(&device->driver, old_fd, fd, data, nbyte);
+  const int bytes = m_write_bytes;
+  link_close(&device->driver, old_fd);
+  link_close(&device->driver, fd);
+  if ((result != nbyte) || (new_is(device, data, nbyte) == 0)) {
+    return -1;
+  }
+  return bytes;
+}
+
+static void test_files(sim_device_t *device, const u8 *old) {
+  u8 *data = malloc(FILE_SIZE + SHIFT_SIZE);
+
+  // identical
+  int bytes = write_delta(device, old, FILE_SIZE, old, FILE_SIZE);
+  printf("delta: identical %d KiB file: %d bytes sent\n", FILE_SIZE / 1024, bytes);
+  CHECK(bytes > 0);
+  CHECK(bytes < FILE_SIZE / 8);
+
+  // shifted by an insert at the start and with a changed byte in the middle
+  memset(data, 0x5a, SHIFT_SIZE);
+  memcpy(data + SHIFT_SIZE, old, FILE_SIZE);
+  data[SHIFT_SIZE + FILE_SIZE / 2] ^= 0xff;
+  bytes = write_delta(device, old, FILE_SIZE, data, FILE_SIZE + SHIFT_SIZE);
+  printf("delta: shifted and changed file: %d bytes sent\n", bytes);
+  CHECK(bytes > 0);
+  CHECK(bytes < FILE_SIZE / 8);
+
+  // truncated -- the new file ends inside a block
+  bytes = write_delta(device, old, FILE_SIZE, old, FILE_SIZE / 2 + 17);
+  printf("delta: truncated file: %d bytes sent\n", bytes);
+  CHECK(bytes > 0);
+  CHECK(bytes < FILE_SIZE / 8);
+
+  // an empty new file and an empty old file
+  CHECK(write_delta(device, old, FILE_SIZE, old, 0) >= 0);
+  bytes = write_delta(device, old, 0, old, FILE_SIZE);
+  CHECK(bytes >= FILE_SIZE);
+
+  free(data);
+}
+
+void test_delta() {
+  sim_device_t device;
+  test_digest();
+
+  u8 *old = malloc(FILE_SIZE);
+  srand(2);
+  for (int i = 0; i < FILE_SIZE; i++) {
+    old[i] = rand();
+  }
+
+  if (sim_device_start(&device, 0, 0) == 0) {
+    m_phy_write = device.driver.phy_driver.write;
+    device.driver.phy_driver.write = count_write;
+    test_files(&device, old);
+  } else {
+    printf("delta: failed to start the device\n");
+    sim_failures++;
+  }
+
+  sim_device_stop(&device);
+  free(old);
+}
@@ -0,0 +1,9 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_CONFIG_H_
+#define SIM_CONFIG_H_
+
+#include "sos/debug.h"
+#include "sos_config.h"
+
+#endif /* SIM_CONFIG_H_ */
@@ -0,0 +1,20 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// the link thread only makes service calls -- they run in place
+
+#ifndef SIM_CORTEXM_CORTEXM_H_
+#define SIM_CORTEXM_CORTEXM_H_
+
+#include <sdk/types.h>
+
+#define CORTEXM_SVCALL_ENTER()
+
+typedef void (*cortexm_svcall_t)(void *);
+
+static inline void cortexm_svcall(cortexm_svcall_t call, void *args) { call(args); }
+
+// boot_device_sim
+u32 cortexm_get_hardware_id();
+void cortexm_reset(void *args);
+
+#endif /* SIM_CORTEXM_CORTEXM_H_ */
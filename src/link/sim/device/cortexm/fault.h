@@ -0,0 +1,15 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_CORTEXM_FAULT_H_
+#define SIM_CORTEXM_FAULT_H_
+
+typedef struct {
+  int num;
+  void *pc;
+  void *caller;
+  void *handler_pc;
+  void *handler_caller;
+  void *addr;
+} fault_t;
+
+#endif /* SIM_CORTEXM_FAULT_H_ */
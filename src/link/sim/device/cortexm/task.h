@@ -0,0 +1,17 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_CORTEXM_TASK_H_
+#define SIM_CORTEXM_TASK_H_
+
+#include <sdk/types.h>
+
+typedef struct {
+  void *code;
+  void *data;
+} task_memories_t;
+
+static inline int task_get_current() { return 1; }
+static inline int task_get_priority(int id) { return 0; }
+static inline int task_get_current_priority() { return 0; }
+
+#endif /* SIM_CORTEXM_TASK_H_ */
@@ -0,0 +1,293 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// The device end of the simulation: link_update() from the kernel's link thread
+// serving the far end of a pty with the link2 slave transport (or the link4 slave
+// with a window). The device file system is the directory it is started in.
+//
+//   link_device_sim <pty fd> <directory> [turnaround us] [bit flips per MB] [window]
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "cortexm/util.h"
+#include "mcu/crc.h"
+#include "sos/link.h"
+#include "sos/sos.h"
+
+#include "../../../sys/unistd/unistd_local.h"
+#include "../sim_stats.h"
+
+// the link thread uses its own names for these (see dirent.h)
+#undef opendir
+#undef readdir_r
+#undef closedir
+
+void *link_update(void *arg);
+
+static struct sim_procmem m_procmem;
+static struct _reent m_reent = {.procmem_base = &m_procmem};
+struct _reent *_global_impure_ptr = &m_reent;
+
+static int m_fd;
+static pid_t m_host_pid;
+static int m_delay_us;
+static bool m_is_turnaround;
+static int m_flips_per_mb;
+static unsigned int m_flip_seed = 1;
+static DIR *m_dir[SIM_OPEN_MAX];
+static sim_stats_t m_local_stats;
+static sim_stats_t *m_stats = &m_local_stats;
+
+static void get_serial_number(mcu_sn_t *serial_number) {
+  memset(serial_number, 0, sizeof(mcu_sn_t));
+  serial_number->sn[0] = getpid();
+}
+
+static void event_handler(int event, void *args) {
+  fprintf(stderr, "device: fatal event %d (%s)\n", event, (const char *)args);
+  exit(1);
+}
+
+const sos_config_t sos_config = {
+  .sys = {.get_serial_number = get_serial_number}, .event_handler = event_handler};
+
+static link_transport_phy_t phy_open(const char *name, const void *options) {
+  return m_fd;
+}
+
+static int phy_read(link_transport_phy_t handle, void *buf, int nbyte) {
+  // device reads block until the host sends something
+  struct pollfd pfd = {.fd = handle, .events = POLLIN};
+  if (poll(&pfd, 1, -1) < 0) {
+    return 0;
+  }
+  if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+    if (getppid() != m_host_pid) {
+      // the host is gone
+      exit(0);
+    }
+    // the host closed the pty and may open it again
+    usleep(1000);
+    return 0;
+  }
+  const int result = read(handle, buf, nbyte);
+  if (result > 0) {
+    m_is_turnaround = true;
+  }
+  // a noisy line
+  for (int i = 0; (i < result) && m_flips_per_mb; i++) {
+    if ((int)(rand_r(&m_flip_seed) % 1000000) < m_flips_per_mb) {
+      ((u8 *)buf)[i] ^= 1 << (rand_r(&m_flip_seed) % 8);
+    }
+  }
+  return result < 0 ? 0 : result;
+}
+
+static int phy_write(link_transport_phy_t handle, const void *buf, int nbyte) {
+  const u8 *p = buf;
+  int bytes = 0;
+  if (m_delay_us && m_is_turnaround) {
+    // a device that is slow to answer
+    usleep(m_delay_us);
+  }
+  m_is_turnaround = false;
+  while (bytes < nbyte) {
+    const int result = write(handle, p + bytes, nbyte - bytes);
+    if (result < 0) {
+      return -1;
+    }
+    bytes += result;
+  }
+  return nbyte;
+}
+
+static void phy_flush(link_transport_phy_t handle) {
+  u8 buffer[256];
+  struct pollfd pfd = {.fd = handle, .events = POLLIN};
+  while ((poll(&pfd, 1, 1) > 0) && (pfd.revents & POLLIN)) {
+    if (read(handle, buffer, sizeof(buffer)) <= 0) {
+      break;
+    }
+  }
+}
+
+static void phy_wait(int msec) { usleep(msec * 1000); }
+
+u16 mcu_calc_crc16(u16 seed, u16 polynomial, const u8 *buffer, u32 nbyte) {
+  u16 crc = seed;
+  for (u32 i = 0; i < nbyte; i++) {
+    crc ^= buffer[i] << 8;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ polynomial : crc << 1;
+    }
+  }
+  return crc;
+}
+
+// the open flags come from the host in the newlib encoding
+int sim_open(const char *path, int flags, ...) {
+  int host_flags = flags & LINK_O_ACCMODE;
+  if (flags & LINK_O_APPEND) {
+    host_flags |= O_APPEND;
+  }
+  if (flags & LINK_O_CREAT) {
+    host_flags |= O_CREAT;
+  }
+  if (flags & LINK_O_TRUNC) {
+    host_flags |= O_TRUNC;
+  }
+  if (flags & LINK_O_EXCL) {
+    host_flags |= O_EXCL;
+  }
+  va_list args;
+  va_start(args, flags);
+  const int mode = va_arg(args, int);
+  va_end(args);
+  return openat(AT_FDCWD, path, host_flags, mode & 0777);
+}
+
+DIR *sim_opendir(const char *name) {
+  for (int i = 1; i < SIM_OPEN_MAX; i++) {
+    if (m_dir[i] == NULL) {
+      m_dir[i] = opendir(name);
+      return m_dir[i] ? (DIR *)(intptr_t)i : NULL;
+    }
+  }
+  errno = EMFILE;
+  return NULL;
+}
+
+int sim_readdir_r(DIR *dirp, struct dirent *entry, struct dirent **result) {
+  const intptr_t index = (intptr_t)dirp;
+  if ((index <= 0) || (index >= SIM_OPEN_MAX) || (m_dir[index] == NULL)) {
+    errno = EBADF;
+    return -1;
+  }
+  errno = 0;
+  struct dirent *next = readdir(m_dir[index]);
+  if (next == NULL) {
+    // newlib's readdir_r() reports the end of the directory as an error
+    errno = errno ? errno : ENOENT;
+    return -1;
+  }
+  __builtin_memcpy(entry, next, sizeof(struct dirent));
+  if (result) {
+    *result = entry;
+  }
+  return 0;
+}
+
+int sim_closedir(DIR *dirp) {
+  const intptr_t index = (intptr_t)dirp;
+  if ((index <= 0) || (index >= SIM_OPEN_MAX) || (m_dir[index] == NULL)) {
+    errno = EBADF;
+    return -1;
+  }
+  const int result = closedir(m_dir[index]);
+  m_dir[index] = NULL;
+  return result;
+}
+
+int u_fildes_is_bad(int fildes) {
+  const int flags = fcntl(fildes, F_GETFL);
+  if ((flags < 0) || (fildes >= SIM_OPEN_MAX)) {
+    errno = EBADF;
+    return -1;
+  }
+  m_procmem.open_file[fildes].flags = flags & O_ACCMODE;
+  return fildes;
+}
+
+int sysfs_file_read(sysfs_file_t *file, void *buf, int nbyte) {
+  const int fildes = file - m_procmem.open_file;
+  const int result = read(fildes, buf, nbyte);
+  m_stats->file_bytes += result > 0 ? result : 0;
+  return result;
+}
+
+int sysfs_file_write(sysfs_file_t *file, const void *buf, int nbyte) {
+  const int fildes = file - m_procmem.open_file;
+  const int result = write(fildes, buf, nbyte);
+  m_stats->file_bytes += result > 0 ? result : 0;
+  return result;
+}
+
+void *sim_memcpy(void *dest, const void *src, size_t n) {
+  m_stats->copy_bytes += n;
+  return __builtin_memcpy(dest, src, n);
+}
+
+void scheduler_check_cancellation() {}
+
+static void map_stats() {
+  const char *path = getenv(SIM_STATS_ENV);
+  if (path == NULL) {
+    return;
+  }
+  const int fd = openat(AT_FDCWD, path, O_RDWR);
+  void *stats = fd < 0 ? MAP_FAILED
+                       : mmap(NULL, sizeof(sim_stats_t), PROT_READ | PROT_WRITE,
+                              MAP_SHARED, fd, 0);
+  if (stats != MAP_FAILED) {
+    m_stats = stats;
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+}
+
+int process_start(const char *path, char *const envp[]) {
+  errno = ENOEXEC;
+  return -1;
+}
+
+int mkfs(const char *path) {
+  errno = ENOTSUP;
+  return -1;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    fprintf(
+      stderr,
+      "usage: link_device_sim <pty fd> <directory> [turnaround us] [bit flips per MB] "
+      "[window]\n");
+    return 1;
+  }
+
+  m_fd = atoi(argv[1]);
+  m_host_pid = getppid();
+  if (chdir(argv[2]) < 0) {
+    perror(argv[2]);
+    return 1;
+  }
+  m_delay_us = argc > 3 ? atoi(argv[3]) : 0;
+  m_flips_per_mb = argc > 4 ? atoi(argv[4]) : 0;
+  const int window = argc > 5 ? atoi(argv[5]) : 0;
+  map_stats();
+
+  link_transport_driver_t driver = {
+    .open = phy_open,
+    .read = phy_read,
+    .write = phy_write,
+    .flush = phy_flush,
+    .wait = phy_wait,
+    .transport_read = link2_transport_slaveread,
+    .transport_write = link2_transport_slavewrite,
+    .timeout = 500,
+    .o_flags = LINK2_FLAG_IS_CHECKSUM};
+  if (window > 0) {
+    driver.transport_read = link4_transport_slaveread;
+    driver.transport_write = link4_transport_slavewrite;
+    driver.window = window;
+  }
+  link_update(&driver);
+  return 0;
+}
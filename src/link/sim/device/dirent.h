@@ -0,0 +1,19 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// the kernel hands directories to the host as an int -- host DIR pointers don't fit so
+// they are kept in a table and the index is handed out instead
+
+#ifndef SIM_DIRENT_H_
+#define SIM_DIRENT_H_
+
+#include_next <dirent.h>
+
+DIR *sim_opendir(const char *name);
+int sim_readdir_r(DIR *dirp, struct dirent *entry, struct dirent **result);
+int sim_closedir(DIR *dirp);
+
+#define opendir sim_opendir
+#define readdir_r sim_readdir_r
+#define closedir sim_closedir
+
+#endif /* SIM_DIRENT_H_ */
@@ -0,0 +1,41 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// included before anything else (-include) in the device sources -- the newlib
+// descriptor table that the kernel reads through _global_impure_ptr
+
+#ifndef SIM_DEVICE_H_
+#define SIM_DEVICE_H_
+
+#include <sys/ioctl.h>
+
+#include <sdk/types.h>
+
+#define SIM_OPEN_MAX 64
+
+// newlib's limits.h has ARG_MAX
+#define ARG_MAX 1024
+
+typedef struct {
+  const void *fs;
+  void *handle;
+  int flags;
+  int loc;
+} open_file_t;
+
+struct sim_procmem {
+  open_file_t open_file[SIM_OPEN_MAX];
+};
+
+struct _reent {
+  struct sim_procmem *procmem_base;
+};
+
+extern struct _reent *_global_impure_ptr;
+
+// the open flags arrive in the newlib encoding -- sim_open() converts them
+#define open sim_open
+
+// copies are counted (see sim_stats.h)
+#define memcpy sim_memcpy
+
+#endif /* SIM_DEVICE_H_ */
@@ -0,0 +1,9 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_SOS_CONFIG_H_
+#define SIM_SOS_CONFIG_H_
+
+#define CONFIG_TASK_TOTAL 8
+#define CONFIG_TASK_PROCESS_TIMER_COUNT 0
+
+#endif /* SIM_SOS_CONFIG_H_ */
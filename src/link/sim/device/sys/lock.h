@@ -0,0 +1,9 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_SYS_LOCK_H_
+#define SIM_SYS_LOCK_H_
+
+typedef int _LOCK_T;
+typedef int _LOCK_RECURSIVE_T;
+
+#endif /* SIM_SYS_LOCK_H_ */
@@ -0,0 +1,10 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_TRACE_H_
+#define SIM_TRACE_H_
+
+#include <sdk/types.h>
+
+typedef u32 trace_id_t;
+
+#endif /* SIM_TRACE_H_ */
@@ -0,0 +1,134 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+#define CHUNK_SIZE (16 * 1024)
+#define CHUNK_COUNT 100
+#define FLIPS_PER_MB 100
+#define RETRY_MAX 50
+
+typedef struct {
+  int retries;
+  int corrupted;
+  double elapsed_us;
+} fault_result_t;
+
+static u16 ref_crc16(u16 crc, const u8 *buffer, int nbyte) {
+  for (int i = 0; i < nbyte; i++) {
+    crc ^= buffer[i] << 8;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ LINK_TRANSPORT_CRC16_POLYNOMIAL : crc << 1;
+    }
+  }
+  return crc;
+}
+
+static void fill_chunk(u8 *buffer, int chunk) {
+  for (int i = 0; i < CHUNK_SIZE; i++) {
+    buffer[i] = (i * 31 + chunk * 7) ^ (i >> 8);
+  }
+}
+
+// the host table crc against a bitwise crc
+static void test_crc() {
+  u8 buffer[300];
+  srand(1);
+  for (int i = 0; i < 1000; i++) {
+    const int nbyte = rand() % sizeof(buffer);
+    const u16 seed = rand();
+    for (int j = 0; j < nbyte; j++) {
+      buffer[j] = rand();
+    }
+    CHECK(link_transport_crc16(seed, buffer, nbyte) == ref_crc16(seed, buffer, nbyte));
+  }
+  CHECK(link_transport_crc16(LINK_TRANSPORT_CRC16_SEED, "123456789", 9) == 0x29b1);
+}
+
+// writes every chunk (again after a failure) to a device that receives bit flips
+static int write_chunks(sim_device_t *device, fault_result_t *result) {
+  u8 buffer[CHUNK_SIZE];
+  int fd = -1;
+  for (int i = 0; (i < RETRY_MAX) && (fd < 0); i++) {
+    fd = link_open(&device->driver, "fault", O_RDWR | O_CREAT | O_TRUNC, 0666);
+  }
+  if (fd < 0) {
+    return -1;
+  }
+
+  const double start = sim_now_us();
+  for (int chunk = 0; chunk < CHUNK_COUNT; chunk++) {
+    fill_chunk(buffer, chunk);
+    int tries = 0;
+    while (
+      (link_lseek(&device->driver, fd, chunk * CHUNK_SIZE, SEEK_SET) != chunk * CHUNK_SIZE)
+      || (link_write(&device->driver, fd, buffer, CHUNK_SIZE) != CHUNK_SIZE)) {
+      if (++tries == RETRY_MAX) {
+        return -1;
+      }
+      // let the device give up on the transfer
+      usleep(2000);
+      device->driver.phy_driver.flush(device->driver.phy_driver.handle);
+    }
+    result->retries += tries;
+  }
+  result->elapsed_us = sim_now_us() - start;
+  return 0;
+}
+
+static void check_chunks(const sim_device_t *device, fault_result_t *result) {
+  char path[64];
+  u8 expected[CHUNK_SIZE];
+  u8 buffer[CHUNK_SIZE];
+  sprintf(path, "%s/fault", device->root);
+  FILE *f = fopen(path, "r");
+  for (int chunk = 0; chunk < CHUNK_COUNT; chunk++) {
+    fill_chunk(expected, chunk);
+    if (
+      (f == NULL) || (fread(buffer, 1, CHUNK_SIZE, f) != CHUNK_SIZE)
+      || memcmp(buffer, expected, CHUNK_SIZE)) {
+      result->corrupted++;
+    }
+  }
+  if (f) {
+    fclose(f);
+  }
+}
+
+static int run(u8 o_flags, fault_result_t *result) {
+  sim_device_t device;
+  memset(result, 0, sizeof(fault_result_t));
+  int err = sim_device_start(&device, 0, FLIPS_PER_MB);
+  if (err == 0) {
+    device.driver.phy_driver.o_flags = o_flags;
+    err = write_chunks(&device, result);
+    check_chunks(&device, result);
+  }
+  sim_device_stop(&device);
+  return err;
+}
+
+// the same writes over a noisy line checked by the xor sum and by the crc
+void test_fault() {
+  test_crc();
+
+  fault_result_t xor_result;
+  fault_result_t crc_result;
+  CHECK(run(LINK2_FLAG_IS_CHECKSUM, &xor_result) == 0);
+  CHECK(run(LINK2_FLAG_IS_CRC, &crc_result) == 0);
+
+  printf(
+    "fault: %d x %d KiB writes, %d flips/MB: xor %d retries, %d chunks corrupted, "
+    "%.2f s; crc %d retries, %d chunks corrupted, %.2f s\n",
+    CHUNK_COUNT, CHUNK_SIZE / 1024, FLIPS_PER_MB, xor_result.retries,
+    xor_result.corrupted, xor_result.elapsed_us / 1e6, crc_result.retries,
+    crc_result.corrupted, crc_result.elapsed_us / 1e6);
+
+  // a bad packet is sent again on its own instead of failing the whole write
+  CHECK(crc_result.corrupted == 0);
+  CHECK(crc_result.retries < xor_result.retries);
+}
@@ -0,0 +1,87 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// host build stand-in for the SDK crypto APIs used by link3 (the simulation doesn't
+// start secure sessions)
+
+#ifndef SIM_SDK_API_H_
+#define SIM_SDK_API_H_
+
+#include "sdk/types.h"
+
+enum { CRYPT_ECC_KEY_PAIR_SECP256R1 = 3 };
+
+typedef struct {
+  int (*init)(void **context);
+  void (*deinit)(void **context);
+  int (*random)(void *context, unsigned char *output, u32 output_length);
+} crypt_random_api_t;
+
+typedef struct {
+  int (*init)(void **context);
+  void (*deinit)(void **context);
+  int (*dh_create_key_pair)(
+    void *context,
+    int type,
+    u8 *public_key,
+    u32 *public_key_capacity);
+  int (*dh_calculate_shared_secret)(
+    void *context,
+    const u8 *public_key,
+    u32 public_key_length,
+    u8 *secret,
+    u32 secret_length);
+  int (*dsa_set_key_pair)(
+    void *context,
+    const u8 *public_key,
+    u32 public_key_capacity,
+    const u8 *private_key,
+    u32 private_key_capacity);
+  int (*dsa_sign)(
+    void *context,
+    const u8 *message_hash,
+    u32 hash_size,
+    u8 *signature,
+    u32 *signature_length);
+  int (*dsa_verify)(
+    void *context,
+    const u8 *message_hash,
+    u32 hash_size,
+    const u8 *signature,
+    u32 signature_length);
+} crypt_ecc_api_t;
+
+typedef struct {
+  int (*init)(void **context);
+  void (*deinit)(void **context);
+  int (*set_key)(void *context, const unsigned char *key, u32 keybits, u32 bits_per_word);
+  int (*encrypt_cbc)(
+    void *context,
+    u32 length,
+    unsigned char iv[16],
+    const unsigned char *input,
+    unsigned char *output);
+  int (*decrypt_cbc)(
+    void *context,
+    u32 length,
+    unsigned char iv[16],
+    const unsigned char *input,
+    unsigned char *output);
+  int (*encrypt_ctr)(
+    void *context,
+    u32 length,
+    u32 *nc_off,
+    unsigned char nonce_counter[16],
+    unsigned char stream_block[16],
+    const unsigned char *input,
+    unsigned char *output);
+  int (*decrypt_ctr)(
+    void *context,
+    u32 length,
+    u32 *nc_off,
+    unsigned char nonce_counter[16],
+    unsigned char stream_block[16],
+    const unsigned char *input,
+    unsigned char *output);
+} crypt_aes_api_t;
+
+#endif /* SIM_SDK_API_H_ */
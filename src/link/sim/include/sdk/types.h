@@ -0,0 +1,74 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// host build stand-in for the SDK types used by the link sources
+
+#ifndef SIM_SDK_TYPES_H_
+#define SIM_SDK_TYPES_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sos/ioctl.h"
+
+typedef uint8_t u8;
+typedef int8_t s8;
+typedef uint16_t u16;
+typedef int16_t s16;
+typedef uint32_t u32;
+typedef int32_t s32;
+typedef uint64_t u64;
+typedef int64_t s64;
+
+#define MCU_PACK __attribute__((packed))
+#define MCU_SYS_MEM
+#define MCU_ROOT_CODE
+#define MCU_ROOT_EXEC_CODE
+#define MCU_WEAK __attribute__((weak))
+#define MCU_NAKED
+#define MCU_ALWAYS_INLINE __attribute__((always_inline))
+#define MCU_UNUSED_ARGUMENT(x) (void)(x)
+
+struct mcu_timeval {
+  u32 tv_sec;
+  u32 tv_usec;
+};
+
+typedef struct MCU_PACK {
+  u8 port;
+  u8 pin;
+} mcu_pin_t;
+
+typedef struct {
+  u32 o_events;
+  void *data;
+} mcu_event_t;
+
+typedef struct {
+  int (*callback)(void *context, const mcu_event_t *data);
+  void *context;
+} mcu_event_handler_t;
+
+enum {
+  I_MCU_GETINFO,
+  I_MCU_SETATTR,
+  I_MCU_SETACTION,
+  I_MCU_TOTAL
+};
+
+typedef struct {
+  u32 sn[4];
+} mcu_sn_t;
+
+typedef struct MCU_PACK {
+  u32 loc;
+  u32 value;
+} mcu_channel_t;
+
+typedef struct MCU_PACK {
+  u8 channel;
+  s8 prio;
+  u32 o_events;
+  mcu_event_handler_t handler;
+} mcu_action_t;
+
+#endif /* SIM_SDK_TYPES_H_ */
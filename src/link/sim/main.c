@@ -0,0 +1,27 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include "sim.h"
+
+int main() {
+  test_phy();
+  test_compound();
+  test_stream_files();
+  test_fault();
+  test_delta();
+  test_pool();
+  test_copy();
+  test_bootloader();
+  test_window();
+  if (sim_failures) {
+    printf("FAILED (%d)\n", sim_failures);
+    return 1;
+  }
+  bench_phy();
+  bench_compound();
+  bench_stream();
+  bench_pool();
+  bench_bootloader();
+  bench_window();
+  printf("PASSED\n");
+  return 0;
+}
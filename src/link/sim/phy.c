@@ -0,0 +1,133 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <poll.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+// the device end of the pty sends back everything it receives
+static void *echo(void *args) {
+  const int fd = *(int *)args;
+  struct pollfd pfd = {.fd = fd, .events = POLLIN};
+  unsigned char buffer[4096];
+  while (poll(&pfd, 1, -1) > 0) {
+    const int result = read(fd, buffer, sizeof(buffer));
+    if (result <= 0) {
+      break;
+    }
+    if (write(fd, buffer, result) != result) {
+      break;
+    }
+  }
+  return NULL;
+}
+
+// one byte read for the packet start then the rest -- the way the transports read
+static int round_trip(link_transport_phy_t phy, const u8 *tx, u8 *rx, int size) {
+  if (link_phy_write(phy, tx, size) != size) {
+    return -1;
+  }
+  int bytes = 0;
+  int empty = 0;
+  while (bytes < size) {
+    const int result = link_phy_read(phy, rx + bytes, bytes == 0 ? 1 : size - bytes);
+    if (result < 0) {
+      return result;
+    }
+    if ((result == 0) && (++empty > 1000)) {
+      return -1;
+    }
+    bytes += result;
+  }
+  return memcmp(tx, rx, size) ? -1 : bytes;
+}
+
+static void test_read() {
+  const int fd = sim_pty_open();
+  CHECK(fd >= 0);
+  link_transport_phy_t phy = link_phy_open(sim_pty_name(fd), NULL);
+  CHECK(phy != LINK_PHY_OPEN_ERROR);
+
+  // nothing to read -- the read returns after the poll period
+  u8 buffer[64];
+  double start = sim_now_us();
+  CHECK(link_phy_read(phy, buffer, sizeof(buffer)) == 0);
+  CHECK(sim_now_us() - start < 100000);
+
+  // buffered bytes are handed out in order across reads
+  CHECK(write(fd, "abcdef", 6) == 6);
+  int bytes = 0;
+  for (int i = 0; (i < 1000) && (bytes == 0); i++) {
+    bytes = link_phy_read(phy, buffer, 1);
+  }
+  CHECK(bytes == 1);
+  CHECK(buffer[0] == 'a');
+  CHECK(link_phy_read(phy, buffer + 1, 2) == 2);
+  CHECK(link_phy_read(phy, buffer + 3, sizeof(buffer) - 3) == 3);
+  CHECK(memcmp(buffer, "abcdef", 6) == 0);
+
+  // a flush drops what is buffered and what is still on the line
+  CHECK(write(fd, "0123456789", 10) == 10);
+  usleep(2000);
+  CHECK(link_phy_read(phy, buffer, 1) == 1);
+  link_phy_flush(phy);
+  CHECK(link_phy_read(phy, buffer, sizeof(buffer)) == 0);
+
+  // the device goes away
+  close(fd);
+  CHECK(link_phy_read(phy, buffer, sizeof(buffer)) == LINK_PHY_ERROR);
+  CHECK(link_phy_close(&phy) == 0);
+}
+
+static void test_echo() {
+  int fd = sim_pty_open();
+  CHECK(fd >= 0);
+  link_transport_phy_t phy = link_phy_open(sim_pty_name(fd), NULL);
+  CHECK(phy != LINK_PHY_OPEN_ERROR);
+  pthread_t thread;
+  CHECK(pthread_create(&thread, NULL, echo, &fd) == 0);
+
+  u8 tx[1024];
+  u8 rx[1024];
+  for (int i = 0; i < (int)sizeof(tx); i++) {
+    tx[i] = i * 7;
+  }
+  for (int size = 1; size <= (int)sizeof(tx); size = size * 2 + 1) {
+    CHECK(round_trip(phy, tx, rx, size) == size);
+  }
+
+  link_phy_close(&phy);
+  close(fd);
+  pthread_join(thread, NULL);
+}
+
+void test_phy() {
+  test_read();
+  test_echo();
+}
+
+// small request/response round trips over the pty
+void bench_phy() {
+  int fd = sim_pty_open();
+  link_transport_phy_t phy = link_phy_open(sim_pty_name(fd), NULL);
+  pthread_t thread;
+  pthread_create(&thread, NULL, echo, &fd);
+
+  static const int sizes[] = {8, 64, 512};
+  u8 tx[512] = {0};
+  u8 rx[512];
+  const int loops = 1000;
+  for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    const double start = sim_now_us();
+    for (int i = 0; i < loops; i++) {
+      round_trip(phy, tx, rx, sizes[s]);
+    }
+    printf("bench: phy: %3d byte round trip %.1f us\n", sizes[s], (sim_now_us() - start) / loops);
+  }
+
+  link_phy_close(&phy);
+  close(fd);
+  pthread_join(thread, NULL);
+}
@@ -0,0 +1,244 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+#define DEVICE_COUNT 8
+#define CONNECT_COUNT 20
+
+// devices are plugged into ports sim0, sim1, ... -- m_port says which one is where
+static sim_device_t m_device[DEVICE_COUNT];
+static char m_serialno[DEVICE_COUNT][LINK_MAX_SN_SIZE];
+static int m_port[DEVICE_COUNT];
+static int m_write_count;
+static link_transport_phy_t (*m_phy_open)(const char *, const void *);
+static int (*m_phy_write)(link_transport_phy_t, const void *, int);
+
+static int getname(char *dest, const char *last, int len) {
+  int port = 0;
+  if (last[0] && (sscanf(last, "sim%d", &port) == 1)) {
+    port++;
+  }
+  if (port == DEVICE_COUNT) {
+    return -1;
+  }
+  snprintf(dest, len, "sim%d", port);
+  return 0;
+}
+
+static link_transport_phy_t open_port(const char *name, const void *options) {
+  int port;
+  if ((sscanf(name, "sim%d", &port) != 1) || (port < 0) || (port >= DEVICE_COUNT)) {
+    return LINK_PHY_OPEN_ERROR;
+  }
+  return m_phy_open(m_device[m_port[port]].name, options);
+}
+
+static int count_write(link_transport_phy_t handle, const void *buf, int nbyte) {
+  m_write_count++;
+  return m_phy_write(handle, buf, nbyte);
+}
+
+static void load_driver(link_transport_mdriver_t *driver) {
+  link_load_default_driver(driver);
+  driver->getname = getname;
+  driver->phy_driver.o_flags = LINK2_FLAG_IS_CHECKSUM;
+  m_phy_open = driver->phy_driver.open;
+  driver->phy_driver.open = open_port;
+  m_phy_write = driver->phy_driver.write;
+  driver->phy_driver.write = count_write;
+}
+
+static int start_devices(int turnaround_us) {
+  link_transport_mdriver_t driver;
+  for (int i = 0; i < DEVICE_COUNT; i++) {
+    if (sim_device_spawn(m_device + i, turnaround_us, 0) < 0) {
+      return -1;
+    }
+    m_port[i] = i;
+  }
+
+  // each device's serial number is its process id
+  load_driver(&driver);
+  for (int i = 0; i < DEVICE_COUNT; i++) {
+    char name[16];
+    sprintf(name, "sim%d", i);
+    driver.phy_driver.handle = driver.phy_driver.open(name, driver.options);
+    if (
+      (driver.phy_driver.handle == LINK_PHY_OPEN_ERROR)
+      || (link_readserialno(&driver, m_serialno[i], LINK_MAX_SN_SIZE) < 0)) {
+      return -1;
+    }
+    link_disconnect(&driver);
+  }
+  return 0;
+}
+
+static void stop_devices() {
+  for (int i = 0; i < DEVICE_COUNT; i++) {
+    sim_device_stop(m_device + i);
+  }
+}
+
+// the device at the other end answers with the serial number that was asked for
+static int is_connected(link_transport_mdriver_t *driver, int device) {
+  char serialno[LINK_MAX_SN_SIZE];
+  return (link_readserialno(driver, serialno, LINK_MAX_SN_SIZE) == 0)
+         && (strcmp(serialno, m_serialno[device]) == 0);
+}
+
+static void test_connect(link_pool_t *pool, link_transport_mdriver_t *driver) {
+  const int target = DEVICE_COUNT - 1;
+
+  // link_connect() asks every device on the way
+  m_write_count = 0;
+  CHECK(link_connect(driver, m_serialno[target]) == 0);
+  const int connect_writes = m_write_count;
+  CHECK(is_connected(driver, target));
+  link_disconnect(driver);
+
+  // the first connect scans and caches every device it reads
+  m_write_count = 0;
+  CHECK(link_pool_connect(pool, driver, m_serialno[target]) == 0);
+  const int scan_writes = m_write_count;
+  CHECK(pool->stats.scan_count == 1);
+  CHECK(is_connected(driver, target));
+  CHECK(link_pool_disconnect(pool, driver) == 0);
+  CHECK(driver->phy_driver.handle == LINK_PHY_OPEN_ERROR);
+
+  // an idle session is handed back without any traffic
+  for (int i = 0; i < CONNECT_COUNT; i++) {
+    m_write_count = 0;
+    CHECK(link_pool_connect(pool, driver, m_serialno[target]) == 0);
+    CHECK(m_write_count == 0);
+    CHECK(is_connected(driver, target));
+    CHECK(link_pool_disconnect(pool, driver) == 0);
+  }
+  CHECK(pool->stats.session_count == CONNECT_COUNT);
+
+  // other devices come from the cache the scan filled
+  m_write_count = 0;
+  CHECK(link_pool_connect(pool, driver, m_serialno[0]) == 0);
+  const int cache_writes = m_write_count;
+  CHECK(pool->stats.cache_count == 1);
+  CHECK(pool->stats.scan_count == 1);
+  CHECK(is_connected(driver, 0));
+  CHECK(link_pool_disconnect(pool, driver) == 0);
+
+  printf(
+    "pool: %d devices: host writes to connect: link_connect() %d, scan %d, "
+    "cache %d, idle session 0\n",
+    DEVICE_COUNT, connect_writes, scan_writes, cache_writes);
+  CHECK(cache_writes < connect_writes);
+}
+
+// a device that moved is found by a scan -- not at the cached path
+static void test_moved(link_pool_t *pool, link_transport_mdriver_t *driver) {
+  const int target = DEVICE_COUNT - 1;
+  link_pool_exit(pool);
+  m_port[3] = target;
+  m_port[target] = 3;
+
+  char target_port[16];
+  sprintf(target_port, "sim%d", target);
+  const link_pool_stats_t stats = pool->stats;
+  CHECK(link_pool_connect(pool, driver, m_serialno[target]) == 0);
+  CHECK(strcmp(driver->dev_name, "sim3") == 0);
+  CHECK(is_connected(driver, target));
+  CHECK(pool->stats.scan_count == stats.scan_count + 1);
+  CHECK(link_pool_disconnect(pool, driver) == 0);
+
+  // the other device's entry went to the target -- it's found by a scan and
+  // then cached at its new path
+  for (int i = 0; i < 2; i++) {
+    link_pool_exit(pool);
+    CHECK(link_pool_connect(pool, driver, m_serialno[3]) == 0);
+    CHECK(strcmp(driver->dev_name, target_port) == 0);
+    CHECK(is_connected(driver, 3));
+    CHECK(link_pool_disconnect(pool, driver) == 0);
+  }
+  CHECK(pool->stats.scan_count == stats.scan_count + 2);
+  CHECK(pool->stats.cache_count == stats.cache_count + 1);
+
+  m_port[3] = 3;
+  m_port[target] = target;
+}
+
+static void test_invalidate(link_pool_t *pool, link_transport_mdriver_t *driver) {
+  link_pool_invalidate(pool, m_serialno[0]);
+  const link_pool_stats_t stats = pool->stats;
+  CHECK(link_pool_connect(pool, driver, m_serialno[0]) == 0);
+  CHECK(pool->stats.scan_count == stats.scan_count + 1);
+  CHECK(is_connected(driver, 0));
+  link_pool_disconnect(pool, driver);
+}
+
+void test_pool() {
+  static link_pool_t pool;
+  link_transport_mdriver_t driver;
+
+  if (start_devices(0) < 0) {
+    printf("pool: failed to start the devices\n");
+    sim_failures++;
+  } else {
+    load_driver(&driver);
+    link_pool_init(&pool);
+    test_connect(&pool, &driver);
+    test_moved(&pool, &driver);
+    test_invalidate(&pool, &driver);
+    link_pool_exit(&pool);
+  }
+  stop_devices();
+}
+
+// connects to the last of the devices when each takes 1 ms to turn around
+void bench_pool() {
+  static link_pool_t pool;
+  link_transport_mdriver_t driver;
+  const char *serialno = m_serialno[DEVICE_COUNT - 1];
+
+  if (start_devices(1000) < 0) {
+    stop_devices();
+    return;
+  }
+  load_driver(&driver);
+
+  double start = sim_now_us();
+  for (int i = 0; i < CONNECT_COUNT; i++) {
+    link_connect(&driver, serialno);
+    link_disconnect(&driver);
+  }
+  const double connect = (sim_now_us() - start) / CONNECT_COUNT;
+
+  link_pool_init(&pool);
+  link_pool_connect(&pool, &driver, serialno);
+  link_pool_disconnect(&pool, &driver);
+
+  start = sim_now_us();
+  for (int i = 0; i < CONNECT_COUNT; i++) {
+    link_pool_connect(&pool, &driver, serialno);
+    link_pool_disconnect(&pool, &driver);
+  }
+  const double session = (sim_now_us() - start) / CONNECT_COUNT;
+
+  // sessions expire right away so every connect goes to the cache
+  pool.idle_timeout = 0;
+  start = sim_now_us();
+  for (int i = 0; i < CONNECT_COUNT; i++) {
+    usleep(10);
+    link_pool_connect(&pool, &driver, serialno);
+    link_pool_disconnect(&pool, &driver);
+  }
+  const double cache = (sim_now_us() - start) / CONNECT_COUNT - 10;
+
+  printf(
+    "bench: pool: %d devices, 1 ms turnaround: link_connect() %.2f ms, cache %.2f ms, "
+    "idle session %.3f ms\n",
+    DEVICE_COUNT, connect / 1000, cache / 1000, session / 1000);
+
+  link_pool_exit(&pool);
+  stop_devices();
+}
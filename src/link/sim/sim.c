@@ -0,0 +1,148 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+int sim_failures;
+
+double sim_now_us() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+int sim_pty_open() {
+  const int fd = posix_openpt(O_RDWR | O_NOCTTY);
+  if (fd < 0) {
+    return -1;
+  }
+  grantpt(fd);
+  unlockpt(fd);
+
+  struct termios options;
+  tcgetattr(fd, &options);
+  cfmakeraw(&options);
+  tcsetattr(fd, TCSANOW, &options);
+  return fd;
+}
+
+const char *sim_pty_name(int fd) { return ptsname(fd); }
+
+static const char *m_device_name;
+
+static int getname(char *dest, const char *last, int len) {
+  if (strcmp(last, m_device_name) == 0) {
+    return -1;
+  }
+  strncpy(dest, m_device_name, len);
+  return 0;
+}
+
+// runs program on the far end of a new pty with the pty's descriptor as the first
+// argument
+static int spawn(sim_device_t *device, const char *program, char *const args[]) {
+  memset(device, 0, sizeof(sim_device_t));
+  strcpy(device->root, "/tmp/link_sim.XXXXXX");
+  if (mkdtemp(device->root) == NULL) {
+    return -1;
+  }
+
+  const int fd = sim_pty_open();
+  if (fd < 0) {
+    return -1;
+  }
+
+  device->pid = fork();
+  if (device->pid == 0) {
+    char fd_arg[16];
+    char *argv[8] = {(char *)program, fd_arg};
+    sprintf(fd_arg, "%d", fd);
+    for (int i = 0; (i < 5) && args[i]; i++) {
+      argv[i + 2] = args[i];
+    }
+    execv(program, argv);
+    perror(program);
+    _exit(1);
+  }
+
+  strncpy(device->name, sim_pty_name(fd), sizeof(device->name) - 1);
+  link_load_default_driver(&device->driver);
+  device->driver.phy_driver.o_flags = LINK2_FLAG_IS_CHECKSUM;
+  // the device has its own copy
+  close(fd);
+  return device->pid < 0 ? -1 : 0;
+}
+
+static int connect_device(sim_device_t *device) {
+  m_device_name = device->name;
+  device->driver.getname = getname;
+  return link_connect(&device->driver, NULL);
+}
+
+int sim_device_spawn(sim_device_t *device, int turnaround_us, int flips_per_mb) {
+  char turnaround_arg[16];
+  char flips_arg[16];
+  sprintf(turnaround_arg, "%d", turnaround_us);
+  sprintf(flips_arg, "%d", flips_per_mb);
+  char *const args[] = {device->root, turnaround_arg, flips_arg, NULL};
+  return spawn(device, "./link_device_sim", args);
+}
+
+int sim_link4_start(sim_device_t *device, int turnaround_us, int window) {
+  char turnaround_arg[16];
+  char window_arg[16];
+  sprintf(turnaround_arg, "%d", turnaround_us);
+  sprintf(window_arg, "%d", window);
+  char *const args[] = {device->root, turnaround_arg, "0", window_arg, NULL};
+  if (spawn(device, "./link_device_sim", args) < 0) {
+    return -1;
+  }
+  // the probe brings it down to the device's window
+  device->driver.phy_driver.window = LINK4_WINDOW_MAX;
+  return connect_device(device);
+}
+
+int sim_device_start(sim_device_t *device, int turnaround_us, int flips_per_mb) {
+  if (sim_device_spawn(device, turnaround_us, flips_per_mb) < 0) {
+    return -1;
+  }
+  return connect_device(device);
+}
+
+int sim_bootloader_start(
+  sim_device_t *device,
+  int flash_page_us,
+  int turnaround_us,
+  bool is_legacy) {
+  char page_arg[16];
+  char turnaround_arg[16];
+  sprintf(page_arg, "%d", flash_page_us);
+  sprintf(turnaround_arg, "%d", turnaround_us);
+  char *const args[] = {page_arg, turnaround_arg, is_legacy ? "legacy" : NULL, NULL};
+  if (spawn(device, "./boot_device_sim", args) < 0) {
+    return -1;
+  }
+  return connect_device(device);
+}
+
+void sim_device_stop(sim_device_t *device) {
+  link_disconnect(&device->driver);
+  if (device->pid > 0) {
+    kill(device->pid, SIGTERM);
+    waitpid(device->pid, NULL, 0);
+  }
+
+  char command[128];
+  sprintf(command, "rm -rf %s", device->root);
+  if (system(command) != 0) {
+    printf("failed to remove %s\n", device->root);
+  }
+}
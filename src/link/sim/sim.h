@@ -0,0 +1,73 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#include "link_local.h"
+
+extern int sim_failures;
+
+#define CHECK(x)                                                                         \
+  do {                                                                                   \
+    if (!(x)) {                                                                          \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #x);                       \
+      sim_failures++;                                                                    \
+      return;                                                                            \
+    }                                                                                    \
+  } while (0)
+
+double sim_now_us();
+
+// opens a raw pseudo terminal -- the link side opens sim_pty_name()
+int sim_pty_open();
+const char *sim_pty_name(int fd);
+
+// link_device_sim serving a temporary directory over a pty -- the host driver is
+// connected. The device waits turnaround_us before it answers and flips
+// flips_per_mb random bits in every MB it receives. Paths on the device are
+// relative to the directory. The serial number is the device's process id.
+typedef struct {
+  pid_t pid;
+  char root[32];
+  char name[64]; // the pty the host opens
+  link_transport_mdriver_t driver;
+} sim_device_t;
+
+// sim_device_spawn() starts the device without connecting the driver
+int sim_device_spawn(sim_device_t *device, int turnaround_us, int flips_per_mb);
+int sim_device_start(sim_device_t *device, int turnaround_us, int flips_per_mb);
+void sim_device_stop(sim_device_t *device);
+
+// link_device_sim with the link4 slave -- it holds window packets and the host
+// keeps as many in flight
+int sim_link4_start(sim_device_t *device, int turnaround_us, int window);
+
+// boot_device_sim on a pty (see sim_boot.h for its flash) -- the host driver is
+// connected. Each page takes flash_page_us to program. A legacy bootloader refuses
+// LINK_CMD_WRITE.
+int sim_bootloader_start(
+  sim_device_t *device,
+  int flash_page_us,
+  int turnaround_us,
+  bool is_legacy);
+
+void test_phy();
+void bench_phy();
+void test_compound();
+void bench_compound();
+void test_stream_files();
+void bench_stream();
+void test_fault();
+void test_delta();
+void test_pool();
+void bench_pool();
+void test_copy();
+void test_bootloader();
+void bench_bootloader();
+void test_window();
+void bench_window();
+
+#endif /* SIM_H_ */
@@ -0,0 +1,11 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_BOOT_H_
+#define SIM_BOOT_H_
+
+// the flash of boot_device_sim -- the bootloader is below the program start address
+#define SIM_BOOT_FLASH_SIZE (512 * 1024)
+#define SIM_BOOT_PROGRAM_START 0x8000
+#define SIM_BOOT_ERASE_SIZE 4096
+
+#endif /* SIM_BOOT_H_ */
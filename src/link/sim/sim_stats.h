@@ -0,0 +1,15 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_STATS_H_
+#define SIM_STATS_H_
+
+// link_device_sim counts into a file that link_sim maps when it's named by
+// SIM_STATS_ENV
+#define SIM_STATS_ENV "LINK_DEVICE_SIM_STATS"
+
+typedef struct {
+  unsigned int copy_bytes; // memcpy() in the link thread and the slave transport
+  unsigned int file_bytes; // read from or written to the file system
+} sim_stats_t;
+
+#endif /* SIM_STATS_H_ */
@@ -0,0 +1,162 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "sim.h"
+
+#define STREAM_SIZE (1024 * 1024)
+#define CALL_SIZE 1024
+
+typedef struct {
+  u8 *data;
+  int size;
+  int offset;
+} stream_buffer_t;
+
+static int fill(void *context, void *buf, int nbyte) {
+  stream_buffer_t *buffer = context;
+  if (nbyte > buffer->size - buffer->offset) {
+    nbyte = buffer->size - buffer->offset;
+  }
+  memcpy(buf, buffer->data + buffer->offset, nbyte);
+  buffer->offset += nbyte;
+  return nbyte;
+}
+
+static int drain(void *context, void *buf, int nbyte) {
+  stream_buffer_t *buffer = context;
+  if (nbyte > buffer->size - buffer->offset) {
+    return -1;
+  }
+  memcpy(buffer->data + buffer->offset, buf, nbyte);
+  buffer->offset += nbyte;
+  return nbyte;
+}
+
+static int get_file_size(const sim_device_t *device, const char *name) {
+  char path[64];
+  struct stat st;
+  sprintf(path, "%s/%s", device->root, name);
+  return stat(path, &st) < 0 ? -1 : (int)st.st_size;
+}
+
+static void test_stream(sim_device_t *device, const u8 *data, u8 *out) {
+  const int fd = link_open(&device->driver, "stream", O_RDWR | O_CREAT | O_TRUNC, 0666);
+  CHECK(fd >= 0);
+
+  stream_buffer_t source = {.data = (u8 *)data, .size = STREAM_SIZE};
+  CHECK(link_write_stream(&device->driver, fd, STREAM_SIZE, fill, &source) == STREAM_SIZE);
+  CHECK(get_file_size(device, "stream") == STREAM_SIZE);
+
+  // a read of INT_MAX stops at the end of the file
+  stream_buffer_t sink = {.data = out, .size = STREAM_SIZE};
+  CHECK(link_lseek(&device->driver, fd, 0, SEEK_SET) == 0);
+  CHECK(link_read_stream(&device->driver, fd, INT_MAX, drain, &sink) == STREAM_SIZE);
+  CHECK(sink.offset == STREAM_SIZE);
+  CHECK(memcmp(out, data, STREAM_SIZE) == 0);
+
+  // a read that ends inside a packet
+  sink.offset = 0;
+  CHECK(link_lseek(&device->driver, fd, 100, SEEK_SET) == 100);
+  CHECK(link_read_stream(&device->driver, fd, 70000, drain, &sink) == 70000);
+  CHECK(sink.offset == 70000);
+  CHECK(memcmp(out, data + 100, 70000) == 0);
+
+  // the host runs out of data early -- on a packet boundary and inside a packet
+  const int packet_size = link_transport_masterpacketsize(&device->driver);
+  CHECK(packet_size > 0);
+  const int short_sizes[] = {3 * packet_size, 3 * packet_size + 17, 0};
+  for (unsigned int i = 0; i < sizeof(short_sizes) / sizeof(short_sizes[0]); i++) {
+    CHECK(link_close(&device->driver, fd) == 0);
+    CHECK(link_open(&device->driver, "stream", O_RDWR | O_TRUNC) == fd);
+    stream_buffer_t partial = {.data = (u8 *)data, .size = short_sizes[i]};
+    CHECK(
+      link_write_stream(&device->driver, fd, STREAM_SIZE, fill, &partial)
+      == short_sizes[i]);
+    CHECK(get_file_size(device, "stream") == short_sizes[i]);
+  }
+
+  // the connection is still in sync
+  sink.offset = 0;
+  CHECK(link_lseek(&device->driver, fd, 0, SEEK_SET) == 0);
+  CHECK(link_read(&device->driver, fd, out, 100) == 0);
+  CHECK(link_close(&device->driver, fd) == 0);
+}
+
+void test_stream_files() {
+  sim_device_t device;
+  u8 *data = malloc(STREAM_SIZE);
+  u8 *out = malloc(STREAM_SIZE);
+  srand(1);
+  for (int i = 0; i < STREAM_SIZE; i++) {
+    data[i] = rand();
+  }
+
+  if (sim_device_start(&device, 0, 0) == 0) {
+    test_stream(&device, data, out);
+  } else {
+    printf("stream: failed to start the device\n");
+    sim_failures++;
+  }
+
+  sim_device_stop(&device);
+  free(data);
+  free(out);
+}
+
+// size bytes each way with link_read()/link_write() calls and with a stream
+static void bench_device(int turnaround_us, int size, const u8 *data, u8 *out) {
+  sim_device_t device;
+  if (sim_device_start(&device, turnaround_us, 0) < 0) {
+    sim_device_stop(&device);
+    return;
+  }
+  const int fd = link_open(&device.driver, "bench", O_RDWR | O_CREAT | O_TRUNC, 0666);
+
+  double start = sim_now_us();
+  for (int offset = 0; offset < size; offset += CALL_SIZE) {
+    link_write(&device.driver, fd, data + offset, CALL_SIZE);
+  }
+  const double write_calls = sim_now_us() - start;
+
+  link_lseek(&device.driver, fd, 0, SEEK_SET);
+  start = sim_now_us();
+  for (int offset = 0; offset < size; offset += CALL_SIZE) {
+    link_read(&device.driver, fd, out + offset, CALL_SIZE);
+  }
+  const double read_calls = sim_now_us() - start;
+
+  link_lseek(&device.driver, fd, 0, SEEK_SET);
+  stream_buffer_t source = {.data = (u8 *)data, .size = size};
+  start = sim_now_us();
+  link_write_stream(&device.driver, fd, size, fill, &source);
+  const double write_stream = sim_now_us() - start;
+
+  link_lseek(&device.driver, fd, 0, SEEK_SET);
+  stream_buffer_t sink = {.data = out, .size = size};
+  start = sim_now_us();
+  link_read_stream(&device.driver, fd, size, drain, &sink);
+  const double read_stream = sim_now_us() - start;
+
+  printf(
+    "bench: stream: %d KiB, %d us turnaround: write x%d %.2f MB/s, stream %.2f MB/s; "
+    "read x%d %.2f MB/s, stream %.2f MB/s\n",
+    size / 1024, turnaround_us, CALL_SIZE, size / write_calls, size / write_stream,
+    CALL_SIZE, size / read_calls, size / read_stream);
+
+  link_close(&device.driver, fd);
+  sim_device_stop(&device);
+}
+
+void bench_stream() {
+  u8 *data = calloc(STREAM_SIZE, 1);
+  u8 *out = malloc(STREAM_SIZE);
+  bench_device(0, STREAM_SIZE, data, out);
+  bench_device(1000, STREAM_SIZE / 16, data, out);
+  free(data);
+  free(out);
+}
@@ -0,0 +1,253 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+#define FILE_SIZE (256 * 1024)
+#define CHUNK_SIZE (16 * 1024)
+#define BENCH_SIZE (1024 * 1024)
+#define TIMEOUT 50
+#define RETRY_MAX 50
+
+// drops and reorders the host's link4 packets on their way to the device
+typedef struct {
+  int (*write)(link_transport_phy_t, const void *, int);
+  unsigned int seed;
+  int loss_percent;
+  int reorder_percent;
+  u8 next; // sequence after the last new packet
+  int packets;
+  int drops;
+  int holds; // packets sent after the one behind them
+  int resends;
+  int held_size;
+  link4_pkt_t held;
+} line_t;
+
+static line_t m_line;
+static u8 m_data[BENCH_SIZE];
+
+static int line_write(link_transport_phy_t handle, const void *buf, int nbyte) {
+  const link4_pkt_t *pkt = buf;
+  if (
+    (nbyte < LINK4_PACKET_HEADER_SIZE) || (pkt->start != LINK4_PACKET_START)
+    || (pkt->o_flags & LINK4_FLAG_IS_PROBE)) {
+    return m_line.write(handle, buf, nbyte);
+  }
+
+  m_line.packets++;
+  if ((u8)(pkt->sequence - m_line.next) < 128) {
+    m_line.next = pkt->sequence + 1;
+  } else {
+    m_line.resends++;
+  }
+
+  const int r = rand_r(&m_line.seed) % 100;
+  if (r < m_line.loss_percent) {
+    m_line.drops++;
+    return nbyte;
+  }
+  if ((r < m_line.loss_percent + m_line.reorder_percent) && (m_line.held_size == 0)) {
+    memcpy(&m_line.held, buf, nbyte);
+    m_line.held_size = nbyte;
+    m_line.holds++;
+    return nbyte;
+  }
+
+  const int result = m_line.write(handle, buf, nbyte);
+  if (m_line.held_size) {
+    m_line.write(handle, &m_line.held, m_line.held_size);
+    m_line.held_size = 0;
+  }
+  return result;
+}
+
+static void line_start(sim_device_t *device, int loss_percent, int reorder_percent) {
+  // a second start on the same device keeps the phy's write
+  if (device->driver.phy_driver.write != line_write) {
+    memset(&m_line, 0, sizeof(m_line));
+    m_line.write = device->driver.phy_driver.write;
+  }
+  m_line.drops = m_line.holds = m_line.resends = m_line.packets = 0;
+  m_line.seed = 1;
+  m_line.loss_percent = loss_percent;
+  m_line.reorder_percent = reorder_percent;
+  m_line.next = device->driver.phy_driver.sequence;
+  device->driver.phy_driver.write = line_write;
+}
+
+static int check_file(const sim_device_t *device, int size) {
+  char path[64];
+  u8 buffer[CHUNK_SIZE];
+  sprintf(path, "%s/window", device->root);
+  FILE *f = fopen(path, "r");
+  int result = f ? 0 : -1;
+  for (int offset = 0; (result == 0) && (offset < size); offset += CHUNK_SIZE) {
+    if (
+      (fread(buffer, 1, CHUNK_SIZE, f) != CHUNK_SIZE)
+      || memcmp(buffer, m_data + offset, CHUNK_SIZE)) {
+      result = -1;
+    }
+  }
+  if (f) {
+    fclose(f);
+  }
+  return result;
+}
+
+// link_write() again after a failure -- returns the number of failures
+static int write_chunk(sim_device_t *device, int fd, int offset) {
+  int tries = 0;
+  while (
+    (link_lseek(&device->driver, fd, offset, SEEK_SET) != offset)
+    || (link_write(&device->driver, fd, m_data + offset, CHUNK_SIZE) != CHUNK_SIZE)) {
+    if (++tries == RETRY_MAX) {
+      break;
+    }
+    // let the device give up on the transfer
+    usleep(2000);
+    device->driver.phy_driver.flush(device->driver.phy_driver.handle);
+  }
+  return tries;
+}
+
+// the host takes the device's window and falls back to link2 for link2 devices
+static void test_resolve() {
+  sim_device_t device;
+  CHECK(sim_link4_start(&device, 0, 3) == 0);
+  int fd = link_open(&device.driver, "window", O_RDWR | O_CREAT | O_TRUNC, 0666);
+  CHECK(fd >= 0);
+  CHECK(device.driver.transport_version == 4);
+  CHECK(device.driver.phy_driver.window == 3);
+  CHECK(link_write(&device.driver, fd, m_data, FILE_SIZE) == FILE_SIZE);
+  CHECK(link_close(&device.driver, fd) == 0);
+  CHECK(check_file(&device, FILE_SIZE) == 0);
+  sim_device_stop(&device);
+
+  CHECK(sim_device_start(&device, 0, 0) == 0);
+  fd = link_open(&device.driver, "window", O_RDWR | O_CREAT | O_TRUNC, 0666);
+  CHECK(fd >= 0);
+  CHECK(device.driver.transport_version == 2);
+  CHECK(link_write(&device.driver, fd, m_data, FILE_SIZE) == FILE_SIZE);
+  CHECK(link_close(&device.driver, fd) == 0);
+  CHECK(check_file(&device, FILE_SIZE) == 0);
+  sim_device_stop(&device);
+}
+
+// the device holds the packets behind a lost one so the host only sends the lost
+// ones again
+static void test_loss(sim_device_t *device) {
+  line_start(device, 20, 20);
+  const int fd = link_open(&device->driver, "window", O_RDWR | O_CREAT | O_TRUNC, 0666);
+  CHECK(fd >= 0);
+  device->driver.phy_driver.timeout = TIMEOUT;
+  // link_open() sets the default timeout
+  device->driver.phy_driver.timeout = TIMEOUT;
+  for (int offset = 0; offset < FILE_SIZE; offset += CHUNK_SIZE) {
+    CHECK(link_write(&device->driver, fd, m_data + offset, CHUNK_SIZE) == CHUNK_SIZE);
+  }
+  CHECK(link_close(&device->driver, fd) == 0);
+  CHECK(check_file(device, FILE_SIZE) == 0);
+  CHECK(device->driver.transport_version == 4);
+  printf(
+    "window: %d KiB, window %d, %d%% lost, %d%% reordered: %d packets, %d lost, %d "
+    "reordered, %d sent again\n",
+    FILE_SIZE / 1024, device->driver.phy_driver.window, m_line.loss_percent,
+    m_line.reorder_percent, m_line.packets, m_line.drops, m_line.holds, m_line.resends);
+  CHECK((m_line.drops > 0) && (m_line.holds > 0));
+  // a packet held at the end of the window isn't released until the resend
+  CHECK(m_line.resends <= m_line.drops + m_line.holds);
+}
+
+// the host's sequence number is wrong after a failed transfer or when it starts
+// again -- it probes the device for its sequence number
+static void test_resync(sim_device_t *device) {
+  line_start(device, 0, 0);
+  const int fd = link_open(&device->driver, "window", O_RDWR | O_CREAT | O_TRUNC, 0666);
+  CHECK(fd >= 0);
+  CHECK(write_chunk(device, fd, 0) == 0);
+
+  // a new host
+  device->driver.phy_driver.sequence += 100;
+  device->driver.transport_version = 0;
+  CHECK(write_chunk(device, fd, CHUNK_SIZE) == 0);
+  CHECK(device->driver.transport_version == 4);
+
+  // packets ahead of the device are held but never complete -- the write fails
+  // and the next one probes
+  device->driver.phy_driver.sequence += 2;
+  const int tries = write_chunk(device, fd, 2 * CHUNK_SIZE);
+  CHECK((tries > 0) && (tries < RETRY_MAX));
+  CHECK(device->driver.transport_version == 4);
+
+  // everything is lost for a while
+  m_line.loss_percent = 100;
+  CHECK(link_write(&device->driver, fd, m_data, CHUNK_SIZE) < 0);
+  CHECK(device->driver.transport_version == 0);
+  m_line.loss_percent = 0;
+  CHECK(write_chunk(device, fd, 3 * CHUNK_SIZE) < RETRY_MAX);
+  CHECK(device->driver.transport_version == 4);
+
+  CHECK(link_close(&device->driver, fd) == 0);
+  CHECK(check_file(device, 4 * CHUNK_SIZE) == 0);
+}
+
+void test_window() {
+  srand(3);
+  for (int i = 0; i < BENCH_SIZE; i++) {
+    m_data[i] = rand();
+  }
+
+  test_resolve();
+
+  const int windows[] = {1, 4, LINK4_WINDOW_MAX};
+  for (unsigned int i = 0; i < sizeof(windows) / sizeof(windows[0]); i++) {
+    sim_device_t device;
+    if (sim_link4_start(&device, 0, windows[i]) < 0) {
+      printf("window: failed to start the device\n");
+      sim_failures++;
+    } else {
+      test_loss(&device);
+      test_resync(&device);
+    }
+    sim_device_stop(&device);
+  }
+}
+
+// seconds to write BENCH_SIZE to a file (window 0 is link2)
+static double bench_write(int turnaround_us, int window) {
+  sim_device_t device;
+  double result = -1;
+  const int err = window ? sim_link4_start(&device, turnaround_us, window)
+                         : sim_device_start(&device, turnaround_us, 0);
+  const int fd =
+    err < 0 ? -1 : link_open(&device.driver, "window", O_RDWR | O_CREAT | O_TRUNC, 0666);
+  if (fd >= 0) {
+    const double start = sim_now_us();
+    if (link_write(&device.driver, fd, m_data, BENCH_SIZE) == BENCH_SIZE) {
+      result = (sim_now_us() - start) / 1e6;
+    }
+  }
+  sim_device_stop(&device);
+  return result;
+}
+
+// stop and wait (link2) against a window of packets in flight (link4)
+void bench_window() {
+  const int turnarounds[] = {0, 200, 1000};
+  for (unsigned int i = 0; i < sizeof(turnarounds) / sizeof(turnarounds[0]); i++) {
+    const double link2 = bench_write(turnarounds[i], 0);
+    const double window1 = bench_write(turnarounds[i], 1);
+    const double window4 = bench_write(turnarounds[i], 4);
+    const double window8 = bench_write(turnarounds[i], LINK4_WINDOW_MAX);
+    printf(
+      "bench: window: %d KiB, %d us turnaround: link2 %.2f s, link4 window 1 %.2f s, "
+      "4 %.2f s (x%.2f), 8 %.2f s (x%.2f)\n",
+      BENCH_SIZE / 1024, turnarounds[i], link2, window1, window4, link2 / window4,
+      window8, link2 / window8);
+  }
+}
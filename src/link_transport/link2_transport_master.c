@@ -53,7 +53,9 @@ int link2_transport_masterread(link_transport_mdriver_t *driver, void *buf, int
       return err;
     }
 
-    if (driver->phy_driver.o_flags & LINK2_FLAG_IS_CHECKSUM) {
+    if (
+      (driver->phy_driver.o_flags & LINK2_FLAG_IS_CHECKSUM)
+      || (pkt.o_flags & LINK2_FLAG_IS_CRC)) {
       // a packet has arrived -- checksum it
       if (link2_transport_checksum_isok(&pkt) == false) {
         return SYSFS_SET_RETURN(1);
@@ -104,24 +106,26 @@ int link2_transport_masterwrite(
 
     memcpy(pkt.data, p, pkt.size);
 
-    if (driver->phy_driver.o_flags & LINK2_FLAG_IS_CHECKSUM) {
+    if (driver->phy_driver.o_flags & (LINK2_FLAG_IS_CHECKSUM | LINK2_FLAG_IS_CRC)) {
       link2_transport_insert_checksum(&pkt);
     } else {
       // checksum is set to zero
       pkt_checksum(&pkt) = 0;
     }
 
-    // send packet
-    if (
-      driver->phy_driver.write(
-        driver->phy_driver.handle, &pkt, pkt.size + LINK2_PACKET_HEADER_SIZE)
-      != (pkt.size + LINK2_PACKET_HEADER_SIZE)) {
-      return SYSFS_SET_RETURN(1);
-    }
+    int retries = 0;
+    do {
+      // send packet
+      if (
+        driver->phy_driver.write(
+          driver->phy_driver.handle, &pkt, pkt.size + LINK2_PACKET_HEADER_SIZE)
+        != (pkt.size + LINK2_PACKET_HEADER_SIZE)) {
+        return SYSFS_SET_RETURN(1);
+      }
 
-    // received ack of the checksum
-    if ((err = wait_ack(driver, pkt_checksum(&pkt), driver->phy_driver.timeout)) < 0) {
-      driver->phy_driver.flush(driver->phy_driver.handle);
+      // received ack of the checksum
+      if ((err = wait_ack(driver, pkt_checksum(&pkt), driver->phy_driver.timeout)) < 0) {
+        driver->phy_driver.flush(driver->phy_driver.handle);
 #if 0
 			printf("\nerror %s():%d 0x%X-%d (%d)\n",
 					 __FUNCTION__,
@@ -130,8 +134,11 @@ int link2_transport_masterwrite(
 					 err,
 					 driver->phy_driver.timeout);
 #endif
-      return err;
-    }
+        return err;
+      }
+
+      // the slave only asks for a packet again when it failed the crc
+    } while ((err == LINK2_PACKET_RESEND) && (retries++ < LINK_TRANSPORT_RESEND_MAX));
 
     if (err != LINK2_PACKET_ACK) {
       return SYSFS_SET_RETURN(1);
@@ -178,7 +185,8 @@ int wait_ack(link_transport_mdriver_t *driver, u8 checksum, int timeout) {
     }
   } while (bytes_read < sizeof(ack));
 
-  if (ack.checksum != checksum) {
+  // a resend has the checksum of the corrupted packet
+  if ((ack.ack != LINK2_PACKET_RESEND) && (ack.checksum != checksum)) {
     return LINK_PROT_ERROR;
   }
 
@@ -10,6 +10,7 @@
 #define pkt_checksum(pktp) ((pktp)->data[(pktp)->size])
 
 static int send_ack(link_transport_driver_t *driver, u8 ack, u8 checksum);
+static int read_packet(link_transport_driver_t *driver, link2_pkt_t *pkt, u16 *checksum);
 
 int link2_transport_slaveread(
   link_transport_driver_t *driver,
@@ -27,36 +28,9 @@ int link2_transport_slaveread(
   p = buf;
   do {
 
-    if (link2_transport_wait_start(driver, &pkt, driver->timeout) < 0) {
-      driver->flush(driver->handle);
-      send_ack(driver, LINK2_PACKET_NACK, 0);
-      return -1 * __LINE__;
-    }
-
-    if (link2_transport_wait_packet(driver, &pkt, driver->timeout) < 0) {
-      driver->flush(driver->handle);
-      send_ack(driver, LINK2_PACKET_NACK, 0);
-      return -1 * __LINE__;
-    }
-
-    if (pkt.start != LINK2_PACKET_START) {
-      // if packet does not start with the start byte then it is not a packet
-      driver->flush(driver->handle);
-      send_ack(driver, LINK2_PACKET_NACK, 0);
-      return -1 * __LINE__;
-    }
-
-    // a packet has arrived -- checksum it
-    if (driver->o_flags & LINK2_FLAG_IS_CHECKSUM) {
-      checksum = pkt_checksum(&pkt);
-      if (link2_transport_checksum_isok(&pkt) == false) {
-        // bad checksum on packet -- treat as a non-packet
-        driver->flush(driver->handle);
-        send_ack(driver, LINK2_PACKET_NACK, checksum);
-        return -1 * __LINE__;
-      }
-    } else {
-      checksum = 0;
+    const int result = read_packet(driver, &pkt, &checksum);
+    if (result < 0) {
+      return result;
     }
 
     // callback to handle incoming data as it arrives
@@ -125,7 +99,7 @@ int link2_transport_slavewrite(
       memcpy(pkt.data, p, pkt.size);
     }
 
-    if (driver->o_flags & LINK2_FLAG_IS_CHECKSUM) {
+    if (driver->o_flags & (LINK2_FLAG_IS_CHECKSUM | LINK2_FLAG_IS_CRC)) {
       link2_transport_insert_checksum(&pkt);
     }
 
@@ -154,3 +128,49 @@ int send_ack(link_transport_driver_t *driver, u8 ack, u8 checksum) {
   ack_pkt.checksum = checksum;
   return driver->write(driver->handle, &ack_pkt, sizeof(ack_pkt));
 }
+
+int read_packet(link_transport_driver_t *driver, link2_pkt_t *pkt, u16 *checksum) {
+  int retries = 0;
+  do {
+    if (link2_transport_wait_start(driver, pkt, driver->timeout) < 0) {
+      driver->flush(driver->handle);
+      send_ack(driver, LINK2_PACKET_NACK, 0);
+      return -1 * __LINE__;
+    }
+
+    if (link2_transport_wait_packet(driver, pkt, driver->timeout) < 0) {
+      driver->flush(driver->handle);
+      send_ack(driver, LINK2_PACKET_NACK, 0);
+      return -1 * __LINE__;
+    }
+
+    if (pkt->start != LINK2_PACKET_START) {
+      // if packet does not start with the start byte then it is not a packet
+      driver->flush(driver->handle);
+      send_ack(driver, LINK2_PACKET_NACK, 0);
+      return -1 * __LINE__;
+    }
+
+    // a packet has arrived -- checksum it
+    if ((driver->o_flags & LINK2_FLAG_IS_CHECKSUM) || (pkt->o_flags & LINK2_FLAG_IS_CRC)) {
+      *checksum = pkt_checksum(pkt);
+      if (link2_transport_checksum_isok(pkt) == true) {
+        return 0;
+      }
+
+      driver->flush(driver->handle);
+      if ((pkt->o_flags & LINK2_FLAG_IS_CRC) && (retries++ < LINK_TRANSPORT_RESEND_MAX)) {
+        // the crc is reliable enough to ask for just this packet again
+        send_ack(driver, LINK2_PACKET_RESEND, *checksum);
+        continue;
+      }
+
+      // bad checksum on packet -- treat as a non-packet
+      send_ack(driver, LINK2_PACKET_NACK, *checksum);
+      return -1 * __LINE__;
+    }
+
+    *checksum = 0;
+    return 0;
+  } while (1);
+}
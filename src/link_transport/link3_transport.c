@@ -15,6 +15,15 @@ void link3_transport_insert_checksum(link3_pkt_t *pkt) {
   int i;
   u16 checksum;
 
+  if (pkt->o_flags & LINK3_FLAG_IS_CRC) {
+    const u8 size[2] = {pkt->size, pkt->size >> 8};
+    checksum = link_transport_crc16(LINK_TRANSPORT_CRC16_SEED, size, sizeof(size));
+    checksum = link_transport_crc16(checksum, pkt->data, pkt->size);
+    pkt->data[pkt->size] = checksum;
+    pkt->data[pkt->size + 1] = checksum >> 8;
+    return;
+  }
+
   // needs to be a more powerful checksum for link3 - optionally enabled
 
   checksum = 0;
@@ -28,13 +37,17 @@ void link3_transport_insert_checksum(link3_pkt_t *pkt) {
 bool link3_transport_checksum_isok(link3_pkt_t *pkt) {
   u16 checksum;
   if (pkt->size <= LINK3_PACKET_DATA_SIZE) {
-    checksum = pkt->data[pkt->size];
+    checksum = pkt->data[pkt->size] | (pkt->data[pkt->size + 1] << 8);
   } else {
     return false;
   }
 
   link3_transport_insert_checksum(pkt);
-  if (checksum == pkt_checksum(pkt)) {
+  if (pkt->o_flags & LINK3_FLAG_IS_CRC) {
+    return checksum == (pkt->data[pkt->size] | (pkt->data[pkt->size + 1] << 8));
+  }
+
+  if ((checksum & 0xff) == pkt_checksum(pkt)) {
     return true;
   }
 
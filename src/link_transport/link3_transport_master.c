@@ -43,6 +43,9 @@ static const crypt_random_api_t *random_api(link_transport_mdriver_t *driver) {
 
 int link3_start_secure_session(link_transport_mdriver_t *driver) {
 
+  // the handshake is not encrypted
+  driver->transport_version = 0;
+
   // deinit if needed
   ecc_api(driver)->deinit(&(driver->phy_driver.crypto_handle.ecc_context));
   aes_api(driver)->deinit(&(driver->phy_driver.crypto_handle.aes_context));
@@ -164,7 +167,9 @@ int link3_transport_masterread(link_transport_mdriver_t *driver, void *buf, int
       return err;
     }
 
-    if (driver->phy_driver.o_flags & LINK3_FLAG_IS_CHECKSUM) {
+    if (
+      (driver->phy_driver.o_flags & LINK3_FLAG_IS_CHECKSUM)
+      || (pkt.o_flags & LINK3_FLAG_IS_CRC)) {
       // a packet has arrived -- checksum it
       if (link3_transport_checksum_isok(&pkt) == false) {
         return SYSFS_SET_RETURN(1);
@@ -240,31 +245,36 @@ int link3_transport_masterwrite(
       memcpy(data->data, p, data->data_size);
     }
 
-    if (driver->phy_driver.o_flags & LINK3_FLAG_IS_CHECKSUM) {
+    if (driver->phy_driver.o_flags & (LINK3_FLAG_IS_CHECKSUM | LINK3_FLAG_IS_CRC)) {
       link3_transport_insert_checksum(&pkt);
     } else {
       // checksum is set to zero
       pkt_checksum(&pkt) = 0;
     }
 
-    // send packet
-    if (
-      driver->phy_driver.write(
-        driver->phy_driver.handle, &pkt, pkt.size + LINK3_PACKET_HEADER_SIZE)
-      != (pkt.size + LINK3_PACKET_HEADER_SIZE)) {
-      return SYSFS_SET_RETURN(1);
-    }
+    int retries = 0;
+    do {
+      // send packet
+      if (
+        driver->phy_driver.write(
+          driver->phy_driver.handle, &pkt, pkt.size + LINK3_PACKET_HEADER_SIZE)
+        != (pkt.size + LINK3_PACKET_HEADER_SIZE)) {
+        return SYSFS_SET_RETURN(1);
+      }
 
-    // received ack of the checksum
-    if ((err = wait_ack(driver, pkt_checksum(&pkt), driver->phy_driver.timeout)) < 0) {
-      driver->phy_driver.flush(driver->phy_driver.handle);
+      // received ack of the checksum
+      if ((err = wait_ack(driver, pkt_checksum(&pkt), driver->phy_driver.timeout)) < 0) {
+        driver->phy_driver.flush(driver->phy_driver.handle);
 #if 0
-      printf(
-        "\nerror %s():%d 0x%X-%d (%d)\n", __FUNCTION__, __LINE__, err, err,
-        driver->phy_driver.timeout);
+        printf(
+          "\nerror %s():%d 0x%X-%d (%d)\n", __FUNCTION__, __LINE__, err, err,
+          driver->phy_driver.timeout);
 #endif
-      return err;
-    }
+        return err;
+      }
+
+      // the slave only asks for a packet again when it failed the crc
+    } while ((err == LINK3_PACKET_RESEND) && (retries++ < LINK_TRANSPORT_RESEND_MAX));
 
     if (err != LINK3_PACKET_ACK) {
       return SYSFS_SET_RETURN(1);
@@ -307,7 +317,8 @@ int wait_ack(link_transport_mdriver_t *driver, u8 checksum, int timeout) {
     }
   } while (bytes_read < sizeof(ack));
 
-  if (ack.checksum != checksum) {
+  // a resend has the checksum of the corrupted packet
+  if ((ack.ack != LINK3_PACKET_RESEND) && (ack.checksum != checksum)) {
     return LINK_PROT_ERROR;
   }
 
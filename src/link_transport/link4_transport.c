@@ -0,0 +1,113 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include "sos/debug.h"
+#include "sos/link.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define pkt_checksum(pktp) ((pktp)->data[(pktp)->size])
+
+// the header after the start byte: flags, size, sequence and reserved
+#define HEADER_SIZE (offsetof(link4_pkt_t, data) - 1)
+
+void link4_transport_insert_checksum(link4_pkt_t *pkt) {
+  int i;
+  u16 checksum;
+
+  if (pkt->o_flags & LINK4_FLAG_IS_CRC) {
+    const u8 header[3] = {pkt->size, pkt->size >> 8, pkt->sequence};
+    checksum = link_transport_crc16(LINK_TRANSPORT_CRC16_SEED, header, sizeof(header));
+    checksum = link_transport_crc16(checksum, pkt->data, pkt->size);
+    pkt->data[pkt->size] = checksum;
+    pkt->data[pkt->size + 1] = checksum >> 8;
+    return;
+  }
+
+  checksum = 0;
+  checksum ^= pkt->size;
+  checksum ^= pkt->sequence;
+  for (i = 0; i < pkt->size; i++) {
+    checksum ^= pkt->data[i];
+  }
+  pkt->data[i] = checksum;
+  pkt->data[i + 1] = 0;
+}
+
+bool link4_transport_checksum_isok(link4_pkt_t *pkt) {
+  u16 checksum;
+  if (pkt->size <= LINK4_PACKET_DATA_SIZE) {
+    checksum = pkt->data[pkt->size] | (pkt->data[pkt->size + 1] << 8);
+  } else {
+    return false;
+  }
+
+  link4_transport_insert_checksum(pkt);
+  if (pkt->o_flags & LINK4_FLAG_IS_CRC) {
+    return checksum == (pkt->data[pkt->size] | (pkt->data[pkt->size + 1] << 8));
+  }
+
+  if ((checksum & 0xff) == pkt_checksum(pkt)) {
+    return true;
+  }
+
+  return false;
+}
+
+void link4_transport_insert_ack_checksum(link4_ack_t *ack) {
+  ack->checksum = ~(ack->ack ^ ack->sequence ^ ack->selective);
+}
+
+int link4_transport_wait_packet(
+  link_transport_driver_t *driver,
+  link4_pkt_t *pkt,
+  int timeout) {
+  char *p;
+  int bytes;
+  int count;
+  int page_size;
+
+  p = ((char *)pkt) + 1; // start received after start
+  count = 0;
+  bytes = 0;
+  pkt->size = 0;
+  u64 start_time, stop_time;
+  do {
+    int bytes_read;
+    start_time = link_transport_gettime();
+
+    if (bytes < (int)HEADER_SIZE) {
+      page_size = HEADER_SIZE - bytes;
+    } else {
+      page_size = (pkt->size - bytes) + LINK4_PACKET_HEADER_SIZE - 1;
+    }
+
+    bytes_read = driver->read(driver->handle, p, page_size);
+    if (bytes_read < 0) {
+      return LINK_PHY_ERROR;
+    }
+
+    if (bytes_read > 0) {
+      bytes += bytes_read;
+      p += bytes_read;
+      count = 0;
+
+      if ((bytes >= (int)HEADER_SIZE) && (pkt->size > LINK4_PACKET_DATA_SIZE)) {
+        // this is erroneous data
+        return LINK_PROT_ERROR;
+      }
+    } else {
+      stop_time = link_transport_gettime();
+      count += (stop_time - start_time) / 1000UL;
+      if (count >= timeout) {
+        return LINK_TIMEOUT_ERROR;
+      }
+    }
+
+  } while ((bytes < (int)HEADER_SIZE)
+           || (bytes < (pkt->size + LINK4_PACKET_HEADER_SIZE - 1)));
+
+  return 0;
+}
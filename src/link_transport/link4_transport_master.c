@@ -0,0 +1,256 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include "sos/fs/sysfs.h"
+#include "sos/link.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RETRY_MAX 4
+
+typedef struct {
+  link4_ack_t ack;
+  int bytes; // acks can arrive in pieces
+} ack_state_t;
+
+static int read_ack(link_transport_mdriver_t *driver, ack_state_t *state, int timeout);
+static int read_bytes(link_transport_mdriver_t *driver, void *dest, int nbyte, int timeout);
+static int write_packet(link_transport_mdriver_t *driver, link4_pkt_t *pkt);
+static int get_window(link_transport_mdriver_t *driver);
+static int get_probe_timeout(link_transport_mdriver_t *driver);
+
+int link4_transport_masterprobe(link_transport_mdriver_t *driver) {
+  link4_pkt_t pkt;
+  link4_ack_t ack;
+  const int ack_size = sizeof(link_ack_t);
+
+  memset(&pkt, 0, sizeof(pkt));
+  pkt.start = LINK4_PACKET_START;
+  pkt.o_flags = driver->phy_driver.o_flags | LINK4_FLAG_IS_PROBE;
+  link4_transport_insert_checksum(&pkt);
+  if (write_packet(driver, &pkt) < 0) {
+    return LINK_PHY_ERROR;
+  }
+
+  // slaves without link4 answer with a two byte link2 nack (or not at all)
+  const int timeout = get_probe_timeout(driver);
+  int result = read_bytes(driver, &ack, ack_size, timeout);
+  if ((result == ack_size) && (ack.ack == LINK4_PACKET_ACK)) {
+    result = read_bytes(driver, &ack.selective, ack_size, timeout);
+  }
+
+  if (result < 0) {
+    driver->phy_driver.flush(driver->phy_driver.handle);
+    return result;
+  }
+
+  const u8 checksum = ack.checksum;
+  link4_transport_insert_ack_checksum(&ack);
+  if ((result != ack_size) || (ack.ack != LINK4_PACKET_ACK) || (ack.checksum != checksum)) {
+    driver->phy_driver.flush(driver->phy_driver.handle);
+    return 0;
+  }
+
+  // the slave reports its receive window in the selective field
+  driver->phy_driver.sequence = ack.sequence;
+  if (ack.selective < get_window(driver)) {
+    driver->phy_driver.window = ack.selective;
+  }
+  return 1;
+}
+
+int link4_transport_masterwrite(
+  link_transport_mdriver_t *driver,
+  const void *buf,
+  int nbyte) {
+  ack_state_t ack_state = {};
+  const u8 *p = buf;
+
+  if (driver == 0) {
+    return -1;
+  }
+
+  // packets are kept until they are acknowledged (too big for the stack)
+  link4_pkt_t *packet = malloc(LINK4_WINDOW_MAX * sizeof(link4_pkt_t));
+  if (packet == 0) {
+    return LINK_PROT_ERROR;
+  }
+
+  // nbyte == 0 still sends one (empty) packet
+  const int total = nbyte ? (nbyte + LINK4_PACKET_DATA_SIZE - 1) / LINK4_PACKET_DATA_SIZE : 1;
+  const int window = get_window(driver);
+  const u8 sequence = driver->phy_driver.sequence;
+  int sent = 0;
+  int acked = 0;
+  int retries = 0;
+  u8 selective = 0;
+  u64 timer = link_transport_gettime();
+
+  while (acked < total) {
+
+    // keep the window full
+    while ((sent < total) && (sent - acked < window)) {
+      link4_pkt_t *pkt = packet + (sent % LINK4_WINDOW_MAX);
+      const int offset = sent * LINK4_PACKET_DATA_SIZE;
+      pkt->start = LINK4_PACKET_START;
+      pkt->o_flags = driver->phy_driver.o_flags;
+      pkt->size = (nbyte - offset) > LINK4_PACKET_DATA_SIZE ? LINK4_PACKET_DATA_SIZE
+                                                             : nbyte - offset;
+      pkt->sequence = sequence + sent;
+      pkt->resd = 0;
+      memcpy(pkt->data, p + offset, pkt->size);
+      if (driver->phy_driver.o_flags & (LINK4_FLAG_IS_CHECKSUM | LINK4_FLAG_IS_CRC)) {
+        link4_transport_insert_checksum(pkt);
+      } else {
+        // checksum is set to zero
+        pkt->data[pkt->size] = 0;
+        pkt->data[pkt->size + 1] = 0;
+      }
+
+      if (write_packet(driver, pkt) < 0) {
+        free(packet);
+        return SYSFS_SET_RETURN(1);
+      }
+
+      if (sent == acked) {
+        timer = link_transport_gettime();
+      }
+      sent++;
+    }
+
+    // the window is full (or everything is sent) -- wait for acks
+    const int elapsed = (link_transport_gettime() - timer) / 1000UL;
+    const int result = read_ack(
+      driver, &ack_state,
+      elapsed < driver->phy_driver.timeout ? driver->phy_driver.timeout - elapsed : 0);
+
+    if (result < 0) {
+      break;
+    }
+
+    if (result > 0) {
+      if (ack_state.ack.ack != LINK4_PACKET_ACK) {
+        // the slave could not handle the data
+        driver->phy_driver.flush(driver->phy_driver.handle);
+        driver->phy_driver.sequence = ack_state.ack.sequence;
+        free(packet);
+        return SYSFS_SET_RETURN(1);
+      }
+
+      // acks are cumulative: every packet before ack.sequence has arrived
+      const u8 count = ack_state.ack.sequence - (u8)(sequence + acked);
+      if ((count > 0) && (count <= sent - acked)) {
+        acked += count;
+        selective = ack_state.ack.selective;
+        retries = 0;
+        timer = link_transport_gettime();
+      } else if (count == 0) {
+        selective |= ack_state.ack.selective;
+      }
+      continue;
+    }
+
+    // timeout -- send the packets that were not acknowledged again
+    if (++retries > RETRY_MAX) {
+      break;
+    }
+
+    for (int i = acked; i < sent; i++) {
+      if ((i > acked) && (selective & (1 << (i - acked - 1)))) {
+        continue;
+      }
+      if (write_packet(driver, packet + (i % LINK4_WINDOW_MAX)) < 0) {
+        free(packet);
+        return SYSFS_SET_RETURN(1);
+      }
+    }
+    timer = link_transport_gettime();
+  }
+
+  free(packet);
+  if (acked < total) {
+    // the slave's sequence number is unknown -- probe again before the next transfer
+    driver->phy_driver.flush(driver->phy_driver.handle);
+    driver->transport_version = 0;
+    return LINK_TIMEOUT_ERROR;
+  }
+
+  driver->phy_driver.sequence = sequence + total;
+  return nbyte;
+}
+
+int write_packet(link_transport_mdriver_t *driver, link4_pkt_t *pkt) {
+  const int size = pkt->size + LINK4_PACKET_HEADER_SIZE;
+  if (driver->phy_driver.write(driver->phy_driver.handle, pkt, size) != size) {
+    return -1;
+  }
+  return 0;
+}
+
+int read_ack(link_transport_mdriver_t *driver, ack_state_t *state, int timeout) {
+  const int result = read_bytes(
+    driver, ((u8 *)&state->ack) + state->bytes, sizeof(state->ack) - state->bytes,
+    timeout);
+
+  if (result < 0) {
+    return result;
+  }
+
+  state->bytes += result;
+  if (state->bytes < (int)sizeof(state->ack)) {
+    return 0;
+  }
+
+  state->bytes = 0;
+  const u8 checksum = state->ack.checksum;
+  link4_transport_insert_ack_checksum(&state->ack);
+  if (state->ack.checksum != checksum) {
+    // out of sync -- drop what is buffered and treat it as a lost ack
+    driver->phy_driver.flush(driver->phy_driver.handle);
+    return 0;
+  }
+
+  return 1;
+}
+
+int read_bytes(link_transport_mdriver_t *driver, void *dest, int nbyte, int timeout) {
+  int bytes_read = 0;
+  // measured from the last byte received (short reads can take less than a millisecond)
+  u64 start_time = link_transport_gettime();
+  while (bytes_read < nbyte) {
+    const int ret = driver->phy_driver.read(
+      driver->phy_driver.handle, ((u8 *)dest) + bytes_read, nbyte - bytes_read);
+
+    if (ret < 0) {
+      return LINK_PHY_ERROR;
+    }
+
+    if (ret > 0) {
+      bytes_read += ret;
+      start_time = link_transport_gettime();
+    } else if ((link_transport_gettime() - start_time) / 1000UL >= (u64)timeout) {
+      break;
+    }
+  }
+  return bytes_read;
+}
+
+int get_window(link_transport_mdriver_t *driver) {
+  if (driver->phy_driver.window == 0) {
+    return LINK4_DEFAULT_WINDOW;
+  }
+  if (driver->phy_driver.window > LINK4_WINDOW_MAX) {
+    return LINK4_WINDOW_MAX;
+  }
+  return driver->phy_driver.window;
+}
+
+int get_probe_timeout(link_transport_mdriver_t *driver) {
+  // the probe is repeated each time the protocol is resolved -- don't wait the full
+  // timeout on slaves that drop it
+  if (driver->phy_driver.timeout < LINK4_PROBE_TIMEOUT) {
+    return driver->phy_driver.timeout;
+  }
+  return LINK4_PROBE_TIMEOUT;
+}
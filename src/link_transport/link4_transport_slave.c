@@ -0,0 +1,305 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include "sos/link.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sos/debug.h"
+
+#define pkt_checksum(pktp) ((pktp)->data[(pktp)->size])
+
+// link4 slaves also accept link2 packets so masters that don't know link4 keep working
+typedef union {
+  link2_pkt_t link2;
+  link4_pkt_t link4;
+} pkt_t;
+
+// packets that arrive ahead of a missing one are held until it arrives
+typedef struct {
+  link4_pkt_t *packet; // indexed by sequence % window (allocated with the first one)
+  u8 received; // bit n is set if packet driver->sequence + 1 + n is held
+  u8 window;
+} pending_t;
+
+static int read_packets(
+  link_transport_driver_t *driver,
+  void *buf,
+  int nbyte,
+  int (*callback)(void *, void *, int),
+  void *context,
+  pending_t *pending);
+static void hold(link_transport_driver_t *driver, pending_t *pending, link4_pkt_t *pkt);
+static int deliver(
+  char **p,
+  int (*callback)(void *, void *, int),
+  void *context,
+  u8 *data,
+  u16 size);
+static int get_window(link_transport_driver_t *driver);
+static int wait_start(link_transport_driver_t *driver, pkt_t *pkt, int timeout);
+static int send_ack(link_transport_driver_t *driver, u8 ack, u8 selective);
+static int send_link2_ack(link_transport_driver_t *driver, u8 ack, u8 checksum);
+static int send_nack(link_transport_driver_t *driver, int is_link4);
+
+int link4_transport_slaveread(
+  link_transport_driver_t *driver,
+  void *buf,
+  int nbyte,
+  int (*callback)(void *, void *, int),
+  void *context) {
+  pending_t pending = {.window = get_window(driver)};
+  const int result = read_packets(driver, buf, nbyte, callback, context, &pending);
+  free(pending.packet);
+  return result;
+}
+
+int read_packets(
+  link_transport_driver_t *driver,
+  void *buf,
+  int nbyte,
+  int (*callback)(void *, void *, int),
+  void *context,
+  pending_t *pending) {
+  char *p = buf;
+  int bytes = 0;
+  int is_link4 = 0;
+  int is_full;
+  int resend_count = 0;
+  pkt_t pkt;
+  memset(&pkt, 0, sizeof(pkt));
+
+  do {
+    u8 *data;
+    u16 size;
+    u8 checksum = 0;
+    int start;
+    int result;
+
+    if ((start = wait_start(driver, &pkt, driver->timeout)) < 0) {
+      driver->flush(driver->handle);
+      if ((start != LINK_TIMEOUT_ERROR) || (is_link4 == 0)) {
+        send_nack(driver, is_link4);
+      }
+      return -1 * __LINE__;
+    }
+
+    if (start == LINK4_PACKET_START) {
+      is_link4 = 1;
+      if (link4_transport_wait_packet(driver, &pkt.link4, driver->timeout) < 0) {
+        // lost or partial packet -- the master will send it again
+        driver->flush(driver->handle);
+        return -1 * __LINE__;
+      }
+
+      if (pkt.link4.o_flags & LINK4_FLAG_IS_PROBE) {
+        // the window goes in place of the selective acks
+        send_ack(driver, LINK4_PACKET_ACK, pending->window);
+        is_full = 1;
+        continue;
+      }
+
+      const bool is_checked =
+        (driver->o_flags & LINK4_FLAG_IS_CHECKSUM) || (pkt.link4.o_flags & LINK4_FLAG_IS_CRC);
+      if (is_checked && (link4_transport_checksum_isok(&pkt.link4) == false)) {
+        // the master sends it again
+        send_ack(driver, LINK4_PACKET_ACK, pending->received);
+        is_full = 1;
+        continue;
+      }
+
+      if (pkt.link4.sequence != driver->sequence) {
+        // hold packets that are ahead and drop duplicates
+        hold(driver, pending, &pkt.link4);
+        send_ack(driver, LINK4_PACKET_ACK, pending->received);
+        is_full = 1;
+        continue;
+      }
+
+      data = pkt.link4.data;
+      size = pkt.link4.size;
+      is_full = (size == LINK4_PACKET_DATA_SIZE);
+    } else {
+      if (link2_transport_wait_packet(driver, &pkt.link2, driver->timeout) < 0) {
+        driver->flush(driver->handle);
+        send_nack(driver, is_link4);
+        return -1 * __LINE__;
+      }
+
+      // a packet has arrived -- checksum it
+      if (
+        (driver->o_flags & LINK2_FLAG_IS_CHECKSUM)
+        || (pkt.link2.o_flags & LINK2_FLAG_IS_CRC)) {
+        checksum = pkt_checksum(&pkt.link2);
+        if (link2_transport_checksum_isok(&pkt.link2) == false) {
+          driver->flush(driver->handle);
+          if (
+            (pkt.link2.o_flags & LINK2_FLAG_IS_CRC)
+            && (resend_count++ < LINK_TRANSPORT_RESEND_MAX)) {
+            // ask for just this packet again
+            send_link2_ack(driver, LINK2_PACKET_RESEND, checksum);
+            is_full = 1;
+            continue;
+          }
+          // bad checksum on packet -- treat as a non-packet
+          send_link2_ack(driver, LINK2_PACKET_NACK, checksum);
+          return -1 * __LINE__;
+        }
+      }
+      resend_count = 0;
+
+      data = pkt.link2.data;
+      size = pkt.link2.size;
+      is_full = (size == LINK2_PACKET_DATA_SIZE);
+    }
+
+    if ((result = deliver(&p, callback, context, data, size)) < 0) {
+      if (is_link4) {
+        send_ack(driver, LINK4_PACKET_NACK, 0);
+      } else {
+        send_link2_ack(driver, LINK2_PACKET_NACK, checksum);
+      }
+      return result;
+    }
+    bytes += size;
+
+    int ack_result;
+    if (is_link4) {
+      driver->sequence++;
+      // the packets held behind this one are next
+      while ((pending->received & 1) && (bytes < nbyte) && is_full) {
+        link4_pkt_t *next = pending->packet + driver->sequence % pending->window;
+        if ((result = deliver(&p, callback, context, next->data, next->size)) < 0) {
+          send_ack(driver, LINK4_PACKET_NACK, 0);
+          return result;
+        }
+        bytes += next->size;
+        is_full = (next->size == LINK4_PACKET_DATA_SIZE);
+        driver->sequence++;
+        pending->received >>= 1;
+      }
+      pending->received >>= 1;
+      ack_result = send_ack(driver, LINK4_PACKET_ACK, pending->received);
+    } else {
+      ack_result = send_link2_ack(driver, LINK2_PACKET_ACK, checksum);
+    }
+    if ((ack_result < 0) && callback) {
+      return -1 * __LINE__;
+    }
+
+  } while ((bytes < nbyte) && is_full);
+
+  if (bytes == 0) {
+    driver->flush(driver->handle);
+  }
+
+  return bytes;
+}
+
+void hold(link_transport_driver_t *driver, pending_t *pending, link4_pkt_t *pkt) {
+  const u8 ahead = pkt->sequence - driver->sequence;
+  if (ahead >= pending->window) {
+    // a duplicate (or too far ahead to be in the master's window)
+    return;
+  }
+  if (pending->packet == NULL) {
+    // without the memory, the master sends them again
+    pending->packet = malloc(pending->window * sizeof(link4_pkt_t));
+    if (pending->packet == NULL) {
+      return;
+    }
+  }
+  memcpy(
+    pending->packet + pkt->sequence % pending->window, pkt,
+    pkt->size + LINK4_PACKET_HEADER_SIZE);
+  pending->received |= 1 << (ahead - 1);
+}
+
+int deliver(
+  char **p,
+  int (*callback)(void *, void *, int),
+  void *context,
+  u8 *data,
+  u16 size) {
+  // callback to handle incoming data as it arrives
+  if (callback == NULL) {
+    // copy the valid data to the buffer
+    memcpy(*p, data, size);
+    *p += size;
+    return size;
+  }
+  return callback(context, data, size);
+}
+
+int link4_transport_slavewrite(
+  link_transport_driver_t *driver,
+  const void *buf,
+  int nbyte,
+  int (*callback)(void *, void *, int),
+  void *context) {
+  // the master doesn't acknowledge packets from the slave so link2 is already streaming
+  return link2_transport_slavewrite(driver, buf, nbyte, callback, context);
+}
+
+int get_window(link_transport_driver_t *driver) {
+  if (driver->window == 0) {
+    return LINK4_DEFAULT_WINDOW;
+  }
+  if (driver->window > LINK4_WINDOW_MAX) {
+    return LINK4_WINDOW_MAX;
+  }
+  return driver->window;
+}
+
+int wait_start(link_transport_driver_t *driver, pkt_t *pkt, int timeout) {
+  int bytes_read;
+  int count = 0;
+  u64 start_time, stop_time;
+  do {
+    start_time = link_transport_gettime();
+    bytes_read = driver->read(driver->handle, pkt, 1);
+    if (bytes_read < 0) {
+      return LINK_PHY_ERROR;
+    }
+    if (bytes_read > 0) {
+      if (
+        (pkt->link4.start == LINK4_PACKET_START)
+        || (pkt->link4.start == LINK2_PACKET_START)) {
+        return pkt->link4.start;
+      }
+    } else {
+      stop_time = link_transport_gettime();
+      count += (stop_time - start_time) / 1000UL;
+      if (count >= timeout) {
+        return LINK_TIMEOUT_ERROR;
+      }
+    }
+  } while (bytes_read != 1);
+
+  return LINK_PROT_ERROR;
+}
+
+int send_ack(link_transport_driver_t *driver, u8 ack, u8 selective) {
+  link4_ack_t ack_pkt;
+  ack_pkt.ack = ack;
+  ack_pkt.sequence = driver->sequence;
+  ack_pkt.selective = selective;
+  link4_transport_insert_ack_checksum(&ack_pkt);
+  return driver->write(driver->handle, &ack_pkt, sizeof(ack_pkt));
+}
+
+int send_link2_ack(link_transport_driver_t *driver, u8 ack, u8 checksum) {
+  link_ack_t ack_pkt;
+  ack_pkt.ack = ack;
+  ack_pkt.checksum = checksum;
+  return driver->write(driver->handle, &ack_pkt, sizeof(ack_pkt));
+}
+
+int send_nack(link_transport_driver_t *driver, int is_link4) {
+  // before any link4 packets arrive, the slave looks like link2 (this is how masters probe)
+  if (is_link4) {
+    return send_ack(driver, LINK4_PACKET_NACK, 0);
+  }
+  return send_link2_ack(driver, LINK2_PACKET_NACK, 0);
+}
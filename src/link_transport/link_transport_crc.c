@@ -0,0 +1,59 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include "sos/link.h"
+
+#if defined __link
+
+// slicing-by-4: table[k][n] is the crc of byte n followed by k zero bytes
+static u16 crc16_table[4][256];
+static int is_crc16_table_ready;
+
+static void init_crc16_table() {
+  for (int n = 0; n < 256; n++) {
+    u16 crc = n << 8;
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ LINK_TRANSPORT_CRC16_POLYNOMIAL : crc << 1;
+    }
+    crc16_table[0][n] = crc;
+  }
+
+  for (int n = 0; n < 256; n++) {
+    for (int k = 1; k < 4; k++) {
+      const u16 crc = crc16_table[k - 1][n];
+      crc16_table[k][n] = (crc << 8) ^ crc16_table[0][crc >> 8];
+    }
+  }
+  is_crc16_table_ready = 1;
+}
+
+u16 link_transport_crc16(u16 crc, const void *buf, int nbyte) {
+  const u8 *p = buf;
+
+  if (is_crc16_table_ready == 0) {
+    init_crc16_table();
+  }
+
+  while (nbyte >= 4) {
+    crc = crc16_table[3][(crc >> 8) ^ p[0]] ^ crc16_table[2][(crc & 0xff) ^ p[1]]
+          ^ crc16_table[1][p[2]] ^ crc16_table[0][p[3]];
+    p += 4;
+    nbyte -= 4;
+  }
+
+  while (nbyte > 0) {
+    crc = (crc << 8) ^ crc16_table[0][(crc >> 8) ^ *p++];
+    nbyte--;
+  }
+
+  return crc;
+}
+
+#else
+
+#include "mcu/crc.h"
+
+u16 link_transport_crc16(u16 crc, const void *buf, int nbyte) {
+  return mcu_calc_crc16(crc, LINK_TRANSPORT_CRC16_POLYNOMIAL, buf, nbyte);
+}
+
+#endif
@@ -0,0 +1,224 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <string.h>
+
+#include "sos/link.h"
+
+static int apply_record(link_delta_apply_t *state);
+static int write_new(link_delta_apply_t *state, const void *buf, int nbyte);
+static void digest_block(link_delta_digest_t *digest, const u8 *block);
+
+static const u32 m_digest_k[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4,
+  0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe,
+  0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f,
+  0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+  0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
+  0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+  0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116,
+  0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7,
+  0xc67178f2};
+
+#define DIGEST_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+u32 link_delta_weak(const void *buf, int nbyte) {
+  const u8 *p = buf;
+  u32 a = 0;
+  u32 b = 0;
+  for (int i = 0; i < nbyte; i++) {
+    a += p[i];
+    b += (nbyte - i) * p[i];
+  }
+  return (a & 0xffff) | (b << 16);
+}
+
+u32 link_delta_roll(u32 weak, u8 out, u8 in, int block_size) {
+  // slide the block one byte without hashing it again
+  const u32 a = ((weak & 0xffff) - out + in) & 0xffff;
+  const u32 b = ((weak >> 16) - block_size * out + a) & 0xffff;
+  return a | (b << 16);
+}
+
+void link_delta_strong(const void *buf, int nbyte, u8 strong[LINK_DELTA_STRONG_SIZE]) {
+  link_delta_digest_t digest;
+  u8 result[LINK_DELTA_DIGEST_SIZE];
+  link_delta_digest_start(&digest);
+  link_delta_digest_update(&digest, buf, nbyte);
+  link_delta_digest_finish(&digest, result);
+  memcpy(strong, result, LINK_DELTA_STRONG_SIZE);
+}
+
+void link_delta_digest_start(link_delta_digest_t *digest) {
+  static const u32 initial[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+  memcpy(digest->state, initial, sizeof(initial));
+  digest->size = 0;
+}
+
+void link_delta_digest_update(link_delta_digest_t *digest, const void *buf, int nbyte) {
+  const u8 *p = buf;
+  int bytes = 0;
+  while (bytes < nbyte) {
+    const int offset = digest->size % 64;
+    int size = 64 - offset;
+    if (size > nbyte - bytes) {
+      size = nbyte - bytes;
+    }
+    if (size == 64) {
+      // whole blocks are hashed in place
+      digest_block(digest, p + bytes);
+    } else {
+      memcpy(digest->block + offset, p + bytes, size);
+      if (offset + size == 64) {
+        digest_block(digest, digest->block);
+      }
+    }
+    digest->size += size;
+    bytes += size;
+  }
+}
+
+void link_delta_digest_finish(
+  link_delta_digest_t *digest,
+  u8 result[LINK_DELTA_DIGEST_SIZE]) {
+  // the padding ends with the length in bits (big endian)
+  const u32 size = digest->size;
+  u8 padding[72] = {0x80};
+  const int padding_size = ((size % 64) < 56 ? 56 : 120) - (size % 64);
+  padding[padding_size + 3] = size >> 29;
+  padding[padding_size + 4] = size >> 21;
+  padding[padding_size + 5] = size >> 13;
+  padding[padding_size + 6] = size >> 5;
+  padding[padding_size + 7] = size << 3;
+  link_delta_digest_update(digest, padding, padding_size + 8);
+
+  for (int i = 0; i < 8; i++) {
+    result[i * 4] = digest->state[i] >> 24;
+    result[i * 4 + 1] = digest->state[i] >> 16;
+    result[i * 4 + 2] = digest->state[i] >> 8;
+    result[i * 4 + 3] = digest->state[i];
+  }
+}
+
+void link_delta_apply_init(
+  link_delta_apply_t *state,
+  link_delta_read_t read_old,
+  link_delta_write_t write_new,
+  void *context,
+  void *buffer,
+  u32 buffer_size) {
+  memset(state, 0, sizeof(link_delta_apply_t));
+  state->read_old = read_old;
+  state->write_new = write_new;
+  state->context = context;
+  state->buffer = buffer;
+  state->buffer_size = buffer_size;
+  link_delta_digest_start(&state->digest);
+}
+
+int link_delta_apply(link_delta_apply_t *state, const void *buf, int nbyte) {
+  const u8 *p = buf;
+  int bytes = 0;
+
+  while (bytes < nbyte) {
+    if (state->remaining > 0) {
+      // literal data is written as it arrives
+      int size = nbyte - bytes;
+      if ((u32)size > state->remaining) {
+        size = state->remaining;
+      }
+      if (write_new(state, p + bytes, size) < 0) {
+        return -1;
+      }
+      state->remaining -= size;
+      bytes += size;
+      continue;
+    }
+
+    // records can be split between packets
+    int size = sizeof(link_delta_record_t) - state->record_bytes;
+    if (size > nbyte - bytes) {
+      size = nbyte - bytes;
+    }
+    memcpy(((u8 *)&state->record) + state->record_bytes, p + bytes, size);
+    state->record_bytes += size;
+    bytes += size;
+
+    if (state->record_bytes == sizeof(link_delta_record_t)) {
+      state->record_bytes = 0;
+      if (apply_record(state) < 0) {
+        return -1;
+      }
+    }
+  }
+
+  return nbyte;
+}
+
+int link_delta_apply_is_complete(const link_delta_apply_t *state) {
+  return (state->remaining == 0) && (state->record_bytes == 0);
+}
+
+int apply_record(link_delta_apply_t *state) {
+  if (state->record.offset == LINK_DELTA_LITERAL) {
+    state->remaining = state->record.nbyte;
+    return 0;
+  }
+
+  u32 offset = state->record.offset;
+  u32 remaining = state->record.nbyte;
+  while (remaining > 0) {
+    const int size = remaining > state->buffer_size ? state->buffer_size : remaining;
+    if (state->read_old(state->context, offset, state->buffer, size) != size) {
+      // the old file is shorter than the signature said
+      return -1;
+    }
+    if (write_new(state, state->buffer, size) < 0) {
+      return -1;
+    }
+    offset += size;
+    remaining -= size;
+  }
+  return 0;
+}
+
+int write_new(link_delta_apply_t *state, const void *buf, int nbyte) {
+  if (state->write_new(state->context, buf, nbyte) != nbyte) {
+    return -1;
+  }
+  link_delta_digest_update(&state->digest, buf, nbyte);
+  state->size += nbyte;
+  return nbyte;
+}
+
+void digest_block(link_delta_digest_t *digest, const u8 *block) {
+  u32 w[64];
+  u32 v[8];
+  for (int i = 0; i < 16; i++) {
+    w[i] = ((u32)block[i * 4] << 24) | ((u32)block[i * 4 + 1] << 16)
+           | ((u32)block[i * 4 + 2] << 8) | block[i * 4 + 3];
+  }
+  for (int i = 16; i < 64; i++) {
+    const u32 s0 =
+      DIGEST_ROTR(w[i - 15], 7) ^ DIGEST_ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    const u32 s1 =
+      DIGEST_ROTR(w[i - 2], 17) ^ DIGEST_ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  memcpy(v, digest->state, sizeof(v));
+  for (int i = 0; i < 64; i++) {
+    const u32 s1 = DIGEST_ROTR(v[4], 6) ^ DIGEST_ROTR(v[4], 11) ^ DIGEST_ROTR(v[4], 25);
+    const u32 ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+    const u32 t1 = v[7] + s1 + ch + m_digest_k[i] + w[i];
+    const u32 s0 = DIGEST_ROTR(v[0], 2) ^ DIGEST_ROTR(v[0], 13) ^ DIGEST_ROTR(v[0], 22);
+    const u32 maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+    memmove(v + 1, v, 7 * sizeof(u32));
+    v[4] += t1;
+    v[0] = t1 + s0 + maj;
+  }
+  for (int i = 0; i < 8; i++) {
+    digest->state[i] += v[i];
+  }
+}
@@ -33,7 +33,9 @@ void link_transport_mastersettimeout(link_transport_mdriver_t *driver, int t) {
     return link1_transport_mastersettimeout(driver, t);
   }
 
-  if (driver->transport_version == 2 || driver->transport_version == 3) {
+  if (
+    driver->transport_version == 2 || driver->transport_version == 3
+    || driver->transport_version == 4) {
     return link2_transport_mastersettimeout(driver, t);
   }
 
@@ -58,6 +60,11 @@ int link_transport_masterread(link_transport_mdriver_t *driver, void *buf, int n
     return link3_transport_masterread(driver, buf, nbyte);
   }
 
+  if (driver->transport_version == 4) {
+    // link4 only changes how the master writes
+    return link2_transport_masterread(driver, buf, nbyte);
+  }
+
   link_error("tranport version is an invalid value (%d)", driver->transport_version);
   return LINK_PROT_ERROR;
 }
@@ -84,6 +91,33 @@ int link_transport_masterwrite(
     return link3_transport_masterwrite(driver, buf, nbyte);
   }
 
+  if (driver->transport_version == 4) {
+    return link4_transport_masterwrite(driver, buf, nbyte);
+  }
+
+  link_error("tranport version is an invalid value (%d)", driver->transport_version);
+  return LINK_PROT_ERROR;
+}
+
+int link_transport_masterpacketsize(link_transport_mdriver_t *driver) {
+  int result;
+  if ((result = resolve_protocol(driver)) < 0) {
+    link_error("failed to resolve protocol with %d", result);
+    return result;
+  }
+
+  // a read or write continues as long as the packets are full
+  switch (driver->transport_version) {
+  case 1:
+    return LINK_PACKET_DATA_SIZE;
+  case 2:
+    return LINK2_PACKET_DATA_SIZE;
+  case 3:
+    return LINK3_PACKET_PAYLOAD_SIZE;
+  case 4:
+    return LINK4_PACKET_DATA_SIZE;
+  }
+
   link_error("tranport version is an invalid value (%d)", driver->transport_version);
   return LINK_PROT_ERROR;
 }
@@ -106,6 +140,16 @@ int resolve_protocol(link_transport_mdriver_t *driver) {
       if (nack == LINK2_PACKET_NACK) {
         // printf("------------------- Resolved to Link2 -------------------\n");
         driver->transport_version = 2;
+
+        // link4 slaves also answer link1 with a link2 nack -- ask for link4 directly
+        const int link4_result = link4_transport_masterprobe(driver);
+        if (link4_result < 0) {
+          return link4_result;
+        }
+        if (link4_result > 0) {
+          // printf("------------------- Resolved to Link4 -------------------\n");
+          driver->transport_version = 4;
+        }
       } else if (nack == LINK3_PACKET_NACK) {
         // printf("------------------- Resolved to Link3 -------------------\n");
         driver->transport_version = 3;
@@ -123,7 +167,7 @@ int resolve_protocol(link_transport_mdriver_t *driver) {
     }
   }
 
-  if (driver->transport_version > 3) {
+  if (driver->transport_version > 4) {
     driver->transport_version = 0;
     return LINK_PROT_ERROR;
   }
@@ -30,6 +30,8 @@
 
 #define CONFIG_MALLOC_CHUNK_SIZE 32
 #define CONFIG_MALLOC_SBRK_JUMP_SIZE 128
+// walk the entire heap looking for corrupt chunks on every free() (slow)
+#define CONFIG_MALLOC_IS_VERIFY_HEAP 0
 
 // require a valid digital signature when installing applications
 #define CONFIG_APPFS_IS_VERIFY_SIGNATURE 1
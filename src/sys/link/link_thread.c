@@ -11,12 +11,15 @@
 #include <errno.h>
 #include <pthread.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/fcntl.h> //Defines the flags
 
 #include "cortexm/util.h"
 
 #include "../process/process_start.h"
 #include "../scheduler/scheduler_local.h"
+#include "../unistd/unistd_local.h"
 
 #include "sos/debug.h"
 #include "sos/fs.h"
@@ -36,6 +39,16 @@
  */
 #define BETWEEN_LINK_WRITE_DELAY() usleep(1000)
 
+// a descriptor that is checked once for a whole transfer
+typedef struct {
+  int fildes;
+  sysfs_file_t *file; // NULL uses read()/write() (sockets and bad descriptors)
+} device_file_t;
+
+static void device_file_open(device_file_t *device, int fildes, int is_write);
+static int device_file_read(device_file_t *device, void *buf, int nbyte);
+static int device_file_write(device_file_t *device, const void *buf, int nbyte);
+
 static int read_device(link_transport_driver_t *driver, int fildes, int size);
 static int write_device(link_transport_driver_t *driver, int fildes, int size);
 static int read_device_callback(void *context, void *buf, int nbyte);
@@ -72,6 +85,58 @@ static void link_cmd_chown(link_transport_driver_t *driver, link_data_t *args);
 static void link_cmd_chmod(link_transport_driver_t *driver, link_data_t *args);
 static void link_cmd_exec(link_transport_driver_t *driver, link_data_t *args);
 static void link_cmd_mkfs(link_transport_driver_t *driver, link_data_t *args);
+static void link_cmd_compound(link_transport_driver_t *driver, link_data_t *args);
+static void
+link_cmd_delta_signature(link_transport_driver_t *driver, link_data_t *args);
+static void link_cmd_delta_apply(link_transport_driver_t *driver, link_data_t *args);
+
+// a compound request runs once all of it has arrived
+typedef struct {
+  link_transport_driver_t *driver;
+  link_compound_t compound;
+  u32 offset; // bytes of the request parsed
+  int count;  // operations run
+  s32 last_opened;
+  link_op_t op;
+  u32 payload_size;
+  char path[PATH_MAX + 1];
+  int is_path_too_long;
+  device_file_t file;  // the file of a write
+  link_reply_t reply;  // the reply of a write
+  int is_stopped;
+  u8 *result;
+  int result_size;
+} compound_state_t;
+
+static void compound_run(compound_state_t *state, const u8 *request, int size);
+static void compound_start(compound_state_t *state);
+static void compound_finish(compound_state_t *state);
+
+#define DELTA_COPY_SIZE 256
+
+typedef struct {
+  int fildes;
+  device_file_t new_file;
+  u32 block_size;
+  u32 count;
+  u32 index;
+  link_delta_signature_t entry;
+  u32 entry_bytes; // bytes of entry that are already sent
+  u8 *block;
+} delta_context_t;
+
+static int delta_signature_callback(void *context, void *buf, int nbyte);
+static int delta_apply_callback(void *context, void *buf, int nbyte);
+static int delta_read_old(void *context, u32 offset, void *buf, int nbyte);
+static int delta_write_new(void *context, const void *buf, int nbyte);
+
+static int compound_execute(
+  link_transport_driver_t *driver,
+  const link_op_t *op,
+  const char *path,
+  s32 *last_opened,
+  u8 *result,
+  int capacity);
 
 void (*const link_cmd_func_table[LINK_CMD_TOTAL])(
   link_transport_driver_t *,
@@ -81,7 +146,8 @@ void (*const link_cmd_func_table[LINK_CMD_TOTAL])(
   link_cmd_unlink,   link_cmd_lseek,        link_cmd_stat,    link_cmd_fstat,
   link_cmd_mkdir,    link_cmd_rmdir,        link_cmd_opendir, link_cmd_readdir,
   link_cmd_closedir, link_cmd_rename,       link_cmd_chown,   link_cmd_chmod,
-  link_cmd_exec,     link_cmd_mkfs};
+  link_cmd_exec,     link_cmd_mkfs,         link_cmd_compound, link_cmd_delta_signature,
+  link_cmd_delta_apply};
 
 void *link_update(void *arg) {
   int err;
@@ -614,28 +680,549 @@ void link_cmd_mkfs(link_transport_driver_t *driver, link_data_t *args) {
   }
 }
 
+void link_cmd_compound(link_transport_driver_t *driver, link_data_t *args) {
+  const link_compound_t compound = args->op.compound;
+  sos_debug_log_datum(
+    SOS_DEBUG_LINK, "linkm:H->>D: compound count=%d size=%d", compound.count,
+    compound.size);
+
+  if (
+    (compound.size > LINK_COMPOUND_REQUEST_MAX) || (compound.count > LINK_COMPOUND_OP_MAX)
+    || (compound.size < compound.count * sizeof(link_op_t))) {
+    args->reply.err = -1;
+    args->reply.err_number = EINVAL;
+    return;
+  }
+
+  compound_state_t state = {
+    .driver = driver,
+    .compound = compound,
+    .last_opened = -1,
+    .result = malloc(LINK_COMPOUND_REPLY_MAX)};
+  u8 *request = malloc(compound.size);
+  if ((state.result == NULL) || (request == NULL)) {
+    free(state.result);
+    free(request);
+    args->reply.err = -1;
+    args->reply.err_number = ENOMEM;
+    return;
+  }
+
+  // accept the request -- hosts wait for this so devices without compound can say no
+  args->op.cmd = 0;
+  args->reply.err = 0;
+  args->reply.err_number = 0;
+  if (
+    link_transport_slavewrite(driver, &args->reply, sizeof(args->reply), NULL, NULL)
+    < 0) {
+    free(state.result);
+    free(request);
+    return;
+  }
+
+  // nothing runs until the whole request is here -- a transfer that fails
+  // doesn't leave a request half done
+  if (link_transport_slaveread(driver, request, compound.size, NULL, NULL) < 0) {
+    driver->flush(driver->handle);
+    free(state.result);
+    free(request);
+    return;
+  }
+  compound_run(&state, request, compound.size);
+  free(request);
+
+  args->reply.err = state.count;
+  args->reply.err_number = state.result_size;
+  sos_debug_log_datum(
+    SOS_DEBUG_LINK, "linkm:D->>H: compound %d results (%d bytes)", args->reply.err,
+    state.result_size);
+  if (
+    (link_transport_slavewrite(driver, &args->reply, sizeof(args->reply), NULL, NULL)
+     >= 0)
+    && (state.result_size > 0)) {
+    BETWEEN_LINK_WRITE_DELAY();
+    link_transport_slavewrite(driver, state.result, state.result_size, NULL, NULL);
+  }
+
+  free(state.result);
+}
+
+void link_cmd_delta_signature(link_transport_driver_t *driver, link_data_t *args) {
+  const link_delta_t delta = args->op.delta;
+  struct stat st;
+  sos_debug_log_datum(
+    SOS_DEBUG_LINK, "linkm:H->>D: delta signature fd=%d block=%d", delta.fildes,
+    delta.block_size);
+
+  if (
+    (delta.block_size < LINK_DELTA_BLOCK_SIZE_MIN)
+    || (delta.block_size > LINK_DELTA_BLOCK_SIZE_MAX)) {
+    args->reply.err = -1;
+    args->reply.err_number = EINVAL;
+    return;
+  }
+
+  if (
+    (delta.fildes == driver->handle) || (fstat(delta.fildes, &st) < 0)
+    || (lseek(delta.fildes, 0, SEEK_SET) < 0)) {
+    args->reply.err = -1;
+    args->reply.err_number = errno;
+    return;
+  }
+
+  delta_context_t context = {
+    .fildes = delta.fildes,
+    .block_size = delta.block_size,
+    .count = st.st_size / delta.block_size,
+    .block = malloc(delta.block_size)};
+  if (context.block == NULL) {
+    args->reply.err = -1;
+    args->reply.err_number = ENOMEM;
+    return;
+  }
+
+  // the number of blocks goes first so the host knows how much to read
+  args->op.cmd = 0;
+  args->reply.err = context.count;
+  args->reply.err_number = 0;
+  if (
+    (link_transport_slavewrite(driver, &args->reply, sizeof(args->reply), NULL, NULL)
+     >= 0)
+    && (context.count > 0)) {
+    BETWEEN_LINK_WRITE_DELAY();
+    link_transport_slavewrite(
+      driver, NULL, context.count * sizeof(link_delta_signature_t),
+      delta_signature_callback, &context);
+  }
+
+  free(context.block);
+}
+
+void link_cmd_delta_apply(link_transport_driver_t *driver, link_data_t *args) {
+  const link_delta_t delta = args->op.delta;
+  link_delta_apply_t apply;
+  sos_debug_log_datum(
+    SOS_DEBUG_LINK, "linkm:H->>D: delta apply fd=%d new=%d size=%d", delta.fildes,
+    delta.new_fildes, delta.nbyte);
+
+  if (
+    (delta.fildes == driver->handle) || (delta.new_fildes == driver->handle)
+    || (delta.fildes == delta.new_fildes)) {
+    args->reply.err = -1;
+    args->reply.err_number = EBADF;
+    return;
+  }
+
+  delta_context_t context = {.fildes = delta.fildes, .block = malloc(DELTA_COPY_SIZE)};
+  if (context.block == NULL) {
+    args->reply.err = -1;
+    args->reply.err_number = ENOMEM;
+    return;
+  }
+
+  // accept the delta -- hosts wait for this so devices without deltas can say no
+  if (
+    link_transport_slavewrite(driver, &args->reply, sizeof(args->reply), NULL, NULL)
+    < 0) {
+    args->op.cmd = 0;
+    free(context.block);
+    return;
+  }
+
+  // the new file is written while the records arrive
+  device_file_open(&context.new_file, delta.new_fildes, 1);
+  link_delta_apply_init(
+    &apply, delta_read_old, delta_write_new, &context, context.block, DELTA_COPY_SIZE);
+  errno = 0;
+  const int result =
+    link_transport_slaveread(driver, NULL, delta.nbyte, delta_apply_callback, &apply);
+  free(context.block);
+
+  if ((result < 0) || (link_delta_apply_is_complete(&apply) == 0)) {
+    args->reply.err = -1;
+    args->reply.err_number = errno ? errno : EIO;
+    sos_debug_log_error(SOS_DEBUG_LINK, "Failed to apply delta (%d)", errno);
+    return;
+  }
+
+  // the digest of the new file follows the reply
+  u8 digest[LINK_DELTA_DIGEST_SIZE];
+  link_delta_digest_finish(&apply.digest, digest);
+  args->op.cmd = 0;
+  args->reply.err = apply.size;
+  args->reply.err_number = 0;
+  if (
+    link_transport_slavewrite(driver, &args->reply, sizeof(args->reply), NULL, NULL)
+    >= 0) {
+    BETWEEN_LINK_WRITE_DELAY();
+    link_transport_slavewrite(driver, digest, LINK_DELTA_DIGEST_SIZE, NULL, NULL);
+  }
+}
+
+void compound_run(compound_state_t *state, const u8 *request, int size) {
+  while ((state->is_stopped == 0) && (state->offset + sizeof(link_op_t) <= (u32)size)) {
+    memcpy(&state->op, request + state->offset, sizeof(link_op_t));
+    state->offset += sizeof(link_op_t);
+    compound_start(state);
+    if ((state->is_stopped) || (state->payload_size == 0)) {
+      continue;
+    }
+
+    // paths and write data follow the operation
+    const u8 *payload = request + state->offset;
+    state->offset += state->payload_size;
+    if (state->op.cmd == LINK_CMD_WRITE) {
+      if (state->reply.err == 0) {
+        const int result = device_file_write(&state->file, payload, state->payload_size);
+        if (result < 0) {
+          state->reply.err = -1;
+          state->reply.err_number = errno;
+        } else {
+          state->reply.err = result;
+        }
+      }
+    } else if (state->is_path_too_long == 0) {
+      memcpy(state->path, payload, state->payload_size);
+    }
+    compound_finish(state);
+  }
+}
+
+void compound_start(compound_state_t *state) {
+  const link_op_t *op = &state->op;
+
+  // paths and write data follow the operation
+  state->payload_size = 0;
+  switch (op->cmd) {
+  case LINK_CMD_OPEN:
+  case LINK_CMD_STAT:
+  case LINK_CMD_UNLINK:
+  case LINK_CMD_MKDIR:
+  case LINK_CMD_RMDIR:
+  case LINK_CMD_OPENDIR:
+    // path_size is in the same place for all of these
+    state->payload_size = op->open.path_size;
+    break;
+  case LINK_CMD_WRITE:
+    state->payload_size = op->write.nbyte;
+    break;
+  }
+  // a path that doesn't fit is an error for the operation (not a shorter path)
+  state->is_path_too_long =
+    (op->cmd != LINK_CMD_WRITE) && (state->payload_size > sizeof(state->path));
+
+  if (
+    (state->count == (int)state->compound.count)
+    || (state->offset + state->payload_size > state->compound.size)) {
+    state->is_stopped = 1;
+    return;
+  }
+
+  if (op->cmd == LINK_CMD_WRITE) {
+    if (state->result_size + sizeof(link_reply_t) > LINK_COMPOUND_REPLY_MAX) {
+      // the results are full -- the host sends the rest again
+      state->is_stopped = 1;
+      return;
+    }
+
+    s32 fildes = op->write.fildes;
+    if (fildes == LINK_COMPOUND_FILDES) {
+      fildes = state->last_opened;
+    }
+    state->reply.err = 0;
+    state->reply.err_number = 0;
+    if (fildes == state->driver->handle) {
+      state->reply.err = -1;
+      state->reply.err_number = EBADF;
+    }
+    errno = 0;
+    device_file_open(&state->file, fildes, 1);
+  }
+
+  if (state->payload_size == 0) {
+    compound_finish(state);
+  }
+}
+
+void compound_finish(compound_state_t *state) {
+  link_reply_t *reply = (link_reply_t *)(state->result + state->result_size);
+  int result_size;
+
+  if (state->op.cmd == LINK_CMD_WRITE) {
+    // compound_run() wrote the data
+    memcpy(reply, &state->reply, sizeof(link_reply_t));
+    result_size = sizeof(link_reply_t);
+  } else {
+    errno = 0;
+    if (state->is_path_too_long) {
+      result_size = -1;
+      if (state->result_size + sizeof(link_reply_t) <= LINK_COMPOUND_REPLY_MAX) {
+        const link_reply_t too_long = {.err = -1, .err_number = ENAMETOOLONG};
+        memcpy(reply, &too_long, sizeof(link_reply_t));
+        result_size = sizeof(link_reply_t);
+      }
+    } else {
+      state->path[state->payload_size ? state->payload_size - 1 : 0] = 0;
+      result_size = compound_execute(
+        state->driver, &state->op, state->path, &state->last_opened,
+        state->result + state->result_size,
+        LINK_COMPOUND_REPLY_MAX - state->result_size);
+    }
+    if (result_size < 0) {
+      // the results are full -- the host sends the rest again
+      state->is_stopped = 1;
+      return;
+    }
+  }
+
+  state->result_size += result_size;
+  state->count++;
+  if (
+    (state->compound.o_flags & LINK_COMPOUND_FLAG_IS_STOP_ON_ERROR) && (reply->err < 0)) {
+    state->is_stopped = 1;
+  }
+}
+
+int compound_execute(
+  link_transport_driver_t *driver,
+  const link_op_t *op,
+  const char *path,
+  s32 *last_opened,
+  u8 *result,
+  int capacity) {
+  link_reply_t reply = {.err = -1, .err_number = EINVAL};
+  struct dirent de;
+  struct stat st;
+  u8 *data = result + sizeof(link_reply_t);
+  int data_size = 0;
+
+  // the largest result the operation can have
+  u32 data_max = 0;
+  switch (op->cmd) {
+  case LINK_CMD_READ:
+    data_max = op->read.nbyte;
+    break;
+  case LINK_CMD_STAT:
+  case LINK_CMD_FSTAT:
+    data_max = sizeof(struct link_stat);
+    break;
+  case LINK_CMD_READDIR:
+    data_max = sizeof(u32) + sizeof(de.d_name);
+    break;
+  }
+
+  if (
+    (data_max > LINK_COMPOUND_REPLY_MAX)
+    || (sizeof(link_reply_t) + data_max > (u32)capacity)) {
+    return -1;
+  }
+
+  s32 fildes = op->read.fildes;
+  if (fildes == LINK_COMPOUND_FILDES) {
+    fildes = *last_opened;
+  }
+
+  switch (op->cmd) {
+  case LINK_CMD_OPEN:
+  case LINK_CMD_OPENDIR:
+    if (op->cmd == LINK_CMD_OPEN) {
+      reply.err = open(path, op->open.flags, op->open.mode);
+    } else {
+      reply.err = (int)opendir(path);
+      if (reply.err == 0) {
+        reply.err = -1;
+      }
+    }
+    if (reply.err >= 0) {
+      *last_opened = reply.err;
+    }
+    break;
+
+  case LINK_CMD_CLOSE:
+  case LINK_CMD_READ:
+  case LINK_CMD_LSEEK:
+  case LINK_CMD_FSTAT:
+    if (fildes == driver->handle) {
+      errno = EBADF;
+      break;
+    }
+
+    if (op->cmd == LINK_CMD_CLOSE) {
+      reply.err = close(fildes);
+    } else if (op->cmd == LINK_CMD_READ) {
+      reply.err = read(fildes, data, op->read.nbyte);
+      if (reply.err > 0) {
+        data_size = reply.err;
+      }
+    } else if (op->cmd == LINK_CMD_LSEEK) {
+      reply.err = lseek(fildes, op->lseek.offset, op->lseek.whence);
+    } else {
+      reply.err = fstat(fildes, &st);
+      if (reply.err == 0) {
+        translate_link_stat((struct link_stat *)data, &st);
+        data_size = sizeof(struct link_stat);
+      }
+    }
+    break;
+
+  case LINK_CMD_STAT:
+    reply.err = stat(path, &st);
+    if (reply.err == 0) {
+      translate_link_stat((struct link_stat *)data, &st);
+      data_size = sizeof(struct link_stat);
+    }
+    break;
+
+  case LINK_CMD_READDIR:
+    reply.err = readdir_r((DIR *)fildes, &de, NULL);
+    if (reply.err < 0) {
+      reply.err = -1;
+    } else {
+      // only the used part of the name is sent
+      const u32 d_ino = de.d_ino;
+      memcpy(data, &d_ino, sizeof(d_ino));
+      strcpy((char *)data + sizeof(d_ino), de.d_name);
+      data_size = sizeof(d_ino) + strlen(de.d_name) + 1;
+    }
+    break;
+
+  case LINK_CMD_CLOSEDIR:
+    reply.err = closedir((DIR *)fildes);
+    break;
+
+  case LINK_CMD_UNLINK:
+    reply.err = unlink(path);
+    break;
+
+  case LINK_CMD_MKDIR:
+    reply.err = mkdir(path, op->mkdir.mode);
+    break;
+
+  case LINK_CMD_RMDIR:
+    reply.err = rmdir(path);
+    break;
+
+  default:
+    // commands with their own data phases can't be batched
+    errno = EINVAL;
+    break;
+  }
+
+  if (reply.err < 0) {
+    reply.err_number = errno;
+  } else {
+    reply.err_number = 0;
+  }
+
+  memcpy(result, &reply, sizeof(reply));
+  return sizeof(link_reply_t) + data_size;
+}
+
+void device_file_open(device_file_t *device, int fildes, int is_write) {
+  device->fildes = fildes;
+  device->file = NULL;
+  if (FILDES_IS_SOCKET(fildes)) {
+    return;
+  }
+
+  const int index = u_fildes_is_bad(fildes);
+  if (index < 0) {
+    // read()/write() report the error
+    return;
+  }
+
+  const int access = get_flags(index) & O_ACCMODE;
+  if ((is_write && (access == O_RDONLY)) || (!is_write && (access == O_WRONLY))) {
+    return;
+  }
+
+  device->file = get_open_file(index);
+}
+
+int device_file_read(device_file_t *device, void *buf, int nbyte) {
+  if (device->file == NULL) {
+    return read(device->fildes, buf, nbyte);
+  }
+  // straight from the file system into the packet
+  scheduler_check_cancellation();
+  return sysfs_file_read(device->file, buf, nbyte);
+}
+
+int device_file_write(device_file_t *device, const void *buf, int nbyte) {
+  if (device->file == NULL) {
+    return write(device->fildes, buf, nbyte);
+  }
+  // straight from the packet to the file system
+  return sysfs_file_write(device->file, buf, nbyte);
+}
+
 int read_device_callback(void *context, void *buf, int nbyte) {
-  int *fildes;
-  int ret;
-  fildes = context;
-  ret = read(*fildes, buf, nbyte);
-  return ret;
+  return device_file_read(context, buf, nbyte);
 }
 
 int write_device_callback(void *context, void *buf, int nbyte) {
-  int *fildes;
-  int ret;
-  fildes = context;
-  ret = write(*fildes, buf, nbyte);
-  return ret;
+  return device_file_write(context, buf, nbyte);
+}
+
+int delta_signature_callback(void *context, void *buf, int nbyte) {
+  delta_context_t *delta = context;
+  u8 *p = buf;
+  int bytes = 0;
+
+  // entries can be split between packets
+  while (bytes < nbyte) {
+    if (delta->entry_bytes == 0) {
+      if (delta->index == delta->count) {
+        break;
+      }
+      if (read(delta->fildes, delta->block, delta->block_size) != (int)delta->block_size) {
+        // ends the stream early
+        break;
+      }
+      delta->entry.weak = link_delta_weak(delta->block, delta->block_size);
+      link_delta_strong(delta->block, delta->block_size, delta->entry.strong);
+      delta->index++;
+    }
+
+    int size = sizeof(link_delta_signature_t) - delta->entry_bytes;
+    if (size > nbyte - bytes) {
+      size = nbyte - bytes;
+    }
+    memcpy(p + bytes, ((u8 *)&delta->entry) + delta->entry_bytes, size);
+    delta->entry_bytes = (delta->entry_bytes + size) % sizeof(link_delta_signature_t);
+    bytes += size;
+  }
+
+  return bytes;
+}
+
+int delta_apply_callback(void *context, void *buf, int nbyte) {
+  return link_delta_apply(context, buf, nbyte);
+}
+
+int delta_read_old(void *context, u32 offset, void *buf, int nbyte) {
+  delta_context_t *delta = context;
+  if (lseek(delta->fildes, offset, SEEK_SET) < 0) {
+    return -1;
+  }
+  return read(delta->fildes, buf, nbyte);
+}
+
+int delta_write_new(void *context, const void *buf, int nbyte) {
+  delta_context_t *delta = context;
+  return device_file_write(&delta->new_file, buf, nbyte);
 }
 
 int read_device(link_transport_driver_t *driver, int fildes, int nbyte) {
-  return link_transport_slavewrite(driver, NULL, nbyte, read_device_callback, &fildes);
+  device_file_t device;
+  device_file_open(&device, fildes, 0);
+  return link_transport_slavewrite(driver, NULL, nbyte, read_device_callback, &device);
 }
 
 int write_device(link_transport_driver_t *driver, int fildes, int nbyte) {
-  return link_transport_slaveread(driver, NULL, nbyte, write_device_callback, &fildes);
+  device_file_t device;
+  device_file_open(&device, fildes, 1);
+  return link_transport_slaveread(driver, NULL, nbyte, write_device_callback, &device);
 }
 
 int read_path(link_transport_driver_t *driver, char *path, size_t size, size_t capacity) {
@@ -53,7 +53,7 @@ void *_realloc_r(struct _reent *reent_ptr, void *addr, size_t size) {
     const u16 free_chunks_next = chunk->header.num_chunks - num_chunks_requested;
     malloc_set_chunk_used(reent_ptr, chunk, num_chunks_requested, size);
     next = chunk + num_chunks_requested;
-    malloc_set_chunk_free(next, free_chunks_next);
+    malloc_release_chunk(reent_ptr, next, free_chunks_next);
     __malloc_unlock(reent_ptr);
     return addr;
   }
@@ -64,12 +64,16 @@ void *_realloc_r(struct _reent *reent_ptr, void *addr, size_t size) {
                                                                         // chunk is free
     const u16 free_chunks_with_next = next->header.num_chunks + chunk->header.num_chunks;
     if (num_chunks_requested < free_chunks_with_next) {
+      malloc_free_list_remove(reent_ptr, next);
+      malloc_erase_chunk(next);
       malloc_set_chunk_used(reent_ptr, chunk, num_chunks_requested, size);
       next = chunk + chunk->header.num_chunks;
-      malloc_set_chunk_free(next, free_chunks_with_next - num_chunks_requested);
+      malloc_release_chunk(reent_ptr, next, free_chunks_with_next - num_chunks_requested);
       __malloc_unlock(reent_ptr);
       return addr;
     } else if (free_chunks_with_next == num_chunks_requested) {
+      malloc_free_list_remove(reent_ptr, next);
+      malloc_erase_chunk(next);
       malloc_set_chunk_used(reent_ptr, chunk, num_chunks_requested, size);
       __malloc_unlock(reent_ptr);
       return addr;
@@ -30,16 +30,40 @@ typedef struct {
   char memory[MALLOC_DATA_SIZE];
 } malloc_chunk_t;
 
+// free chunks keep the links of their free list in the chunk memory
+typedef struct {
+  malloc_chunk_t *next;
+  malloc_chunk_t *prev;
+} malloc_free_link_t;
+
+// 12-byte header, the two links and the pointer in the last word of a free chunk
+#if CONFIG_MALLOC_CHUNK_SIZE < 24
+#error "CONFIG_MALLOC_CHUNK_SIZE is too small to hold the free list links"
+#endif
+
+// one free list per power of two of num_chunks (num_chunks is a u16)
+#define MALLOC_FREE_LIST_TOTAL 16
+
+// the first chunk of every heap holds the free lists
+typedef struct {
+  u32 bitmap; // bit n is set when list n is not empty
+  malloc_chunk_t *list[MALLOC_FREE_LIST_TOTAL];
+} malloc_free_lists_t;
+
 void malloc_set_chunk_used(
   struct _reent *reent,
   malloc_chunk_t *chunk,
   u16 num_chunks,
   u32 actual_size);
 void malloc_set_chunk_free(malloc_chunk_t *chunk, u16 num_chunks);
+void malloc_erase_chunk(malloc_chunk_t *chunk);
 int malloc_chunk_is_free(malloc_chunk_t *chunk);
 u16 malloc_calc_num_chunks(u32 size);
 malloc_chunk_t *malloc_chunk_from_addr(void *addr);
 
+void malloc_release_chunk(struct _reent *reent, malloc_chunk_t *chunk, u16 num_chunks);
+void malloc_free_list_remove(struct _reent *reent, malloc_chunk_t *chunk);
+
 int malloc_get_more_memory(struct _reent *reent_ptr, u32 size, int is_new_heap);
 
 
@@ -12,11 +12,30 @@
 #include "trace.h"
 
 #define ENABLE_DEEP_TRACE 0
+#define MALLOC_FREE_LIST_SEARCH_MAX 8
 
 static void set_last_chunk(malloc_chunk_t *chunk);
 static void cleanup_memory(struct _reent *reent_ptr, int release_extra_memory);
 static malloc_chunk_t *find_free_chunk(struct _reent *reent_ptr, u32 num_chunks);
+static malloc_chunk_t *search_free_list(
+  struct _reent *reent_ptr,
+  malloc_chunk_t *chunk,
+  u32 num_chunks,
+  u32 loop_max);
+#if CONFIG_MALLOC_IS_VERIFY_HEAP
 static int is_memory_corrupt(struct _reent *reent_ptr);
+#endif
+
+static malloc_free_lists_t *get_free_lists(struct _reent *reent_ptr);
+static int get_free_list_index(u16 num_chunks);
+static malloc_free_link_t *get_free_link(malloc_chunk_t *chunk);
+static malloc_chunk_t **get_free_tail(malloc_chunk_t *chunk);
+static void free_list_insert(struct _reent *reent_ptr, malloc_chunk_t *chunk);
+static int is_chunk_in_heap(struct _reent *reent_ptr, malloc_chunk_t *chunk);
+static int is_free_list_chunk_valid(struct _reent *reent_ptr, malloc_chunk_t *chunk);
+static malloc_chunk_t *get_previous_free_chunk(
+  struct _reent *reent_ptr,
+  malloc_chunk_t *chunk);
 
 void malloc_process_fault(void *loc);
 
@@ -32,37 +51,143 @@ u16 malloc_calc_num_chunks(u32 size) {
   return num_chunks;
 }
 
-malloc_chunk_t *find_free_chunk(struct _reent *reent_ptr, u32 num_chunks) {
-  int loop_count = 0;
+malloc_free_lists_t *get_free_lists(struct _reent *reent_ptr) {
   malloc_chunk_t *chunk = (malloc_chunk_t *)&(reent_ptr->procmem_base->base);
+  return (malloc_free_lists_t *)chunk->memory;
+}
 
-#if ENABLE_DEEP_TRACE
-  sos_debug_log_info(SOS_DEBUG_MALLOC, "-----------find free");
-#endif
+int get_free_list_index(u16 num_chunks) { return 31 - __builtin_clz(num_chunks); }
 
-  while (chunk->header.num_chunks != 0) {
-#if ENABLE_DEEP_TRACE
-    sos_debug_log_info(
-      SOS_DEBUG_MALLOC, "checking chunk %p %d %ld", chunk, chunk->header.num_chunks,
-      chunk->header.actual_size);
-#endif
-    const int is_free = malloc_chunk_is_free(chunk);
+malloc_free_link_t *get_free_link(malloc_chunk_t *chunk) {
+  return (malloc_free_link_t *)chunk->memory;
+}
 
-    if (is_free == -1) {
-      return NULL;
+// the last word of a free chunk points back to the chunk so free() can find it
+malloc_chunk_t **get_free_tail(malloc_chunk_t *chunk) {
+  return (malloc_chunk_t **)(chunk + chunk->header.num_chunks) - 1;
+}
+
+void free_list_insert(struct _reent *reent_ptr, malloc_chunk_t *chunk) {
+  malloc_free_lists_t *lists = get_free_lists(reent_ptr);
+  const int index = get_free_list_index(chunk->header.num_chunks);
+  malloc_free_link_t *link = get_free_link(chunk);
+  link->prev = NULL;
+  link->next = lists->list[index];
+  if (link->next != NULL) {
+    get_free_link(link->next)->prev = chunk;
+  }
+  lists->list[index] = chunk;
+  lists->bitmap |= (1 << index);
+  *get_free_tail(chunk) = chunk;
+}
+
+void malloc_free_list_remove(struct _reent *reent_ptr, malloc_chunk_t *chunk) {
+  malloc_free_lists_t *lists = get_free_lists(reent_ptr);
+  const int index = get_free_list_index(chunk->header.num_chunks);
+  malloc_free_link_t *link = get_free_link(chunk);
+  if (
+    ((link->prev != NULL) && (is_free_list_chunk_valid(reent_ptr, link->prev) == 0))
+    || ((link->next != NULL) && (is_free_list_chunk_valid(reent_ptr, link->next) == 0))) {
+    // don't follow links the application has overwritten
+    sos_debug_log_error(SOS_DEBUG_MALLOC, "Corrupt Free List 0x%lX", (u32)chunk);
+    SOS_TRACE_CRITICAL("Heap Corrupt");
+    malloc_process_fault(chunk); // this will exit the process
+    return;
+  }
+  if (link->prev != NULL) {
+    get_free_link(link->prev)->next = link->next;
+  } else {
+    lists->list[index] = link->next;
+    if (link->next == NULL) {
+      lists->bitmap &= ~(1 << index);
     }
+  }
+  if (link->next != NULL) {
+    get_free_link(link->next)->prev = link->prev;
+  }
+  *get_free_tail(chunk) = NULL;
+}
+
+int is_chunk_in_heap(struct _reent *reent_ptr, malloc_chunk_t *chunk) {
+  const u32 base = (u32)&(reent_ptr->procmem_base->base);
+  const u32 offset = (u32)chunk - base;
+  return ((u32)chunk >= base) && (offset < reent_ptr->procmem_base->size)
+         && ((offset % CONFIG_MALLOC_CHUNK_SIZE) == 0);
+}
+
+// the links live in memory the application can write -- check them before use
+int is_free_list_chunk_valid(struct _reent *reent_ptr, malloc_chunk_t *chunk) {
+  if (is_chunk_in_heap(reent_ptr, chunk) == 0) {
+    sos_debug_log_warning(SOS_DEBUG_MALLOC, "Free list link out of heap %p", chunk);
+    return 0;
+  }
+  return malloc_chunk_is_free(chunk) == 1;
+}
+
+malloc_chunk_t *get_previous_free_chunk(struct _reent *reent_ptr, malloc_chunk_t *chunk) {
+  // if the chunk before is in use, the word is application data -- it may point anywhere
+  malloc_chunk_t *previous = *((malloc_chunk_t **)chunk - 1);
+  if (
+    (previous >= chunk) || (is_chunk_in_heap(reent_ptr, previous) == 0)
+    || (cortexm_verify_zero_sum32(
+          previous, CORTEXM_ZERO_SUM32_COUNT(malloc_chunk_header_t))
+        == 0)
+    || (previous->header.actual_size != 0)
+    || (previous + previous->header.num_chunks != chunk)) {
+    return NULL;
+  }
+  return previous;
+}
 
-    if ((is_free == 1) && (chunk->header.num_chunks >= num_chunks)) {
+malloc_chunk_t *search_free_list(
+  struct _reent *reent_ptr,
+  malloc_chunk_t *chunk,
+  u32 num_chunks,
+  u32 loop_max) {
+  for (u32 loop_count = 0; (chunk != NULL) && (loop_count < loop_max); loop_count++) {
+    if (is_free_list_chunk_valid(reent_ptr, chunk) == 0) {
+      return NULL;
+    }
+    if (chunk->header.num_chunks >= num_chunks) {
       return chunk;
     }
-    loop_count++;
-    chunk = chunk + chunk->header.num_chunks;
+    chunk = get_free_link(chunk)->next;
   }
-
-  // No block found to fit size
   return NULL;
 }
 
+malloc_chunk_t *find_free_chunk(struct _reent *reent_ptr, u32 num_chunks) {
+  malloc_free_lists_t *lists = get_free_lists(reent_ptr);
+  const int index = get_free_list_index(num_chunks);
+
+#if ENABLE_DEEP_TRACE
+  sos_debug_log_info(
+    SOS_DEBUG_MALLOC, "find free %ld in 0x%lX", num_chunks, lists->bitmap);
+#endif
+
+  // a few chunks of about the right size are checked first to limit fragmentation
+  malloc_chunk_t *chunk =
+    search_free_list(reent_ptr, lists->list[index], num_chunks, MALLOC_FREE_LIST_SEARCH_MAX);
+  if (chunk != NULL) {
+    return chunk;
+  }
+
+  // every chunk in a list above index is big enough -- use the smallest one
+  const u32 fit_bitmap = (index + 1 < MALLOC_FREE_LIST_TOTAL)
+                           ? (lists->bitmap & ~((1UL << (index + 1)) - 1))
+                           : 0;
+  if (fit_bitmap) {
+    chunk = lists->list[__builtin_ctz(fit_bitmap)];
+    return is_free_list_chunk_valid(reent_ptr, chunk) ? chunk : NULL;
+  }
+
+  // the rest of the list for the size
+  return search_free_list(
+    reent_ptr, lists->list[index], num_chunks,
+    reent_ptr->procmem_base->size / CONFIG_MALLOC_CHUNK_SIZE);
+}
+
+#if CONFIG_MALLOC_IS_VERIFY_HEAP
 int is_memory_corrupt(struct _reent *reent_ptr) {
   malloc_chunk_t *chunk = (malloc_chunk_t *)&(reent_ptr->procmem_base->base);
 
@@ -75,40 +200,53 @@ int is_memory_corrupt(struct _reent *reent_ptr) {
   }
   return 0;
 }
+#endif
 
 void cleanup_memory(struct _reent *reent_ptr, int release_extra_memory) {
+  malloc_free_lists_t *lists = get_free_lists(reent_ptr);
   malloc_chunk_t *current;
-  malloc_chunk_t *next;
   malloc_chunk_t *last_chunk_if_free = 0;
-  current = (malloc_chunk_t *)&(reent_ptr->procmem_base->base);
-  next = current + (current->header.num_chunks);
-  // if num_chunks is zero -- that is the last chunk
-  while (next->header.num_chunks != 0) {
-    int current_free = malloc_chunk_is_free(current);
-    int next_free = malloc_chunk_is_free(next);
 
-    if (next_free) {
-      last_chunk_if_free = next;
-    } else {
-      last_chunk_if_free = 0;
-    }
+  // free() only combines a chunk with the chunk after it -- combine everything and
+  // rebuild the free lists
+  lists->bitmap = 0;
+  memset(lists->list, 0, sizeof(lists->list));
 
-    if (next_free == -1) {
+  current = (malloc_chunk_t *)&(reent_ptr->procmem_base->base);
+  // if num_chunks is zero -- that is the last chunk
+  while (current->header.num_chunks != 0) {
+    const int current_free = malloc_chunk_is_free(current);
+    if (current_free == -1) {
       return;
     }
 
-    if ((current_free == 1) && (next_free == 1)) { // both blocks are free
-      // combine the free chunks as one larger free chunk
-      malloc_set_chunk_free(
-        current, current->header.num_chunks + next->header.num_chunks);
+    if (current_free == 1) {
+      malloc_chunk_t *next = current + current->header.num_chunks;
+      while (next->header.num_chunks != 0) {
+        const int next_free = malloc_chunk_is_free(next);
+        if (next_free == -1) {
+          return;
+        }
+        const u32 total_chunks = current->header.num_chunks + next->header.num_chunks;
+        if ((next_free == 0) || (total_chunks > 0xffff)) {
+          break;
+        }
+        // combine the free chunks as one larger free chunk
+        malloc_erase_chunk(next);
+        malloc_set_chunk_free(current, total_chunks);
+        next = current + current->header.num_chunks;
+      }
+      free_list_insert(reent_ptr, current);
+      last_chunk_if_free = current;
     } else {
-      current = next;
+      last_chunk_if_free = 0;
     }
-    next = next + next->header.num_chunks;
+    current = current + current->header.num_chunks;
   }
 
-  // next->header.num_chunks is 0 -- next and current are the same
+  // current->header.num_chunks is 0
   if (release_extra_memory && (last_chunk_if_free != 0)) {
+    malloc_free_list_remove(reent_ptr, last_chunk_if_free);
     // do negative _sbrk to give memory back to stack
     ptrdiff_t size =
       -1 * (last_chunk_if_free->header.num_chunks * CONFIG_MALLOC_CHUNK_SIZE);
@@ -117,6 +255,30 @@ void cleanup_memory(struct _reent *reent_ptr, int release_extra_memory) {
   }
 }
 
+void malloc_release_chunk(struct _reent *reent_ptr, malloc_chunk_t *chunk, u16 num_chunks) {
+  malloc_chunk_t *previous = get_previous_free_chunk(reent_ptr, chunk);
+  if (previous != NULL) {
+    const u32 total_chunks = num_chunks + previous->header.num_chunks;
+    if (total_chunks <= 0xffff) {
+      malloc_free_list_remove(reent_ptr, previous);
+      num_chunks = total_chunks;
+      chunk = previous;
+    }
+  }
+
+  malloc_chunk_t *next = chunk + num_chunks;
+  if ((next->header.num_chunks != 0) && (malloc_chunk_is_free(next) == 1)) {
+    const u32 total_chunks = num_chunks + next->header.num_chunks;
+    if (total_chunks <= 0xffff) {
+      malloc_free_list_remove(reent_ptr, next);
+      malloc_erase_chunk(next);
+      num_chunks = total_chunks;
+    }
+  }
+  malloc_set_chunk_free(chunk, num_chunks);
+  free_list_insert(reent_ptr, chunk);
+}
+
 malloc_chunk_t *malloc_chunk_from_addr(void *addr) {
   malloc_chunk_t *chunk;
   chunk = (malloc_chunk_t *)((char *)addr - (sizeof(malloc_chunk_t) - MALLOC_DATA_SIZE));
@@ -191,6 +353,7 @@ void _free_r(struct _reent *reent_ptr, void *addr) {
   }
 
   __malloc_lock(reent_ptr);
+#if CONFIG_MALLOC_IS_VERIFY_HEAP
   // check for corrupt memory
   if (is_memory_corrupt(reent_ptr) < 0) {
     sos_debug_log_error(SOS_DEBUG_MALLOC, "Free Memory Corrupt 0x%lX", (u32)reent_ptr);
@@ -199,6 +362,7 @@ void _free_r(struct _reent *reent_ptr, void *addr) {
     malloc_process_fault(reent_ptr); // this will exit the process
     return;
   }
+#endif
 
   tmp = (unsigned int)chunk - (unsigned int)(&(base->base));
   if (tmp % CONFIG_MALLOC_CHUNK_SIZE) {
@@ -217,8 +381,7 @@ void _free_r(struct _reent *reent_ptr, void *addr) {
   }
 
   // sos_debug_log_info(SOS_DEBUG_MALLOC, "f:%d 0x%X", getpid(), addr);
-  malloc_set_chunk_free(chunk, chunk->header.num_chunks);
-  cleanup_memory(reent_ptr, 0);
+  malloc_release_chunk(reent_ptr, chunk, chunk->header.num_chunks);
 
   __malloc_unlock(reent_ptr);
   SOS_DEBUG_EXIT_TIMER_SCOPE(SOS_DEBUG_MALLOC, _free_r);
@@ -230,8 +393,10 @@ int malloc_get_more_memory(struct _reent *reent_ptr, u32 size, int is_new_heap)
   void *new_heap = 0;
   int extra_bytes = 0;
 
+  const u16 free_lists_chunks = malloc_calc_num_chunks(sizeof(malloc_free_lists_t));
   if (is_new_heap) {
     extra_bytes = CONFIG_MALLOC_SBRK_JUMP_SIZE;
+    size += free_lists_chunks * CONFIG_MALLOC_CHUNK_SIZE;
   }
 
   // jump as size but round up to a multiple of CONFIG_MALLOC_SBRK_JUMP_SIZE
@@ -249,8 +414,21 @@ int malloc_get_more_memory(struct _reent *reent_ptr, u32 size, int is_new_heap)
     return -1;
   } else {
     malloc_chunk_t *chunk;
+    int num_chunks = jump_size / CONFIG_MALLOC_CHUNK_SIZE;
+    // the memory may hold the headers of an earlier heap
+    for (int i = 0; i < (jump_size + extra_bytes) / CONFIG_MALLOC_CHUNK_SIZE; i++) {
+      malloc_erase_chunk((malloc_chunk_t *)new_heap + i);
+    }
     if (is_new_heap) {
+      // the first chunk holds the free lists -- it is never freed
       chunk = new_heap;
+      chunk->header.task_id = 0;
+      chunk->header.num_chunks = free_lists_chunks;
+      chunk->header.actual_size = sizeof(malloc_free_lists_t);
+      cortexm_assign_zero_sum32(chunk, CORTEXM_ZERO_SUM32_COUNT(malloc_chunk_header_t));
+      memset(chunk->memory, 0, sizeof(malloc_free_lists_t));
+      chunk += free_lists_chunks;
+      num_chunks -= free_lists_chunks;
     } else {
       /*
        * After the first call, there is always an extra CONFIG_MALLOC_SBRK_JUMP_SIZE bytes
@@ -262,9 +440,9 @@ int malloc_get_more_memory(struct _reent *reent_ptr, u32 size, int is_new_heap)
        */
       chunk = new_heap - CONFIG_MALLOC_SBRK_JUMP_SIZE;
     }
-    malloc_set_chunk_free(chunk, jump_size / CONFIG_MALLOC_CHUNK_SIZE);
     // mark the last block (heap should have extra room for this)
-    set_last_chunk(chunk + chunk->header.num_chunks);
+    set_last_chunk(chunk + num_chunks);
+    malloc_release_chunk(reent_ptr, chunk, num_chunks);
 #if ENABLE_DEEP_TRACE
     sos_debug_log_info(
       SOS_DEBUG_MALLOC, "set last chunk at %p", chunk + chunk->header.num_chunks);
@@ -321,11 +499,17 @@ void *_malloc_r(struct _reent *reent_ptr, size_t size) {
   }
 
   // Find a free chunk that fits size -- add memory using get_more_memory() as necessary
+  int is_combined = 0;
   do {
 
     chunk = find_free_chunk(reent_ptr, num_chunks);
-    if (chunk == NULL) {
+    if ((chunk == NULL) && (is_combined == 0)) {
+      // combine neighboring free chunks (and repair the lists) before growing the heap
+      cleanup_memory(reent_ptr, 0);
+      is_combined = 1;
+    } else if (chunk == NULL) {
 
+#if CONFIG_MALLOC_IS_VERIFY_HEAP
       // See if the memory is corrupt
       if (is_memory_corrupt(reent_ptr)) {
         sos_debug_log_error(SOS_DEBUG_MALLOC, "Memory Corrupt %p", reent_ptr);
@@ -337,6 +521,7 @@ void *_malloc_r(struct _reent *reent_ptr, size_t size) {
         sos_handle_event(SOS_EVENT_MALLOC_FAILED, "ENOMEM2");
         return NULL;
       }
+#endif
 
       // Try to get more memory
       if (malloc_get_more_memory(reent_ptr, size, 0) < 0) {
@@ -355,15 +540,18 @@ void *_malloc_r(struct _reent *reent_ptr, size_t size) {
 
       // See if the memory will fit in this chunk
       int diff_chunks = chunk->header.num_chunks - num_chunks;
-      if (diff_chunks) {
-        malloc_set_chunk_free(chunk + num_chunks, diff_chunks);
-      } else if (chunk->header.num_chunks < num_chunks) {
+      if (diff_chunks < 0) {
         __malloc_unlock(reent_ptr);
         errno = ENOMEM;
         sos_debug_log_info(SOS_DEBUG_MALLOC, "ENOMEM %s():%d<-", __FUNCTION__, __LINE__);
         sos_handle_event(SOS_EVENT_MALLOC_FAILED, NULL);
         return NULL;
       }
+      malloc_free_list_remove(reent_ptr, chunk);
+      if (diff_chunks) {
+        malloc_set_chunk_free(chunk + num_chunks, diff_chunks);
+        free_list_insert(reent_ptr, chunk + num_chunks);
+      }
       malloc_set_chunk_used(reent_ptr, chunk, num_chunks, size);
       alloc = chunk->memory;
     }
@@ -400,6 +588,12 @@ void malloc_set_chunk_free(malloc_chunk_t *chunk, u16 free_chunks) {
   cortexm_assign_zero_sum32(chunk, CORTEXM_ZERO_SUM32_COUNT(malloc_chunk_header_t));
 }
 
+// free() trusts any valid free header that ends where the freed chunk starts --
+// a chunk that is combined into another must not keep one
+void malloc_erase_chunk(malloc_chunk_t *chunk) {
+  memset(&chunk->header, 0, sizeof(malloc_chunk_header_t));
+}
+
 void set_last_chunk(malloc_chunk_t *chunk) {
   chunk->header.task_id = task_get_current();
   chunk->header.num_chunks = 0;
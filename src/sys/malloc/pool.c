@@ -0,0 +1,243 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <errno.h>
+#include <reent.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cortexm/cortexm.h"
+#include "cortexm/task.h"
+#include "sos/pool.h"
+
+// the start of each piece of memory given to the pool -- the objects follow the
+// bitmap of the ones in use
+typedef struct pool_region {
+  struct pool_region *next;
+  u32 start; // first object
+  u32 count;
+  u32 used[];
+} pool_region_t;
+
+typedef struct {
+  sos_pool_t *pool;
+  pool_region_t *region; // new memory from sos_pool_add()
+  void *first;
+  void *last;
+  u32 count;
+  int result; // zero or an errno value
+} pool_args_t;
+
+static void pool_alloc(pool_args_t *args);
+static void pool_free(pool_args_t *args);
+static void svcall_pool_alloc(void *args) MCU_ROOT_EXEC_CODE;
+static void svcall_pool_free(void *args) MCU_ROOT_EXEC_CODE;
+static void root_pool_alloc(pool_args_t *args) MCU_ROOT_EXEC_CODE;
+static void root_pool_free(pool_args_t *args) MCU_ROOT_EXEC_CODE;
+static pool_region_t *find_region(sos_pool_t *pool, void *object, u32 *index)
+  MCU_ROOT_EXEC_CODE;
+
+static u32 get_header_size(u32 count) {
+  const u32 size = sizeof(pool_region_t) + ((count + 31) / 32) * sizeof(u32);
+  return (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+}
+
+void sos_pool_init(
+  sos_pool_t *pool,
+  u32 object_size,
+  u32 grow_count,
+  struct _reent *reent) {
+  pool->free = NULL;
+  pool->reent = reent;
+  pool->object_size = SOS_POOL_OBJECT_SIZE(object_size);
+  pool->grow_count = grow_count;
+  pool->total = 0;
+  pool->used = 0;
+  pool->region = NULL;
+}
+
+int sos_pool_add(sos_pool_t *pool, void *memory, u32 size) {
+  u32 count = size / pool->object_size;
+  while ((count > 0) && (get_header_size(count) + count * pool->object_size > size)) {
+    count--;
+  }
+  if (count == 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  u8 *first = (u8 *)memory + get_header_size(count);
+  pool_region_t *region = memory;
+  region->next = NULL;
+  region->start = (u32)first;
+  region->count = count;
+  memset(region->used, 0, ((count + 31) / 32) * sizeof(u32));
+
+  // link the objects before handing them to the pool all at once
+  u8 *object = first;
+  for (u32 i = 0; i < count - 1; i++) {
+    *(void **)object = object + pool->object_size;
+    object += pool->object_size;
+  }
+
+  pool_args_t args = {
+    .pool = pool,
+    .region = region,
+    .first = first,
+    .last = object,
+    .count = count};
+  pool_free(&args);
+  if (args.result) {
+    errno = args.result;
+    return -1;
+  }
+  return count;
+}
+
+void *sos_pool_alloc(sos_pool_t *pool) {
+  pool_args_t args = {.pool = pool};
+  pool_alloc(&args);
+
+  // the heap can only be used in thread mode
+  if ((args.first == NULL) && (pool->grow_count > 0) && (__get_IPSR() == 0)) {
+    struct _reent *reent =
+      (pool->reent != NULL) ? pool->reent : sos_task_table[0].global_reent;
+    const u32 size = pool->object_size * pool->grow_count;
+    void *memory = _malloc_r(reent, size);
+    if (memory == NULL) {
+      // errno is set by malloc
+      return NULL;
+    }
+    sos_pool_add(pool, memory, size);
+    pool_alloc(&args);
+  }
+
+  if (args.first == NULL) {
+    errno = ENOMEM;
+  }
+  return args.first;
+}
+
+int sos_pool_free(sos_pool_t *pool, void *object) {
+  if (object == NULL) {
+    return 0;
+  }
+  pool_args_t args = {.pool = pool, .first = object, .last = object, .count = 0};
+  pool_free(&args);
+  if (args.result) {
+    errno = args.result;
+    return -1;
+  }
+  return 0;
+}
+
+// exception handlers (root code) can't use SVCall -- they change the list directly
+void pool_alloc(pool_args_t *args) {
+  if (__get_IPSR() != 0) {
+    root_pool_alloc(args);
+  } else {
+    cortexm_svcall(svcall_pool_alloc, args);
+  }
+}
+
+void pool_free(pool_args_t *args) {
+  if (__get_IPSR() != 0) {
+    root_pool_free(args);
+  } else {
+    cortexm_svcall(svcall_pool_free, args);
+  }
+}
+
+void svcall_pool_alloc(void *args) {
+  CORTEXM_SVCALL_ENTER();
+  pool_args_t *p = args;
+  // the first word of a free object is read in root mode
+  if (
+    (task_validate_memory(p->pool, sizeof(sos_pool_t)) < 0)
+    || ((p->pool->free != NULL)
+        && (task_validate_memory(p->pool->free, p->pool->object_size) < 0))) {
+    p->first = NULL;
+    return;
+  }
+  root_pool_alloc(p);
+}
+
+void svcall_pool_free(void *args) {
+  CORTEXM_SVCALL_ENTER();
+  pool_args_t *p = args;
+  // the list is linked in root mode -- a thread can only link memory it owns
+  if (task_validate_memory(p->pool, sizeof(sos_pool_t)) < 0) {
+    p->result = EPERM;
+    return;
+  }
+  if (p->region != NULL) {
+    const u32 size = (u32)p->last + p->pool->object_size - (u32)p->region;
+    if (task_validate_memory(p->region, size) < 0) {
+      p->result = EPERM;
+      return;
+    }
+  } else if (task_validate_memory(p->first, p->pool->object_size) < 0) {
+    p->result = EPERM;
+    return;
+  }
+  root_pool_free(p);
+}
+
+void root_pool_alloc(pool_args_t *args) {
+  sos_pool_t *pool = args->pool;
+  const u32 primask = cortexm_root_enter_critical();
+  args->first = pool->free;
+  if (args->first != NULL) {
+    u32 index;
+    pool_region_t *region = find_region(pool, args->first, &index);
+    if (region == NULL) {
+      // the free list is corrupt
+      args->first = NULL;
+    } else {
+      region->used[index / 32] |= 1 << (index % 32);
+      pool->free = *(void **)args->first;
+      pool->used++;
+    }
+  }
+  cortexm_root_exit_critical(primask);
+}
+
+void root_pool_free(pool_args_t *args) {
+  sos_pool_t *pool = args->pool;
+  const u32 primask = cortexm_root_enter_critical();
+  if (args->region != NULL) {
+    // new objects from sos_pool_add()
+    args->region->next = pool->region;
+    pool->region = args->region;
+    pool->total += args->count;
+  } else {
+    // don't write through a pointer the pool never handed out or free an object twice
+    u32 index;
+    pool_region_t *region = find_region(pool, args->first, &index);
+    if ((region == NULL) || ((region->used[index / 32] & (1 << (index % 32))) == 0)) {
+      cortexm_root_exit_critical(primask);
+      args->result = EINVAL;
+      return;
+    }
+    region->used[index / 32] &= ~(1 << (index % 32));
+    pool->used--;
+  }
+  *(void **)args->last = pool->free;
+  pool->free = args->first;
+  cortexm_root_exit_critical(primask);
+}
+
+pool_region_t *find_region(sos_pool_t *pool, void *object, u32 *index) {
+  const u32 address = (u32)object;
+  for (pool_region_t *region = pool->region; region != NULL; region = region->next) {
+    const u32 offset = address - region->start;
+    if ((address >= region->start) && (offset < region->count * pool->object_size)) {
+      if (offset % pool->object_size) {
+        // inside an object
+        return NULL;
+      }
+      *index = offset / pool->object_size;
+      return region;
+    }
+  }
+  return NULL;
+}
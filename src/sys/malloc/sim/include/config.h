@@ -0,0 +1,13 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_CONFIG_H_
+#define SIM_CONFIG_H_
+
+// host pointers are 8 bytes -- a free chunk holds two links and a back pointer
+#define CONFIG_MALLOC_CHUNK_SIZE 64
+#define CONFIG_MALLOC_SBRK_JUMP_SIZE 128
+#if !defined CONFIG_MALLOC_IS_VERIFY_HEAP
+#define CONFIG_MALLOC_IS_VERIFY_HEAP 0
+#endif
+
+#endif /* SIM_CONFIG_H_ */
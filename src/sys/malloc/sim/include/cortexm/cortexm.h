@@ -0,0 +1,45 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_CORTEXM_CORTEXM_H_
+#define SIM_CORTEXM_CORTEXM_H_
+
+#include <sdk/types.h>
+
+#define CORTEXM_ZERO_SUM32_COUNT(x) (sizeof(x) / sizeof(u32))
+
+static inline void cortexm_assign_zero_sum32(void *data, int count) {
+  u32 *words = data;
+  u32 sum = 0;
+  for (int i = 0; i < count - 1; i++) {
+    sum += words[i];
+  }
+  words[count - 1] = 0 - sum;
+}
+
+static inline int cortexm_verify_zero_sum32(void *data, int count) {
+  u32 *words = data;
+  u32 sum = 0;
+  for (int i = 0; i < count; i++) {
+    sum += words[i];
+  }
+  return sum == 0;
+}
+
+// pool_sim: exception number (0 is thread mode) and a service call that runs
+// the handler directly
+extern u32 sim_ipsr;
+extern int sim_svcall_count;
+
+static inline u32 __get_IPSR() { return sim_ipsr; }
+
+static inline void cortexm_svcall(void (*call)(void *), void *args) {
+  sim_svcall_count++;
+  call(args);
+}
+
+#define CORTEXM_SVCALL_ENTER()
+
+static inline u32 cortexm_root_enter_critical() { return 0; }
+static inline void cortexm_root_exit_critical(u32 primask) { (void)primask; }
+
+#endif /* SIM_CORTEXM_CORTEXM_H_ */
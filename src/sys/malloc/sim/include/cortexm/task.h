@@ -0,0 +1,32 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// the heap belongs to the main thread of process 1 -- it owns all memory
+
+#ifndef SIM_CORTEXM_TASK_H_
+#define SIM_CORTEXM_TASK_H_
+
+static inline int task_get_current() { return 1; }
+static inline int task_thread_asserted(int id) {
+  (void)id;
+  return 0;
+}
+static inline int task_get_pid(int id) {
+  (void)id;
+  return 1;
+}
+
+struct _reent;
+
+typedef struct {
+  struct _reent *global_reent;
+} task_t;
+
+extern task_t sos_task_table[];
+
+static inline int task_validate_memory(void *target, unsigned int size) {
+  (void)target;
+  (void)size;
+  return 0;
+}
+
+#endif /* SIM_CORTEXM_TASK_H_ */
@@ -0,0 +1,29 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// the parts of the newlib reentrancy structure used by the heap
+
+#ifndef SIM_REENT_H_
+#define SIM_REENT_H_
+
+#include <stddef.h>
+
+#include <sdk/types.h>
+
+typedef struct {
+  u32 size;
+  int proc_mem_lock;
+  u32 base;
+} proc_mem_t;
+
+struct _reent {
+  proc_mem_t *procmem_base;
+};
+
+extern struct _reent *_REENT;
+
+void *_sbrk_r(struct _reent *reent_ptr, ptrdiff_t incr);
+void *_malloc_r(struct _reent *reent_ptr, size_t size);
+void _free_r(struct _reent *reent_ptr, void *addr);
+void *_realloc_r(struct _reent *reent_ptr, void *addr, size_t size);
+
+#endif /* SIM_REENT_H_ */
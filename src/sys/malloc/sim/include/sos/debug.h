@@ -0,0 +1,32 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// errors are counted -- warnings and info are dropped
+
+#ifndef SIM_SOS_DEBUG_H_
+#define SIM_SOS_DEBUG_H_
+
+#include <stdio.h>
+
+extern int sim_heap_errors;
+
+#define SOS_DEBUG_MALLOC 0
+#define SOS_DEBUG_SYS 0
+
+#define sos_debug_log_error(...)                                                         \
+  do {                                                                                   \
+    printf("%s:%d: error logged\n", __FILE__, __LINE__);                                 \
+    sim_heap_errors++;                                                                   \
+  } while (0)
+#define sos_debug_log_warning(...)                                                       \
+  do {                                                                                   \
+  } while (0)
+#define sos_debug_log_info(...)                                                          \
+  do {                                                                                   \
+  } while (0)
+#define sos_debug_log_datum(...)                                                         \
+  do {                                                                                   \
+  } while (0)
+#define SOS_DEBUG_ENTER_TIMER_SCOPE(name)
+#define SOS_DEBUG_EXIT_TIMER_SCOPE(flags, name)
+
+#endif /* SIM_SOS_DEBUG_H_ */
@@ -0,0 +1,12 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_SOS_SOS_H_
+#define SIM_SOS_SOS_H_
+
+#define SOS_EVENT_MALLOC_FAILED 1
+#define SOS_EVENT_FATAL 2
+
+void sos_handle_event(int event, void *args);
+static inline void sos_trace_stack(unsigned long count) { (void)count; }
+
+#endif /* SIM_SOS_SOS_H_ */
@@ -0,0 +1,8 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_SYS_UNISTD_H_
+#define SIM_SYS_UNISTD_H_
+
+#include <unistd.h>
+
+#endif /* SIM_SYS_UNISTD_H_ */
@@ -0,0 +1,8 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_TRACE_H_
+#define SIM_TRACE_H_
+
+#define SOS_TRACE_CRITICAL(message)
+
+#endif /* SIM_TRACE_H_ */
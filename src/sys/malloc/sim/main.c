@@ -0,0 +1,267 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "sos/sos.h"
+#include "sys/malloc/malloc_local.h"
+
+#define HEAP_SIZE (8 * 1024 * 1024)
+#define BLOCK_TOTAL 4096
+
+int sim_heap_errors;
+static int failures;
+static int malloc_failed_count;
+
+static proc_mem_t *proc_mem;
+static struct _reent reent;
+struct _reent *_REENT = &reent;
+
+#define CHECK(x)                                                                         \
+  do {                                                                                   \
+    if (!(x)) {                                                                          \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #x);                       \
+      failures++;                                                                        \
+      return;                                                                            \
+    }                                                                                    \
+  } while (0)
+
+void __malloc_lock(struct _reent *ptr) { (void)ptr; }
+void __malloc_unlock(struct _reent *ptr) { (void)ptr; }
+
+void sos_handle_event(int event, void *args) {
+  (void)args;
+  if (event == SOS_EVENT_MALLOC_FAILED) {
+    malloc_failed_count++;
+  }
+}
+
+void *_sbrk_r(struct _reent *reent_ptr, ptrdiff_t incr) {
+  proc_mem_t *base = reent_ptr->procmem_base;
+  if (base->size + incr > HEAP_SIZE - sizeof(proc_mem_t)) {
+    return NULL;
+  }
+  void *result = (char *)&base->base + base->size;
+  base->size += incr;
+  return result;
+}
+
+static void reset() {
+  // the kernel keeps heap addresses in u32 -- map the heap where they fit
+  if (proc_mem == NULL) {
+    proc_mem =
+      mmap(NULL, HEAP_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+  }
+  memset(proc_mem, 0, sizeof(proc_mem_t));
+  reent.procmem_base = proc_mem;
+}
+
+static void fill(void *block, size_t size, int seed) {
+  for (size_t i = 0; i < size; i++) {
+    ((u8 *)block)[i] = (u8)(seed + i);
+  }
+}
+
+static int is_filled(const void *block, size_t size, int seed) {
+  for (size_t i = 0; i < size; i++) {
+    if (((const u8 *)block)[i] != (u8)(seed + i)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// the chunks tile the heap and every free chunk is on the list for its size
+static void check_heap() {
+  malloc_chunk_t *first = (malloc_chunk_t *)&proc_mem->base;
+  malloc_free_lists_t *lists = (malloc_free_lists_t *)first->memory;
+  malloc_chunk_t *chunk = first;
+  int free_count = 0;
+  int previous_free = 0;
+  while (chunk->header.num_chunks != 0) {
+    CHECK(
+      (u8 *)chunk < (u8 *)&proc_mem->base + proc_mem->size);
+    const int is_free = malloc_chunk_is_free(chunk);
+    CHECK(is_free != -1);
+    if (is_free) {
+      // free neighbors are always merged
+      CHECK(previous_free == 0);
+      free_count++;
+    }
+    previous_free = is_free;
+    chunk += chunk->header.num_chunks;
+  }
+
+  int list_count = 0;
+  for (int i = 0; i < MALLOC_FREE_LIST_TOTAL; i++) {
+    CHECK(((lists->bitmap >> i) & 1) == (lists->list[i] != NULL));
+    for (malloc_chunk_t *entry = lists->list[i]; entry != NULL;
+         entry = ((malloc_free_link_t *)entry->memory)->next) {
+      CHECK(malloc_chunk_is_free(entry) == 1);
+      CHECK((31 - __builtin_clz(entry->header.num_chunks)) == i);
+      list_count++;
+    }
+  }
+  CHECK(list_count == free_count);
+  CHECK(sim_heap_errors == 0);
+}
+
+static void test_random() {
+  void *block[BLOCK_TOTAL] = {0};
+  size_t size[BLOCK_TOTAL];
+  const int live = 1000;
+
+  reset();
+  srand(1);
+  for (int iteration = 0; iteration < 1000000; iteration++) {
+    const int i = rand() % live;
+    if (block[i] != NULL) {
+      CHECK(is_filled(block[i], size[i], i));
+      if (rand() % 4 == 0) {
+        const size_t new_size = rand() % 700 + 1;
+        void *moved = _realloc_r(&reent, block[i], new_size);
+        CHECK(moved != NULL);
+        const size_t kept = new_size < size[i] ? new_size : size[i];
+        CHECK(is_filled(moved, kept, i));
+        block[i] = moved;
+        size[i] = new_size;
+        fill(block[i], size[i], i);
+      } else {
+        _free_r(&reent, block[i]);
+        block[i] = NULL;
+      }
+    } else {
+      size[i] = rand() % ((rand() % 8) == 0 ? 3000 : 200) + 1;
+      block[i] = _malloc_r(&reent, size[i]);
+      CHECK(block[i] != NULL);
+      fill(block[i], size[i], i);
+    }
+
+    if ((iteration % 1000) == 0) {
+      const int failures_before = failures;
+      check_heap();
+      if (failures != failures_before) {
+        printf("random: failed at iteration %d\n", iteration);
+        return;
+      }
+    }
+  }
+
+  // freeing everything leaves one free chunk that free((void*)1) gives back
+  for (int i = 0; i < live; i++) {
+    _free_r(&reent, block[i]);
+  }
+  check_heap();
+  _free_r(&reent, (void *)1);
+  check_heap();
+  CHECK(proc_mem->size <= 4 * CONFIG_MALLOC_SBRK_JUMP_SIZE);
+  CHECK(malloc_failed_count == 0);
+}
+
+// an exhausted heap fails cleanly and is usable again after a free
+static void test_exhausted() {
+  void *block[BLOCK_TOTAL];
+  int count = 0;
+  reset();
+  while (count < BLOCK_TOTAL) {
+    block[count] = _malloc_r(&reent, 4096);
+    if (block[count] == NULL) {
+      break;
+    }
+    count++;
+  }
+  CHECK(count < BLOCK_TOTAL);
+  CHECK(malloc_failed_count > 0);
+  // "sbrk has no more memory"
+  sim_heap_errors = 0;
+  check_heap();
+
+  _free_r(&reent, block[count / 2]);
+  CHECK(_malloc_r(&reent, 4096) != NULL);
+  check_heap();
+  malloc_failed_count = 0;
+}
+
+static void churn(void **block, int live, int loops) {
+  for (int n = 0; n < loops; n++) {
+    const int i = rand() % live;
+    _free_r(&reent, block[i]);
+    block[i] = _malloc_r(&reent, rand() % 200 + 1);
+    if ((n % 1000) == 0) {
+      const int failures_before = failures;
+      check_heap();
+      if (failures != failures_before) {
+        printf("churn: failed at %d\n", n);
+        return;
+      }
+    }
+  }
+}
+
+// a new heap starts on memory that still holds the headers of an earlier heap
+static void test_stale_heap() {
+  static void *block[BLOCK_TOTAL];
+  const int live = 1000;
+  srand(3);
+  for (int pass = 0; pass < 2; pass++) {
+    reset();
+    for (int i = 0; i < live; i++) {
+      block[i] = _malloc_r(&reent, rand() % 200 + 1);
+      CHECK(block[i] != NULL);
+    }
+    churn(block, live, 100000);
+  }
+}
+
+static double now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// time for a free/malloc pair as the number of live blocks grows
+static void bench() {
+  static void *block[BLOCK_TOTAL];
+  const int live_list[] = {10, 100, 1000, 4000};
+  for (unsigned int k = 0; k < sizeof(live_list) / sizeof(live_list[0]); k++) {
+    const int live = live_list[k];
+    const int loops = 200000;
+    u32 requested = 0;
+    reset();
+    srand(2);
+    for (int i = 0; i < live; i++) {
+      const size_t size = rand() % 200 + 1;
+      block[i] = _malloc_r(&reent, size);
+      requested += size;
+    }
+
+    const double start = now_ns();
+    for (int n = 0; n < loops; n++) {
+      const int i = rand() % live;
+      _free_r(&reent, block[i]);
+      block[i] = _malloc_r(&reent, rand() % 200 + 1);
+    }
+    const double pair_ns = (now_ns() - start) / loops;
+
+    printf(
+      "%4d live blocks: free/malloc %.0f ns, heap %lu bytes for %lu requested\n", live,
+      pair_ns, (unsigned long)proc_mem->size, (unsigned long)requested);
+  }
+}
+
+int main() {
+  setvbuf(stdout, NULL, _IONBF, 0);
+  test_random();
+  test_stale_heap();
+  test_exhausted();
+  if (failures) {
+    printf("FAILED (%d)\n", failures);
+    return 1;
+  }
+  bench();
+  printf("PASSED\n");
+  return 0;
+}
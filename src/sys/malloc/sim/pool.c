@@ -0,0 +1,225 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "cortexm/task.h"
+#include "sos/pool.h"
+#include "sos/sos.h"
+#include "sys/malloc/malloc_local.h"
+
+#define HEAP_SIZE (1024 * 1024)
+#define OBJECT_SIZE 24
+#define GROW_COUNT 5
+#define OBJECT_TOTAL 64
+#define FUZZ_ROUNDS 20000
+
+u32 sim_ipsr;
+int sim_svcall_count;
+int sim_heap_errors;
+static int failures;
+
+static struct _reent reent;
+struct _reent *_REENT = &reent;
+task_t sos_task_table[1] = {{&reent}};
+
+#define CHECK(x)                                                                         \
+  do {                                                                                   \
+    if (!(x)) {                                                                          \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #x);                       \
+      failures++;                                                                        \
+      return;                                                                            \
+    }                                                                                    \
+  } while (0)
+
+void __malloc_lock(struct _reent *ptr) { (void)ptr; }
+void __malloc_unlock(struct _reent *ptr) { (void)ptr; }
+void sos_handle_event(int event, void *args) {
+  (void)event;
+  (void)args;
+}
+
+void *_sbrk_r(struct _reent *reent_ptr, ptrdiff_t incr) {
+  proc_mem_t *base = reent_ptr->procmem_base;
+  if (base->size + incr > HEAP_SIZE - sizeof(proc_mem_t)) {
+    return NULL;
+  }
+  void *result = (char *)&base->base + base->size;
+  base->size += incr;
+  return result;
+}
+
+// the pool keeps object addresses in u32 -- map the memory where they fit
+static void *map_memory(u32 size) {
+  return mmap(
+    NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+}
+
+static void reset() {
+  static proc_mem_t *proc_mem;
+  if (proc_mem == NULL) {
+    proc_mem = map_memory(HEAP_SIZE);
+  }
+  memset(proc_mem, 0, sizeof(proc_mem_t));
+  reent.procmem_base = proc_mem;
+}
+
+static int free_errno(sos_pool_t *pool, void *object) {
+  errno = 0;
+  return sos_pool_free(pool, object) < 0 ? errno : 0;
+}
+
+// objects from several grow regions with heap memory in between
+static void test_grow() {
+  static u8 *object[OBJECT_TOTAL];
+  void *between[OBJECT_TOTAL / GROW_COUNT + 2];
+  int between_count = 0;
+  sos_pool_t pool = SOS_POOL_INITIALIZER(OBJECT_SIZE, GROW_COUNT);
+  reset();
+
+  for (int i = 0; i < OBJECT_TOTAL; i++) {
+    if (pool.used == pool.total) {
+      // the next grow region doesn't follow the last one
+      between[between_count++] = _malloc_r(&reent, OBJECT_SIZE * 3);
+    }
+    object[i] = sos_pool_alloc(&pool);
+    CHECK(object[i] != NULL);
+    CHECK(((u32)object[i] & 0x03) == 0);
+    memset(object[i], i, OBJECT_SIZE);
+  }
+  CHECK(pool.used == OBJECT_TOTAL);
+  CHECK(pool.total >= OBJECT_TOTAL);
+  CHECK(between_count > 1);
+  between[between_count++] = _malloc_r(&reent, OBJECT_SIZE * 3);
+  for (int i = 0; i < OBJECT_TOTAL; i++) {
+    for (int j = 0; j < OBJECT_SIZE; j++) {
+      CHECK(object[i][j] == (u8)i);
+    }
+  }
+
+  // heap memory between and after regions, inside an object, the region header
+  for (int i = 0; i < between_count; i++) {
+    CHECK(free_errno(&pool, between[i]) == EINVAL);
+  }
+  for (int i = 0; i < OBJECT_TOTAL; i++) {
+    CHECK(free_errno(&pool, object[i] + 4) == EINVAL);
+    CHECK(free_errno(&pool, object[i] + OBJECT_SIZE / 2) == EINVAL);
+  }
+  CHECK(free_errno(&pool, pool.region) == EINVAL);
+  CHECK(pool.used == OBJECT_TOTAL);
+
+  // every object once -- the second free of each is rejected
+  for (int i = 0; i < OBJECT_TOTAL; i++) {
+    CHECK(free_errno(&pool, object[i]) == 0);
+    CHECK(free_errno(&pool, object[i]) == EINVAL);
+  }
+  CHECK(pool.used == 0);
+
+  // the free list is intact: each object is handed out once
+  const u16 total = pool.total;
+  for (int i = 0; i < total; i++) {
+    object[i] = sos_pool_alloc(&pool);
+    CHECK(object[i] != NULL);
+    for (int j = 0; j < i; j++) {
+      CHECK(object[j] != object[i]);
+    }
+  }
+  CHECK(pool.total == total);
+}
+
+// memory added by the caller -- too small for one object and the header is rejected
+static void test_add() {
+  u64 *memory = map_memory(64 * sizeof(u64));
+  sos_pool_t pool;
+  sos_pool_init(&pool, OBJECT_SIZE, 0, NULL);
+  errno = 0;
+  CHECK(sos_pool_add(&pool, memory, OBJECT_SIZE) < 0);
+  CHECK(errno == EINVAL);
+
+  const int count = sos_pool_add(&pool, memory, 64 * sizeof(u64));
+  CHECK(count > 0);
+  CHECK(count < (int)(64 * sizeof(u64) / OBJECT_SIZE));
+  CHECK(pool.total == count);
+  for (int i = 0; i < count; i++) {
+    u8 *object = sos_pool_alloc(&pool);
+    CHECK((object >= (u8 *)memory) && (object + OBJECT_SIZE <= (u8 *)(memory + 64)));
+    memset(object, 0xAA, OBJECT_SIZE);
+  }
+  errno = 0;
+  CHECK(sos_pool_alloc(&pool) == NULL);
+  CHECK(errno == ENOMEM);
+
+  // root code uses the list directly and never grows the pool
+  sim_ipsr = 15;
+  const int svcall_count = sim_svcall_count;
+  sos_pool_t grow_pool = SOS_POOL_INITIALIZER(OBJECT_SIZE, GROW_COUNT);
+  CHECK(sos_pool_alloc(&grow_pool) == NULL);
+  CHECK(grow_pool.total == 0);
+  CHECK(sim_svcall_count == svcall_count);
+  sim_ipsr = 0;
+}
+
+// random allocs and frees (some of them bad) against a list of the objects in use
+static void fuzz() {
+  static u8 *used[OBJECT_TOTAL];
+  static u8 *freed[OBJECT_TOTAL];
+  int used_count = 0;
+  int freed_count = 0;
+  sos_pool_t pool = SOS_POOL_INITIALIZER(OBJECT_SIZE, GROW_COUNT);
+  reset();
+
+  for (int round = 0; round < FUZZ_ROUNDS; round++) {
+    const int op = rand() % 4;
+    if ((op == 0) && (used_count < OBJECT_TOTAL)) {
+      u8 *object = sos_pool_alloc(&pool);
+      CHECK(object != NULL);
+      for (int i = 0; i < used_count; i++) {
+        CHECK(used[i] != object);
+      }
+      memset(object, used_count, OBJECT_SIZE);
+      used[used_count++] = object;
+      for (int i = 0; i < freed_count; i++) {
+        if (freed[i] == object) {
+          freed[i] = freed[--freed_count];
+          break;
+        }
+      }
+    } else if ((op == 1) && used_count) {
+      const int i = rand() % used_count;
+      CHECK(free_errno(&pool, used[i]) == 0);
+      if (freed_count < OBJECT_TOTAL) {
+        freed[freed_count++] = used[i];
+      }
+      used[i] = used[--used_count];
+      for (int j = i; j < used_count; j++) {
+        // the objects still in use keep what was written
+        memset(used[j], j, OBJECT_SIZE);
+      }
+    } else if ((op == 2) && freed_count) {
+      CHECK(free_errno(&pool, freed[rand() % freed_count]) == EINVAL);
+    } else if (used_count) {
+      u8 *inside = used[rand() % used_count] + 1 + rand() % (OBJECT_SIZE - 1);
+      CHECK(free_errno(&pool, inside) == EINVAL);
+    }
+    CHECK(pool.used == used_count);
+    for (int i = 0; i < used_count; i++) {
+      CHECK(used[i][0] == (u8)i && used[i][OBJECT_SIZE - 1] == (u8)i);
+    }
+  }
+}
+
+int main() {
+  srand(1);
+  test_grow();
+  test_add();
+  fuzz();
+  if (failures || sim_heap_errors) {
+    printf("FAILED (%d)\n", failures + sim_heap_errors);
+    return 1;
+  }
+  printf("PASSED\n");
+  return 0;
+}
@@ -82,6 +82,7 @@
 #include "../scheduler/scheduler_timing.h"
 #include "mqueue.h"
 #include "sos/debug.h"
+#include "sos/pool.h"
 
 //#define MSG_RD_ONLY 0
 //#define MSG_RDWR 1
@@ -127,7 +128,10 @@ typedef struct {
   void *next;
 } mq_list_t;
 
+#define MQ_POOL_GROW_COUNT 4
+
 static mq_list_t *mq_first = NULL;
+static sos_pool_t mq_pool = SOS_POOL_INITIALIZER(sizeof(mq_list_t), MQ_POOL_GROW_COUNT);
 
 static int mq_entry_size(const mq_t *mq) { return sizeof(struct message) + mq->max_size; }
 
@@ -174,30 +178,31 @@ static void *mq_message_data(struct message *msg) {
 }
 
 static mq_t *mq_find_free() {
-  mq_list_t *entry;
-  mq_list_t *new_entry;
-  mq_list_t *last_entry;
-  last_entry = 0;
-  for (entry = mq_first; entry != 0; entry = entry->next) {
-    last_entry = entry;
-    if (entry->mq.msg_table == 0) {
-      return &entry->mq;
-    }
-  }
-
-  // no free message queues
-  new_entry = _malloc_r(sos_task_table[0].global_reent, sizeof(mq_list_t));
+  mq_list_t *new_entry = sos_pool_alloc(&mq_pool);
   if (new_entry == 0) {
     return 0;
   }
+  memset(new_entry, 0, sizeof(mq_list_t));
+  new_entry->next = mq_first;
+  mq_first = new_entry;
+  return &new_entry->mq;
+}
 
-  if (last_entry == 0) {
-    mq_first = new_entry;
-  } else {
-    last_entry->next = new_entry;
+static void mq_delete(mq_t *mq) {
+  mq_list_t *entry;
+  mq_list_t *last_entry = 0;
+  for (entry = mq_first; entry != 0; entry = entry->next) {
+    if (&entry->mq == mq) {
+      if (last_entry == 0) {
+        mq_first = entry->next;
+      } else {
+        last_entry->next = entry->next;
+      }
+      sos_pool_free(&mq_pool, entry);
+      return;
+    }
+    last_entry = entry;
   }
-  new_entry->next = 0;
-  return &new_entry->mq;
 }
 
 static void mq_init_table(mq_t *mq) {
@@ -278,6 +283,7 @@ static void mq_destroy(mq_t *mq) {
     pthread_mutex_destroy(&mq->mutex);
     pthread_cond_destroy(&mq->send_cond);
     pthread_cond_destroy(&mq->recv_cond);
+    mq_delete(mq);
   }
 }
 
@@ -472,12 +478,13 @@ mqd_t mq_open(
     struct _reent *reent_ptr = sos_task_table[0].global_reent;
     new_mq = mq_find_free();
     if (new_mq == NULL) {
-      // errno is set by malloc
+      // errno is set by the pool
       return -1;
     }
 
     // initialize the mutex
     if (mq_init_mutex(new_mq) < 0) {
+      mq_delete(new_mq);
       return -1;
     }
 
@@ -502,6 +509,7 @@ mqd_t mq_open(
     new_mq->msg_table = _calloc_r(
       message_reent_ptr, new_mq->max_msgs, (new_mq->max_size + sizeof(struct message)));
     if (new_mq->msg_table == NULL) {
+      mq_delete(new_mq);
       return -1;
     }
 
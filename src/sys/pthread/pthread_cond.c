@@ -107,7 +107,10 @@ int pthread_cond_broadcast(pthread_cond_t *cond) {
 /*! \cond */
 void svcall_cond_signal(void *args) {
   CORTEXM_SVCALL_ENTER();
-  int id = *((int *)args);
+  const int id = scheduler_get_highest_priority_blocked(args);
+  if (id == -1) {
+    return;
+  }
   scheduler_root_assert_active(id, SCHEDULER_UNBLOCK_COND);
   scheduler_root_update_on_wake(id, task_get_priority(id));
 }
@@ -120,8 +123,6 @@ void svcall_cond_signal(void *args) {
  * - EINVAL: cond is NULL or not initialized
  */
 int pthread_cond_signal(pthread_cond_t *cond) {
-  int new_thread;
-
   if (cond == NULL) {
     errno = EINVAL;
     return -1;
@@ -132,11 +133,8 @@ int pthread_cond_signal(pthread_cond_t *cond) {
     return -1;
   }
 
-  new_thread = scheduler_get_highest_priority_blocked(cond);
-
-  if (new_thread != -1) {
-    cortexm_svcall(svcall_cond_signal, &new_thread);
-  }
+  // wake the task at the head of the condition's wait queue (if any)
+  cortexm_svcall(svcall_cond_signal, cond);
 
   return 0;
 }
@@ -20,6 +20,7 @@
 
 #include "../scheduler/scheduler_root.h"
 #include "../scheduler/scheduler_timing.h"
+#include "../scheduler/scheduler_wait_queue.h"
 
 /*! \cond */
 static void pthread_mutex_svcall_unlock(void *args);
@@ -37,6 +38,9 @@ static void svcall_mutex_trylock(svcall_mutex_trylock_t *args) MCU_ROOT_EXEC_COD
 
 static void root_mutex_block(svcall_mutex_trylock_t *args);
 static void svcall_mutex_unblocked(svcall_mutex_trylock_t *args) MCU_ROOT_EXEC_CODE;
+
+static int mutex_fast_lock(pthread_mutex_t *mutex, int id);
+static int mutex_fast_unlock(pthread_mutex_t *mutex, int id);
 /*! \endcond */
 
 /*! \details This function locks \a mutex.  If \a mutex cannot be locked immediately,
@@ -142,6 +146,12 @@ int pthread_mutex_unlock(pthread_mutex_t *mutex) {
     return -1;
   }
 
+  if (mutex_fast_unlock(mutex, args.id) == 0) {
+    // nobody is waiting and the priority doesn't need to be restored
+    SOS_DEBUG_EXIT_TIMER_SCOPE_AVERAGE(SOS_DEBUG_PTHREAD, pthread_mutex_unlock, 20);
+    return 0;
+  }
+
   args.mutex = mutex; // The Mutex
   cortexm_svcall((cortexm_svcall_t)pthread_mutex_svcall_unlock, &args);
   SOS_DEBUG_EXIT_TIMER_SCOPE_AVERAGE(SOS_DEBUG_PTHREAD, pthread_mutex_unlock, 20);
@@ -320,6 +330,11 @@ int mutex_trylock(
     }
   }
 
+  // Lock the mutex without the kernel if it is free and uncontended
+  if (mutex_fast_lock(mutex, id) == 0) {
+    return 0;
+  }
+
   // Lock the mutex if it is free
   args.id = id;
   args.mutex = mutex;
@@ -350,6 +365,67 @@ int pthread_mutex_force_unlock(pthread_mutex_t *mutex) {
   return 0;
 }
 
+#if defined __ARM_FEATURE_LDREX && (__ARM_FEATURE_LDREX & 0x04)
+/*
+ * The fast paths work because any exception (SVCall, PendSV, SysTick or
+ * an interrupt) between LDREX and STREX clears the exclusive monitor. If
+ * STREX succeeds, no other task or kernel code touched the mutex in between.
+ */
+int mutex_fast_lock(pthread_mutex_t *mutex, int id) {
+  if (mutex->prio_ceiling > task_get_priority(id)) {
+    // the kernel needs to elevate the priority of the task
+    return -1;
+  }
+
+  do {
+    if ((int)__LDREXW((volatile u32 *)&mutex->pthread) != -1) {
+      __CLREX();
+      return -1;
+    }
+  } while (__STREXW((u32)id, (volatile u32 *)&mutex->pthread));
+  __DMB();
+
+  mutex->pid = task_get_pid(id);
+  mutex->lock = 1;
+  return 0;
+}
+
+int mutex_fast_unlock(pthread_mutex_t *mutex, int id) {
+  if (task_get_priority(id) != sos_sched_table[id].attr.schedparam.sched_priority) {
+    // the kernel needs to restore the priority of the task
+    return -1;
+  }
+
+  // the kernel sets the lock count for the new owner if there is one
+  mutex->lock = 0;
+  __DMB();
+  do {
+    __LDREXW((volatile u32 *)&mutex->pthread);
+    // read without a critical section -- the queues only change in an exception which
+    // clears the exclusive monitor so the STREX fails and the read is repeated
+    if (scheduler_wait_queue_get_head(mutex) != -1) {
+      // the mutex needs to be handed to the waiting task
+      __CLREX();
+      return -1;
+    }
+  } while (__STREXW((u32)-1, (volatile u32 *)&mutex->pthread));
+  return 0;
+}
+#else
+// no exclusive access instructions -- always use the kernel
+int mutex_fast_lock(pthread_mutex_t *mutex, int id) {
+  MCU_UNUSED_ARGUMENT(mutex);
+  MCU_UNUSED_ARGUMENT(id);
+  return -1;
+}
+
+int mutex_fast_unlock(pthread_mutex_t *mutex, int id) {
+  MCU_UNUSED_ARGUMENT(mutex);
+  MCU_UNUSED_ARGUMENT(id);
+  return -1;
+}
+#endif
+
 void root_mutex_block(svcall_mutex_trylock_t *args) {
   // block the calling mutex
   sos_sched_table[args->id].block_object =
@@ -14,6 +14,7 @@
 #include <pthread.h>
 
 #include "../scheduler/scheduler_root.h"
+#include "../scheduler/scheduler_wait_queue.h"
 
 /*! \cond */
 typedef struct {
@@ -116,6 +117,8 @@ void svcall_set_scheduling_param(void *args) {
 
     // Issue #161 -- need to set the effective priority -- not just the prio ceiling
     task_set_priority(id, sos_sched_table[id].attr.schedparam.sched_priority);
+    // a blocked task moves to its new place in the wait queue
+    scheduler_wait_queue_root_update_priority(id);
 
     if (p->policy == SCHED_FIFO) {
       task_assert_fifo(id);
@@ -0,0 +1,86 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// included before anything else (-include) -- adds the newlib mutex and
+// condition to the scheduler simulation types
+
+#ifndef SIM_PTHREAD_HOST_H_
+#define SIM_PTHREAD_HOST_H_
+
+#include "../../../scheduler/sim/include/sim_host.h"
+
+#define __ARM_FEATURE_LDREX 0x0f
+
+// newlib mutex layout -- the fast paths use LDREX/STREX on pthread
+typedef struct {
+  int pthread;
+  int pid;
+  int lock;
+  int prio_ceiling;
+  int flags;
+} sim_pthread_mutex_t;
+#define pthread_mutex_t sim_pthread_mutex_t
+
+typedef struct {
+  int is_initialized;
+  int process_shared;
+  int prio_ceiling;
+  int protocol;
+  int type;
+  int recursive;
+} sim_pthread_mutexattr_t;
+#define pthread_mutexattr_t sim_pthread_mutexattr_t
+
+// newlib condition: the pid and flags in one word
+typedef u32 sim_pthread_cond_t;
+#define pthread_cond_t sim_pthread_cond_t
+
+typedef struct {
+  int is_initialized;
+  int process_shared;
+} sim_pthread_condattr_t;
+#define pthread_condattr_t sim_pthread_condattr_t
+
+#define PTHREAD_MUTEX_FLAGS_PSHARED (1 << 0)
+#define PTHREAD_MUTEX_FLAGS_RECURSIVE (1 << 1)
+#define PTHREAD_MUTEX_FLAGS_INITIALIZED (1 << 2)
+
+// keep the kernel functions apart from the host library
+#define pthread_mutex_init sim_pthread_mutex_init
+#define pthread_mutex_lock sim_pthread_mutex_lock
+#define pthread_mutex_trylock sim_pthread_mutex_trylock
+#define pthread_mutex_unlock sim_pthread_mutex_unlock
+#define pthread_mutex_destroy sim_pthread_mutex_destroy
+#define pthread_mutex_timedlock sim_pthread_mutex_timedlock
+#define pthread_mutex_getprioceiling sim_pthread_mutex_getprioceiling
+#define pthread_mutex_setprioceiling sim_pthread_mutex_setprioceiling
+#define pthread_cond_init sim_pthread_cond_init
+#define pthread_cond_destroy sim_pthread_cond_destroy
+#define pthread_cond_broadcast sim_pthread_cond_broadcast
+#define pthread_cond_signal sim_pthread_cond_signal
+#define pthread_cond_wait sim_pthread_cond_wait
+#define pthread_cond_timedwait sim_pthread_cond_timedwait
+#define getpid sim_getpid
+
+struct timespec;
+int pthread_mutex_init(pthread_mutex_t *mutex, const pthread_mutexattr_t *attr);
+int pthread_mutex_lock(pthread_mutex_t *mutex);
+int pthread_mutex_trylock(pthread_mutex_t *mutex);
+int pthread_mutex_unlock(pthread_mutex_t *mutex);
+int pthread_mutex_destroy(pthread_mutex_t *mutex);
+int pthread_mutex_timedlock(pthread_mutex_t *mutex, const struct timespec *abs_timeout);
+int pthread_mutex_getprioceiling(pthread_mutex_t *mutex, int *prioceiling);
+int pthread_mutex_setprioceiling(
+  pthread_mutex_t *mutex,
+  int prioceiling,
+  int *old_ceiling);
+int pthread_cond_init(pthread_cond_t *cond, const pthread_condattr_t *attr);
+int pthread_cond_signal(pthread_cond_t *cond);
+int pthread_cond_broadcast(pthread_cond_t *cond);
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex);
+int pthread_cond_timedwait(
+  pthread_cond_t *cond,
+  pthread_mutex_t *mutex,
+  const struct timespec *abstime);
+int getpid();
+
+#endif /* SIM_PTHREAD_HOST_H_ */
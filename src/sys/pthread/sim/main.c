@@ -0,0 +1,266 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <errno.h>
+#include <pthread.h>
+
+#include "../../scheduler/sim/sim.h"
+
+#include "../../scheduler/scheduler_root.h"
+#include "../../scheduler/scheduler_wait_queue.h"
+
+int sim_getpid() { return task_get_pid(task_get_current()); }
+
+void scheduler_root_update_on_stopped() {}
+
+void scheduler_check_cancellation() {}
+
+int scheduler_root_unblock_all(void *block_object, int unblock_type) {
+  return scheduler_wait_queue_root_unblock_all(block_object, unblock_type);
+}
+
+// only called in root mode -- from the svcalls that wake a task
+int scheduler_get_highest_priority_blocked(void *block_object) {
+  if (sim_root_depth == 0) {
+    // from a thread this would cost a service call of its own
+    printf("scheduler_get_highest_priority_blocked() called from a thread\n");
+    sim_failures++;
+  }
+  const u32 primask = cortexm_root_enter_critical();
+  const int id = scheduler_wait_queue_get_head(block_object);
+  cortexm_root_exit_critical(primask);
+  return id;
+}
+
+// the tasks are threads of the same process
+static void start_task(int id, int priority) {
+  sim_start_task(id, priority);
+  sos_task_table[id].pid = 1;
+  sos_sched_table[id].attr.schedparam.sched_priority = priority;
+}
+
+static void set_current(int id) {
+  m_task_current = id;
+  m_task_current_priority = task_get_priority(id);
+}
+
+// the simulated scheduler_root_update_on_sleep() leaves the task running
+static void block(int id, pthread_mutex_t *mutex) {
+  set_current(id);
+  pthread_mutex_lock(mutex);
+  task_deassert_active(id);
+}
+
+static void reset() {
+  sim_reset_tasks();
+  scheduler_wait_queue_init();
+  start_task(1, 3);
+  start_task(2, 5);
+  start_task(3, 3);
+  set_current(1);
+  sim_svcall_count = 0;
+}
+
+static void test_uncontended() {
+  pthread_mutex_t mutex;
+  reset();
+  SIM_CHECK(pthread_mutex_init(&mutex, NULL) == 0);
+
+  SIM_CHECK(pthread_mutex_lock(&mutex) == 0);
+  SIM_CHECK(mutex.pthread == 1);
+  SIM_CHECK(mutex.lock == 1);
+  SIM_CHECK(mutex.pid == 1);
+  SIM_CHECK(pthread_mutex_unlock(&mutex) == 0);
+  SIM_CHECK(mutex.pthread == -1);
+  SIM_CHECK(mutex.lock == 0);
+
+  SIM_CHECK(pthread_mutex_trylock(&mutex) == 0);
+  SIM_CHECK(pthread_mutex_unlock(&mutex) == 0);
+  SIM_CHECK(sim_svcall_count == 0);
+  SIM_CHECK(sim_critical_depth == 0);
+
+  // a second lock by the owner is an error unless the mutex is recursive
+  SIM_CHECK(pthread_mutex_lock(&mutex) == 0);
+  SIM_CHECK(pthread_mutex_lock(&mutex) == -1);
+  SIM_CHECK(errno == EDEADLK);
+  SIM_CHECK(pthread_mutex_unlock(&mutex) == 0);
+
+  mutex.flags |= PTHREAD_MUTEX_FLAGS_RECURSIVE;
+  SIM_CHECK(pthread_mutex_lock(&mutex) == 0);
+  SIM_CHECK(pthread_mutex_lock(&mutex) == 0);
+  SIM_CHECK(mutex.lock == 2);
+  SIM_CHECK(pthread_mutex_unlock(&mutex) == 0);
+  SIM_CHECK(mutex.pthread == 1);
+  SIM_CHECK(pthread_mutex_unlock(&mutex) == 0);
+  SIM_CHECK(mutex.pthread == -1);
+  SIM_CHECK(sim_svcall_count == 0);
+}
+
+// an exception between LDREX and STREX makes the fast path try again
+static void test_exclusive_cleared() {
+  pthread_mutex_t mutex;
+  reset();
+  SIM_CHECK(pthread_mutex_init(&mutex, NULL) == 0);
+  __LDREXW((volatile u32 *)&mutex.pthread);
+  sim_exclusive_clear();
+  SIM_CHECK(__STREXW(1, (volatile u32 *)&mutex.pthread) == 1);
+  SIM_CHECK(mutex.pthread == -1);
+  SIM_CHECK(pthread_mutex_lock(&mutex) == 0);
+  SIM_CHECK(mutex.pthread == 1);
+  SIM_CHECK(pthread_mutex_unlock(&mutex) == 0);
+}
+
+static void test_contended() {
+  pthread_mutex_t mutex;
+  reset();
+  SIM_CHECK(pthread_mutex_init(&mutex, NULL) == 0);
+  SIM_CHECK(pthread_mutex_lock(&mutex) == 0);
+
+  // the kernel blocks the other tasks on the mutex
+  set_current(2);
+  SIM_CHECK(pthread_mutex_trylock(&mutex) == -1);
+  SIM_CHECK(errno == EBUSY);
+  SIM_CHECK(scheduler_wait_queue_get_head(&mutex) == -1);
+  sim_svcall_count = 0;
+  block(2, &mutex);
+  SIM_CHECK(sim_svcall_count == 1);
+  SIM_CHECK(scheduler_wait_queue_get_head(&mutex) == 2);
+  block(3, &mutex);
+  SIM_CHECK(mutex.pthread == 1);
+  SIM_CHECK(scheduler_wait_queue_get_head(&mutex) == 2);
+
+  // unlocking hands the mutex to the highest priority waiter through the kernel
+  set_current(1);
+  sim_svcall_count = 0;
+  SIM_CHECK(pthread_mutex_unlock(&mutex) == 0);
+  SIM_CHECK(sim_svcall_count > 0);
+  SIM_CHECK(mutex.pthread == 2);
+  SIM_CHECK(mutex.lock == 1);
+  SIM_CHECK(scheduler_wait_queue_get_head(&mutex) == 3);
+
+  set_current(2);
+  SIM_CHECK(pthread_mutex_unlock(&mutex) == 0);
+  SIM_CHECK(mutex.pthread == 3);
+  SIM_CHECK(scheduler_wait_queue_get_head(&mutex) == -1);
+
+  // the last owner has nobody to hand it to -- back to the fast path
+  set_current(3);
+  sim_svcall_count = 0;
+  SIM_CHECK(pthread_mutex_unlock(&mutex) == 0);
+  SIM_CHECK(mutex.pthread == -1);
+  SIM_CHECK(sim_svcall_count == 0);
+  SIM_CHECK(sim_critical_depth == 0);
+}
+
+// the kernel elevates and restores the priority of the owner
+static void test_prio_ceiling() {
+  pthread_mutex_t mutex;
+  reset();
+  SIM_CHECK(pthread_mutex_init(&mutex, NULL) == 0);
+  SIM_CHECK(pthread_mutex_setprioceiling(&mutex, 10, NULL) == 0);
+
+  SIM_CHECK(pthread_mutex_lock(&mutex) == 0);
+  SIM_CHECK(sim_svcall_count == 1);
+  SIM_CHECK(mutex.pthread == 1);
+  SIM_CHECK(task_get_priority(1) == 10);
+
+  SIM_CHECK(pthread_mutex_unlock(&mutex) == 0);
+  SIM_CHECK(sim_svcall_count == 2);
+  SIM_CHECK(mutex.pthread == -1);
+  SIM_CHECK(task_get_priority(1) == 3);
+}
+
+// the task waits on cond -- the simulated scheduler_root_update_on_sleep() leaves it
+// running so it takes and releases the mutex again on the way out
+static void wait(int id, pthread_cond_t *cond, pthread_mutex_t *mutex) {
+  set_current(id);
+  pthread_mutex_lock(mutex);
+  pthread_cond_wait(cond, mutex);
+  pthread_mutex_unlock(mutex);
+  task_deassert_active(id);
+}
+
+// a signal finds and wakes the head of the wait queue in one service call
+static void test_cond_signal() {
+  const pthread_condattr_t attr = {.is_initialized = 1};
+  pthread_cond_t cond;
+  pthread_mutex_t mutex;
+  reset();
+  SIM_CHECK(pthread_mutex_init(&mutex, NULL) == 0);
+  SIM_CHECK(pthread_cond_init(&cond, &attr) == 0);
+
+  sim_svcall_count = 0;
+  SIM_CHECK(pthread_cond_signal(&cond) == 0);
+  SIM_CHECK(sim_svcall_count == 1);
+
+  wait(3, &cond, &mutex);
+  wait(2, &cond, &mutex);
+  SIM_CHECK(scheduler_wait_queue_get_head(&cond) == 2);
+  SIM_CHECK(!task_active_asserted(2) && !task_active_asserted(3));
+
+  set_current(1);
+  sim_svcall_count = 0;
+  SIM_CHECK(pthread_cond_signal(&cond) == 0);
+  SIM_CHECK(sim_svcall_count == 1);
+  SIM_CHECK(task_active_asserted(2) && !task_active_asserted(3));
+  SIM_CHECK(scheduler_wait_queue_get_head(&cond) == 3);
+
+  SIM_CHECK(pthread_cond_signal(&cond) == 0);
+  SIM_CHECK(sim_svcall_count == 2);
+  SIM_CHECK(task_active_asserted(3));
+  SIM_CHECK(scheduler_wait_queue_get_head(&cond) == -1);
+
+  wait(2, &cond, &mutex);
+  wait(3, &cond, &mutex);
+  set_current(1);
+  SIM_CHECK(pthread_cond_broadcast(&cond) == 0);
+  SIM_CHECK(task_active_asserted(2) && task_active_asserted(3));
+  SIM_CHECK(scheduler_wait_queue_get_head(&cond) == -1);
+  SIM_CHECK(sim_critical_depth == 0);
+}
+
+// service calls and time for an uncontended lock/unlock pair
+static void bench() {
+  pthread_mutex_t mutex;
+  const int loops = 10000000;
+  reset();
+  pthread_mutex_init(&mutex, NULL);
+
+  double start = sim_now_ns();
+  for (int i = 0; i < loops; i++) {
+    pthread_mutex_lock(&mutex);
+    pthread_mutex_unlock(&mutex);
+  }
+  const double fast_ns = (sim_now_ns() - start) / loops;
+  const double fast_svcalls = (double)sim_svcall_count / loops;
+
+  // a priority ceiling above the task always takes the kernel path
+  pthread_mutex_setprioceiling(&mutex, 10, NULL);
+  sim_svcall_count = 0;
+  for (int i = 0; i < 1000; i++) {
+    pthread_mutex_lock(&mutex);
+    pthread_mutex_unlock(&mutex);
+  }
+  const double kernel_svcalls = sim_svcall_count / 1000.0;
+
+  printf(
+    "uncontended lock/unlock: %.0f service calls (kernel path %.0f), %.1f ns on the "
+    "host\n",
+    fast_svcalls,
+    kernel_svcalls,
+    fast_ns);
+}
+
+int main() {
+  test_uncontended();
+  test_exclusive_cleared();
+  test_contended();
+  test_prio_ceiling();
+  test_cond_signal();
+  if (sim_failures) {
+    printf("FAILED (%d)\n", sim_failures);
+    return 1;
+  }
+  bench();
+  printf("PASSED\n");
+  return 0;
+}
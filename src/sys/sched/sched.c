@@ -13,6 +13,7 @@
 #include <sched.h>
 
 #include "../scheduler/scheduler_root.h"
+#include "../scheduler/scheduler_wait_queue.h"
 
 /*! \cond */
 typedef struct {
@@ -237,6 +238,8 @@ void svcall_set_scheduling_param(void *args) {
 
     // Issue #161 -- need to set the effective priority -- not just the prio ceiling
     task_set_priority(id, sos_sched_table[id].attr.schedparam.sched_priority);
+    // a blocked task moves to its new place in the wait queue
+    scheduler_wait_queue_root_update_priority(id);
 
     // this won't become effective until the next time the task is run because the RR
     // timer is currently active
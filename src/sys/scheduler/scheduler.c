@@ -20,6 +20,7 @@
 #include "../unistd/unistd_local.h"
 #include "sched.h"
 #include "scheduler_root.h"
+#include "scheduler_wait_queue.h"
 #include "sos/debug.h"
 
 #include "cortexm/fault_local.h"
@@ -163,19 +164,16 @@ int check_faults() {
 
 // Called when the task stops or drops in priority (e.g., releases a mutex)
 void scheduler_root_update_on_stopped() {
-  int i;
   s8 next_priority;
 
   // Issue #130
 
   SOS_DEBUG_ENTER_CYCLE_SCOPE_AVERAGE();
   cortexm_disable_interrupts();
-  next_priority = CONFIG_SCHED_LOWEST_PRIORITY;
-  for (i = 1; i < task_get_total(); i++) {
-    // Find the highest priority of all active tasks
-    if (task_enabled_active_not_stopped(i) && (task_get_priority(i) > next_priority)) {
-      next_priority = task_get_priority(i);
-    }
+  // The highest priority of all active tasks comes from the ready bitmap
+  next_priority = task_root_get_ready_priority();
+  if (next_priority < CONFIG_SCHED_LOWEST_PRIORITY) {
+    next_priority = CONFIG_SCHED_LOWEST_PRIORITY;
   }
   task_root_set_current_priority(next_priority);
   cortexm_enable_interrupts();
@@ -209,72 +207,21 @@ void scheduler_root_update_on_wake(int id, int new_priority) {
   task_root_switch_context();
 }
 
-// this is called from user space?
+// this is only called from root (the svcalls that wake a task) -- a thread asks for the
+// head inside the service call that wakes the task so each wake costs one SVCall
 int scheduler_get_highest_priority_blocked(void *block_object) {
-  int priority;
-  int i;
-  int new_thread;
-  int current_task = task_get_current();
-
-  // check to see if another task is waiting for the mutex
-  priority = CONFIG_SCHED_LOWEST_PRIORITY - 1;
-  new_thread = -1;
-
-  // Issue #139 - blocked mutexes should be awarded in a round robin fashion started with
-  // the current task
-  if (current_task == 0) {
-    current_task++;
-  }
-  i = current_task + 1;
-  if (i == task_get_total()) {
-    i = 1;
-  }
-  do {
-    if (task_enabled(i)) {
-      if (
-        (sos_sched_table[i].block_object == block_object) && (!task_active_asserted(i))) {
-        // it's waiting for the block -- give the block to the highest priority and
-        // waiting longest
-        if (
-          !task_stopped_asserted(i)
-          && (sos_sched_table[i].attr.schedparam.sched_priority > priority)) {
-          //! \todo Find the task that has been waiting the longest time
-          new_thread = i;
-          priority = sos_sched_table[i].attr.schedparam.sched_priority;
-        }
-      }
-    }
-    // Issue #139
-    i++;
-    if (i == task_get_total()) {
-      i = 1;
-    }
-  } while (i != current_task);
-
-  return new_thread;
+  // the wait queue is ordered by priority then by time spent waiting; interrupts
+  // (timeouts) change the queues -- read them in a critical section
+  const u32 primask = cortexm_root_enter_critical();
+  const int id = scheduler_wait_queue_get_head(block_object);
+  cortexm_root_exit_critical(primask);
+  return id;
 }
+
 // This is only called from SVcall so it is always synchronous -- no re-entrancy issues
 // with it
 int scheduler_root_unblock_all(void *block_object, int unblock_type) {
-  int i;
-  int priority;
-  priority = CONFIG_SCHED_LOWEST_PRIORITY - 1;
-  for (i = 1; i < task_get_total(); i++) {
-    if (task_enabled(i)) {
-      if (
-        (sos_sched_table[i].block_object == block_object) && (!task_active_asserted(i))) {
-        // it's waiting for the semaphore -- give the semaphore to the highest priority
-        // and waiting longest
-        scheduler_root_assert_active(i, unblock_type);
-        if (
-          !task_stopped_asserted(i)
-          && (sos_sched_table[i].attr.schedparam.sched_priority > priority)) {
-          priority = sos_sched_table[i].attr.schedparam.sched_priority;
-        }
-      }
-    }
-  }
-  return priority;
+  return scheduler_wait_queue_root_unblock_all(block_object, unblock_type);
 }
 
 void start_first_thread() {
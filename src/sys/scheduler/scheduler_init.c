@@ -9,6 +9,7 @@
 /*! \file */
 #include "scheduler_fault.h"
 #include "scheduler_timing.h"
+#include "scheduler_wait_queue.h"
 
 #include "cortexm/fault_local.h"
 #include "sos/debug.h"
@@ -33,6 +34,7 @@ void scheduler_init() {
     sos_task_table[i] = (task_t){};
     sos_sched_table[i] = (sched_task_t){};
   }
+  scheduler_wait_queue_init();
 
   // Do basic init of task 0 so that memory allocation can happen before the scheduler
   // starts
@@ -76,6 +76,9 @@ typedef struct {
   volatile struct mcu_timeval wake;
   volatile u16 flags;
   trace_id_t trace_id;
+  volatile u8 wait_queue; // one-based wait queue number (zero if not waiting)
+  volatile u8 wait_next;
+  volatile u8 wait_prev;
 #if CONFIG_TASK_PROCESS_TIMER_COUNT > 0
   sos_process_timer_t timer[CONFIG_TASK_PROCESS_TIMER_COUNT];
 #endif
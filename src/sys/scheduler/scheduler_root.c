@@ -9,6 +9,8 @@
 /*! \file */
 
 #include "scheduler_root.h"
+#include "scheduler_timing.h"
+#include "scheduler_wait_queue.h"
 
 void scheduler_svcall_set_delaymutex(void *args) {
   CORTEXM_SVCALL_ENTER();
@@ -25,13 +27,14 @@ void scheduler_root_assert_active(int id, int unblock_type) {
   scheduler_root_deassert_aiosuspend(id);
   // Remove all blocks (mutex, timing, etc)
   sos_sched_table[id].block_object = NULL;
+  scheduler_wait_queue_root_remove(id);
+  scheduler_timing_root_cancel_wake(id);
   sos_sched_table[id].wake.tv_sec = SCHEDULER_TIMEVAL_SEC_INVALID;
   sos_sched_table[id].wake.tv_usec = 0;
 }
 
 void scheduler_root_deassert_active(int id) {
-  task_deassert_active(id);
-  task_deassert_exec(id); // stop executing the task
+  task_deassert_active(id); // removes the task from the ready list
 }
 
 
@@ -12,16 +12,29 @@
 
 #include "scheduler_root.h"
 #include "scheduler_timing.h"
+#include "scheduler_wait_queue.h"
 
 #include "sos/debug.h"
 
 static volatile u32 sched_usecond_counter MCU_SYS_MEM;
 
+// min-heap of sleeping task ids ordered by sos_sched_table[id].wake
+static volatile u8 m_wake_heap[CONFIG_TASK_TOTAL] MCU_SYS_MEM;
+// one-based position of each task in m_wake_heap (zero if the task is not queued)
+static volatile u8 m_wake_position[CONFIG_TASK_TOTAL] MCU_SYS_MEM;
+static volatile u8 m_wake_count MCU_SYS_MEM;
+
 static int root_handle_usecond_overflow_event(void *context, const mcu_event_t *data)
   MCU_ROOT_EXEC_CODE;
 static int root_handle_usecond_match_event(void *context, const mcu_event_t *data)
   MCU_ROOT_EXEC_CODE;
 
+static int wake_is_before(int a, int b) MCU_ROOT_EXEC_CODE;
+static void wake_heap_assign(int index, int id) MCU_ROOT_EXEC_CODE;
+static void wake_heap_sift_up(int index) MCU_ROOT_EXEC_CODE;
+static void wake_heap_sift_down(int index) MCU_ROOT_EXEC_CODE;
+static void root_queue_wake(int id) MCU_ROOT_EXEC_CODE;
+
 #if CONFIG_TASK_PROCESS_TIMER_COUNT
 static int root_handle_usecond_process_timer_match_event(
   void *context,
@@ -30,8 +43,11 @@ static int root_handle_usecond_process_timer_match_event(
 static void svcall_allocate_timer(void *args) MCU_ROOT_EXEC_CODE;
 static void root_allocate_timer(void *args) MCU_ROOT_EXEC_CODE;
 
-static int send_and_reload_timer(volatile sos_process_timer_t *timer, u8 task_id, u32 now)
-  MCU_ROOT_EXEC_CODE;
+static int send_and_reload_timer(
+  timer_t timer_id,
+  volatile sos_process_timer_t *timer,
+  u8 task_id,
+  u32 now) MCU_ROOT_EXEC_CODE;
 
 static inline u8 scheduler_timing_process_timer_task_id(timer_t timer_id) {
   return timer_id >> 8;
@@ -45,8 +61,29 @@ static inline u8 scheduler_timing_process_timer_count() {
   return CONFIG_TASK_PROCESS_TIMER_COUNT;
 }
 
-static void update_tmr_for_process_timer_match(volatile sos_process_timer_t *timer)
-  MCU_ROOT_EXEC_CODE;
+static inline u16 scheduler_timing_process_timer_index(timer_t timer_id) {
+  return scheduler_timing_process_timer_task_id(timer_id) * CONFIG_TASK_PROCESS_TIMER_COUNT
+         + scheduler_timing_process_timer_id_offset(timer_id);
+}
+
+#define PROCESS_TIMER_TOTAL (CONFIG_TASK_TOTAL * CONFIG_TASK_PROCESS_TIMER_COUNT)
+
+// min-heap of armed process timers (all tasks) ordered by timer->value
+static volatile u16 m_process_timer_heap[PROCESS_TIMER_TOTAL] MCU_SYS_MEM;
+// one-based position of each timer in m_process_timer_heap (zero if not armed)
+static volatile u16 m_process_timer_position[PROCESS_TIMER_TOTAL] MCU_SYS_MEM;
+static volatile u16 m_process_timer_count MCU_SYS_MEM;
+
+static int process_timer_is_before(timer_t a, timer_t b) MCU_ROOT_EXEC_CODE;
+static void process_timer_heap_assign(int index, timer_t timer_id) MCU_ROOT_EXEC_CODE;
+static void process_timer_heap_sift_up(int index) MCU_ROOT_EXEC_CODE;
+static void process_timer_heap_sift_down(int index) MCU_ROOT_EXEC_CODE;
+static void root_unqueue_process_timer(timer_t timer_id) MCU_ROOT_EXEC_CODE;
+static void root_queue_process_timer(timer_t timer_id) MCU_ROOT_EXEC_CODE;
+
+static void update_tmr_for_process_timer_match(
+  timer_t timer_id,
+  volatile sos_process_timer_t *timer) MCU_ROOT_EXEC_CODE;
 #endif
 
 u64 scheduler_timing_real64usec(struct mcu_timeval *tv) {
@@ -117,10 +154,91 @@ void scheduler_timing_root_timedblock(void *block_object, struct mcu_timeval *ab
 
   // only sleep if the time hasn't already passed
   if (is_time_to_sleep) {
+    if (block_object != NULL) {
+      scheduler_wait_queue_root_append(id, block_object);
+    }
+    if (abs_time->tv_sec != SCHEDULER_TIMEVAL_SEC_INVALID) {
+      root_queue_wake(id);
+    }
     scheduler_root_update_on_sleep();
   }
 }
 
+int wake_is_before(int a, int b) {
+  const u32 a_sec = sos_sched_table[a].wake.tv_sec;
+  const u32 b_sec = sos_sched_table[b].wake.tv_sec;
+  return (a_sec < b_sec)
+         || ((a_sec == b_sec)
+             && (sos_sched_table[a].wake.tv_usec < sos_sched_table[b].wake.tv_usec));
+}
+
+void wake_heap_assign(int index, int id) {
+  m_wake_heap[index] = id;
+  m_wake_position[id] = index + 1;
+}
+
+void wake_heap_sift_up(int index) {
+  const int id = m_wake_heap[index];
+  while (index > 0) {
+    const int parent = (index - 1) / 2;
+    if (!wake_is_before(id, m_wake_heap[parent])) {
+      break;
+    }
+    wake_heap_assign(index, m_wake_heap[parent]);
+    index = parent;
+  }
+  wake_heap_assign(index, id);
+}
+
+void wake_heap_sift_down(int index) {
+  const int id = m_wake_heap[index];
+  const int count = m_wake_count;
+  while (1) {
+    int child = index * 2 + 1;
+    if (child >= count) {
+      break;
+    }
+    if ((child + 1 < count) && wake_is_before(m_wake_heap[child + 1], m_wake_heap[child])) {
+      child++;
+    }
+    if (!wake_is_before(m_wake_heap[child], id)) {
+      break;
+    }
+    wake_heap_assign(index, m_wake_heap[child]);
+    index = child;
+  }
+  wake_heap_assign(index, id);
+}
+
+void root_queue_wake(int id) {
+  const u32 primask = cortexm_root_enter_critical();
+  // a task is only queued once -- re-queue if the wake time has changed
+  scheduler_timing_root_cancel_wake(id);
+  const int index = m_wake_count;
+  m_wake_count++;
+  wake_heap_assign(index, id);
+  wake_heap_sift_up(index);
+  cortexm_root_exit_critical(primask);
+}
+
+void scheduler_timing_root_cancel_wake(int id) {
+  const u32 primask = cortexm_root_enter_critical();
+  const int position = m_wake_position[id];
+  if (position) {
+    const int index = position - 1;
+    m_wake_position[id] = 0;
+    m_wake_count--;
+    if (index < m_wake_count) {
+      // fill the hole with the last entry and restore the heap order
+      const int moved = m_wake_heap[m_wake_count];
+      wake_heap_assign(index, moved);
+      wake_heap_sift_up(index);
+      wake_heap_sift_down(m_wake_position[moved] - 1);
+    }
+  }
+  cortexm_root_exit_critical(primask);
+}
+
 void scheduler_timing_convert_timespec(
   struct mcu_timeval *tv,
   const struct timespec *ts) {
@@ -224,28 +342,34 @@ int root_handle_usecond_match_event(void *context, const mcu_event_t *data) {
 
   u32 now = sos_config.clock.disable();
 
-  for (int i = 1; i < task_get_total(); i++) {
-
-    if (task_enabled_not_active(i)) {
-      u32 tmp = sos_sched_table[i].wake.tv_usec;
-
-      // compare the current clock to the wake time
-      if (
-        (sos_sched_table[i].wake.tv_sec < sched_usecond_counter)
-        || ((sos_sched_table[i].wake.tv_sec == sched_usecond_counter) && (tmp <= now))) {
-        // wake this task
-        scheduler_root_assert_active(i, SCHEDULER_UNBLOCK_SLEEP);
-        if (!task_stopped_asserted(i) && (scheduler_priority(i) > new_priority)) {
-          new_priority = scheduler_priority(i);
-        }
+  // only the tasks that are expiring are touched -- the rest stay in the heap
+  const u32 primask = cortexm_root_enter_critical();
+  while (m_wake_count > 0) {
+    const int i = m_wake_heap[0];
+    const u32 tmp = sos_sched_table[i].wake.tv_usec;
 
-      } else if (
-        (sos_sched_table[i].wake.tv_sec == sched_usecond_counter) && (tmp < next)) {
-        // see if this is the next event to wake up
+    // compare the current clock to the earliest wake time
+    if (
+      (sos_sched_table[i].wake.tv_sec > sched_usecond_counter)
+      || ((sos_sched_table[i].wake.tv_sec == sched_usecond_counter) && (tmp > now))) {
+      if (sos_sched_table[i].wake.tv_sec == sched_usecond_counter) {
+        // this is the next event to wake up
         next = tmp;
       }
+      break;
+    }
+
+    scheduler_timing_root_cancel_wake(i);
+    if (task_enabled_not_active(i)) {
+      // wake this task
+      scheduler_root_assert_active(i, SCHEDULER_UNBLOCK_SLEEP);
+      if (!task_stopped_asserted(i) && (scheduler_priority(i) > new_priority)) {
+        new_priority = scheduler_priority(i);
+      }
     }
   }
+  cortexm_root_exit_critical(primask);
+
   if (next < SOS_USECOND_PERIOD) {
     chan_req.value = next;
   }
@@ -272,40 +396,34 @@ int root_handle_usecond_process_timer_match_event(
 
   u32 now = sos_config.clock.disable();
 
-  for (int i = 1; i < task_get_total(); i++) {
-    // look for the next signal
-
-    if (task_enabled(i)) {
-
-      for (int j = 0; j < CONFIG_TASK_PROCESS_TIMER_COUNT; j++) {
-        volatile sos_process_timer_t *timer = sos_sched_table[i].timer + j;
-
-        if (timer->o_flags & SCHEDULER_TIMING_PROCESS_TIMER_FLAG_IS_INITIALIZED) {
-          u32 tmp = timer->value.tv_usec;
-          if (
-            (timer->value.tv_sec < sched_usecond_counter) // seconds are in the past
-            // seconds are the sae and useconds are in the past
-            || ((timer->value.tv_sec == sched_usecond_counter) && (tmp <= now))) {
-
-            // reload the timer if interval is valid
-            send_and_reload_timer(timer, i, now);
-
-            // if interval value is non-zero, need to check if this is less than next
-            if (timer->interval.tv_sec + timer->interval.tv_usec) {
-              tmp = timer->value.tv_usec;
-              if ((timer->value.tv_sec == sched_usecond_counter) && (tmp < next)) {
-                next = tmp;
-              }
-            }
+  // fire the expired timers from the front of the queue
+  const u32 primask = cortexm_root_enter_critical();
+  while (m_process_timer_count > 0) {
+    const timer_t timer_id = m_process_timer_heap[0];
+    const u8 task_id = scheduler_timing_process_timer_task_id(timer_id);
+    volatile sos_process_timer_t *timer = scheduler_timing_process_timer(timer_id);
+    const u32 tmp = timer->value.tv_usec;
 
-          } else if ((timer->value.tv_sec == sched_usecond_counter) && (tmp < next)) {
-            // see if this is the next event to wake up
-            next = tmp;
-          }
-        }
+    if (
+      (timer->value.tv_sec > sched_usecond_counter)
+      || ((timer->value.tv_sec == sched_usecond_counter) && (tmp > now))) {
+      if (timer->value.tv_sec == sched_usecond_counter) {
+        // this is the next event to wake up
+        next = tmp;
       }
+      break;
+    }
+
+    if (
+      task_enabled(task_id)
+      && (timer->o_flags & SCHEDULER_TIMING_PROCESS_TIMER_FLAG_IS_INITIALIZED)) {
+      // sends the signal and re-queues the timer if the interval is valid
+      send_and_reload_timer(timer_id, timer, task_id, now);
+    } else {
+      root_unqueue_process_timer(timer_id);
     }
   }
+  cortexm_root_exit_critical(primask);
 
   if (next < SOS_USECOND_PERIOD) {
     chan_req.value = next;
@@ -319,6 +437,89 @@ int root_handle_usecond_process_timer_match_event(
 #endif
 
 #if CONFIG_TASK_PROCESS_TIMER_COUNT > 0
+int process_timer_is_before(timer_t a, timer_t b) {
+  volatile sos_process_timer_t *a_timer = scheduler_timing_process_timer(a);
+  volatile sos_process_timer_t *b_timer = scheduler_timing_process_timer(b);
+  return (a_timer->value.tv_sec < b_timer->value.tv_sec)
+         || ((a_timer->value.tv_sec == b_timer->value.tv_sec)
+             && (a_timer->value.tv_usec < b_timer->value.tv_usec));
+}
+
+void process_timer_heap_assign(int index, timer_t timer_id) {
+  m_process_timer_heap[index] = timer_id;
+  m_process_timer_position[scheduler_timing_process_timer_index(timer_id)] = index + 1;
+}
+
+void process_timer_heap_sift_up(int index) {
+  const timer_t timer_id = m_process_timer_heap[index];
+  while (index > 0) {
+    const int parent = (index - 1) / 2;
+    if (!process_timer_is_before(timer_id, m_process_timer_heap[parent])) {
+      break;
+    }
+    process_timer_heap_assign(index, m_process_timer_heap[parent]);
+    index = parent;
+  }
+  process_timer_heap_assign(index, timer_id);
+}
+
+void process_timer_heap_sift_down(int index) {
+  const timer_t timer_id = m_process_timer_heap[index];
+  const int count = m_process_timer_count;
+  while (1) {
+    int child = index * 2 + 1;
+    if (child >= count) {
+      break;
+    }
+    if (
+      (child + 1 < count)
+      && process_timer_is_before(
+        m_process_timer_heap[child + 1], m_process_timer_heap[child])) {
+      child++;
+    }
+    if (!process_timer_is_before(m_process_timer_heap[child], timer_id)) {
+      break;
+    }
+    process_timer_heap_assign(index, m_process_timer_heap[child]);
+    index = child;
+  }
+  process_timer_heap_assign(index, timer_id);
+}
+
+void root_unqueue_process_timer(timer_t timer_id) {
+  const u32 primask = cortexm_root_enter_critical();
+  const u16 timer_index = scheduler_timing_process_timer_index(timer_id);
+  const int position = m_process_timer_position[timer_index];
+  if (position) {
+    const int index = position - 1;
+    m_process_timer_position[timer_index] = 0;
+    m_process_timer_count--;
+    if (index < m_process_timer_count) {
+      // fill the hole with the last entry and restore the heap order
+      const timer_t moved = m_process_timer_heap[m_process_timer_count];
+      process_timer_heap_assign(index, moved);
+      process_timer_heap_sift_up(index);
+      process_timer_heap_sift_down(
+        m_process_timer_position[scheduler_timing_process_timer_index(moved)] - 1);
+    }
+  }
+  cortexm_root_exit_critical(primask);
+}
+
+void root_queue_process_timer(timer_t timer_id) {
+  // call root_unqueue_process_timer() before changing timer->value and this after
+  volatile sos_process_timer_t *timer = scheduler_timing_process_timer(timer_id);
+  const u32 primask = cortexm_root_enter_critical();
+  root_unqueue_process_timer(timer_id);
+  if (timer->value.tv_sec != SCHEDULER_TIMEVAL_SEC_INVALID) {
+    const int index = m_process_timer_count;
+    m_process_timer_count++;
+    process_timer_heap_assign(index, timer_id);
+    process_timer_heap_sift_up(index);
+  }
+  cortexm_root_exit_critical(primask);
+}
+
 volatile sos_process_timer_t *scheduler_timing_process_timer(timer_t timer_id) {
   u8 task_id = scheduler_timing_process_timer_task_id(timer_id);
   u8 id_offset = scheduler_timing_process_timer_id_offset(timer_id);
@@ -369,6 +570,8 @@ void root_allocate_timer(void *args) {
 
 void scheduler_timing_root_process_timer_initialize(u16 task_id) {
   for (int i = 0; i < CONFIG_TASK_PROCESS_TIMER_COUNT; i++) {
+    // the slot may still be queued by a task that was deleted
+    root_unqueue_process_timer(SCHEDULER_TIMING_PROCESS_TIMER(task_id, i));
     sos_sched_table[task_id].timer[i] = (sos_process_timer_t){};
   }
 
@@ -416,6 +619,7 @@ void svcall_delete_timer(void *args) {
     return;
   }
 
+  root_unqueue_process_timer(p->timer_id);
   *timer = (sos_process_timer_t){};
   cortexm_assign_zero_sum32((void *)timer, sizeof(sos_process_timer_t) / sizeof(u32));
   p->result = 0;
@@ -437,13 +641,14 @@ typedef struct {
 static void svcall_cancel_timer(void *args) MCU_ROOT_EXEC_CODE;
 void svcall_cancel_timer(void *args) {
   CORTEXM_SVCALL_ENTER();
-  svcall_delete_timer_t *p = args;
+  svcall_cancel_timer_t *p = args;
   volatile sos_process_timer_t *timer = scheduler_timing_process_timer(p->timer_id);
   if (timer == NULL) {
     p->result = -1;
     return;
   }
 
+  root_unqueue_process_timer(p->timer_id);
   timer->value.tv_sec = SCHEDULER_TIMEVAL_SEC_INVALID;
   timer->value.tv_usec = 0;
   timer->interval.tv_sec = 0;
@@ -484,6 +689,8 @@ void svcall_settime(void *args) {
     return;
   }
 
+  // the heap is ordered by timer->value -- take the timer out before changing it
+  root_unqueue_process_timer(p->timer_id);
   scheduler_timing_root_get_realtime(&abs_time);
 
   if (timer->value.tv_sec == SCHEDULER_TIMEVAL_SEC_INVALID) {
@@ -517,7 +724,8 @@ void svcall_settime(void *args) {
   }
 
   // stop the timer -- see if event is in past, assign the values, start the timer
-  update_tmr_for_process_timer_match(timer);
+  root_queue_process_timer(p->timer_id);
+  update_tmr_for_process_timer_match(p->timer_id, timer);
 
   cortexm_assign_zero_sum32((void *)timer, sizeof(sos_process_timer_t) / sizeof(u32));
   p->result = 0;
@@ -622,7 +830,11 @@ void scheduler_timing_process_unqueue_timer(
   cortexm_svcall(svcall_unqueue_timer, &args);
 }
 
-int send_and_reload_timer(volatile sos_process_timer_t *timer, u8 task_id, u32 now) {
+int send_and_reload_timer(
+  timer_t timer_id,
+  volatile sos_process_timer_t *timer,
+  u8 task_id,
+  u32 now) {
 
   // check to see if a signal has already been queued
   if (
@@ -640,6 +852,7 @@ int send_and_reload_timer(volatile sos_process_timer_t *timer, u8 task_id, u32 n
   }
 
   // reload the timer if interval is valid
+  root_unqueue_process_timer(timer_id);
   if (timer->interval.tv_sec + timer->interval.tv_usec) {
     struct mcu_timeval current;
     current.tv_sec = sched_usecond_counter;
@@ -649,10 +862,13 @@ int send_and_reload_timer(volatile sos_process_timer_t *timer, u8 task_id, u32 n
   } else {
     timer->value.tv_sec = SCHEDULER_TIMEVAL_SEC_INVALID;
   }
+  root_queue_process_timer(timer_id);
   return 0;
 }
 
-void update_tmr_for_process_timer_match(volatile sos_process_timer_t *timer) {
+void update_tmr_for_process_timer_match(
+  timer_t timer_id,
+  volatile sos_process_timer_t *timer) {
 
 
   if (
@@ -686,11 +902,11 @@ void update_tmr_for_process_timer_match(volatile sos_process_timer_t *timer) {
 
     if (is_time_to_send) {
       // send it now and reload if needed
-      send_and_reload_timer(timer, task_get_current(), now);
+      send_and_reload_timer(timer_id, timer, task_get_current(), now);
 
       // if interval is non-zero -- this needs to be called again
       if (timer->interval.tv_sec + timer->interval.tv_usec) {
-        update_tmr_for_process_timer_match(timer);
+        update_tmr_for_process_timer_match(timer_id, timer);
       }
     }
   }
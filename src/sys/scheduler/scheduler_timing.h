@@ -10,6 +10,7 @@ void scheduler_timing_init();
 
 u32 scheduler_timing_useconds_to_clocks(int useconds);
 void scheduler_timing_root_timedblock(void * block_object, struct mcu_timeval * interval);
+void scheduler_timing_root_cancel_wake(int id) MCU_ROOT_EXEC_CODE;
 
 void scheduler_timing_convert_timespec(struct mcu_timeval * tv, const struct timespec * ts);
 void scheduler_timing_convert_mcu_timeval(struct timespec * ts, const struct mcu_timeval * mcu_tv);
@@ -0,0 +1,233 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+/*! \addtogroup SCHED
+ * @{
+ *
+ */
+
+/*! \file */
+
+#include "scheduler_root.h"
+#include "scheduler_wait_queue.h"
+
+#define WAIT_QUEUE_TOTAL CONFIG_TASK_TOTAL
+#define WAIT_QUEUE_HASH_SIZE (CONFIG_TASK_TOTAL * 2)
+#define WAIT_QUEUE_NONE 0xff
+
+#if CONFIG_TASK_TOTAL >= WAIT_QUEUE_NONE
+#error "CONFIG_TASK_TOTAL must be less than 255 to use wait queues"
+#endif
+
+typedef struct {
+  volatile void *block_object;
+  u8 head;
+  u8 tail;
+  u8 count;
+  u8 next_free;
+} wait_queue_t;
+
+static volatile wait_queue_t m_wait_queue[WAIT_QUEUE_TOTAL] MCU_SYS_MEM;
+// open addressed index from the object address to the one-based queue number
+static volatile u8 m_wait_queue_hash[WAIT_QUEUE_HASH_SIZE] MCU_SYS_MEM;
+static volatile u8 m_wait_queue_free MCU_SYS_MEM;
+
+static int hash_home(volatile void *block_object);
+static int hash_find(volatile void *block_object);
+static void hash_remove(int queue);
+static int queue_get_priority(int id);
+
+void scheduler_wait_queue_init() {
+  for (int i = 0; i < WAIT_QUEUE_TOTAL; i++) {
+    m_wait_queue[i] = (wait_queue_t){.next_free = i + 1};
+  }
+  m_wait_queue[WAIT_QUEUE_TOTAL - 1].next_free = WAIT_QUEUE_NONE;
+  m_wait_queue_free = 0;
+  for (int i = 0; i < WAIT_QUEUE_HASH_SIZE; i++) {
+    m_wait_queue_hash[i] = 0;
+  }
+}
+
+int hash_home(volatile void *block_object) {
+  // objects are word aligned -- the low bits don't carry information
+  return ((u32)block_object >> 2) % WAIT_QUEUE_HASH_SIZE;
+}
+
+int hash_find(volatile void *block_object) {
+  int slot = hash_home(block_object);
+  for (int i = 0; i < WAIT_QUEUE_HASH_SIZE; i++) {
+    const int queue = m_wait_queue_hash[slot];
+    if (queue == 0) {
+      return -1;
+    }
+    if (m_wait_queue[queue - 1].block_object == block_object) {
+      return queue - 1;
+    }
+    slot = (slot + 1) % WAIT_QUEUE_HASH_SIZE;
+  }
+  return -1;
+}
+
+void hash_remove(int queue) {
+  int slot = hash_home(m_wait_queue[queue].block_object);
+  while (m_wait_queue_hash[slot] != queue + 1) {
+    slot = (slot + 1) % WAIT_QUEUE_HASH_SIZE;
+  }
+
+  // shift the following entries back so lookups never hit a hole
+  m_wait_queue_hash[slot] = 0;
+  int next = slot;
+  while (1) {
+    next = (next + 1) % WAIT_QUEUE_HASH_SIZE;
+    const int entry = m_wait_queue_hash[next];
+    if (entry == 0) {
+      break;
+    }
+    const int home = hash_home(m_wait_queue[entry - 1].block_object);
+    const int is_movable = (slot <= next) ? ((home <= slot) || (home > next))
+                                          : ((home <= slot) && (home > next));
+    if (is_movable) {
+      m_wait_queue_hash[slot] = entry;
+      m_wait_queue_hash[next] = 0;
+      slot = next;
+    }
+  }
+
+  m_wait_queue[queue].block_object = NULL;
+  m_wait_queue[queue].next_free = m_wait_queue_free;
+  m_wait_queue_free = queue;
+}
+
+int queue_get_priority(int id) {
+  return sos_sched_table[id].attr.schedparam.sched_priority;
+}
+
+void scheduler_wait_queue_root_append(int id, volatile void *block_object) {
+  const u32 primask = cortexm_root_enter_critical();
+  scheduler_wait_queue_root_remove(id);
+
+  int queue = hash_find(block_object);
+  if (queue < 0) {
+    // there is always a free queue because a task waits on one object at a time
+    // (task_root_delete() takes deleted tasks out of their queue)
+    if (m_wait_queue_free == WAIT_QUEUE_NONE) {
+      cortexm_root_exit_critical(primask);
+      sos_handle_event(SOS_EVENT_ROOT_FATAL, "wait queue");
+      return;
+    }
+    queue = m_wait_queue_free;
+    m_wait_queue_free = m_wait_queue[queue].next_free;
+    m_wait_queue[queue].block_object = block_object;
+    m_wait_queue[queue].count = 0;
+    int slot = hash_home(block_object);
+    while (m_wait_queue_hash[slot] != 0) {
+      slot = (slot + 1) % WAIT_QUEUE_HASH_SIZE;
+    }
+    m_wait_queue_hash[slot] = queue + 1;
+  }
+
+  volatile wait_queue_t *wait_queue = m_wait_queue + queue;
+  const int priority = queue_get_priority(id);
+
+  // insert behind every task with the same or higher priority (FIFO within priority)
+  int prev = WAIT_QUEUE_NONE;
+  int next = WAIT_QUEUE_NONE;
+  if (wait_queue->count) {
+    prev = wait_queue->tail;
+    while ((prev != WAIT_QUEUE_NONE) && (queue_get_priority(prev) < priority)) {
+      next = prev;
+      prev = sos_sched_table[prev].wait_prev;
+    }
+  }
+
+  sos_sched_table[id].wait_prev = prev;
+  sos_sched_table[id].wait_next = next;
+  if (prev == WAIT_QUEUE_NONE) {
+    wait_queue->head = id;
+  } else {
+    sos_sched_table[prev].wait_next = id;
+  }
+  if (next == WAIT_QUEUE_NONE) {
+    wait_queue->tail = id;
+  } else {
+    sos_sched_table[next].wait_prev = id;
+  }
+  wait_queue->count++;
+  sos_sched_table[id].wait_queue = queue + 1;
+  cortexm_root_exit_critical(primask);
+}
+
+void scheduler_wait_queue_root_remove(int id) {
+  const u32 primask = cortexm_root_enter_critical();
+  const int queue = sos_sched_table[id].wait_queue - 1;
+  if (queue >= 0) {
+    volatile wait_queue_t *wait_queue = m_wait_queue + queue;
+    const int prev = sos_sched_table[id].wait_prev;
+    const int next = sos_sched_table[id].wait_next;
+    if (prev == WAIT_QUEUE_NONE) {
+      wait_queue->head = next;
+    } else {
+      sos_sched_table[prev].wait_next = next;
+    }
+    if (next == WAIT_QUEUE_NONE) {
+      wait_queue->tail = prev;
+    } else {
+      sos_sched_table[next].wait_prev = prev;
+    }
+    sos_sched_table[id].wait_queue = 0;
+    wait_queue->count--;
+    if (wait_queue->count == 0) {
+      hash_remove(queue);
+    }
+  }
+  cortexm_root_exit_critical(primask);
+}
+
+void scheduler_wait_queue_root_update_priority(int id) {
+  const u32 primask = cortexm_root_enter_critical();
+  const int queue = sos_sched_table[id].wait_queue - 1;
+  if (queue >= 0) {
+    // queue the task again at its new priority
+    volatile void *block_object = m_wait_queue[queue].block_object;
+    scheduler_wait_queue_root_remove(id);
+    scheduler_wait_queue_root_append(id, block_object);
+  }
+  cortexm_root_exit_critical(primask);
+}
+
+int scheduler_wait_queue_get_head(volatile void *block_object) {
+  const int queue = hash_find(block_object);
+  if (queue < 0) {
+    return -1;
+  }
+
+  // the head is normally the answer -- skip tasks stopped by a signal
+  int id = m_wait_queue[queue].head;
+  for (int i = 0; (i < WAIT_QUEUE_TOTAL) && (id != WAIT_QUEUE_NONE); i++) {
+    if (task_enabled(id) && !task_active_asserted(id) && !task_stopped_asserted(id)) {
+      return id;
+    }
+    id = sos_sched_table[id].wait_next;
+  }
+  return -1;
+}
+
+int scheduler_wait_queue_root_unblock_all(void *block_object, int unblock_type) {
+  int priority = CONFIG_SCHED_LOWEST_PRIORITY - 1;
+  int queue;
+  while ((queue = hash_find(block_object)) >= 0) {
+    const int id = m_wait_queue[queue].head;
+    if (!task_enabled(id)) {
+      // the task was deleted while it was waiting
+      scheduler_wait_queue_root_remove(id);
+      continue;
+    }
+    // this removes the task from the queue (and frees the queue when it is empty)
+    scheduler_root_assert_active(id, unblock_type);
+    if (!task_stopped_asserted(id) && (queue_get_priority(id) > priority)) {
+      priority = queue_get_priority(id);
+    }
+  }
+  return priority;
+}
+
+/*! @} */
@@ -0,0 +1,33 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SCHEDULER_SCHEDULER_WAIT_QUEUE_H_
+#define SCHEDULER_SCHEDULER_WAIT_QUEUE_H_
+
+#include "scheduler_local.h"
+
+/*
+ * Tasks that block on a synchronization object (mutex, semaphore, condition)
+ * are linked into a wait queue owned by that object. The queue is ordered by
+ * priority and then by arrival so the head is always the highest priority
+ * task that has been waiting the longest.
+ *
+ * The links live in sched_task_t. The queues are looked up by object address
+ * because the POSIX object types don't have room for a queue head. A task only
+ * waits on one object at a time so CONFIG_TASK_TOTAL queues are enough.
+ */
+
+void scheduler_wait_queue_init();
+
+void scheduler_wait_queue_root_append(int id, volatile void *block_object)
+  MCU_ROOT_EXEC_CODE;
+void scheduler_wait_queue_root_remove(int id) MCU_ROOT_EXEC_CODE;
+// call when sched_priority of a task changes so it moves to its new place
+void scheduler_wait_queue_root_update_priority(int id) MCU_ROOT_EXEC_CODE;
+
+// the queues are changed by interrupts -- call this within a critical section (or
+// between LDREX and STREX, see scheduler_get_highest_priority_blocked())
+int scheduler_wait_queue_get_head(volatile void *block_object);
+int scheduler_wait_queue_root_unblock_all(void *block_object, int unblock_type)
+  MCU_ROOT_EXEC_CODE;
+
+#endif /* SCHEDULER_SCHEDULER_WAIT_QUEUE_H_ */
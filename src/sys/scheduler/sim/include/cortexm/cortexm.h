@@ -0,0 +1,54 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// the simulation is single threaded -- critical sections only count nesting,
+// service calls are counted plain function calls and the exclusive monitor is a flag
+
+#ifndef SIM_CORTEXM_CORTEXM_H_
+#define SIM_CORTEXM_CORTEXM_H_
+
+#include <sdk/types.h>
+
+extern int sim_critical_depth;
+
+static inline u32 cortexm_root_enter_critical() { return sim_critical_depth++; }
+static inline void cortexm_root_exit_critical(u32 primask) {
+  sim_critical_depth = primask;
+}
+
+extern int sim_svcall_count;
+extern int sim_root_depth; // non-zero while a service call runs
+
+typedef void (*cortexm_svcall_t)(void *);
+static inline void cortexm_svcall(cortexm_svcall_t call, void *args) {
+  sim_svcall_count++;
+  sim_root_depth++;
+  call(args);
+  sim_root_depth--;
+}
+#define CORTEXM_SVCALL_ENTER()
+
+// cleared by STREX and by any exception (sim_exclusive_clear())
+extern int sim_exclusive;
+
+static inline void sim_exclusive_clear() { sim_exclusive = 0; }
+static inline u32 __LDREXW(volatile u32 *address) {
+  sim_exclusive = 1;
+  return *address;
+}
+static inline u32 __STREXW(u32 value, volatile u32 *address) {
+  if (sim_exclusive == 0) {
+    return 1;
+  }
+  sim_exclusive = 0;
+  *address = value;
+  return 0;
+}
+static inline void __CLREX() { sim_exclusive = 0; }
+static inline void __DMB() {}
+
+static inline void cortexm_assign_zero_sum32(void *data, int count) {
+  (void)data;
+  (void)count;
+}
+
+#endif /* SIM_CORTEXM_CORTEXM_H_ */
@@ -0,0 +1,10 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_CORTEXM_FAULT_H_
+#define SIM_CORTEXM_FAULT_H_
+
+typedef struct {
+  int num;
+} fault_t;
+
+#endif /* SIM_CORTEXM_FAULT_H_ */
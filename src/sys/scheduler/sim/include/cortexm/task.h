@@ -0,0 +1,51 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// the task table fields used by the scheduler plus the real task_table.h helpers
+
+#ifndef SIM_CORTEXM_TASK_H_
+#define SIM_CORTEXM_TASK_H_
+
+#include <sdk/types.h>
+
+struct _reent;
+
+typedef union {
+  volatile u32 t_atomic[2];
+  volatile u64 t;
+} task_timer_t;
+
+typedef struct {
+  void *address;
+  u32 size;
+} task_memory_t;
+
+typedef struct {
+  task_memory_t code;
+  task_memory_t data;
+  task_memory_t stackguard;
+} task_memories_t;
+
+typedef struct {
+  int pid;
+  volatile s8 priority;
+  volatile u8 flags;
+  volatile u16 parent;
+  volatile task_timer_t timer;
+  void *global_reent;
+  void *reent;
+  volatile u8 ready_next;
+  volatile u8 ready_prev;
+  volatile u8 ready_priority;
+} task_t;
+
+#include "task_table.h"
+
+extern volatile s8 m_task_current_priority;
+
+u8 task_get_total();
+static inline s8 task_get_current_priority() { return m_task_current_priority; }
+static inline void task_root_set_current_priority(s8 value) {
+  m_task_current_priority = value;
+}
+
+#endif /* SIM_CORTEXM_TASK_H_ */
@@ -0,0 +1,28 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// host build stand-in for the SDK types used by the simulated sources
+
+#ifndef SIM_SDK_TYPES_H_
+#define SIM_SDK_TYPES_H_
+
+#include <stdint.h>
+
+typedef uint8_t u8;
+typedef int8_t s8;
+typedef uint16_t u16;
+typedef int16_t s16;
+typedef uint32_t u32;
+typedef int32_t s32;
+typedef uint64_t u64;
+typedef int64_t s64;
+
+#define MCU_PACK __attribute__((packed))
+#define MCU_SYS_MEM
+#define MCU_ROOT_CODE
+#define MCU_ROOT_EXEC_CODE
+#define MCU_WEAK __attribute__((weak))
+#define MCU_NAKED
+#define MCU_ALWAYS_INLINE __attribute__((always_inline))
+#define MCU_UNUSED_ARGUMENT(x) (void)(x)
+
+#endif /* SIM_SDK_TYPES_H_ */
@@ -0,0 +1,30 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// included before anything else (-include) so the newlib types win over glibc
+
+#ifndef SIM_HOST_H_
+#define SIM_HOST_H_
+
+// newlib uses an integer timer_t -- the scheduler encodes the task and slot in it
+#define __timer_t_defined 1
+typedef unsigned long timer_t;
+
+#include <pthread.h>
+#include <signal.h>
+
+#include <sdk/types.h>
+
+// newlib keeps the scheduling parameters in pthread_attr_t
+typedef struct {
+  int is_initialized;
+  void *stackaddr;
+  int stacksize;
+  int contentionscope;
+  int inheritsched;
+  int schedpolicy;
+  struct sched_param schedparam;
+  int detachstate;
+} sim_pthread_attr_t;
+#define pthread_attr_t sim_pthread_attr_t
+
+#endif /* SIM_HOST_H_ */
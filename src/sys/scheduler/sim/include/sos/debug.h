@@ -0,0 +1,25 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_SOS_DEBUG_H_
+#define SIM_SOS_DEBUG_H_
+
+#define sos_debug_log_error(...)                                                         \
+  do {                                                                                   \
+  } while (0)
+#define sos_debug_log_warning(...)                                                       \
+  do {                                                                                   \
+  } while (0)
+#define sos_debug_log_info(...)                                                          \
+  do {                                                                                   \
+  } while (0)
+#define sos_debug_printf(...)                                                            \
+  do {                                                                                   \
+  } while (0)
+#define SOS_DEBUG_PTHREAD 0
+#define SOS_DEBUG_LINE_TRACE()
+#define SOS_DEBUG_ENTER_TIMER_SCOPE(name)
+#define SOS_DEBUG_EXIT_TIMER_SCOPE(flags, name)
+#define SOS_DEBUG_ENTER_TIMER_SCOPE_AVERAGE(name)
+#define SOS_DEBUG_EXIT_TIMER_SCOPE_AVERAGE(flags, name, count)
+
+#endif /* SIM_SOS_DEBUG_H_ */
@@ -0,0 +1,37 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_SOS_SOS_H_
+#define SIM_SOS_SOS_H_
+
+#include <stdlib.h>
+
+#include <sdk/types.h>
+
+#define SOS_SCHEDULER_TIMEVAL_SECONDS 2048
+#define SOS_USECOND_PERIOD (1000000UL * SOS_SCHEDULER_TIMEVAL_SECONDS)
+
+#define SCHED_USECOND_TMR_SLEEP_OC 0
+#define SCHED_USECOND_TMR_SYSTEM_TIMER_OC 1
+#define SCHED_USECOND_TMR_MINIMUM_PROCESS_TIMER_INTERVAL 100
+
+#define SYSFS_GET_RETURN(value) (value)
+
+struct mcu_timeval {
+  u32 tv_sec;
+  u32 tv_usec;
+};
+
+typedef struct {
+  u32 loc;
+  u32 value;
+} mcu_channel_t;
+
+typedef struct {
+  u32 o_events;
+  void *data;
+} mcu_event_t;
+
+#define SOS_EVENT_ROOT_FATAL 1
+void sos_handle_event(int event, void *args);
+
+#endif /* SIM_SOS_SOS_H_ */
@@ -0,0 +1,38 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_SOS_CONFIG_H_
+#define SIM_SOS_CONFIG_H_
+
+#include "sos/sos.h"
+
+#define CONFIG_TASK_TOTAL 64
+#define CONFIG_TASK_PROCESS_TIMER_COUNT 4
+#define CONFIG_SCHED_LOWEST_PRIORITY 0
+#define CONFIG_SCHED_HIGHEST_PRIORITY 31
+#define CONFIG_PTHREAD_MAX_LOCKS 1024
+#define CONFIG_PTHREAD_MUTEX_PRIO_CEILING 0
+
+// the microsecond timer is simulated by main.c
+typedef struct {
+  void (*initialize)(
+    int (*handle_match_channel0)(void *, const mcu_event_t *),
+    int (*handle_match_channel1)(void *, const mcu_event_t *),
+    int (*handle_overflow)(void *, const mcu_event_t *));
+  u32 (*disable)();
+  void (*enable)();
+  void (*set_channel)(const mcu_channel_t *channel);
+  void (*get_channel)(mcu_channel_t *channel);
+} sos_clock_config_t;
+
+typedef struct {
+  u32 core_clock_frequency;
+} sos_sys_config_t;
+
+typedef struct {
+  sos_clock_config_t clock;
+  sos_sys_config_t sys;
+} sos_config_t;
+
+extern const sos_config_t sos_config;
+
+#endif /* SIM_SOS_CONFIG_H_ */
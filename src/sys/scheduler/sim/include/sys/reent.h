@@ -0,0 +1,8 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_SYS_REENT_H_
+#define SIM_SYS_REENT_H_
+
+struct _reent;
+
+#endif /* SIM_SYS_REENT_H_ */
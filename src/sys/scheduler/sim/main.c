@@ -0,0 +1,16 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include "sim.h"
+
+int main() {
+  test_process_timers();
+  test_wait_queue();
+  if (sim_failures) {
+    printf("FAILED (%d)\n", sim_failures);
+    return 1;
+  }
+  bench_process_timers();
+  bench_wait_queue();
+  printf("PASSED\n");
+  return 0;
+}
@@ -0,0 +1,215 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// POSIX process timers (scheduler_timing.c) against a model of the armed timers
+
+#include <stdlib.h>
+
+#include "sim.h"
+
+#include "../scheduler_timing.h"
+
+#define TIMER_TASK_COUNT 16
+#define TIMER_COUNT (TIMER_TASK_COUNT * CONFIG_TASK_PROCESS_TIMER_COUNT)
+
+static timer_t m_timer_list[TIMER_COUNT];
+
+static void start_timer_tasks(int task_count) {
+  sim_reset_tasks();
+  scheduler_timing_init();
+  for (int id = 1; id <= task_count; id++) {
+    sim_start_task(id, 1);
+    scheduler_timing_root_process_timer_initialize(id);
+    m_task_current = id;
+    for (int j = 0; j < CONFIG_TASK_PROCESS_TIMER_COUNT; j++) {
+      // the first slot of a process is reserved for alarm() -- use it directly
+      m_timer_list[(id - 1) * CONFIG_TASK_PROCESS_TIMER_COUNT + j] =
+        (j == 0) ? SCHEDULER_TIMING_PROCESS_TIMER(id, 0)
+                 : scheduler_timing_process_create_timer(NULL);
+    }
+  }
+  m_task_current = 0;
+}
+
+static int is_armed(timer_t timer_id) {
+  return scheduler_timing_process_timer(timer_id)->value.tv_sec
+         != SCHEDULER_TIMEVAL_SEC_INVALID;
+}
+
+static u32 timer_value(timer_t timer_id) {
+  return scheduler_timing_process_timer(timer_id)->value.tv_usec;
+}
+
+// the earliest armed timer (all timers stay in the first timer second)
+static u32 earliest_value(int timer_count) {
+  u32 result = SOS_USECOND_PERIOD + 1;
+  for (int i = 0; i < timer_count; i++) {
+    if (is_armed(m_timer_list[i]) && (timer_value(m_timer_list[i]) < result)) {
+      result = timer_value(m_timer_list[i]);
+    }
+  }
+  return result;
+}
+
+static void set_timer(timer_t timer_id, u32 value, u32 interval) {
+  const struct mcu_timeval value_tv = {.tv_sec = 0, .tv_usec = value};
+  const struct mcu_timeval interval_tv = {.tv_sec = 0, .tv_usec = interval};
+  struct mcu_timeval o_value;
+  struct mcu_timeval o_interval;
+  m_task_current = timer_id >> 8;
+  scheduler_timing_process_set_timer(
+    timer_id, 0, &value_tv, &interval_tv, &o_value, &o_interval);
+  m_task_current = 0;
+}
+
+// the signal was handled -- the timer can send another one
+static void deliver_signals() {
+  for (int i = 0; i < sim_signal_count; i++) {
+    const timer_t timer_id = sim_signal_list[i].value;
+    scheduler_timing_process_timer(timer_id)->o_flags &=
+      ~SCHEDULER_TIMING_PROCESS_TIMER_FLAG_IS_QUEUED;
+  }
+  sim_signal_count = 0;
+}
+
+void test_process_timers() {
+  start_timer_tasks(TIMER_TASK_COUNT);
+  srand(3);
+
+  u32 expected[TIMER_COUNT];
+  u32 interval[TIMER_COUNT];
+  int armed[TIMER_COUNT] = {0};
+  int fire_count = 0;
+
+  for (int iteration = 0; iteration < 200000; iteration++) {
+    if ((rand() % 3) == 0) {
+      // re-arm, change or cancel a timer (possibly one that is queued)
+      const int i = rand() % TIMER_COUNT;
+      if ((rand() % 4) == 0) {
+        scheduler_timing_process_cancel_timer(m_timer_list[i]);
+        armed[i] = 0;
+      } else {
+        const u32 value = 1 + rand() % 5000;
+        interval[i] = (rand() % 2) ? 100 + rand() % 3000 : 0;
+        set_timer(m_timer_list[i], value, interval[i]);
+        expected[i] = sim_now + value;
+        armed[i] = 1;
+      }
+      // the compare value may be early (a cancelled timer) but never late
+      SIM_CHECK(sim_channel[1] <= earliest_value(TIMER_COUNT));
+      continue;
+    }
+
+    const u32 match = sim_channel[1];
+    if (match > SOS_USECOND_PERIOD) {
+      SIM_CHECK(earliest_value(TIMER_COUNT) > SOS_USECOND_PERIOD);
+      continue;
+    }
+
+    // the timer reaches the compare value
+    sim_now = match;
+    sim_fire_process_timer_match();
+
+    // every expired timer sent exactly one signal at its time
+    int expired = 0;
+    for (int i = 0; i < TIMER_COUNT; i++) {
+      if (armed[i] && (expected[i] <= sim_now)) {
+        int sent = 0;
+        for (int j = 0; j < sim_signal_count; j++) {
+          sent += (sim_signal_list[j].value == (int)m_timer_list[i]);
+        }
+        SIM_CHECK(sent == 1);
+        SIM_CHECK(expected[i] == sim_now);
+        expired++;
+        if (interval[i]) {
+          expected[i] = sim_now + interval[i];
+        } else {
+          armed[i] = 0;
+        }
+      }
+      SIM_CHECK(is_armed(m_timer_list[i]) == armed[i]);
+      if (armed[i]) {
+        SIM_CHECK(timer_value(m_timer_list[i]) == expected[i]);
+      }
+    }
+    SIM_CHECK(expired == sim_signal_count);
+    SIM_CHECK(sim_channel[1] == earliest_value(TIMER_COUNT));
+    fire_count += expired;
+    deliver_signals();
+  }
+  SIM_CHECK(fire_count > 10000);
+  SIM_CHECK(sim_critical_depth == 0);
+}
+
+// the previous compare-match handler checked every timer slot of every task
+static u32 scan_process_timers(u32 now) {
+  u32 next = SOS_USECOND_PERIOD;
+  for (int i = 1; i < task_get_total(); i++) {
+    if (task_enabled(i)) {
+      for (int j = 0; j < CONFIG_TASK_PROCESS_TIMER_COUNT; j++) {
+        volatile sos_process_timer_t *timer = sos_sched_table[i].timer + j;
+        if (timer->o_flags & SCHEDULER_TIMING_PROCESS_TIMER_FLAG_IS_INITIALIZED) {
+          const u32 value = timer->value.tv_usec;
+          if ((timer->value.tv_sec == 0) && (value > now) && (value < next)) {
+            next = value;
+          }
+        }
+      }
+    }
+  }
+  return next;
+}
+
+static int compare_double(const void *a, const void *b) {
+  const double a_value = *(const double *)a;
+  const double b_value = *(const double *)b;
+  return (a_value > b_value) - (a_value < b_value);
+}
+
+// handler time per compare match with every task running periodic timers
+void bench_process_timers() {
+  printf("process timer compare match (periodic timers, %d tasks):\n", CONFIG_TASK_TOTAL - 1);
+  for (int task_count = 1; task_count < CONFIG_TASK_TOTAL; task_count *= 2) {
+    if (task_count > TIMER_TASK_COUNT) {
+      break;
+    }
+    start_timer_tasks(task_count);
+    // fill the rest of the table with tasks that have idle timers
+    for (int id = task_count + 1; id < CONFIG_TASK_TOTAL; id++) {
+      sim_start_task(id, 1);
+      scheduler_timing_root_process_timer_initialize(id);
+    }
+
+    const int timer_count = task_count * CONFIG_TASK_PROCESS_TIMER_COUNT;
+    srand(5);
+    for (int i = 0; i < timer_count; i++) {
+      set_timer(m_timer_list[i], 1 + rand() % 1000, 500 + rand() % 500);
+    }
+
+    static double elapsed[20000];
+    const int loops = sizeof(elapsed) / sizeof(double);
+    double total = 0;
+    double scan_total = 0;
+    volatile u32 sink = 0;
+    for (int i = 0; i < loops; i++) {
+      sim_now = sim_channel[1];
+      double start = sim_now_ns();
+      sim_fire_process_timer_match();
+      elapsed[i] = sim_now_ns() - start;
+      total += elapsed[i];
+      deliver_signals();
+
+      start = sim_now_ns();
+      sink += scan_process_timers(sim_now);
+      scan_total += sim_now_ns() - start;
+    }
+
+    qsort(elapsed, loops, sizeof(double), compare_double);
+    printf(
+      "  %3d armed timers: handler %.0f ns average %.0f ns 99th percentile, slot scan "
+      "%.0f ns\n",
+      timer_count,
+      total / loops,
+      elapsed[loops * 99 / 100],
+      scan_total / loops);
+  }
+}
@@ -0,0 +1,128 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// stand-ins for the hardware and for the parts of the kernel the simulated
+// scheduler sources call
+
+#include <string.h>
+#include <time.h>
+
+#include "sim.h"
+
+#include "../../signal/sig_local.h"
+#include "../scheduler_root.h"
+#include "../scheduler_timing.h"
+#include "../scheduler_wait_queue.h"
+
+volatile task_t sos_task_table[CONFIG_TASK_TOTAL];
+volatile sched_task_t sos_sched_table[CONFIG_TASK_TOTAL];
+volatile s8 m_task_current_priority;
+volatile int m_task_current;
+int sim_critical_depth;
+int sim_svcall_count;
+int sim_root_depth;
+int sim_exclusive;
+int sim_failures;
+
+u32 sim_now;
+u32 sim_channel[2];
+static int (*sim_handle_process_timer_match)(void *, const mcu_event_t *);
+
+sim_signal_t sim_signal_list[4096];
+int sim_signal_count;
+
+u8 task_get_total() { return CONFIG_TASK_TOTAL; }
+void task_root_update_ready(int id) { MCU_UNUSED_ARGUMENT(id); }
+
+static void sim_clock_initialize(
+  int (*handle_match_channel0)(void *, const mcu_event_t *),
+  int (*handle_match_channel1)(void *, const mcu_event_t *),
+  int (*handle_overflow)(void *, const mcu_event_t *)) {
+  MCU_UNUSED_ARGUMENT(handle_match_channel0);
+  MCU_UNUSED_ARGUMENT(handle_overflow);
+  sim_handle_process_timer_match = handle_match_channel1;
+}
+
+static u32 sim_clock_disable() { return sim_now; }
+static void sim_clock_enable() {}
+static void sim_clock_set_channel(const mcu_channel_t *channel) {
+  sim_channel[channel->loc] = channel->value;
+}
+static void sim_clock_get_channel(mcu_channel_t *channel) {
+  channel->value = sim_channel[channel->loc];
+}
+
+const sos_config_t sos_config = {
+  .clock =
+    {.initialize = sim_clock_initialize,
+     .disable = sim_clock_disable,
+     .enable = sim_clock_enable,
+     .set_channel = sim_clock_set_channel,
+     .get_channel = sim_clock_get_channel},
+  .sys = {.core_clock_frequency = 120000000UL}};
+
+int sim_fire_process_timer_match() { return sim_handle_process_timer_match(0, 0); }
+
+void sim_reset_tasks() {
+  memset((void *)sos_task_table, 0, sizeof(sos_task_table));
+  memset((void *)sos_sched_table, 0, sizeof(sos_sched_table));
+  sim_signal_count = 0;
+  sim_now = 1000;
+  sim_channel[0] = SOS_USECOND_PERIOD + 1;
+  sim_channel[1] = SOS_USECOND_PERIOD + 1;
+  m_task_current = 0;
+  m_task_current_priority = 0;
+}
+
+void sim_start_task(int id, int priority) {
+  sos_task_table[id].pid = id;
+  sos_task_table[id].priority = priority;
+  sos_task_table[id].flags |= TASK_FLAGS_USED | TASK_FLAGS_ACTIVE;
+}
+
+double sim_now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int signal_root_send(
+  int send_tid,
+  int tid,
+  int si_signo,
+  int si_sigcode,
+  int sig_value,
+  int forward) {
+  MCU_UNUSED_ARGUMENT(send_tid);
+  MCU_UNUSED_ARGUMENT(si_sigcode);
+  MCU_UNUSED_ARGUMENT(forward);
+  if (sim_signal_count < (int)(sizeof(sim_signal_list) / sizeof(sim_signal_t))) {
+    sim_signal_list[sim_signal_count] = (sim_signal_t){
+      .tid = tid, .signo = si_signo, .value = sig_value, .now = sim_now};
+    sim_signal_count++;
+  }
+  return 0;
+}
+
+int sim_fatal_count;
+void sos_handle_event(int event, void *args) {
+  MCU_UNUSED_ARGUMENT(event);
+  MCU_UNUSED_ARGUMENT(args);
+  sim_fatal_count++;
+}
+
+// same as scheduler_root.c
+void scheduler_root_assert_active(int id, int unblock_type) {
+  MCU_UNUSED_ARGUMENT(unblock_type);
+  task_assert_active(id);
+  sos_sched_table[id].block_object = NULL;
+  scheduler_wait_queue_root_remove(id);
+  scheduler_timing_root_cancel_wake(id);
+  sos_sched_table[id].wake.tv_sec = SCHEDULER_TIMEVAL_SEC_INVALID;
+  sos_sched_table[id].wake.tv_usec = 0;
+}
+
+void scheduler_root_update_on_sleep() {}
+void scheduler_root_update_on_wake(int id, int new_priority) {
+  MCU_UNUSED_ARGUMENT(id);
+  MCU_UNUSED_ARGUMENT(new_priority);
+}
@@ -0,0 +1,49 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <stdio.h>
+
+#include "../scheduler_local.h"
+
+extern int sim_failures;
+
+#define SIM_CHECK(x)                                                                     \
+  do {                                                                                   \
+    if (!(x)) {                                                                          \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #x);                       \
+      sim_failures++;                                                                    \
+      return;                                                                            \
+    }                                                                                    \
+  } while (0)
+
+// microsecond timer
+extern u32 sim_now;
+extern u32 sim_channel[2];
+int sim_fire_process_timer_match();
+
+// tasks
+void sim_reset_tasks();
+void sim_start_task(int id, int priority);
+double sim_now_ns();
+
+// signals sent by the process timers
+typedef struct {
+  int tid;
+  int signo;
+  int value;
+  u32 now;
+} sim_signal_t;
+
+extern sim_signal_t sim_signal_list[];
+extern int sim_signal_count;
+
+extern int sim_fatal_count;
+
+void test_process_timers();
+void test_wait_queue();
+void bench_wait_queue();
+void bench_process_timers();
+
+#endif /* SIM_H_ */
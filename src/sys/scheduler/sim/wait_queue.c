@@ -0,0 +1,185 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// wait queues (scheduler_wait_queue.c) against a model of the blocked tasks
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+
+#include "../scheduler_root.h"
+#include "../scheduler_timing.h"
+#include "../scheduler_wait_queue.h"
+
+#define OBJECT_COUNT 6
+
+static u32 m_object[OBJECT_COUNT];
+// arrival order of each blocked task (the model)
+static u32 m_arrival[CONFIG_TASK_TOTAL];
+static int m_object_index[CONFIG_TASK_TOTAL];
+static u32 m_arrival_count;
+
+static int get_priority(int id) { return sos_sched_table[id].attr.schedparam.sched_priority; }
+
+static void set_priority(int id, int priority) {
+  sos_sched_table[id].attr.schedparam.sched_priority = priority;
+  task_set_priority(id, priority);
+}
+
+static void start_tasks() {
+  sim_reset_tasks();
+  scheduler_wait_queue_init();
+  for (int id = 1; id < CONFIG_TASK_TOTAL; id++) {
+    sim_start_task(id, 0);
+    set_priority(id, 0);
+    m_object_index[id] = -1;
+  }
+}
+
+// scheduler_timing_root_timedblock() with a timeout
+static void block(int id, int object_index) {
+  struct mcu_timeval abs_time = {.tv_sec = 1, .tv_usec = id};
+  task_deassert_active(id);
+  m_task_current = id;
+  scheduler_timing_root_timedblock(m_object + object_index, &abs_time);
+  m_task_current = 0;
+  m_object_index[id] = object_index;
+  m_arrival[id] = m_arrival_count++;
+}
+
+// the task the model expects at the head of the queue
+static int model_head(int object_index) {
+  int result = -1;
+  for (int id = 1; id < CONFIG_TASK_TOTAL; id++) {
+    if (m_object_index[id] != object_index) {
+      continue;
+    }
+    if (
+      (result < 0) || (get_priority(id) > get_priority(result))
+      || ((get_priority(id) == get_priority(result)) && (m_arrival[id] < m_arrival[result]))) {
+      result = id;
+    }
+  }
+  return result;
+}
+
+// the same steps as task_root_delete() and the reuse of the slot
+static void delete_task(int id) {
+  scheduler_wait_queue_root_remove(id);
+  scheduler_timing_root_cancel_wake(id);
+  task_deassert_used(id);
+  sos_sched_table[id] = (sched_task_t){};
+  m_object_index[id] = -1;
+  sim_start_task(id, 0);
+  set_priority(id, 0);
+}
+
+void test_wait_queue() {
+  start_tasks();
+  srand(7);
+  for (int iteration = 0; iteration < 500000; iteration++) {
+    const int id = 1 + rand() % (CONFIG_TASK_TOTAL - 1);
+    const int object_index = rand() % OBJECT_COUNT;
+    switch (rand() % 6) {
+    case 0:
+    case 1:
+      if (m_object_index[id] < 0) {
+        set_priority(id, rand() % 4);
+        block(id, object_index);
+      }
+      break;
+    case 2: {
+      // a sem_post() or mutex unlock wakes the head
+      const int head = scheduler_wait_queue_get_head(m_object + object_index);
+      SIM_CHECK(head == model_head(object_index));
+      if (head > 0) {
+        scheduler_root_assert_active(head, SCHEDULER_UNBLOCK_SEMAPHORE);
+        m_object_index[head] = -1;
+      }
+    } break;
+    case 3:
+      if ((rand() % 8) == 0) {
+        // pthread_cond_broadcast() wakes all of them
+        scheduler_wait_queue_root_unblock_all(m_object + object_index, SCHEDULER_UNBLOCK_COND);
+        for (int i = 1; i < CONFIG_TASK_TOTAL; i++) {
+          if (m_object_index[i] == object_index) {
+            SIM_CHECK(task_active_asserted(i));
+            m_object_index[i] = -1;
+          }
+        }
+      }
+      break;
+    case 4:
+      // the task is killed while it may be waiting
+      delete_task(id);
+      break;
+    case 5:
+      // pthread_setschedparam() on a task that may be waiting
+      set_priority(id, rand() % 4);
+      scheduler_wait_queue_root_update_priority(id);
+      m_arrival[id] = m_arrival_count++;
+      break;
+    }
+
+    for (int i = 0; i < OBJECT_COUNT; i++) {
+      SIM_CHECK(scheduler_wait_queue_get_head(m_object + i) == model_head(i));
+    }
+  }
+  SIM_CHECK(sim_fatal_count == 0);
+  SIM_CHECK(sim_critical_depth == 0);
+
+  // tasks killed while waiting on short lived objects don't use up the queues
+  start_tasks();
+  static u32 objects[CONFIG_TASK_TOTAL * 8];
+  for (int i = 0; i < (int)(sizeof(objects) / sizeof(u32)); i++) {
+    const int id = 1 + i % (CONFIG_TASK_TOTAL - 1);
+    task_deassert_active(id);
+    struct mcu_timeval abs_time = {.tv_sec = 1, .tv_usec = i};
+    m_task_current = id;
+    scheduler_timing_root_timedblock(objects + i, &abs_time);
+    m_task_current = 0;
+    delete_task(id);
+    // a new object at the same address doesn't find the old waiter
+    SIM_CHECK(scheduler_wait_queue_get_head(objects + i) == -1);
+  }
+  SIM_CHECK(sim_fatal_count == 0);
+}
+
+// the previous lookup compared block_object of every task
+static int scan_highest_priority_blocked(void *block_object) {
+  int result = -1;
+  for (int id = 1; id < CONFIG_TASK_TOTAL; id++) {
+    if (
+      task_enabled(id) && !task_active_asserted(id)
+      && (sos_sched_table[id].block_object == block_object)) {
+      if ((result < 0) || (get_priority(id) > get_priority(result))) {
+        result = id;
+      }
+    }
+  }
+  return result;
+}
+
+void bench_wait_queue() {
+  start_tasks();
+  for (int id = 1; id < CONFIG_TASK_TOTAL; id++) {
+    block(id, id % OBJECT_COUNT);
+  }
+  const int loops = 200000;
+  volatile int sink = 0;
+  double start = sim_now_ns();
+  for (int i = 0; i < loops; i++) {
+    sink += scan_highest_priority_blocked(m_object + (i % OBJECT_COUNT));
+  }
+  const double scan = (sim_now_ns() - start) / loops;
+  start = sim_now_ns();
+  for (int i = 0; i < loops; i++) {
+    sink += scheduler_wait_queue_get_head(m_object + (i % OBJECT_COUNT));
+  }
+  const double queue = (sim_now_ns() - start) / loops;
+  printf(
+    "highest priority blocked task (%d tasks): table scan %.1f ns, wait queue %.1f ns\n",
+    CONFIG_TASK_TOTAL - 1,
+    scan,
+    queue);
+}
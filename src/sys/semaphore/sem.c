@@ -18,12 +18,15 @@
 
 #include "../scheduler/scheduler_root.h"
 #include "../scheduler/scheduler_timing.h"
+#include "../scheduler/scheduler_wait_queue.h"
 #include "semaphore.h"
 
 #include "sos/debug.h"
+#include "sos/pool.h"
 
 #define SEM_FILE_HDR_SIGNATURE 0x1285ABC8
 #define SEM_FILE_HDR_NOT_SIGNATURE (~SEM_FILE_HDR_SIGNATURE)
+#define SEM_POOL_GROW_COUNT 4
 
 /*! \cond */
 typedef struct {
@@ -53,6 +56,7 @@ typedef struct {
 } root_sem_args_t;
 
 static sem_list_t *sem_first = 0;
+static sos_pool_t sem_pool = SOS_POOL_INITIALIZER(sizeof(sem_list_t), SEM_POOL_GROW_COUNT);
 
 static sem_t *sem_find_named(const char *name) {
   sem_list_t *entry;
@@ -67,30 +71,33 @@ static sem_t *sem_find_named(const char *name) {
 }
 
 static sem_t *sem_find_free() {
-  sem_list_t *entry;
-  sem_list_t *new_entry;
-  sem_list_t *last_entry;
-  last_entry = 0;
-  for (entry = sem_first; entry != 0; entry = entry->next) {
-    last_entry = entry;
-    if (entry->sem.is_initialized == 0) {
-      return &entry->sem;
-    }
-  }
-
-  // no free semaphores
-  new_entry = _malloc_r(sos_task_table[0].global_reent, sizeof(sem_list_t));
+  sem_list_t *new_entry = sos_pool_alloc(&sem_pool);
   if (new_entry == 0) {
     return SEM_FAILED;
   }
-  if (last_entry == 0) {
-    sem_first = new_entry;
-  } else {
-    last_entry->next = new_entry;
-  }
-  new_entry->next = 0;
+  memset(new_entry, 0, sizeof(sem_list_t));
+  new_entry->next = sem_first;
+  sem_first = new_entry;
   return &new_entry->sem;
 }
+
+static void sem_delete(sem_t *sem) {
+  sem_list_t *entry;
+  sem_list_t *last_entry = 0;
+  sem->is_initialized = 0;
+  for (entry = sem_first; entry != 0; entry = entry->next) {
+    if (&entry->sem == sem) {
+      if (last_entry == 0) {
+        sem_first = entry->next;
+      } else {
+        last_entry->next = entry->next;
+      }
+      sos_pool_free(&sem_pool, entry);
+      return;
+    }
+    last_entry = entry;
+  }
+}
 /*! \endcond */
 
 /*! \details Initializes \a sem as an unnamed semaphore with
@@ -217,8 +224,8 @@ sem_t *sem_open(const char *name, int oflag, ...) {
   case 0:
     // Create the new semaphore
     new_sem = sem_find_free();
-    if (new_sem == NULL) {
-      // errno is set by malloc
+    if (new_sem == SEM_FAILED) {
+      // errno is set by the pool
       return SEM_FAILED;
     }
 
@@ -264,7 +271,7 @@ int sem_close(sem_t *sem) {
   if (sem->references == 0) {
     if (sem->is_initialized == 2) {
       // Close and delete
-      sem->is_initialized = 0;
+      sem_delete(sem);
       return 0;
     }
   }
@@ -282,8 +289,6 @@ int sem_close(sem_t *sem) {
  *
  */
 int sem_post(sem_t *sem) {
-  int new_thread;
-
   if (check_initialized(sem) < 0) {
     return -1;
   }
@@ -291,12 +296,8 @@ int sem_post(sem_t *sem) {
   // unlock the semaphore -- increment the semaphore
   sem->value++;
 
-  // see if any tasks are blocked on this semaphore
-  new_thread = scheduler_get_highest_priority_blocked(sem);
-
-  if (new_thread != -1) {
-    cortexm_svcall(svcall_sem_post, &new_thread);
-  }
+  // wake the task at the head of the semaphore's wait queue (if any)
+  cortexm_svcall(svcall_sem_post, sem);
 
   return 0;
 }
@@ -399,7 +400,7 @@ int sem_unlink(const char *name) {
 
   if (sem->references == 0) {
     // Close and delete
-    sem->is_initialized = 0;
+    sem_delete(sem);
     return 0;
   } else {
     // Close but don't delete until all references are gone
@@ -441,7 +442,10 @@ int sem_wait(sem_t *sem) {
 
 void svcall_sem_post(void *args) {
   CORTEXM_SVCALL_ENTER();
-  int id = *((int *)args);
+  const int id = scheduler_get_highest_priority_blocked(args);
+  if (id == -1) {
+    return;
+  }
   sos_sched_table[id].block_object = NULL;
   scheduler_root_assert_active(id, SCHEDULER_UNBLOCK_SEMAPHORE);
   scheduler_root_update_on_wake(id, task_get_priority(id));
@@ -480,6 +484,7 @@ void svcall_sem_wait(void *args) {
 
   if (p->sem->value <= 0) {
     // task must be blocked until the semaphore is available
+    scheduler_wait_queue_root_append(task_get_current(), p->sem);
     scheduler_root_update_on_sleep();
     p->result = -1; // didn't get the semaphore
   } else {
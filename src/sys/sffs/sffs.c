@@ -28,6 +28,16 @@ extern int pthread_mutex_force_unlock(pthread_mutex_t *mutex);
 
 #define OPENDIR_HANDLE ((void*)0x1234567)
 
+#if !defined SFFS_GC_STACK_SIZE
+#define SFFS_GC_STACK_SIZE 2048
+#endif
+
+#define SFFS_GC_DEFAULT_INTERVAL 100
+
+#ifndef __SIM__
+static void * gc_thread(void * args);
+static int start_gc_thread(const void * cfg);
+#endif
 
 #define DEBUG_LEVEL 3
 
@@ -57,8 +67,21 @@ static void unlock_sffs(const sffs_config_t * config){
 
 
 int sffs_unmount(const void * cfg){
-	//close the device access file descriptor
-	return sffs_dev_close(cfg);
+	int ret;
+	lock_sffs(cfg);
+	sffs_block_freemap(cfg);
+	sffs_serialno_freeindex(cfg);
+	//close the device access file descriptor -- the gc thread stops when it sees this
+	ret = sffs_dev_close(cfg);
+	unlock_sffs(cfg);
+
+#ifndef __SIM__
+	//the thread may be sleeping or waiting for the lock
+	while( SFFS_STATE(cfg)->is_gc_running ){
+		usleep(1000);
+	}
+#endif
+	return ret;
 }
 
 int sffs_ismounted(const void * cfg){
@@ -96,6 +119,9 @@ int sffs_init(const void * cfg){
 		return -1;
 	}
 
+	//the map is rebuilt once the file system is checked
+	sffs_block_freemap(cfg);
+
 	bad_files = 0;
 	clean_open_blocks = false;
 
@@ -142,12 +168,103 @@ int sffs_init(const void * cfg){
 		}
 	}
 
+	if ( sffs_block_initmap(cfg) < 0 ){
+		//the allocator falls back to scanning the device
+		mcu_debug_log_warning(MCU_DEBUG_FILESYSTEM, "failed to build block map");
+	}
+
 	mcu_debug_log_info(MCU_DEBUG_FILESYSTEM, "Found %d bad files", bad_files);
 
-	//start a new thread to handle reads/writes if asynchronous IO will be supported
+#ifndef __SIM__
+	if( (SFFS_CONFIG(cfg)->gc_reserve > 0) && (SFFS_STATE(cfg)->is_gc_running == 0) ){
+		if( start_gc_thread(cfg) < 0 ){
+			//blocks are still erased when they are allocated
+			mcu_debug_log_warning(MCU_DEBUG_FILESYSTEM, "failed to start gc thread");
+		}
+	}
+#endif
+
 	return 0;
 }
 
+int sffs_gc(const void * cfg, int reserve){
+	int ret;
+
+	//one section erase or one list consolidation per call so writers don't wait long
+	lock_sffs(cfg);
+	if( sffs_ismounted(cfg) == 0 ){
+		//unmounted while the gc thread was waiting for the lock
+		unlock_sffs(cfg);
+		return 0;
+	}
+	ret = sffs_block_gc(cfg, reserve);
+	if( (ret == 0) || (ret == 2) ){
+		//list blocks keep their sections from being erased (without the index the list is only scanned if blocks are short)
+		ret = sffs_serialno_gc(cfg, ret == 2);
+	}
+	unlock_sffs(cfg);
+	return ret;
+}
+
+#ifndef __SIM__
+int start_gc_thread(const void * cfg){
+	pthread_attr_t attr;
+	pthread_t thread;
+	struct sched_param param;
+
+	if( pthread_attr_init(&attr) < 0 ){
+		return -1;
+	}
+
+	param.sched_priority = 0;
+	pthread_attr_setstacksize(&attr, SFFS_GC_STACK_SIZE);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+	pthread_attr_setschedparam(&attr, &param);
+
+	SFFS_STATE(cfg)->is_gc_running = 1;
+	if( pthread_create(&thread, &attr, gc_thread, (void*)cfg) < 0 ){
+		SFFS_STATE(cfg)->is_gc_running = 0;
+		pthread_attr_destroy(&attr);
+		return -1;
+	}
+
+	pthread_attr_destroy(&attr);
+	return 0;
+}
+
+void * gc_thread(void * args){
+	const void * cfg = args;
+	u32 interval;
+	int ret;
+
+	interval = SFFS_CONFIG(cfg)->gc_interval;
+	if( interval == 0 ){
+		interval = SFFS_GC_DEFAULT_INTERVAL;
+	}
+
+	while( sffs_ismounted(cfg) ){
+		//keep going while there is work -- the mutex goes to any waiting writer between slices
+		do {
+			ret = sffs_gc(cfg, SFFS_CONFIG(cfg)->gc_reserve);
+		} while( (ret == 1) && sffs_ismounted(cfg) );
+
+		if( ret < 0 ){
+			mcu_debug_log_warning(MCU_DEBUG_FILESYSTEM, "gc failed");
+		}
+
+		if( interval >= 1000 ){
+			sleep(interval / 1000);
+		}
+		usleep((interval % 1000) * 1000);
+	}
+
+	SFFS_STATE(cfg)->is_gc_running = 0;
+	return NULL;
+}
+#endif
+
 
 int sffs_mkfs(const void * cfg){
 	int ret;
@@ -160,6 +277,10 @@ int sffs_mkfs(const void * cfg){
 		SFFS_CONFIG(cfg)->drive.state->file.fs = NULL;
 		mcu_debug_log_error(MCU_DEBUG_FILESYSTEM, "failed to erase");
 	} else {
+		if ( SFFS_STATE(cfg)->block_map != NULL ){
+			//the device is blank -- start the map over
+			sffs_block_initmap(cfg);
+		}
 		mcu_debug_log_info(MCU_DEBUG_FILESYSTEM, "Init serial number");
 		if ( (ret = sffs_serialno_mkfs(cfg)) < 0 ){
 			//failed to format so no other access is allowed
@@ -305,6 +426,7 @@ int sffs_open(const void * cfg, void ** handle, const char * path, int flags, in
 		ret = SYSFS_SET_RETURN(ENOMEM);
 		goto sffs_open_unlock;
 	}
+	h->segment_map = NULL;
 
 	ret = 0;
 	name = sysfs_getfilename(path, NULL);
@@ -350,7 +472,8 @@ int sffs_open(const void * cfg, void ** handle, const char * path, int flags, in
 	}
 
 	//unlock()
-	if ( ret == -1 ){
+	if ( ret < 0 ){
+		sffs_file_freemap(h);
 		free(h);
 		h = NULL;
 	}
@@ -385,7 +508,7 @@ int sffs_read(const void * cfg, void * handle, int flags, int loc, void * buf, i
 		return SYSFS_SET_RETURN(EACCES);
 	}
 
-	if ( sffs_file_startread(cfg, handle) == nbyte ){
+	if ( (sffs_file_startread(cfg, handle) == nbyte) || (op.nbyte == 0) ){
 		return op.nbyte;
 	}
 
@@ -428,10 +551,16 @@ int sffs_write(const void * cfg, void * handle, int flags, int loc, const void *
 		return SYSFS_SET_RETURN(EACCES);
 	}
 
-	if ( sffs_file_startwrite(cfg, handle) == nbyte ){
+	ret = sffs_file_startwrite(cfg, handle);
+	if ( ret == nbyte ){
 		return op.nbyte;
 	}
 
+	if ( ret < 0 ){
+		//files can't have holes
+		return SYSFS_SET_RETURN(EINVAL);
+	}
+
 	lock_sffs(cfg);
 	if ( sffs_file_finishwrite(cfg, handle) < 0 ){
 		ret = -1;
@@ -450,6 +579,7 @@ int sffs_close(const void * cfg, void ** handle){
 	lock_sffs(cfg);
 	ret = sffs_file_close(cfg, h);
 	*handle = NULL;
+	sffs_file_freemap(h);
 	free(h);
 	unlock_sffs(cfg);
 	if( ret < 0 ){
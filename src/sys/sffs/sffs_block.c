@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stddef.h>
 
 #include "sffs_block.h"
@@ -11,13 +12,50 @@
 
 #define DEBUG_LEVEL 10
 
+//block states in the RAM map (one nibble per block)
+#define MAP_FREE 0
+#define MAP_OPEN 1
+#define MAP_CLOSED 2
+#define MAP_DIRTY 3
+#define MAP_STATE_MASK 0x03
+#define MAP_LIST 0x04 //the block belongs to CL_SERIALNO_LIST
+
+#define SECTION_OWNER_NONE SERIALNO_INVALID
+#define SECTION_OWNER_MIXED (SERIALNO_INVALID-1)
+
+typedef struct {
+	serial_t owner; //serial number of all the live (open or closed) blocks in the section
+	u16 free;
+	u16 live;
+} block_section_t;
+
+typedef struct {
+	int total;
+	int eraseable;
+	int sections;
+	int cursor; //all sections before the cursor are full
+	block_section_t * section;
+	u8 * state;
+} block_map_t;
+
 static int get_sffs_block_addr(const void * cfg, block_t block){
 	return BLOCK_SIZE * block;
 }
 
 static block_t alloc_block(const void * cfg, serial_t serialno, block_t hint, uint8_t type);
+static block_t alloc_block_map(const void * cfg, block_map_t * map, serial_t serialno, block_t hint, uint8_t type);
+static int load_status(const void * cfg, block_t block, sffs_block_hdr_t * hdr);
+static block_map_t * get_map(const void * cfg);
+static u8 map_get(block_map_t * map, block_t block);
+static void map_set(block_map_t * map, block_t block, u8 state, serial_t serialno);
+static void map_erase_section(block_map_t * map, block_t block);
+static int map_find_free(block_map_t * map, int section);
+static u8 get_map_state(uint8_t status);
+static uint8_t get_map_status(u8 state);
 static int erase_dirty_blocks(const void * cfg, int max_written);
 static int erase_dirty_block(const void * cfg, block_t sffs_block_num);
+static int get_written(const void * cfg, block_t sffs_block_num, int * written);
+static int erase_section(const void * cfg, block_t sffs_block_num, int written);
 
 block_t sffs_block_geteraseable(const void * cfg){
 	return sffs_dev_geterasesize(cfg) / BLOCK_SIZE;
@@ -29,10 +67,19 @@ int sffs_block_gettotal(const void * cfg){
 
 static int mark_allocated(const void * cfg, block_t block, serial_t serialno, uint8_t type){
 	sffs_block_hdr_t hdr;
+	block_map_t * map;
 	hdr.type = type;
 	hdr.serialno = serialno;
 	hdr.status = BLOCK_STATUS_OPEN;
-	return sffs_dev_write(cfg, get_sffs_block_addr(cfg, block), &hdr, sizeof(hdr));
+	if ( sffs_dev_write(cfg, get_sffs_block_addr(cfg, block), &hdr, sizeof(hdr)) != sizeof(hdr) ){
+		return -1;
+	}
+
+	map = get_map(cfg);
+	if( map != NULL ){
+		map_set(map, block, MAP_OPEN | (serialno == CL_SERIALNO_LIST ? MAP_LIST : 0), serialno);
+	}
+	return 0;
 }
 
 /*! \details This function reads the serial number associated with the block.
@@ -120,9 +167,17 @@ int sffs_block_save(const void * cfg, block_t sffs_block_num, sffs_block_data_t
 }
 
 int sffs_block_saveraw(const void * cfg, block_t sffs_block_num, sffs_block_data_t * data){
+	block_map_t * map;
 	if ( sffs_dev_write(cfg, get_sffs_block_addr(cfg, sffs_block_num), data, sizeof(*data) ) != sizeof(*data)  ){
 		return -1;
 	}
+
+	map = get_map(cfg);
+	if( map != NULL ){
+		map_set(map, sffs_block_num,
+				  get_map_state(data->hdr.status) | (data->hdr.serialno == CL_SERIALNO_LIST ? MAP_LIST : 0),
+				  data->hdr.serialno);
+	}
 	return 0;
 }
 
@@ -163,10 +218,152 @@ int sffs_block_loadhdr(const void * cfg, sffs_block_hdr_t * dest, block_t src){
 }
 
 int sffs_block_setstatus(const void * cfg, block_t block, uint8_t status){
+	int ret;
+	u8 state;
+	block_map_t * map;
 	if ( block == BLOCK_INVALID ){
 		return -1;
 	}
-	return sffs_dev_write(cfg, get_sffs_block_addr(cfg, block) + offsetof(sffs_block_hdr_t, status), &status, sizeof(status));
+	ret = sffs_dev_write(cfg, get_sffs_block_addr(cfg, block) + offsetof(sffs_block_hdr_t, status), &status, sizeof(status));
+
+	map = get_map(cfg);
+	if( (ret == sizeof(status)) && (map != NULL) ){
+		//flash can only clear bits so the status on the device is old & new
+		state = map_get(map, block);
+		map_set(map, block,
+				  get_map_state(get_map_status(state) & status) | (state & MAP_LIST),
+				  (state & MAP_LIST) ? CL_SERIALNO_LIST : SERIALNO_INVALID);
+	}
+	return ret;
+}
+
+int sffs_block_initmap(const void * cfg){
+	sffs_block_hdr_t hdr;
+	block_map_t * map;
+	int i;
+	int total_blocks;
+	int eraseable_blocks;
+	int sections;
+
+	sffs_block_freemap(cfg);
+
+	eraseable_blocks = sffs_block_geteraseable(cfg);
+	total_blocks = sffs_block_gettotal(cfg);
+	sections = (total_blocks + eraseable_blocks - 1) / eraseable_blocks;
+
+	//the map is optional -- without it, the allocator scans the block headers on the device
+	map = malloc(sizeof(block_map_t) + sections*sizeof(block_section_t) + (total_blocks+1)/2);
+	if( map == NULL ){
+		sffs_error("no memory for the block map\n");
+		return -1;
+	}
+
+	map->total = total_blocks;
+	map->eraseable = eraseable_blocks;
+	map->sections = sections;
+	map->cursor = 0;
+	map->section = (block_section_t*)(map + 1);
+	map->state = (u8*)(map->section + sections);
+
+	for(i=0; i < sections; i++){
+		map_erase_section(map, i*eraseable_blocks);
+	}
+
+	for(i = FIRST_BLOCK; i < total_blocks; i++){
+		if ( sffs_dev_read(cfg, get_sffs_block_addr(cfg, i), &hdr, sizeof(hdr)) != sizeof(hdr) ){
+			sffs_error("failed to read device\n");
+			free(map);
+			return -1;
+		}
+
+		if( hdr.status != BLOCK_STATUS_FREE ){
+			map_set(map, i,
+					  get_map_state(hdr.status) | (hdr.serialno == CL_SERIALNO_LIST ? MAP_LIST : 0),
+					  hdr.serialno);
+		}
+	}
+
+	SFFS_STATE(cfg)->block_map = map;
+	return 0;
+}
+
+void sffs_block_freemap(const void * cfg){
+	free(SFFS_STATE(cfg)->block_map);
+	SFFS_STATE(cfg)->block_map = NULL;
+}
+
+int sffs_block_checkmap(const void * cfg){
+	sffs_block_hdr_t hdr;
+	block_map_t * map;
+	block_section_t * s;
+	serial_t owner;
+	u8 state;
+	int i;
+	int j;
+	int free;
+	int live;
+	int differences;
+
+	map = get_map(cfg);
+	if( map == NULL ){
+		return 0;
+	}
+
+	differences = 0;
+	for(i=0; i < map->sections; i++){
+		s = map->section + i;
+		owner = SECTION_OWNER_NONE;
+		free = 0;
+		live = 0;
+		for(j = i*map->eraseable; (j < (i+1)*map->eraseable) && (j < map->total); j++){
+			state = map_get(map, j);
+			if( j < FIRST_BLOCK ){
+				differences += (state != MAP_DIRTY);
+				continue;
+			}
+
+			if ( sffs_dev_read(cfg, get_sffs_block_addr(cfg, j), &hdr, sizeof(hdr)) != sizeof(hdr) ){
+				return -1;
+			}
+
+			if( (state & MAP_STATE_MASK) != get_map_state(hdr.status) ){
+				sffs_error("block %d is 0x%X on the device and %d in the map\n", j, hdr.status, state);
+				differences++;
+			} else if( (hdr.status != BLOCK_STATUS_FREE) && (((state & MAP_LIST) != 0) != (hdr.serialno == CL_SERIALNO_LIST)) ){
+				sffs_error("block %d list flag is wrong\n", j);
+				differences++;
+			}
+
+			switch(get_map_state(hdr.status)){
+				case MAP_FREE:
+					free++;
+					break;
+				case MAP_OPEN:
+				case MAP_CLOSED:
+					live++;
+					if( owner == SECTION_OWNER_NONE ){
+						owner = hdr.serialno;
+					} else if( owner != hdr.serialno ){
+						owner = SECTION_OWNER_MIXED;
+					}
+					break;
+			}
+		}
+
+		//a section that had more than one owner stays mixed until it is empty
+		if( (s->free != free) || (s->live != live) ||
+			 ((s->owner != owner) && (s->owner != SECTION_OWNER_MIXED || live == 0)) ){
+			sffs_error("section %d has %d free %d live owner %d (map %d %d %d)\n", i, free, live, owner, s->free, s->live, s->owner);
+			differences++;
+		}
+
+		if( (i < map->cursor) && (free != 0) ){
+			sffs_error("section %d is before the cursor with %d free blocks\n", i, free);
+			differences++;
+		}
+	}
+
+	return differences;
 }
 
 int sffs_block_discardopen(const void * cfg){
@@ -204,6 +401,7 @@ block_t alloc_block(const void * cfg, serial_t serialno, block_t hint, uint8_t t
 	int total_blocks;
 	int eraseable_blocks;
 	int first;
+	block_map_t * map;
 
 	eraseable_blocks = sffs_block_geteraseable(cfg);  //number of blocks that are eraseable contiguously
 	total_blocks = sffs_block_gettotal(cfg); //total number of blocks on the device
@@ -213,6 +411,11 @@ block_t alloc_block(const void * cfg, serial_t serialno, block_t hint, uint8_t t
 		hint = first;
 	}
 
+	map = get_map(cfg);
+	if( map != NULL ){
+		return alloc_block_map(cfg, map, serialno, hint, type);
+	}
+
 	if ( hint != BLOCK_INVALID ){
 		first_loop = eraseable_blocks - ( hint % eraseable_blocks) + hint;
 
@@ -288,59 +491,193 @@ block_t alloc_block(const void * cfg, serial_t serialno, block_t hint, uint8_t t
 	return BLOCK_INVALID;
 }
 
+//same search order as alloc_block() but without reading the device
+block_t alloc_block_map(const void * cfg, block_map_t * map, serial_t serialno, block_t hint, uint8_t type){
+	int i;
+	int section;
+	block_section_t * s;
+
+	if ( hint != BLOCK_INVALID ){
+		//starting at hint -- find a free block within the erasable block
+		section = hint / map->eraseable;
+		if( (section < map->sections) && map->section[section].free ){
+			for(i = hint+1; i < (section+1)*map->eraseable; i++){
+				if( map_get(map, i) == MAP_FREE ){
+					break;
+				}
+			}
+			if( i < (section+1)*map->eraseable ){
+				if ( mark_allocated(cfg, i, serialno, type) < 0 ){
+					sffs_error("failed to mark block allocated\n");
+					return BLOCK_INVALID;
+				}
+				return i;
+			}
+		}
+		section++;
+	} else {
+		section = 0;
+	}
+
+	//now try to find an erasable block that is empty or only used by serialno
+	if( section < map->cursor ){
+		section = map->cursor;
+	}
+
+	for( ; section < map->sections; section++){
+		s = map->section + section;
+		if( s->free && ((s->owner == serialno) || (s->owner == SECTION_OWNER_NONE)) ){
+			i = map_find_free(map, section);
+			if ( mark_allocated(cfg, i, serialno, type) < 0 ){
+				sffs_error("failed to mark block allocated here\n");
+				return BLOCK_INVALID;
+			}
+			return i;
+		}
+	}
+
+	//now just find a block anywhere
+	for(section = map->cursor; section < map->sections; section++){
+		if( map->section[section].free ){
+			i = map_find_free(map, section);
+			if ( mark_allocated(cfg, i, serialno, type) < 0 ){
+				sffs_error("failed to mark block allocated there\n");
+				return BLOCK_INVALID;
+			}
+			return i;
+		}
+		if( section == map->cursor ){
+			map->cursor++;
+		}
+	}
+
+	sffs_debug(DEBUG_LEVEL, "never found a block\n");
+	return BLOCK_INVALID;
+}
+
+int sffs_block_gc(const void * cfg, int reserve){
+	block_map_t * map;
+	int i;
+	int free;
+	int best;
+	int best_written;
+	int written;
+	int ret;
+
+	//the GC needs the map to count free blocks
+	map = get_map(cfg);
+	if( map == NULL ){
+		return 0;
+	}
+
+	free = 0;
+	for(i=0; i < map->sections; i++){
+		free += map->section[i].free;
+	}
+
+	if( free >= reserve ){
+		return 0;
+	}
+
+	//erase the section that needs the fewest blocks copied to the scratch area
+	best = -1;
+	best_written = (map->eraseable * 3) >> 2;
+	for(i=0; (i < map->sections) && (best_written > 0); i++){
+		if( (map->section[i].free != 0) || (map->section[i].live >= best_written) ){
+			continue;
+		}
+
+		ret = get_written(cfg, i * map->eraseable, &written);
+		if( ret < 0 ){
+			return -1;
+		}
+
+		if( (ret == 1) && (written < best_written) ){
+			best = i;
+			best_written = written;
+		}
+	}
+
+	if( best < 0 ){
+		sffs_debug(DEBUG_LEVEL, "%d free blocks and no section to erase\n", free);
+		return 2;
+	}
+
+	sffs_debug(DEBUG_LEVEL, "%d free blocks -- erase section %d (%d written)\n", free, best, best_written);
+	if( erase_section(cfg, best * map->eraseable, best_written) < 0 ){
+		return -1;
+	}
+
+	return 1;
+}
+
 int erase_dirty_blocks(const void * cfg, int max_written){
 	int i;
-	int j;
 	int total_blocks;
 	int eraseable_blocks;
-	sffs_block_hdr_t hdr;
-
 	int written;
-	bool do_erase;
+	int ret;
 
 	eraseable_blocks = sffs_block_geteraseable(cfg);  //number of blocks that are eraseable contiguously
 	total_blocks = sffs_block_gettotal(cfg); //total number of blocks on the device
 
 	//now try to find a free erasable block
 	for(i = 0; i < total_blocks; i += eraseable_blocks){
-		written = 0;
-		do_erase = true;
-		for(j = 0; j < eraseable_blocks; j++){
+		ret = get_written(cfg, i, &written);
+		if( ret < 0 ){
+			return -1;
+		}
 
-			if ( sffs_dev_read(cfg, get_sffs_block_addr(cfg, i+j), &hdr, sizeof(hdr)) != sizeof(hdr) ){
+		if ( (ret == 1) && (written < max_written) ){
+			if ( erase_section(cfg, i, written) < 0 ){
 				return -1;
 			}
+		}
 
-			//See if this eraseable block is used by another serial number
-			if ( hdr.status == BLOCK_STATUS_CLOSED ){
-				if ( hdr.serialno == CL_SERIALNO_LIST ){
-					do_erase = false;
-					break;
-				}
-				written++; //count how many blocks are finalized
-			} else if ( hdr.status == BLOCK_STATUS_OPEN ){
-				do_erase = false;
-				break;
-			} else if ( (hdr.status == BLOCK_STATUS_FREE) && ((i+j)!=0) ){
-				do_erase = false;
-				break;
-			}
+	}
+	return 0;
+}
+
+int get_written(const void * cfg, block_t sffs_block_num, int * written){
+	int j;
+	int eraseable_blocks;
+	sffs_block_hdr_t hdr;
+
+	eraseable_blocks = sffs_block_geteraseable(cfg);
+	*written = 0;
+	for(j = 0; j < eraseable_blocks; j++){
+
+		if ( load_status(cfg, sffs_block_num+j, &hdr) < 0 ){
+			return -1;
 		}
 
-		if ( (do_erase == true) && (written < max_written) ){
-			if ( written > sffs_scratch_capacity(cfg) ){
-				if ( sffs_scratch_erase(cfg) < 0 ){
-					sffs_error("failed to erase scratch area\n");
-					return -1;
-				}
+		//See if this eraseable block is used by another serial number
+		if ( hdr.status == BLOCK_STATUS_CLOSED ){
+			if ( hdr.serialno == CL_SERIALNO_LIST ){
+				return 0;
 			}
+			(*written)++; //count how many blocks are finalized
+		} else if ( hdr.status == BLOCK_STATUS_OPEN ){
+			return 0;
+		} else if ( (hdr.status == BLOCK_STATUS_FREE) && ((sffs_block_num+j)!=0) ){
+			return 0;
+		}
+	}
 
-			if ( erase_dirty_block(cfg, i) < 0 ){
-				sffs_error("failed to erase dirty blocks\n");
-				return -1;
-			}
+	return 1;
+}
+
+int erase_section(const void * cfg, block_t sffs_block_num, int written){
+	if ( written > sffs_scratch_capacity(cfg) ){
+		if ( sffs_scratch_erase(cfg) < 0 ){
+			sffs_error("failed to erase scratch area\n");
+			return -1;
 		}
+	}
 
+	if ( erase_dirty_block(cfg, sffs_block_num) < 0 ){
+		sffs_error("failed to erase dirty blocks\n");
+		return -1;
 	}
 	return 0;
 }
@@ -350,12 +687,12 @@ int erase_dirty_block(const void * cfg, block_t sffs_block_num){
 	int i;
 	int eraseable_blocks;
 	sffs_block_hdr_t hdr;
-
+	block_map_t * map;
 
 	eraseable_blocks = sffs_block_geteraseable(cfg);  //number of blocks that are eraseable contiguously
 	for(i = sffs_block_num; i < (sffs_block_num + eraseable_blocks); i++){
 
-		if ( sffs_dev_read(cfg, get_sffs_block_addr(cfg, i), &hdr, sizeof(hdr)) != sizeof(hdr) ){
+		if ( load_status(cfg, i, &hdr) < 0 ){
 			sffs_error("failed to read device\n");
 			return -1;
 		}
@@ -380,6 +717,11 @@ int erase_dirty_block(const void * cfg, block_t sffs_block_num){
 
 	CL_TP_DESC(CL_PROB_RARE, "section erased");
 
+	map = get_map(cfg);
+	if( map != NULL ){
+		map_erase_section(map, sffs_block_num);
+	}
+
 	//restore the scratch area
 	if ( sffs_scratch_restore(cfg) < 0 ){
 		sffs_error("failed to restore scratch area\n");
@@ -389,3 +731,121 @@ int erase_dirty_block(const void * cfg, block_t sffs_block_num){
 	return 0;
 
 }
+
+int load_status(const void * cfg, block_t block, sffs_block_hdr_t * hdr){
+	u8 state;
+	block_map_t * map = get_map(cfg);
+	if( map == NULL ){
+		if ( sffs_dev_read(cfg, get_sffs_block_addr(cfg, block), hdr, sizeof(*hdr)) != sizeof(*hdr) ){
+			return -1;
+		}
+		return 0;
+	}
+
+	//the map only knows whether or not the block belongs to the list
+	state = map_get(map, block);
+	hdr->status = get_map_status(state);
+	hdr->serialno = (state & MAP_LIST) ? CL_SERIALNO_LIST : SERIALNO_INVALID;
+	hdr->type = 0;
+	return 0;
+}
+
+block_map_t * get_map(const void * cfg){
+	return SFFS_STATE(cfg)->block_map;
+}
+
+u8 map_get(block_map_t * map, block_t block){
+	if( block >= map->total ){
+		//the last section may be partial -- the rest is never free
+		return MAP_DIRTY;
+	}
+	return (map->state[block >> 1] >> ((block & 1) << 2)) & 0x0f;
+}
+
+void map_set(block_map_t * map, block_t block, u8 state, serial_t serialno){
+	block_section_t * s = map->section + block / map->eraseable;
+	u8 previous = map_get(map, block);
+	bool was_live = ((previous & MAP_STATE_MASK) == MAP_OPEN) || ((previous & MAP_STATE_MASK) == MAP_CLOSED);
+	bool is_live = ((state & MAP_STATE_MASK) == MAP_OPEN) || ((state & MAP_STATE_MASK) == MAP_CLOSED);
+
+	if( (previous & MAP_STATE_MASK) == MAP_FREE ){
+		s->free--;
+	}
+
+	if( (state & MAP_STATE_MASK) == MAP_FREE ){
+		s->free++;
+		if( block / map->eraseable < map->cursor ){
+			map->cursor = block / map->eraseable;
+		}
+	}
+
+	if( was_live && !is_live ){
+		s->live--;
+		if( s->live == 0 ){
+			s->owner = SECTION_OWNER_NONE;
+		}
+	} else if( !was_live && is_live ){
+		s->live++;
+		if( s->owner == SECTION_OWNER_NONE ){
+			s->owner = serialno;
+		}
+		if( (s->owner != serialno) || (serialno == SERIALNO_INVALID) ){
+			s->owner = SECTION_OWNER_MIXED;
+		}
+	}
+
+	map->state[block >> 1] &= ~(0x0f << ((block & 1) << 2));
+	map->state[block >> 1] |= state << ((block & 1) << 2);
+}
+
+void map_erase_section(block_map_t * map, block_t block){
+	block_section_t * s;
+	int i;
+	int first = block - (block % map->eraseable);
+
+	s = map->section + first / map->eraseable;
+	s->owner = SECTION_OWNER_NONE;
+	s->free = 0;
+	s->live = 0;
+	for(i = first; (i < first + map->eraseable) && (i < map->total); i++){
+		map->state[i >> 1] &= ~(0x0f << ((i & 1) << 2));
+		if( i < FIRST_BLOCK ){
+			//block 0 is never allocated
+			map->state[i >> 1] |= MAP_DIRTY << ((i & 1) << 2);
+		} else {
+			s->free++;
+		}
+	}
+
+	if( first / map->eraseable < map->cursor ){
+		map->cursor = first / map->eraseable;
+	}
+}
+
+int map_find_free(block_map_t * map, int section){
+	int i;
+	for(i = section*map->eraseable; i < (section+1)*map->eraseable; i++){
+		if( map_get(map, i) == MAP_FREE ){
+			return i;
+		}
+	}
+	return BLOCK_INVALID;
+}
+
+u8 get_map_state(uint8_t status){
+	switch(status){
+		case BLOCK_STATUS_FREE: return MAP_FREE;
+		case BLOCK_STATUS_OPEN: return MAP_OPEN;
+		case BLOCK_STATUS_CLOSED: return MAP_CLOSED;
+		default: return MAP_DIRTY;
+	}
+}
+
+uint8_t get_map_status(u8 state){
+	switch(state & MAP_STATE_MASK){
+		case MAP_FREE: return BLOCK_STATUS_FREE;
+		case MAP_OPEN: return BLOCK_STATUS_OPEN;
+		case MAP_CLOSED: return BLOCK_STATUS_CLOSED;
+		default: return BLOCK_STATUS_DIRTY;
+	}
+}
@@ -31,6 +31,16 @@ int sffs_block_setstatus(const void * cfg, block_t sffs_block_num, uint8_t statu
 
 int sffs_block_discardopen(const void * cfg);
 
+//builds the RAM block map used by the allocator (needs to be called after scratch restore)
+int sffs_block_initmap(const void * cfg);
+void sffs_block_freemap(const void * cfg);
+
+//compares the RAM block map with the block headers on the device (returns the number of differences)
+int sffs_block_checkmap(const void * cfg);
+
+//erases at most one dirty section if fewer than reserve blocks are free (1: erased, 2: nothing to erase, 0: reserve met)
+int sffs_block_gc(const void * cfg, int reserve);
+
 serial_t sffs_block_get_serialno(const void * cfg, block_t block);
 
 block_t sffs_block_geteraseable(const void * cfg);
@@ -88,17 +88,25 @@ int sffs_dev_open(const void * cfg){
 
 int sffs_dev_write(const void * cfg, int loc, const void * buf, int nbyte){
 	int ret;
-	//int i;
-	char buffer[nbyte];
+	int i;
+	int size;
+	char buffer[256];
 	ret = sysfs_shared_write(SFFS_DRIVE(cfg), loc,  buf, nbyte);
 	if( ret < 0 ){ return ret; }
 
 	wait_busy(cfg, 100);
 
-	memset(buffer, 0, nbyte);
-	sysfs_shared_read(SFFS_DRIVE(cfg), loc, buffer, nbyte);
-	if ( memcmp(buffer, buf, nbyte) != 0 ){
-		return SYSFS_SET_RETURN(EIO);
+	//verify a piece at a time -- a run of blocks is too big for the stack
+	for(i=0; i < nbyte; i += size){
+		size = nbyte - i;
+		if( size > (int)sizeof(buffer) ){
+			size = sizeof(buffer);
+		}
+		memset(buffer, 0, size);
+		sysfs_shared_read(SFFS_DRIVE(cfg), loc + i, buffer, size);
+		if ( memcmp(buffer, (const char*)buf + i, size) != 0 ){
+			return SYSFS_SET_RETURN(EIO);
+		}
 	}
 
 	return ret;
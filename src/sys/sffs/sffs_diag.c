@@ -245,7 +245,7 @@ int sffs_diag_get(const void * cfg, sffs_diag_t * dest){
 
 	memset(dest, 0, sizeof(sffs_diag_t));
 	erase_size = sffs_dev_geterasesize(cfg);
-	size = sffs_dev_getsize(cfg) - erase_size*2;
+	size = sffs_dev_getsize(cfg) - erase_size; //the last section is the scratch pad
 
 	for(j=0*BLOCK_SIZE; j < size; j+=erase_size){
 		eraseable = 1;
@@ -309,7 +309,7 @@ int sffs_diag_get(const void * cfg, sffs_diag_t * dest){
 		//printf("%d to %d: dirty: %d free: %d written: %d\n", j/BLOCK_SIZE, (j+erase_size)/BLOCK_SIZE-1, dirty_blocks, free_blocks, written_blocks);
 
 		if ( eraseable == 1 ){
-			dest->eraseable_blocks+=blocks_per_eraseable;
+			dest->eraseable_blocks+=erase_size / BLOCK_SIZE;
 		}
 	}
 
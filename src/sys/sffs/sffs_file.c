@@ -4,6 +4,7 @@
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <stddef.h>
 #include <string.h>
 #include <fcntl.h>
@@ -25,9 +26,36 @@
 
 #define DEBUG_LEVEL 10
 
+//segments per open file in the RAM map (2 bytes each) -- segments past this are looked up in the list
+#if !defined SFFS_SEGMENT_MAP_SIZE
+#define SFFS_SEGMENT_MAP_SIZE 512
+#endif
+
+#define SEGMENT_MAP_GROW 32
+
+//blocks saved with one device write (a RAM copy of this many blocks is malloc'd per write)
+#if !defined SFFS_FILE_RUN_MAX
+#define SFFS_FILE_RUN_MAX 8
+#endif
+
+typedef struct {
+	u16 count /*! segments in the map -- segments from count to SFFS_SEGMENT_MAP_SIZE are not in the list */;
+	u16 capacity;
+	u8 is_complete /*! no segment past SFFS_SEGMENT_MAP_SIZE is in the list */;
+	block_t block[];
+} segment_map_t;
+
 static void svcall_execute_callback(cl_handle_t * handle) MCU_ROOT_EXEC_CODE;
 static int cleanup_file(const void * cfg, block_t hdr_block, int addr, uint8_t status);
 int mark_file_closed(const void * cfg, block_t hdr_block);
+static int load_segment_data(const void * cfg, cl_handle_t * handle, int segment);
+static int lookup_segment_map(const void * cfg, cl_handle_t * handle, int segment, block_t * block);
+static segment_map_t * build_segment_map(const void * cfg, cl_handle_t * handle);
+static void update_segment_map(cl_handle_t * handle, int segment, block_t block);
+static segment_map_t * grow_segment_map(segment_map_t * map, int count);
+static bool is_file_block(const sffs_block_hdr_t * hdr, serial_t serialno);
+static int read_run(const void * cfg, cl_handle_t * handle, int segment, int nsegments, int space);
+static int write_run(const void * cfg, cl_handle_t * handle, int nsegments, sffs_block_data_t * run);
 
 
 static int get_sffs_block_data_addr(const void * cfg, block_t block){
@@ -82,6 +110,12 @@ int sffs_file_startread(const void * cfg, cl_handle_t * handle){
 
 	//first check to see if the current segment is the segment being read
 	handle->bytes_left = handle->op->nbyte;
+	if ( handle->op->loc >= handle->size ){
+		handle->bytes_left = 0;
+		handle->op->nbyte = 0;
+		return 0;
+	}
+
 	if ( handle->bytes_left + handle->op->loc > handle->size ){
 		handle->bytes_left = handle->size - handle->op->loc;
 		handle->op->nbyte = handle->bytes_left;
@@ -120,8 +154,8 @@ int sffs_file_finishread(const void * cfg, cl_handle_t * handle){
 			return -1;
 		}
 
-		//read the final segment
-		if ( sffs_file_loadsegment(cfg, handle, handle->segment + 1) < 0){
+		//read the final segment -- runs read by sffs_file_read() don't move handle->segment
+		if ( sffs_file_loadsegment(cfg, handle, handle->op->loc / BLOCK_DATA_SIZE) < 0){
 			sffs_error("failed to load final segment\n");
 			return -1;
 		}
@@ -251,6 +285,8 @@ int sffs_file_savesegment(const void * cfg, cl_handle_t * handle){
 			return -1;
 		}
 
+		update_segment_map(handle, handle->segment, block);
+
 	} else {
 		sffs_debug(DEBUG_LEVEL + 2, "segment not dirty\n");
 	}
@@ -258,18 +294,8 @@ int sffs_file_savesegment(const void * cfg, cl_handle_t * handle){
 }
 
 int sffs_file_loadsegment(const void * cfg, cl_handle_t * handle, int segment){
-	block_t block;
-	//save this to a new block in the file
-	block = sffs_filelist_get(cfg, handle->segment_list_block, segment, SFFS_FILELIST_STATUS_CURRENT, NULL);
-	if ( block == BLOCK_INVALID ){ //the segment doesn't exist in the file; create it
-		sffs_debug(DEBUG_LEVEL + 2, "segment %d doesn't exist %d\n", segment, handle->segment_list_block);
-		memset(handle->segment_data.data, 0, BLOCK_DATA_SIZE);
-	} else {
-		sffs_debug(DEBUG_LEVEL + 2, "loading segment %d from block %d\n", segment, block);
-		if( sffs_block_load(cfg, block, &(handle->segment_data)) < 0 ){
-			sffs_error("failed to load segment (%d) data block (%d)\n", segment, block);
-			return -1;
-		}
+	if( load_segment_data(cfg, handle, segment) < 0 ){
+		return -1;
 	}
 	handle->segment = segment;
 	handle->segment_data.hdr.status = BLOCK_STATUS_OPEN;
@@ -278,7 +304,6 @@ int sffs_file_loadsegment(const void * cfg, cl_handle_t * handle, int segment){
 
 
 int sffs_file_swapsegment(const void * cfg, cl_handle_t * handle, int new_segment){
-	block_t block;
 
 	if ( new_segment == handle->segment ){
 		//The new segment is equal to the current segment
@@ -291,25 +316,76 @@ int sffs_file_swapsegment(const void * cfg, cl_handle_t * handle, int new_segmen
 	}
 
 	//now load the new segment -- mark it as allocated
-	handle->segment = new_segment;
-	block = sffs_filelist_get(cfg, handle->segment_list_block, new_segment, SFFS_FILELIST_STATUS_CURRENT, NULL);
+	return sffs_file_loadsegment(cfg, handle, new_segment);
+}
 
-	if ( block == BLOCK_INVALID ){ //the segment doesn't exist in the file; create it
-		memset(handle->segment_data.data, 0, BLOCK_DATA_SIZE);
-	} else {
-		sffs_block_load(cfg, block, &(handle->segment_data));
+void sffs_file_freemap(cl_handle_t * handle){
+	free(handle->segment_map);
+	handle->segment_map = NULL;
+}
+
+int sffs_file_checkmap(const void * cfg, cl_handle_t * handle){
+	sffs_list_t list;
+	sffs_filelist_item_t item;
+	segment_map_t * map;
+	block_t block;
+	int differences;
+	int i;
+
+	map = handle->segment_map;
+	if( map == NULL ){
+		return 0;
 	}
 
-	handle->segment_data.hdr.status = BLOCK_STATUS_OPEN;
-	return 0;
+	differences = 0;
+	for(i=0; i < map->count; i++){
+		block = sffs_filelist_get(cfg, handle->segment_list_block, i, SFFS_FILELIST_STATUS_CURRENT, NULL);
+		if( block != map->block[i] ){
+			sffs_error("segment %d is in block %d and the map has %d\n", i, block, map->block[i]);
+			differences++;
+		}
+	}
+
+	//a complete map has every segment in the list
+	if( map->is_complete ){
+		if( sffs_filelist_init(cfg, &list, handle->segment_list_block) < 0 ){
+			return -1;
+		}
+
+		while( sffs_list_getnext(cfg, &list, &item, NULL) == 0 ){
+			if( (item.status == SFFS_FILELIST_STATUS_CURRENT) && (item.segment >= map->count) ){
+				sffs_error("segment %d is past the map\n", item.segment);
+				differences++;
+			}
+		}
+	}
+
+	return differences;
 }
 
 int sffs_file_write(const void * cfg, cl_handle_t * handle, int start_segment, int nsegments){
+	sffs_block_data_t * run;
 	int i;
+	int count;
 
 	if ( nsegments > 0 ){
+		run = NULL;
+		if( nsegments > 1 ){
+			run = malloc(sizeof(sffs_block_data_t) * (nsegments < SFFS_FILE_RUN_MAX ? nsegments : SFFS_FILE_RUN_MAX));
+		}
+
 		handle->segment = start_segment;
-		for(i=0; i < nsegments; i++){
+		for(i=0; i < nsegments; i += count){
+			if( run != NULL ){
+				count = write_run(cfg, handle, nsegments - i, run);
+				if( count < 0 ){
+					free(run);
+					return -1;
+				}
+				continue;
+			}
+
+			//no memory for the run -- one segment at a time
 			memcpy(handle->segment_data.data, handle->op->buf, BLOCK_DATA_SIZE);
 			handle->segment_data.hdr.status = BLOCK_STATUS_CLOSED;
 			if ( sffs_file_savesegment(cfg, handle) < 0){
@@ -317,7 +393,9 @@ int sffs_file_write(const void * cfg, cl_handle_t * handle, int start_segment, i
 			}
 			handle->segment++;
 			handle->op->buf += BLOCK_DATA_SIZE;
+			count = 1;
 		}
+		free(run);
 
 		handle->op->loc += (BLOCK_DATA_SIZE * nsegments);
 		handle->bytes_left -= (BLOCK_DATA_SIZE * nsegments);
@@ -332,13 +410,26 @@ int sffs_file_write(const void * cfg, cl_handle_t * handle, int start_segment, i
 
 int sffs_file_read(const void * cfg, cl_handle_t * handle, int start_segment, int nsegments){
 	int i;
+	int count;
+	int space;
+
 	if ( nsegments > 0 ){
-		for(i=0; i < nsegments; i++){
-			if ( sffs_file_loadsegment(cfg, handle, start_segment + i) < 0 ){
+		space = handle->bytes_left;
+		for(i=0; i < nsegments; i += count){
+			count = read_run(cfg, handle, start_segment + i, nsegments - i, space);
+			if( count < 0 ){
 				return -1;
 			}
-			memcpy(handle->op->buf, handle->segment_data.data, BLOCK_DATA_SIZE);
-			handle->op->buf += BLOCK_DATA_SIZE;
+
+			if( count == 0 ){
+				if ( sffs_file_loadsegment(cfg, handle, start_segment + i) < 0 ){
+					return -1;
+				}
+				memcpy(handle->op->buf, handle->segment_data.data, BLOCK_DATA_SIZE);
+				count = 1;
+			}
+			handle->op->buf += BLOCK_DATA_SIZE * count;
+			space -= BLOCK_DATA_SIZE * count;
 		}
 		handle->op->loc += (BLOCK_DATA_SIZE * nsegments);
 		handle->bytes_left -= (BLOCK_DATA_SIZE * nsegments);
@@ -350,6 +441,9 @@ int sffs_file_open(const void * cfg, cl_handle_t * handle, serial_t serialno, in
 	block_t block;
 	cl_hdr_t * hdr;
 
+	handle->segment_map = NULL;
+	handle->is_segment_map_off = 0;
+
 	block = sffs_serialno_get(cfg, serialno, SFFS_SNLIST_ITEM_STATUS_CLOSED, &(handle->serialno_addr));
 	if ( block == BLOCK_INVALID ){
 		sffs_error("serialno does not exist\n");
@@ -468,6 +562,8 @@ int sffs_file_new(const void * cfg, cl_handle_t * handle, const char * name, int
 	handle->mtime = 0;
 	handle->amode = amode;
 	handle->op = NULL;
+	handle->segment_map = NULL;
+	handle->is_segment_map_off = 0;
 
 	sffs_debug(DEBUG_LEVEL, "new file: list block:%d\n", list_block);
 
@@ -905,3 +1001,309 @@ int cleanup_file(const void * cfg, block_t hdr_block, int addr, uint8_t status){
 
 	return 0;
 }
+
+int load_segment_data(const void * cfg, cl_handle_t * handle, int segment){
+	sffs_block_hdr_t hdr;
+	block_t block;
+	int is_mapped;
+
+	hdr = handle->segment_data.hdr;
+	is_mapped = lookup_segment_map(cfg, handle, segment, &block);
+	if( is_mapped == 0 ){
+		block = sffs_filelist_get(cfg, handle->segment_list_block, segment, SFFS_FILELIST_STATUS_CURRENT, NULL);
+	}
+
+	if ( block == BLOCK_INVALID ){ //the segment doesn't exist in the file; create it
+		sffs_debug(DEBUG_LEVEL + 2, "segment %d doesn't exist %d\n", segment, handle->segment_list_block);
+		memset(handle->segment_data.data, 0, BLOCK_DATA_SIZE);
+		return 0;
+	}
+
+	sffs_debug(DEBUG_LEVEL + 2, "loading segment %d from block %d\n", segment, block);
+	if( sffs_block_load(cfg, block, &(handle->segment_data)) < 0 ){
+		sffs_error("failed to load segment (%d) data block (%d)\n", segment, block);
+		return -1;
+	}
+
+	if( is_mapped && (is_file_block(&(handle->segment_data.hdr), hdr.serialno) == false) ){
+		//the block was discarded after the map was built (the file was rewritten using another handle)
+		sffs_debug(DEBUG_LEVEL, "segment %d block %d is stale\n", segment, block);
+		sffs_file_freemap(handle);
+		handle->is_segment_map_off = 1;
+		handle->segment_data.hdr = hdr;
+		return load_segment_data(cfg, handle, segment);
+	}
+
+	return 0;
+}
+
+int lookup_segment_map(const void * cfg, cl_handle_t * handle, int segment, block_t * block){
+	segment_map_t * map;
+
+	if( handle->is_segment_map_off ){
+		return 0;
+	}
+
+	map = handle->segment_map;
+	if( map == NULL ){
+		if( handle->op == NULL ){
+			//opening (or stat-ing) a file only needs the first segment
+			return 0;
+		}
+
+		map = build_segment_map(cfg, handle);
+		if( map == NULL ){
+			handle->is_segment_map_off = 1;
+			return 0;
+		}
+		handle->segment_map = map;
+	}
+
+	if( segment < map->count ){
+		*block = map->block[segment];
+		return 1;
+	}
+
+	if( (segment < SFFS_SEGMENT_MAP_SIZE) || map->is_complete ){
+		*block = BLOCK_INVALID;
+		return 1;
+	}
+
+	return 0;
+}
+
+segment_map_t * build_segment_map(const void * cfg, cl_handle_t * handle){
+	sffs_list_t list;
+	sffs_filelist_item_t item;
+	segment_map_t * map;
+	int count;
+
+	count = (handle->size + BLOCK_DATA_SIZE - 1) / BLOCK_DATA_SIZE;
+	if( count > SFFS_SEGMENT_MAP_SIZE ){
+		count = SFFS_SEGMENT_MAP_SIZE;
+	}
+
+	map = grow_segment_map(NULL, count);
+	if( map == NULL ){
+		sffs_error("no memory for the segment map\n");
+		return NULL;
+	}
+
+	if( sffs_filelist_init(cfg, &list, handle->segment_list_block) < 0 ){
+		free(map);
+		return NULL;
+	}
+
+	//one pass over the list instead of one per segment
+	while( sffs_list_getnext(cfg, &list, &item, NULL) == 0 ){
+		if( item.status != SFFS_FILELIST_STATUS_CURRENT ){
+			continue;
+		}
+
+		if( item.segment >= SFFS_SEGMENT_MAP_SIZE ){
+			map->is_complete = 0;
+			continue;
+		}
+
+		if( item.segment >= map->count ){
+			map = grow_segment_map(map, item.segment + 1);
+			if( map == NULL ){
+				return NULL;
+			}
+		}
+
+		//sffs_filelist_get() returns the first current entry
+		if( map->block[item.segment] == BLOCK_INVALID ){
+			map->block[item.segment] = item.block;
+		}
+	}
+
+	sffs_debug(DEBUG_LEVEL, "segment map has %d segments\n", map->count);
+	return map;
+}
+
+void update_segment_map(cl_handle_t * handle, int segment, block_t block){
+	segment_map_t * map;
+
+	map = handle->segment_map;
+	if( map == NULL ){
+		return;
+	}
+
+	if( segment >= SFFS_SEGMENT_MAP_SIZE ){
+		map->is_complete = 0;
+		return;
+	}
+
+	if( segment >= map->count ){
+		map = grow_segment_map(map, segment + 1);
+		handle->segment_map = map;
+		if( map == NULL ){
+			handle->is_segment_map_off = 1;
+			return;
+		}
+	}
+
+	map->block[segment] = block;
+}
+
+segment_map_t * grow_segment_map(segment_map_t * map, int count){
+	segment_map_t * new_map;
+	int capacity;
+	int i;
+
+	i = 0;
+	if( map != NULL ){
+		i = map->count;
+	}
+
+	if( (map == NULL) || (count > map->capacity) ){
+		capacity = ((count + SEGMENT_MAP_GROW - 1) / SEGMENT_MAP_GROW) * SEGMENT_MAP_GROW;
+		if( capacity > SFFS_SEGMENT_MAP_SIZE ){
+			capacity = SFFS_SEGMENT_MAP_SIZE;
+		}
+
+		new_map = realloc(map, sizeof(segment_map_t) + capacity * sizeof(block_t));
+		if( new_map == NULL ){
+			free(map);
+			return NULL;
+		}
+
+		if( map == NULL ){
+			new_map->is_complete = 1;
+		}
+		map = new_map;
+		map->capacity = capacity;
+	}
+
+	//segments that aren't in the list
+	for(; i < count; i++){
+		map->block[i] = BLOCK_INVALID;
+	}
+	map->count = count;
+	return map;
+}
+
+bool is_file_block(const sffs_block_hdr_t * hdr, serial_t serialno){
+	return (hdr->serialno == serialno) &&
+			(hdr->type == BLOCK_TYPE_FILE_DATA) &&
+			((hdr->status == BLOCK_STATUS_OPEN) || (hdr->status == BLOCK_STATUS_CLOSED));
+}
+
+int read_run(const void * cfg, cl_handle_t * handle, int segment, int nsegments, int space){
+	sffs_block_hdr_t hdr;
+	block_t first;
+	block_t block;
+	char * buf;
+	int count;
+	int max;
+	int i;
+
+	//the blocks (headers included) are read straight into the caller's buffer
+	max = space / BLOCK_SIZE;
+	if( max > nsegments ){
+		max = nsegments;
+	}
+
+	if( (max < 2) ||
+		 (lookup_segment_map(cfg, handle, segment, &first) == 0) ||
+		 (first == BLOCK_INVALID) ){
+		return 0;
+	}
+
+	for(count = 1; count < max; count++){
+		if( (lookup_segment_map(cfg, handle, segment + count, &block) == 0) ||
+			 (block != first + count) ){
+			break;
+		}
+	}
+
+	if( count < 2 ){
+		return 0;
+	}
+
+	buf = handle->op->buf;
+	sffs_debug(DEBUG_LEVEL + 2, "reading segments %d to %d from block %d\n", segment, segment + count - 1, first);
+	if( sffs_dev_read(cfg, first * BLOCK_SIZE, buf, count * BLOCK_SIZE) != count * BLOCK_SIZE ){
+		sffs_error("failed to read blocks %d to %d\n", first, first + count - 1);
+		return -1;
+	}
+
+	for(i=0; i < count; i++){
+		memcpy(&hdr, buf + i * BLOCK_SIZE, BLOCK_HEADER_SIZE);
+		if( is_file_block(&hdr, handle->segment_data.hdr.serialno) == false ){
+			//stale map -- sffs_file_loadsegment() finds out and looks the segment up in the list
+			return 0;
+		}
+	}
+
+	//drop the headers
+	for(i=0; i < count; i++){
+		memmove(buf + i * BLOCK_DATA_SIZE, buf + i * BLOCK_SIZE + BLOCK_HEADER_SIZE, BLOCK_DATA_SIZE);
+	}
+
+	return count;
+}
+
+int write_run(const void * cfg, cl_handle_t * handle, int nsegments, sffs_block_data_t * run){
+	block_t block[SFFS_FILE_RUN_MAX];
+	serial_t serialno;
+	int count;
+	int size;
+	int i;
+	int j;
+	int k;
+
+	if( nsegments > SFFS_FILE_RUN_MAX ){
+		nsegments = SFFS_FILE_RUN_MAX;
+	}
+
+	handle->mtime = 0;
+	serialno = handle->segment_data.hdr.serialno;
+
+	//allocating first lets the blocks land next to each other
+	for(count = 0; count < nsegments; count++){
+		block[count] = sffs_block_alloc(cfg, serialno, handle->segment_list_block, BLOCK_TYPE_FILE_DATA);
+		if( block[count] == BLOCK_INVALID ){
+			sffs_error("could not alloc block\n");
+			break;
+		}
+	}
+
+	if( count == 0 ){
+		return -1;
+	}
+
+	for(i=0; i < count; i = j){
+		for(j = i + 1; (j < count) && (block[j] == block[j-1] + 1); j++){
+			;
+		}
+
+		for(k = i; k < j; k++){
+			run[k-i].hdr.serialno = serialno;
+			run[k-i].hdr.type = BLOCK_TYPE_FILE_DATA;
+			run[k-i].hdr.status = BLOCK_STATUS_OPEN;
+			memcpy(run[k-i].data, handle->op->buf + k * BLOCK_DATA_SIZE, BLOCK_DATA_SIZE);
+		}
+
+		//same bytes as sffs_block_save() -- the headers after the first are written again with the values sffs_block_alloc() wrote
+		sffs_debug(DEBUG_LEVEL + 2, "saving segments %d to %d to block %d\n", handle->segment + i, handle->segment + j - 1, block[i]);
+		size = (j - i) * BLOCK_SIZE - offsetof(sffs_block_hdr_t, status);
+		if( sffs_dev_write(cfg, block[i] * BLOCK_SIZE + offsetof(sffs_block_hdr_t, status), &(run[0].hdr.status), size) != size ){
+			sffs_error("could not save blocks %d to %d\n", block[i], block[j-1]);
+			return -1;
+		}
+	}
+
+	for(i=0; i < count; i++){
+		if ( sffs_filelist_update(cfg, handle->segment_list_block, handle->segment, block[i]) < 0){
+			sffs_error("could not update file list\n");
+			return -1;
+		}
+		update_segment_map(handle, handle->segment, block[i]);
+		handle->segment++;
+		handle->op->buf += BLOCK_DATA_SIZE;
+	}
+
+	return count;
+}
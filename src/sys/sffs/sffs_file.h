@@ -58,6 +58,10 @@ int sffs_file_swapsegment(const void * cfg, cl_handle_t * handle, int new_segmen
 
 int sffs_file_loadsegment(const void * cfg, cl_handle_t * handle, int segment);
 int sffs_file_savesegment(const void * cfg, cl_handle_t * handle);
+void sffs_file_freemap(cl_handle_t * handle);
+
+//compares the handle's segment map with the file list (returns the number of differences)
+int sffs_file_checkmap(const void * cfg, cl_handle_t * handle);
 
 int sffs_file_clean(const void * cfg, serial_t serialno, block_t hdr_block, uint8_t status);
 
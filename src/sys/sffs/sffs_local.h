@@ -12,11 +12,7 @@
 
 #include <stdint.h>
 
-#ifdef __SIM__
-#include "../sffs/sim_device.h"
-#else
 #include "sos/fs/devfs.h"
-#endif
 #include "sffs_dev.h"
 
 typedef u32 serial_t;
@@ -104,6 +100,8 @@ typedef struct MCU_PACK {
 	u8 amode /*! The open mode */;
 	u16 segment /*! The segment of the file */;
 	u32 mtime /*! The time of the last modification */;
+	void * segment_map /*! RAM map of segments to blocks (built on the first read or write) */;
+	u8 is_segment_map_off /*! Set when the map can't be used (segments are looked up in the list) */;
 	sffs_block_data_t segment_data; /*! The RAM buffer for the segment */;
 } cl_handle_t;
 
@@ -17,6 +17,32 @@
 #define SERIALNO_DEL_AVAILABLE (0x01)
 #define SERIALNO_DEL_NOT_AVAILABLE (0)
 
+//slots in the RAM index of the list (12 bytes each) -- a longer list is partly indexed
+#if !defined SFFS_SERIALNO_INDEX_SIZE
+#define SFFS_SERIALNO_INDEX_SIZE 128
+#endif
+#define SERIALNO_INDEX_MAX_COUNT (SFFS_SERIALNO_INDEX_SIZE*3/4)
+
+typedef struct {
+	serial_t serialno; //SERIALNO_INVALID if the slot is empty
+	int addr;
+	block_t block;
+	uint8_t status;
+} serialno_index_entry_t;
+
+/*
+ * The index holds the valid entries from the start of the list up to the
+ * first one that doesn't fit (or that shares its serial number and status
+ * with an earlier entry). A lookup that misses a partial index scans the
+ * list on the device.
+ */
+typedef struct {
+	int count;
+	int dirty; //dirty entries in the list
+	bool is_complete; //every valid entry is in the index
+	serialno_index_entry_t entry[SFFS_SERIALNO_INDEX_SIZE];
+} serialno_index_t;
+
 enum {
 	SFFS_INDEX_STATUS_FREE = 0xFF,
 	SFFS_INDEX_STATUS_OPEN = 0xFE,
@@ -31,6 +57,13 @@ static int validate_checksum(cl_snlist_item_t * entry);
 static block_t find_list_block(const void * cfg);
 static int is_dirty(void * data);
 static int consolidate_list(const void * cfg, int (*is_free)(void*), int (*is_dirty)(void*));
+static serialno_index_t * get_index(const void * cfg);
+static void index_build(const void * cfg);
+static int index_insert(serialno_index_t * index, cl_snlist_item_t * item, int addr);
+static serialno_index_entry_t * index_find(serialno_index_t * index, serial_t serialno, uint8_t status);
+static serialno_index_entry_t * index_find_addr(serialno_index_t * index, serial_t serialno, int addr);
+static void index_remove(serialno_index_t * index, serialno_index_entry_t * entry);
+static int index_home(serial_t serialno);
 
 
 void set_checksum(cl_snlist_item_t * entry){
@@ -145,6 +178,7 @@ int sffs_serialno_init(const void * cfg, cl_snlist_item_t * bad_serialno_item){
 	serial_t sn;
 	block_t sn_list_block;
 
+	sffs_serialno_freeindex(cfg);
 	sn_list_block = sffs_dev_getlist_block(cfg);
 
 
@@ -196,6 +230,8 @@ int sffs_serialno_init(const void * cfg, cl_snlist_item_t * bad_serialno_item){
 
 	sffs_debug(DEBUG_LEVEL, "start serialno is %d\n", sn);
 
+	index_build(cfg);
+
 	return ret;
 }
 
@@ -222,6 +258,8 @@ int sffs_serialno_mkfs(const void * cfg){
 		return -1;
 	}
 
+	index_build(cfg);
+
 	return 0;
 }
 
@@ -284,9 +322,62 @@ int consolidate_list(const void * cfg, int (*is_free)(void*), int (*is_dirty)(vo
 
 	sffs_dev_setlist_block(cfg, sn_list_block);
 
+	//the entries moved to the new list
+	if( get_index(cfg) != NULL ){
+		index_build(cfg);
+	}
+
 	return 0;
 }
 
+int sffs_serialno_gc(const void * cfg, bool is_scan_ok){
+	sffs_list_t list;
+	cl_snlist_item_t item;
+	serialno_index_t * index;
+	int dirty;
+	int i;
+
+	index = get_index(cfg);
+	if( (index != NULL) && index->is_complete ){
+		dirty = index->dirty;
+		for(i=0; i < SFFS_SERIALNO_INDEX_SIZE; i++){
+			if( (index->entry[i].serialno != SERIALNO_INVALID) &&
+				 (index->entry[i].status != SFFS_SNLIST_ITEM_STATUS_CLOSED) ){
+				//open files keep the address of their entry -- it can't move
+				return 0;
+			}
+		}
+	} else {
+		if( is_scan_ok == false ){
+			return 0;
+		}
+
+		if ( cl_snlist_init(cfg, &list, sffs_dev_getlist_block(cfg)) < 0 ){
+			return -1;
+		}
+
+		dirty = 0;
+		while( cl_snlist_getnext(cfg, &list, &item) == 0 ){
+			if( item.status == SFFS_SNLIST_ITEM_STATUS_DIRTY ){
+				dirty++;
+			} else if( item.status != SFFS_SNLIST_ITEM_STATUS_CLOSED ){
+				return 0;
+			}
+		}
+	}
+
+	//only worth it if at least one list block is freed
+	if( dirty < (int)(BLOCK_DATA_SIZE / sizeof(cl_snlist_item_t)) ){
+		return 0;
+	}
+
+	sffs_debug(DEBUG_LEVEL, "consolidate %d dirty entries\n", dirty);
+	if( sffs_serialno_consolidate(cfg) < 0 ){
+		return -1;
+	}
+	return 1;
+}
+
 int sffs_serialno_consolidate(const void * cfg){
 	sffs_debug(DEBUG_LEVEL, "consolidate main\n");
 	if( consolidate_list(cfg, sffs_serialno_isfree, is_dirty) < 0 ){
@@ -298,62 +389,19 @@ int sffs_serialno_consolidate(const void * cfg){
 
 
 serial_t sffs_serialno_new(const void * cfg){
-	sffs_list_t list;
-	cl_snlist_item_t item;
-	int dev_addr;
-	serial_t ret;
 	serial_t sn;
 
-	sffs_debug(DEBUG_LEVEL, "list starts on block %d\n", sffs_dev_getlist_block(cfg) );
-
+	//serial numbers are handed out in order from the highest one in the list (see sffs_serialno_init())
 	sn = sffs_dev_getserialno(cfg); //retrieves the current serial number
 	sn++;
 	if( sn == SERIALNO_INVALID ){
 		//The highest number if 4 billion
-		sn = CL_SERIALNO_LIST + 1;
 		sffs_error("out of serial numbers\n"); //this should be a no space errno
 		return SERIALNO_INVALID;
 	}
 	sffs_dev_setserialno(cfg, sn);
-
+	sffs_debug(DEBUG_LEVEL, "new serial number is %d\n", sn);
 	return sn;
-
-	if ( cl_snlist_init(cfg, &list, sffs_dev_getlist_block(cfg)) < 0 ){
-		sffs_error("failed to init list\n");
-		return BLOCK_INVALID;
-	}
-
-	if( list.block_data.hdr.status == 0x00 ){
-		sffs_error("sn list block (%d) is dirty\n", list.block_data.hdr.status);
-		//this needs to be a panic (reset device so that the sn list can re-initialize)
-#ifdef __SIM__
-		printf("No new serial numbers\n");
-		exit(1);
-#endif
-		return BLOCK_INVALID;
-	}
-
-	ret = 1;
-	while( sffs_list_getnext(cfg, &list, &item, &dev_addr) == 0 ){
-
-		if ( (item.status != SFFS_SNLIST_ITEM_STATUS_DIRTY) && (item.serialno == sn) ){
-			continue;
-		} else {
-			ret = sn;
-			break;
-		}
-		sn++;
-		if( sn == 65535 ){
-			sn = CL_SERIALNO_LIST + 1;
-		}
-	}
-	sn++;
-	if( sn == 65535 ){
-		sn = CL_SERIALNO_LIST + 1;
-	}
-	sffs_dev_setserialno(cfg, sn);
-	sffs_debug(DEBUG_LEVEL, "new serial number is %d\n", ret);
-	return ret;
 }
 
 
@@ -362,6 +410,23 @@ block_t sffs_serialno_get(const void * cfg, serial_t serialno, uint8_t status, i
 	sffs_list_t list;
 	cl_snlist_item_t item;
 	int dev_addr;
+	serialno_index_t * index;
+	serialno_index_entry_t * entry;
+
+	index = get_index(cfg);
+	if( index != NULL ){
+		entry = index_find(index, serialno, status);
+		if( entry != NULL ){
+			if ( addr != NULL ){
+				*addr = entry->addr;
+			}
+			return entry->block;
+		}
+
+		if( index->is_complete ){
+			return BLOCK_INVALID;
+		}
+	}
 
 	sffs_debug(DEBUG_LEVEL, "list starts on block %d\n", sffs_dev_getlist_block(cfg));
 
@@ -406,17 +471,53 @@ block_t sffs_serialno_get(const void * cfg, serial_t serialno, uint8_t status, i
 }
 
 int sffs_serialno_setstatus(const void * cfg, int addr, uint8_t status){
+	cl_snlist_item_t item;
+	serialno_index_t * index;
+	serialno_index_entry_t * entry;
+
 	sffs_debug(DEBUG_LEVEL, "writing addr 0x%X\n", addr);
 	if ( sffs_dev_write(cfg, addr + offsetof(cl_snlist_item_t, status), &status, sizeof(status)) != sizeof(status) ){
 		sffs_error("failed to set status at 0x%X\n", addr);
 		return -1;
 	}
+
+	index = get_index(cfg);
+	if( index != NULL ){
+		//read back the entry to get the serial number and the status that is on the device
+		if ( sffs_dev_read(cfg, addr, &item, sizeof(item)) != sizeof(item) ){
+			sffs_serialno_freeindex(cfg);
+			return 0;
+		}
+
+		entry = index_find_addr(index, item.serialno, addr);
+		if( entry != NULL ){
+			index_remove(index, entry);
+			if( item.status == SFFS_SNLIST_ITEM_STATUS_DIRTY ){
+				index->dirty++;
+			}
+		}
+
+		if( (item.status != SFFS_SNLIST_ITEM_STATUS_DIRTY) && (validate_checksum(&item) == 0) ){
+			if( (entry != NULL) || index->is_complete ){
+				if( index_insert(index, &item, addr) < 0 ){
+					//the order of the entries that share the status is on the device
+					index_build(cfg);
+				}
+			} else if( index_find(index, item.serialno, item.status) != NULL ){
+				//the entry is past the end of a partial index but a lookup would now hit the wrong one
+				index_build(cfg);
+			}
+		}
+	}
+
 	return 0;
 }
 
 int sffs_serialno_append(const void * cfg, serial_t serialno, block_t new_block, int * addr, int status){
 	cl_snlist_item_t item;
 	sffs_list_t list;
+	serialno_index_t * index;
+	int dev_addr;
 	//The serial number is at the head of every block
 	sffs_debug(DEBUG_LEVEL, "append %d to sn list\n", serialno);
 	item.status = status;
@@ -433,10 +534,162 @@ int sffs_serialno_append(const void * cfg, serial_t serialno, block_t new_block,
 				  item.serialno,
 				  item.block,
 				  item.checksum);
-	return sffs_list_append(cfg,
-									&list,
-									BLOCK_TYPE_SERIALNO_LIST,
-									&item,
-									addr);
+	dev_addr = -1;
+	if( sffs_list_append(cfg,
+								&list,
+								BLOCK_TYPE_SERIALNO_LIST,
+								&item,
+								&dev_addr) < 0 ){
+		return -1;
+	}
+
+	//dev_addr is not assigned if the item is already in the list
+	if( dev_addr != -1 ){
+		if( addr != NULL ){
+			*addr = dev_addr;
+		}
+
+		//the entry is last in the list -- a partial index stays a partial index
+		index = get_index(cfg);
+		if( (index != NULL) && index->is_complete && (index_insert(index, &item, dev_addr) < 0) ){
+			index->is_complete = false;
+		}
+	}
+
+	return 0;
+}
+
+void sffs_serialno_freeindex(const void * cfg){
+	free(SFFS_STATE(cfg)->serialno_index);
+	SFFS_STATE(cfg)->serialno_index = NULL;
+}
+
+serialno_index_t * get_index(const void * cfg){
+	return SFFS_STATE(cfg)->serialno_index;
+}
+
+void index_build(const void * cfg){
+	sffs_list_t list;
+	cl_snlist_item_t item;
+	serialno_index_t * index;
+	int dev_addr;
+	int i;
+
+	sffs_serialno_freeindex(cfg);
+
+	//without the index, entries are found by scanning the list on the device
+	index = malloc(sizeof(serialno_index_t));
+	if( index == NULL ){
+		sffs_error("no memory for the serialno index\n");
+		return;
+	}
+
+	index->count = 0;
+	index->dirty = 0;
+	index->is_complete = true;
+	for(i=0; i < SFFS_SERIALNO_INDEX_SIZE; i++){
+		index->entry[i].serialno = SERIALNO_INVALID;
+	}
+
+	if ( cl_snlist_init(cfg, &list, sffs_dev_getlist_block(cfg)) < 0 ){
+		free(index);
+		return;
+	}
+
+	while( sffs_list_getnext(cfg, &list, &item, &dev_addr) == 0 ){
+		if( item.status == SFFS_SNLIST_ITEM_STATUS_DIRTY ){
+			index->dirty++;
+		} else if( validate_checksum(&item) == 0 ){
+			if( index_insert(index, &item, dev_addr) < 0 ){
+				sffs_debug(DEBUG_LEVEL, "serialno index is partial\n");
+				index->is_complete = false;
+				break;
+			}
+		}
+	}
+
+	SFFS_STATE(cfg)->serialno_index = index;
+}
+
+int index_home(serial_t serialno){
+	//serial numbers are assigned sequentially so they spread out well without mixing
+	return serialno % SFFS_SERIALNO_INDEX_SIZE;
+}
+
+int index_insert(serialno_index_t * index, cl_snlist_item_t * item, int addr){
+	int slot;
+
+	if( item->serialno == SERIALNO_INVALID ){
+		return 0; //can't be looked up
+	}
+
+	if( index->count == SERIALNO_INDEX_MAX_COUNT ){
+		return -1;
+	}
+
+	//sffs_serialno_get() returns the first entry in the list -- the index can only have one
+	if( index_find(index, item->serialno, item->status) != NULL ){
+		return -1;
+	}
+
+	slot = index_home(item->serialno);
+	while( index->entry[slot].serialno != SERIALNO_INVALID ){
+		slot = (slot + 1) % SFFS_SERIALNO_INDEX_SIZE;
+	}
+
+	index->entry[slot].serialno = item->serialno;
+	index->entry[slot].addr = addr;
+	index->entry[slot].block = item->block;
+	index->entry[slot].status = item->status;
+	index->count++;
+	return 0;
+}
+
+serialno_index_entry_t * index_find(serialno_index_t * index, serial_t serialno, uint8_t status){
+	int slot;
+	slot = index_home(serialno);
+	while( index->entry[slot].serialno != SERIALNO_INVALID ){
+		if( (index->entry[slot].serialno == serialno) && (index->entry[slot].status == status) ){
+			return index->entry + slot;
+		}
+		slot = (slot + 1) % SFFS_SERIALNO_INDEX_SIZE;
+	}
+	return NULL;
+}
+
+serialno_index_entry_t * index_find_addr(serialno_index_t * index, serial_t serialno, int addr){
+	int slot;
+	slot = index_home(serialno);
+	while( index->entry[slot].serialno != SERIALNO_INVALID ){
+		if( index->entry[slot].addr == addr ){
+			return index->entry + slot;
+		}
+		slot = (slot + 1) % SFFS_SERIALNO_INDEX_SIZE;
+	}
+	return NULL;
+}
+
+void index_remove(serialno_index_t * index, serialno_index_entry_t * entry){
+	int slot;
+	int next;
+	int home;
+
+	//shift the following entries back so lookups never hit a hole
+	slot = entry - index->entry;
+	index->entry[slot].serialno = SERIALNO_INVALID;
+	index->count--;
+	next = slot;
+	while( 1 ){
+		next = (next + 1) % SFFS_SERIALNO_INDEX_SIZE;
+		if( index->entry[next].serialno == SERIALNO_INVALID ){
+			break;
+		}
+		home = index_home(index->entry[next].serialno);
+		if( (slot <= next) ? ((home <= slot) || (home > next)) : ((home <= slot) && (home > next)) ){
+			index->entry[slot] = index->entry[next];
+			index->entry[next].serialno = SERIALNO_INVALID;
+			slot = next;
+		}
+	}
 }
 
@@ -6,6 +6,8 @@
 #ifndef SFFS_SERIALNO_H_
 #define SFFS_SERIALNO_H_
 
+#include <stdbool.h>
+
 #include "sffs_block.h"
 #include "sffs_list.h"
 #include "sffs_local.h"
@@ -52,10 +54,12 @@ block_t sffs_serialno_get(const void * cfg, serial_t serialno, uint8_t status, i
 int sffs_serialno_append(const void * cfg, serial_t serialno, block_t new_block, int * addr, int status); //appends an entry as "open"
 int sffs_serialno_setstatus(const void * cfg, int addr, uint8_t status);
 int sffs_serialno_consolidate(const void * cfg);
+int sffs_serialno_gc(const void * cfg, bool is_scan_ok); //consolidates the list if it is mostly dirty and no files are open
 int sffs_serialno_mkfs(const void * cfg);
 block_t sffs_serialno_getlistblock(const void * cfg);
 int sffs_serialno_isfree(void * data);
 int sffs_serialno_scan(serial_t * serialno);
+void sffs_serialno_freeindex(const void * cfg);
 
 static inline int cl_snlist_init(const void * cfg, sffs_list_t * list, block_t list_block){
 	return sffs_list_init(cfg, list, list_block, sizeof(cl_snlist_item_t), sffs_serialno_isfree);
@@ -0,0 +1,130 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+//RAM flash that stands in for sffs_dev.c -- bits can only be cleared until the section is erased
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <sys/sffs/sffs_dev.h>
+#include "dev.h"
+
+//serial NOR timing: 4 KB section erase, 256 byte page program, 40 MHz reads
+#define ERASE_US 45000
+#define PAGE_PROGRAM_US 700
+#define PAGE_SIZE 256
+#define READ_BYTES_PER_US 5
+
+static char mem[SIM_DEV_SIZE];
+
+int sim_dev_read_count; //number of reads for benchmarks
+int sim_dev_write_count; //number of writes for benchmarks
+int sim_dev_erase_count; //number of section erases for benchmarks
+u64 sim_dev_time_us; //time the device was busy
+int sim_dev_erase_sleep_us; //real time a section erase takes (for the gc thread)
+
+static void check_open(const void * cfg, const char * operation){
+	if( SFFS_CONFIG(cfg)->drive.state->file.handle == NULL ){
+		printf("dev: %s after the device was closed\n", operation);
+		exit(1);
+	}
+}
+
+int sffs_dev_getlist_block(const void * cfg){
+	return SFFS_STATE(cfg)->list_block;
+}
+
+void sffs_dev_setlist_block(const void * cfg, int list_block){
+	SFFS_STATE(cfg)->list_block = list_block;
+}
+
+int sffs_dev_getserialno(const void * cfg){
+	return SFFS_STATE(cfg)->serialno;
+}
+
+void sffs_dev_setserialno(const void * cfg, int serialno){
+	SFFS_STATE(cfg)->serialno = serialno;
+}
+
+void sffs_dev_setdelay_mutex(pthread_mutex_t * mutex){
+	//no scheduler to tell
+}
+
+int sffs_dev_open(const void * cfg){
+	drive_info_t * info = &(SFFS_STATE(cfg)->dattr);
+	memset(info, 0, sizeof(drive_info_t));
+	info->write_block_size = 1;
+	info->num_write_blocks = SIM_DEV_SIZE;
+	info->erase_block_size = SIM_DEV_ERASE_SIZE;
+	info->erase_block_time = ERASE_US;
+	info->page_program_size = PAGE_SIZE;
+
+	//sffs_ismounted() checks the handle
+	SFFS_CONFIG(cfg)->drive.state->file.handle = mem;
+	return 0;
+}
+
+int sffs_dev_close(const void * cfg){
+	SFFS_CONFIG(cfg)->drive.state->file.handle = NULL;
+	return 0;
+}
+
+int sffs_dev_write(const void * cfg, int loc, const void * buf, int nbyte){
+	int i;
+	unsigned char dest;
+	unsigned char src;
+	const unsigned char * chbuf;
+
+	check_open(cfg, "write");
+	sim_dev_write_count++;
+	if ( (loc < 0) || (loc + nbyte > SIM_DEV_SIZE) ){
+		printf("dev: write of %d bytes at 0x%X is past the end\n", nbyte, loc);
+		exit(1);
+	}
+
+	//make sure the memory is writeable
+	chbuf = (const unsigned char *)buf;
+	for(i=0; i < nbyte; i++){
+		dest = mem[loc + i];
+		src = chbuf[i];
+		if ( (dest | src) != dest ){
+			printf("dev: bad write 0x%X cannot be written over 0x%X at 0x%X\n", src, dest, loc + i);
+			exit(1);
+		}
+		mem[loc + i] = src;
+	}
+
+	sim_dev_time_us += (((loc % PAGE_SIZE) + nbyte + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_PROGRAM_US;
+	return nbyte;
+}
+
+int sffs_dev_read(const void * cfg, int loc, void * buf, int nbyte){
+	check_open(cfg, "read");
+	sim_dev_read_count++;
+	if ( (loc < 0) || (loc + nbyte > SIM_DEV_SIZE) ){
+		printf("dev: read of %d bytes at 0x%X is past the end\n", nbyte, loc);
+		exit(1);
+	}
+	memcpy(buf, &(mem[loc]), nbyte);
+	sim_dev_time_us += 1 + nbyte / READ_BYTES_PER_US;
+	return nbyte;
+}
+
+int sffs_dev_erase(const void * cfg){
+	check_open(cfg, "erase");
+	memset(mem, 0xFF, SIM_DEV_SIZE);
+	return 0;
+}
+
+int sffs_dev_erasesection(const void * cfg, int loc){
+	if( sim_dev_erase_sleep_us ){
+		usleep(sim_dev_erase_sleep_us);
+	}
+	//the device must still be open when the erase finishes
+	check_open(cfg, "section erase");
+	sim_dev_erase_count++;
+	memset(&(mem[loc & ~(SIM_DEV_ERASE_SIZE-1)]), 0xFF, SIM_DEV_ERASE_SIZE);
+	sim_dev_time_us += ERASE_US;
+	return 0;
+}
@@ -0,0 +1,17 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#ifndef SIM_DEV_H_
+#define SIM_DEV_H_
+
+#include <sdk/types.h>
+
+#define SIM_DEV_SIZE (1024*1024)
+#define SIM_DEV_ERASE_SIZE 4096
+
+extern int sim_dev_read_count;
+extern int sim_dev_write_count;
+extern int sim_dev_erase_count;
+extern u64 sim_dev_time_us;
+extern int sim_dev_erase_sleep_us;
+
+#endif /* SIM_DEV_H_ */
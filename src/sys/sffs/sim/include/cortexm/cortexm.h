@@ -0,0 +1,14 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// host build stand-in for the service call used by the sffs file callbacks
+
+#ifndef SIM_CORTEXM_CORTEXM_H_
+#define SIM_CORTEXM_CORTEXM_H_
+
+typedef void (*cortexm_svcall_t)(void *);
+
+#define CORTEXM_SVCALL_ENTER()
+
+static inline void cortexm_svcall(cortexm_svcall_t call, void *args) { call(args); }
+
+#endif /* SIM_CORTEXM_CORTEXM_H_ */
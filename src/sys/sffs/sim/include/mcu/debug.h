@@ -0,0 +1,14 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// the simulated filesystem doesn't log
+
+#ifndef SIM_MCU_DEBUG_H_
+#define SIM_MCU_DEBUG_H_
+
+#define MCU_DEBUG_FILESYSTEM 0
+
+#define mcu_debug_log_error(...)
+#define mcu_debug_log_warning(...)
+#define mcu_debug_log_info(...)
+
+#endif /* SIM_MCU_DEBUG_H_ */
@@ -0,0 +1,10 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// the simulated filesystem doesn't log
+
+#ifndef SIM_SOS_DEBUG_H_
+#define SIM_SOS_DEBUG_H_
+
+#include "mcu/debug.h"
+
+#endif /* SIM_SOS_DEBUG_H_ */
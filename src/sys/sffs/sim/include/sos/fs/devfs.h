@@ -0,0 +1,35 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// host build stand-in for the asynchronous operation sffs keeps in its file handles
+
+#ifndef SIM_SOS_FS_DEVFS_H_
+#define SIM_SOS_FS_DEVFS_H_
+
+#include "sos/fs/sysfs.h"
+
+typedef struct {
+  u32 o_events;
+  void *data;
+} mcu_event_t;
+
+typedef int (*mcu_callback_t)(void *context, const mcu_event_t *data);
+
+typedef struct {
+  mcu_callback_t callback;
+  void *context;
+} mcu_event_handler_t;
+
+typedef struct {
+  int tid;
+  int flags;
+  int loc;
+  union {
+    const void *buf_const;
+    void *buf;
+  };
+  int nbyte;
+  int result;
+  mcu_event_handler_t handler;
+} devfs_async_t;
+
+#endif /* SIM_SOS_FS_DEVFS_H_ */
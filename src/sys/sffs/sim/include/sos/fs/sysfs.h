@@ -0,0 +1,39 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// host build stand-in for the sysfs types and helpers used by sffs
+
+#ifndef SIM_SOS_FS_SYSFS_H_
+#define SIM_SOS_FS_SYSFS_H_
+
+#include <errno.h>
+#include <pthread.h>
+#include <sdk/types.h>
+
+#include "mcu/debug.h"
+
+#define SYSFS_SET_RETURN(error_number) (-1 * (error_number | (__LINE__ << 8)))
+#define SYSFS_GET_RETURN_ERRNO(value) ((-1 * value) & 0xff)
+
+typedef struct {
+  const void *fs;
+  void *handle;
+  int flags;
+  int loc;
+} sysfs_file_t;
+
+typedef struct {
+  sysfs_file_t file;
+  pthread_mutex_t mutex;
+} sysfs_shared_state_t;
+
+typedef struct {
+  const void *devfs;
+  const char *name;
+  sysfs_shared_state_t *state;
+} sysfs_shared_config_t;
+
+int sysfs_getamode(int flags);
+const char *sysfs_getfilename(const char *path, int *elements);
+int pthread_mutex_force_unlock(pthread_mutex_t *mutex);
+
+#endif /* SIM_SOS_FS_SYSFS_H_ */
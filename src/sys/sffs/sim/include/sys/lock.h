@@ -0,0 +1,10 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+// host build stand-in for the newlib lock header -- sffs uses pthread mutexes
+
+#ifndef SIM_SYS_LOCK_H_
+#define SIM_SYS_LOCK_H_
+
+#include <pthread.h>
+
+#endif /* SIM_SYS_LOCK_H_ */
@@ -0,0 +1,633 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "sos/fs/sffs.h"
+#include "sffs_block.h"
+#include "sffs_file.h"
+#include "sffs_diag.h"
+#include "dev.h"
+#include "tests.h"
+
+#define MAP_FILES 6
+#define MAP_FILE_SIZE (24*1024)
+#define MAP_ROUNDS 600
+#define SEGMENT_MAP_SIZE 512 //SFFS_SEGMENT_MAP_SIZE in sffs_file.c
+#define SEGMENT_FILE_SIZE (160*1024)
+#define SEGMENT_ROUNDS 1500
+#define RUN_MAX 8 //SFFS_FILE_RUN_MAX in sffs_file.c
+#define RUN_FILE_SIZE (64*1024)
+#define RUN_FILES 3
+#define RUN_ROUNDS 300
+#define GUARD 64
+#define GC_RESERVE 64
+#define GC_FILES 4
+#define GC_FILE_SIZE (12*1024)
+#define GC_ROUNDS 400
+#define GC_UNMOUNT_TRIALS 20
+#define GC_THREAD_RESERVE 2048 //half the device so the thread is usually erasing
+
+static int failures;
+
+#define CHECK(x) do { \
+	if( !(x) ){ \
+		printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #x); \
+		failures++; \
+		return; \
+	} \
+} while(0)
+
+static sffs_state_t state;
+static const sffs_config_t config = {
+		.drive = { .name = "disk", .state = &state.drive }
+};
+static sffs_state_t gc_state;
+static const sffs_config_t gc_config = {
+		.drive = { .name = "disk", .state = &gc_state.drive },
+		.gc_reserve = GC_THREAD_RESERVE,
+		.gc_interval = 1
+};
+static const void * cfg = &config;
+
+int sysfs_getamode(int flags){
+	int amode = 0;
+	if( (flags & O_ACCMODE) != O_WRONLY ){
+		amode |= R_OK;
+	}
+	if( (flags & O_ACCMODE) != O_RDONLY ){
+		amode |= W_OK;
+	}
+	return amode;
+}
+
+const char * sysfs_getfilename(const char * path, int * elements){
+	const char * name = strrchr(path, '/');
+	return name ? name + 1 : path;
+}
+
+int pthread_mutex_force_unlock(pthread_mutex_t * mutex){
+	return 0;
+}
+
+//sysfs passes the errno encoded in the result on to the caller
+static int get_result(int result){
+	if( result < 0 ){
+		errno = SYSFS_GET_RETURN_ERRNO(result);
+		return -1;
+	}
+	return result;
+}
+
+void * test_open(const char * path, int flags, int mode){
+	void * handle;
+	if ( get_result(sffs_open(cfg, &handle, path, flags, mode)) < 0 ){
+		return NULL;
+	}
+	return handle;
+}
+
+int test_close(void * handle){
+	return get_result(sffs_close(cfg, &handle));
+}
+
+int test_read(void * handle, int loc, void * buf, int nbyte){
+	return get_result(sffs_read(cfg, handle, 0, loc, buf, nbyte));
+}
+
+int test_write(void * handle, int loc, const void * buf, int nbyte){
+	return get_result(sffs_write(cfg, handle, 0, loc, buf, nbyte));
+}
+
+void * test_opendir(const char * path){
+	void * handle;
+	if ( get_result(sffs_opendir(cfg, &handle, path)) < 0 ){
+		return NULL;
+	}
+	return handle;
+}
+
+int test_readdir_r(void * handle, int loc, struct dirent * entry){
+	return get_result(sffs_readdir_r(cfg, handle, loc, entry));
+}
+
+int test_closedir(void * handle){
+	return get_result(sffs_closedir(cfg, &handle));
+}
+
+int test_fstat(void * handle, struct stat * stat){
+	return get_result(sffs_fstat(cfg, handle, stat));
+}
+
+int test_remove(const char * path){
+	return get_result(sffs_remove(cfg, path));
+}
+
+int test_unlink(const char * path){
+	return get_result(sffs_unlink(cfg, path));
+}
+
+int test_stat(const char * path, struct stat * stat){
+	return get_result(sffs_stat(cfg, path, stat));
+}
+
+int test_gc(int reserve){
+	return sffs_gc(cfg, reserve);
+}
+
+static void format(){
+	sffs_dev_open(cfg);
+	if( (sffs_mkfs(cfg) < 0) || (sffs_init(cfg) < 0) ){
+		printf("failed to format the device\n");
+		exit(1);
+	}
+}
+
+static void fill(char * buffer, int nbyte){
+	int i;
+	for(i=0; i < nbyte; i++){
+		buffer[i] = rand();
+	}
+}
+
+//files rewritten, appended and unlinked until the device wraps -- the block map matches the headers
+static void test_block_map(){
+	static char shadow[MAP_FILES][MAP_FILE_SIZE];
+	static char buffer[MAP_FILE_SIZE];
+	int size[MAP_FILES] = {0};
+	char name[16];
+	void * handle;
+	struct stat st;
+	int round;
+	int erases;
+	int f;
+	int i;
+
+	format();
+	CHECK(sffs_block_checkmap(cfg) == 0);
+
+	erases = sim_dev_erase_count;
+	for(round=0; round < MAP_ROUNDS; round++){
+		f = rand() % MAP_FILES;
+		sprintf(name, "map%d", f);
+		switch(rand() % 4){
+			case 0:
+				//rewrite
+				size[f] = 1 + rand() % MAP_FILE_SIZE;
+				fill(shadow[f], size[f]);
+				handle = test_open(name, O_RDWR | O_CREAT | O_TRUNC, 0666);
+				CHECK(handle != NULL);
+				CHECK(test_write(handle, 0, shadow[f], size[f]) == size[f]);
+				CHECK(test_close(handle) == 0);
+				break;
+			case 1:
+				//append
+				i = rand() % (MAP_FILE_SIZE - size[f] + 1);
+				fill(shadow[f] + size[f], i);
+				handle = test_open(name, O_RDWR | O_CREAT, 0666);
+				CHECK(handle != NULL);
+				CHECK(test_write(handle, size[f], shadow[f] + size[f], i) == i);
+				CHECK(test_close(handle) == 0);
+				size[f] += i;
+				break;
+			case 2:
+				if( size[f] ){
+					CHECK(test_unlink(name) == 0);
+					size[f] = 0;
+				}
+				break;
+			case 3:
+				if( size[f] ){
+					handle = test_open(name, O_RDONLY, 0);
+					CHECK(handle != NULL);
+					CHECK(test_read(handle, 0, buffer, MAP_FILE_SIZE) == size[f]);
+					CHECK(memcmp(buffer, shadow[f], size[f]) == 0);
+					CHECK(test_close(handle) == 0);
+				}
+				break;
+		}
+		CHECK(sffs_block_checkmap(cfg) == 0);
+	}
+	CHECK(sim_dev_erase_count > erases);
+
+	//the map built at mount agrees with the files
+	CHECK(sffs_init(cfg) == 0);
+	CHECK(sffs_block_checkmap(cfg) == 0);
+	for(f=0; f < MAP_FILES; f++){
+		sprintf(name, "map%d", f);
+		if( size[f] ){
+			CHECK(test_stat(name, &st) == 0);
+			CHECK(st.st_size == size[f]);
+		} else {
+			CHECK(test_stat(name, &st) < 0);
+		}
+	}
+}
+
+//one handle seeks, extends the file (past the segments the map holds) and is reopened with
+//O_TRUNC -- the cached segment map always matches the file list
+static void test_segment_map(){
+	static char shadow[SEGMENT_FILE_SIZE];
+	static char buffer[SEGMENT_FILE_SIZE];
+	void * handle;
+	struct stat st;
+	int size;
+	int round;
+	int max_size;
+	int loc;
+	int nbyte;
+	int expected;
+
+	format();
+	handle = test_open("segments", O_RDWR | O_CREAT, 0666);
+	CHECK(handle != NULL);
+	size = 0;
+	max_size = 0;
+	for(round=0; round < SEGMENT_ROUNDS; round++){
+		switch(rand() % 8){
+			case 0:
+				//truncate -- mostly once the file is past the map
+				if( (size < SEGMENT_MAP_SIZE*BLOCK_DATA_SIZE) && (rand() % 16) ){
+					break;
+				}
+				CHECK(test_close(handle) == 0);
+				handle = test_open("segments", O_RDWR | O_TRUNC, 0666);
+				CHECK(handle != NULL);
+				memset(shadow, 0, size);
+				size = 0;
+				break;
+			case 1:
+				//reopen -- the map is built from the list again
+				CHECK(test_close(handle) == 0);
+				handle = test_open("segments", O_RDWR, 0666);
+				CHECK(handle != NULL);
+				break;
+			case 2:
+				//a file can't have a hole
+				errno = 0;
+				CHECK(test_write(handle, size + 1 + rand() % 1000, buffer, 10) < 0);
+				CHECK(errno == EINVAL);
+				break;
+			case 3:
+			case 4:
+				//write anywhere including across the end
+				loc = rand() % 4 ? size : rand() % (size + 1);
+				nbyte = 1 + rand() % (rand() % 4 ? 600 : 20000);
+				if( loc + nbyte > SEGMENT_FILE_SIZE ){
+					nbyte = SEGMENT_FILE_SIZE - loc;
+				}
+				fill(shadow + loc, nbyte);
+				CHECK(test_write(handle, loc, shadow + loc, nbyte) == nbyte);
+				if( loc + nbyte > size ){
+					size = loc + nbyte;
+				}
+				if( size > max_size ){
+					max_size = size;
+				}
+				break;
+			default:
+				//read from anywhere including past the end
+				loc = rand() % (size + 100);
+				nbyte = 1 + rand() % 4000;
+				expected = nbyte;
+				if( loc + nbyte > size ){
+					expected = loc < size ? size - loc : 0;
+				}
+				CHECK(test_read(handle, loc, buffer, nbyte) == expected);
+				CHECK(memcmp(buffer, shadow + loc, expected) == 0);
+				break;
+		}
+		CHECK(sffs_file_checkmap(cfg, handle) == 0);
+	}
+	CHECK(max_size > SEGMENT_MAP_SIZE*BLOCK_DATA_SIZE);
+
+	CHECK(test_read(handle, 0, buffer, SEGMENT_FILE_SIZE) == size);
+	CHECK(memcmp(buffer, shadow, size) == 0);
+	CHECK(sffs_file_checkmap(cfg, handle) == 0);
+	CHECK(test_close(handle) == 0);
+	CHECK(test_stat("segments", &st) == 0);
+	CHECK(st.st_size == size);
+}
+
+//reads nbyte at loc between two guards -- the runs are read straight into the buffer
+static int read_guarded(void * handle, int loc, char * buffer, int nbyte){
+	int result;
+	int i;
+	memset(buffer, 0x5A, nbyte + 2*GUARD);
+	result = test_read(handle, loc, buffer + GUARD, nbyte);
+	for(i=0; i < GUARD; i++){
+		if( (buffer[i] != 0x5A) || (buffer[GUARD + nbyte + i] != 0x5A) ){
+			printf("read of %d bytes at %d wrote outside the buffer\n", nbyte, loc);
+			return -2;
+		}
+	}
+	return result;
+}
+
+//reads and writes that start and end on, just before and just after segment boundaries with
+//runs shorter than, equal to and longer than RUN_MAX
+static void test_run_boundaries(){
+	static char shadow[RUN_FILE_SIZE];
+	static char buffer[RUN_FILE_SIZE + 2*GUARD];
+	const int locs[] = {
+		0, 1, BLOCK_DATA_SIZE - 1, BLOCK_DATA_SIZE, BLOCK_DATA_SIZE + 1,
+		3*BLOCK_DATA_SIZE - 1, 3*BLOCK_DATA_SIZE, 3*BLOCK_DATA_SIZE + 1 };
+	const int lengths[] = {
+		1, BLOCK_DATA_SIZE - 1, BLOCK_DATA_SIZE, BLOCK_DATA_SIZE + 1, 2*BLOCK_DATA_SIZE,
+		RUN_MAX*BLOCK_DATA_SIZE - 1, RUN_MAX*BLOCK_DATA_SIZE, RUN_MAX*BLOCK_DATA_SIZE + 1,
+		(RUN_MAX + 3)*BLOCK_DATA_SIZE + 7 };
+	const int size = 40*BLOCK_DATA_SIZE;
+	void * handle;
+	int loc;
+	int nbyte;
+	int i;
+	int j;
+
+	format();
+	fill(shadow, size);
+	handle = test_open("runs", O_RDWR | O_CREAT, 0666);
+	CHECK(handle != NULL);
+	CHECK(test_write(handle, 0, shadow, size) == size);
+	CHECK(test_close(handle) == 0);
+
+	for(i=0; i < (int)(sizeof(locs)/sizeof(int)); i++){
+		for(j=0; j < (int)(sizeof(lengths)/sizeof(int)); j++){
+			loc = locs[i];
+			nbyte = lengths[j];
+
+			handle = test_open("runs", O_RDWR, 0666);
+			CHECK(handle != NULL);
+			CHECK(read_guarded(handle, loc, buffer, nbyte) == nbyte);
+			CHECK(memcmp(buffer + GUARD, shadow + loc, nbyte) == 0);
+
+			fill(shadow + loc, nbyte);
+			CHECK(test_write(handle, loc, shadow + loc, nbyte) == nbyte);
+			CHECK(read_guarded(handle, loc, buffer, nbyte) == nbyte);
+			CHECK(memcmp(buffer + GUARD, shadow + loc, nbyte) == 0);
+			CHECK(test_close(handle) == 0);
+
+			//the segments around the ones written are intact
+			handle = test_open("runs", O_RDONLY, 0);
+			CHECK(handle != NULL);
+			CHECK(read_guarded(handle, 0, buffer, size) == size);
+			CHECK(memcmp(buffer + GUARD, shadow, size) == 0);
+			CHECK(test_close(handle) == 0);
+		}
+	}
+	CHECK(sffs_block_checkmap(cfg) == 0);
+}
+
+//random reads and writes of any length at any offset in files whose blocks are interleaved
+//(so runs break up) against a copy of each file -- the device wraps and sections are erased
+static void test_run_fuzz(){
+	static char shadow[RUN_FILES][RUN_FILE_SIZE];
+	static char buffer[RUN_FILE_SIZE + 2*GUARD];
+	int size[RUN_FILES] = {0};
+	char name[16];
+	void * handle;
+	int round;
+	int count;
+	int erases;
+	int loc;
+	int nbyte;
+	int expected;
+	int f;
+
+	format();
+	erases = sim_dev_erase_count;
+	for(round=0; round < RUN_ROUNDS; round++){
+		f = rand() % RUN_FILES;
+		sprintf(name, "run%d", f);
+		if( rand() % 32 == 0 ){
+			if( size[f] ){
+				CHECK(test_unlink(name) == 0);
+				size[f] = 0;
+			}
+			continue;
+		}
+
+		handle = test_open(name, O_RDWR | O_CREAT, 0666);
+		CHECK(handle != NULL);
+		for(count = 1 + rand() % 8; count > 0; count--){
+			loc = rand() % (size[f] + 1);
+			nbyte = 1 + rand() % (rand() % 4 ? 3*BLOCK_DATA_SIZE : 12000);
+			if( rand() % 2 ){
+				if( loc + nbyte > RUN_FILE_SIZE ){
+					nbyte = RUN_FILE_SIZE - loc;
+				}
+				fill(shadow[f] + loc, nbyte);
+				CHECK(test_write(handle, loc, shadow[f] + loc, nbyte) == nbyte);
+				if( loc + nbyte > size[f] ){
+					size[f] = loc + nbyte;
+				}
+			} else {
+				expected = loc + nbyte > size[f] ? size[f] - loc : nbyte;
+				CHECK(read_guarded(handle, loc, buffer, nbyte) == expected);
+				CHECK(memcmp(buffer + GUARD, shadow[f] + loc, expected) == 0);
+			}
+		}
+		CHECK(test_close(handle) == 0);
+	}
+	CHECK(sim_dev_erase_count > erases);
+	CHECK(sffs_block_checkmap(cfg) == 0);
+
+	//everything is still there after a remount
+	CHECK(sffs_init(cfg) == 0);
+	for(f=0; f < RUN_FILES; f++){
+		sprintf(name, "run%d", f);
+		handle = test_open(name, O_RDONLY, 0);
+		CHECK((handle != NULL) || (size[f] == 0));
+		if( handle != NULL ){
+			CHECK(read_guarded(handle, 0, buffer, RUN_FILE_SIZE) == size[f]);
+			CHECK(memcmp(buffer + GUARD, shadow[f], size[f]) == 0);
+			CHECK(test_close(handle) == 0);
+		}
+	}
+}
+
+static int rewrite(const char * name, const char * data, int nbyte){
+	void * handle;
+	int ret;
+	handle = test_open(name, O_RDWR | O_CREAT | O_TRUNC, 0666);
+	if( handle == NULL ){
+		return -1;
+	}
+	ret = test_write(handle, 0, data, nbyte);
+	if( test_close(handle) < 0 ){
+		return -1;
+	}
+	return ret;
+}
+
+static int verify(const char * name, const char * data, int nbyte){
+	static char buffer[GC_FILE_SIZE];
+	void * handle;
+	int ret;
+	handle = test_open(name, O_RDONLY, 0);
+	if( handle == NULL ){
+		return -1;
+	}
+	ret = test_read(handle, 0, buffer, GC_FILE_SIZE);
+	test_close(handle);
+	if( (ret != nbyte) || memcmp(buffer, data, nbyte) ){
+		return -1;
+	}
+	return 0;
+}
+
+//gc slices between rewrites keep the reserve of erased blocks -- writes never erase inline
+static void test_gc_reserve(){
+	static char shadow[GC_FILES][GC_FILE_SIZE];
+	sffs_diag_t diag;
+	char name[16];
+	int round;
+	int erases;
+	int inline_erases;
+	int reserve;
+	int ret;
+	int f;
+
+	//without gc the writes wrap the device and a few of them erase everything that is dirty
+	for(reserve=0; reserve <= GC_RESERVE; reserve += GC_RESERVE){
+		format();
+		inline_erases = 0;
+		for(round=0; round < GC_ROUNDS; round++){
+			f = round % GC_FILES;
+			sprintf(name, "gc%d", f);
+			fill(shadow[f], GC_FILE_SIZE);
+
+			erases = sim_dev_erase_count;
+			CHECK(rewrite(name, shadow[f], GC_FILE_SIZE) == GC_FILE_SIZE);
+			if( sim_dev_erase_count != erases ){
+				inline_erases++;
+			}
+
+			if( reserve ){
+				while( (ret = test_gc(reserve)) == 1 ){
+					;
+				}
+				CHECK(ret == 0);
+				CHECK(sffs_diag_get(cfg, &diag) == 0);
+				CHECK(diag.free_blocks >= reserve);
+				CHECK(sffs_block_checkmap(cfg) == 0);
+			}
+		}
+
+		for(f=0; f < GC_FILES; f++){
+			sprintf(name, "gc%d", f);
+			CHECK(verify(name, shadow[f], GC_FILE_SIZE) == 0);
+		}
+
+		if( reserve ){
+			CHECK(inline_erases == 0);
+		} else {
+			CHECK(inline_erases > 0);
+		}
+	}
+}
+
+//the gc thread erases (slowly) while the filesystem is written and unmounted --
+//unmount waits for the thread and the device is never touched once it is closed
+static void test_gc_unmount(){
+	static char shadow[GC_FILES][GC_FILE_SIZE];
+	char name[16];
+	int trial;
+	int round;
+	int erases;
+	int f;
+
+	cfg = &gc_config;
+	sim_dev_erase_sleep_us = 0;
+	format();
+	CHECK(gc_state.is_gc_running);
+	for(f=0; f < GC_FILES; f++){
+		sprintf(name, "gc%d", f);
+		fill(shadow[f], GC_FILE_SIZE);
+		CHECK(rewrite(name, shadow[f], GC_FILE_SIZE) == GC_FILE_SIZE);
+	}
+
+	erases = sim_dev_erase_count;
+	for(trial=0; trial < GC_UNMOUNT_TRIALS; trial++){
+		sim_dev_erase_sleep_us = 200;
+		for(round=0; round < GC_FILES * 4; round++){
+			f = rand() % GC_FILES;
+			sprintf(name, "gc%d", f);
+			fill(shadow[f], GC_FILE_SIZE);
+			CHECK(rewrite(name, shadow[f], GC_FILE_SIZE) == GC_FILE_SIZE);
+		}
+
+		//unmount at a random point of the thread's cycle (often while it is erasing)
+		if( rand() & 1 ){
+			usleep(rand() % 2000);
+		}
+		CHECK(sffs_unmount(cfg) == 0);
+		CHECK(gc_state.is_gc_running == 0);
+		CHECK(sffs_ismounted(cfg) == 0);
+		CHECK(gc_state.block_map == NULL);
+		usleep(5000);
+
+		//dev.c exits if the thread used the device after it was closed
+		sim_dev_erase_sleep_us = 0;
+		sffs_dev_open(cfg);
+		CHECK(sffs_init(cfg) == 0);
+		CHECK(gc_state.is_gc_running);
+		CHECK(sffs_block_checkmap(cfg) == 0);
+		for(f=0; f < GC_FILES; f++){
+			sprintf(name, "gc%d", f);
+			CHECK(verify(name, shadow[f], GC_FILE_SIZE) == 0);
+		}
+	}
+	CHECK(sim_dev_erase_count > erases);
+
+	CHECK(sffs_unmount(cfg) == 0);
+	CHECK(gc_state.is_gc_running == 0);
+	cfg = &config;
+}
+
+//write latency with and without the gc reserve, the append benchmark with and without the block map
+static void bench(){
+	format();
+	test_bench_gc("gc.txt", 0);
+
+	format();
+	test_bench_gc("gc.txt", GC_RESERVE);
+
+	format();
+	printf("bench: with the block map: ");
+	fflush(stdout);
+	test_bench_append("bench.txt");
+
+	sffs_block_freemap(cfg);
+	printf("bench: scanning headers:   ");
+	fflush(stdout);
+	test_bench_append("bench.txt");
+	sffs_block_initmap(cfg);
+}
+
+int main(){
+	srand(1);
+
+	format();
+	if( test_file() < 0 ){
+		printf("%s:%d: test_file() failed\n", __FILE__, __LINE__);
+		failures++;
+	}
+	test_block_map();
+	test_segment_map();
+	test_run_boundaries();
+	test_run_fuzz();
+	test_gc_reserve();
+	test_gc_unmount();
+
+	if( failures ){
+		printf("FAILED (%d)\n", failures);
+		return 1;
+	}
+	bench();
+	printf("PASSED\n");
+	return 0;
+}
@@ -0,0 +1,386 @@
+// Copyright 2011-2021 Tyler Gilbert and Stratify Labs, Inc; see LICENSE.md
+
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/sffs/sffs_diag.h>
+
+#include "sos/fs/sffs.h"
+#include "dev.h"
+#include "tests.h"
+
+#define NUM_DIR_TESTS 5
+#define NUM_RW_TESTS 26
+#define NUM_LONG_RW_TESTS 5
+
+#define BUFFER_SIZE 16
+#define LONG_BUFFER_SIZE 1024
+
+#define NUM_BENCH_APPENDS 64
+#define NUM_BENCH_READ_PASSES 4
+
+#define LARGE_BUFFER_SIZE 8192
+#define NUM_BENCH_LARGE 16
+
+#define NUM_BENCH_GC_WRITES 4000
+#define NUM_BENCH_GC_SEGMENTS 32
+#define BENCH_GC_RESERVE 64
+
+
+
+int test_run(bool file_test, bool dir_test, bool bench_test){
+
+	if( file_test == true ){
+		if ( test_file() < 0 ){
+			printf("File test failed\n");
+			return -1;
+		}
+	}
+
+	if( dir_test == true ){
+		if ( test_file() < 0 ){
+			printf("Dir test failed\n");
+			return -1;
+		}
+	}
+
+	if( bench_test == true ){
+		if ( test_bench_append("bench.txt") < 0 ){
+			printf("Bench test failed\n");
+			return -1;
+		}
+
+		if ( test_bench_read("bench.txt") < 0 ){
+			printf("Read bench test failed\n");
+			return -1;
+		}
+
+		if ( test_bench_large("bench.txt") < 0 ){
+			printf("Large file bench test failed\n");
+			return -1;
+		}
+
+		if ( test_bench_gc("bench.txt", 0) < 0 ){
+			printf("GC bench test failed\n");
+			return -1;
+		}
+
+		if ( test_bench_gc("bench.txt", BENCH_GC_RESERVE) < 0 ){
+			printf("GC bench test failed\n");
+			return -1;
+		}
+	}
+
+	return 0;
+
+}
+
+
+int test_dir(){
+	struct dirent entry;
+	void * handle;
+	int i;
+	char buffer[64];
+
+
+	if ( (handle = test_opendir("")) == NULL ){
+		printf("failed to opendir()\n");
+		return -1;
+	}
+
+	i = 0;
+	while( test_readdir_r(handle, i, &entry) == 0 ){
+		sprintf(buffer, "test%d", i);
+		printf("dir: %d %s\n", (int)entry.d_ino, entry.d_name);
+		if ( strcmp(buffer, entry.d_name) != 0 ){
+			printf("Unexpected directory entry %s\n", entry.d_name);
+		}
+		i++;
+	}
+
+	if ( test_readdir_r(handle, i, &entry) == 0 ){
+		printf("Failed to remove all directories\n");
+	}
+
+
+	if ( test_closedir(handle) ){
+		return -1;
+	}
+
+	return 0;
+}
+
+
+
+int test_listdir(const char * path){
+	void * handle;
+	struct dirent entry;
+	int i;
+	if ( (handle = test_opendir(path)) == NULL ){
+		printf("failed to opendir()\n");
+		return -1;
+	}
+
+	i = 0;
+	while( test_readdir_r(handle, i, &entry) == 0 ){
+		printf("dir: %d %s\n", (int)entry.d_ino, entry.d_name);
+		i++;
+	}
+
+	test_closedir(&handle);
+	return 0;
+
+}
+
+
+
+int test_bench_append(const char * file){
+	void * handle;
+	char buffer[LONG_BUFFER_SIZE];
+	int i;
+	int reads;
+	int max_reads;
+	int total_reads;
+
+	if ( (handle = test_open(file, O_RDWR | O_CREAT | O_TRUNC, 0666)) == NULL ){
+		printf("failed to open %s\n", file);
+		return -1;
+	}
+
+	memset(buffer, 0xAA, LONG_BUFFER_SIZE);
+	max_reads = 0;
+	total_reads = 0;
+	for(i=0; i < NUM_BENCH_APPENDS; i++){
+		//each append allocates new blocks -- count the device reads it takes
+		reads = sim_dev_read_count;
+		if ( test_write(handle, i*LONG_BUFFER_SIZE, buffer, LONG_BUFFER_SIZE) != LONG_BUFFER_SIZE ){
+			printf("failed to append to %s (%d)\n", file, i);
+			test_close(handle);
+			return -1;
+		}
+		reads = sim_dev_read_count - reads;
+		total_reads += reads;
+		if( reads > max_reads ){
+			max_reads = reads;
+		}
+	}
+
+	printf("%d appends of %d bytes: %d device reads per append (max %d)\n",
+			 NUM_BENCH_APPENDS, LONG_BUFFER_SIZE, total_reads / NUM_BENCH_APPENDS, max_reads);
+
+	if ( test_close(handle) < 0 ){
+		return -1;
+	}
+
+	return test_unlink(file);
+}
+
+int test_bench_read(const char * file){
+	void * handle;
+	char buffer[LONG_BUFFER_SIZE];
+	char expected[LONG_BUFFER_SIZE];
+	int i;
+	int pass;
+	int loc;
+	int reads;
+	clock_t start;
+	double seconds;
+
+	if ( (handle = test_open(file, O_RDWR | O_CREAT | O_TRUNC, 0666)) == NULL ){
+		printf("failed to open %s\n", file);
+		return -1;
+	}
+
+	for(i=0; i < NUM_BENCH_APPENDS; i++){
+		memset(buffer, i, LONG_BUFFER_SIZE);
+		if ( test_write(handle, i*LONG_BUFFER_SIZE, buffer, LONG_BUFFER_SIZE) != LONG_BUFFER_SIZE ){
+			printf("failed to write %s (%d)\n", file, i);
+			test_close(handle);
+			return -1;
+		}
+	}
+
+	if ( test_close(handle) < 0 ){
+		return -1;
+	}
+
+	//read the whole file a few times like a log reader would
+	if ( (handle = test_open(file, O_RDONLY, 0)) == NULL ){
+		printf("failed to open %s\n", file);
+		return -1;
+	}
+
+	reads = sim_dev_read_count;
+	start = clock();
+	for(pass=0; pass < NUM_BENCH_READ_PASSES; pass++){
+		for(i=0; i < NUM_BENCH_APPENDS; i++){
+			//every other pass reads the file backwards
+			loc = (pass & 1) ? (NUM_BENCH_APPENDS - 1 - i) : i;
+			memset(expected, loc, LONG_BUFFER_SIZE);
+			if ( (test_read(handle, loc*LONG_BUFFER_SIZE, buffer, LONG_BUFFER_SIZE) != LONG_BUFFER_SIZE) ||
+				  (memcmp(buffer, expected, LONG_BUFFER_SIZE) != 0) ){
+				printf("bad read of %s at %d\n", file, loc*LONG_BUFFER_SIZE);
+				test_close(handle);
+				return -1;
+			}
+		}
+	}
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	reads = sim_dev_read_count - reads;
+
+	printf("%d reads of %d bytes: %d device reads per read, %d KB/s\n",
+			 NUM_BENCH_READ_PASSES * NUM_BENCH_APPENDS, LONG_BUFFER_SIZE,
+			 reads / (NUM_BENCH_READ_PASSES * NUM_BENCH_APPENDS),
+			 seconds > 0 ? (int)(NUM_BENCH_READ_PASSES * NUM_BENCH_APPENDS * LONG_BUFFER_SIZE / 1024 / seconds) : 0);
+
+	if ( test_close(handle) < 0 ){
+		return -1;
+	}
+
+	return test_unlink(file);
+}
+
+int test_bench_large(const char * file){
+	void * handle;
+	static char buffer[LARGE_BUFFER_SIZE];
+	static char expected[LARGE_BUFFER_SIZE];
+	int i;
+	int reads;
+	int writes;
+	clock_t start;
+	double seconds;
+
+	if ( (handle = test_open(file, O_RDWR | O_CREAT | O_TRUNC, 0666)) == NULL ){
+		printf("failed to open %s\n", file);
+		return -1;
+	}
+
+	//big writes and reads span many segments -- count the device transfers they take
+	reads = sim_dev_read_count;
+	writes = sim_dev_write_count;
+	start = clock();
+	for(i=0; i < NUM_BENCH_LARGE; i++){
+		memset(buffer, i, LARGE_BUFFER_SIZE);
+		if ( test_write(handle, i*LARGE_BUFFER_SIZE, buffer, LARGE_BUFFER_SIZE) != LARGE_BUFFER_SIZE ){
+			printf("failed to write %s (%d)\n", file, i);
+			test_close(handle);
+			return -1;
+		}
+	}
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	reads = sim_dev_read_count - reads;
+	writes = sim_dev_write_count - writes;
+
+	printf("%d writes of %d bytes: %d device reads and %d device writes per write, %d KB/s\n",
+			 NUM_BENCH_LARGE, LARGE_BUFFER_SIZE,
+			 reads / NUM_BENCH_LARGE, writes / NUM_BENCH_LARGE,
+			 seconds > 0 ? (int)(NUM_BENCH_LARGE * LARGE_BUFFER_SIZE / 1024 / seconds) : 0);
+
+	if ( test_close(handle) < 0 ){
+		return -1;
+	}
+
+	if ( (handle = test_open(file, O_RDONLY, 0)) == NULL ){
+		printf("failed to open %s\n", file);
+		return -1;
+	}
+
+	reads = sim_dev_read_count;
+	start = clock();
+	for(i=0; i < NUM_BENCH_LARGE; i++){
+		memset(expected, i, LARGE_BUFFER_SIZE);
+		if ( (test_read(handle, i*LARGE_BUFFER_SIZE, buffer, LARGE_BUFFER_SIZE) != LARGE_BUFFER_SIZE) ||
+			  (memcmp(buffer, expected, LARGE_BUFFER_SIZE) != 0) ){
+			printf("bad read of %s at %d\n", file, i*LARGE_BUFFER_SIZE);
+			test_close(handle);
+			return -1;
+		}
+	}
+	seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+	reads = sim_dev_read_count - reads;
+
+	printf("%d reads of %d bytes: %d device reads per read, %d KB/s\n",
+			 NUM_BENCH_LARGE, LARGE_BUFFER_SIZE, reads / NUM_BENCH_LARGE,
+			 seconds > 0 ? (int)(NUM_BENCH_LARGE * LARGE_BUFFER_SIZE / 1024 / seconds) : 0);
+
+	if ( test_close(handle) < 0 ){
+		return -1;
+	}
+
+	return test_unlink(file);
+}
+
+static int compare_latency(const void * a, const void * b){
+	return (*(const u32*)a > *(const u32*)b) - (*(const u32*)a < *(const u32*)b);
+}
+
+int test_bench_gc(const char * file, int reserve){
+	static u32 latency[NUM_BENCH_GC_WRITES];
+	void * handle;
+	char buffer[LONG_BUFFER_SIZE];
+	int i;
+	int loc;
+	int erases;
+	int inline_erases;
+	u64 start;
+	u64 total;
+
+	//a logger rewriting a small file wraps the device a few times so blocks must be erased
+	inline_erases = 0;
+	total = 0;
+	for(i=0; i < NUM_BENCH_GC_WRITES; i++){
+		loc = (i % NUM_BENCH_GC_SEGMENTS) * LONG_BUFFER_SIZE;
+		memset(buffer, i, LONG_BUFFER_SIZE);
+
+		//the time the device is busy while the file is opened, written and closed
+		erases = sim_dev_erase_count;
+		start = sim_dev_time_us;
+		if ( (handle = test_open(file, O_RDWR | O_CREAT, 0666)) == NULL ){
+			printf("failed to open %s\n", file);
+			return -1;
+		}
+
+		if ( test_write(handle, loc, buffer, LONG_BUFFER_SIZE) != LONG_BUFFER_SIZE ){
+			printf("failed to write %s (%d)\n", file, i);
+			test_close(handle);
+			return -1;
+		}
+
+		if ( test_close(handle) < 0 ){
+			return -1;
+		}
+		latency[i] = sim_dev_time_us - start;
+		total += latency[i];
+		if( sim_dev_erase_count != erases ){
+			inline_erases++;
+		}
+
+		//the gc thread runs its time slices between writes
+		while( (reserve > 0) && ((erases = test_gc(reserve)) == 1) ){
+			;
+		}
+
+		if( erases < 0 ){
+			printf("gc failed\n");
+			return -1;
+		}
+	}
+
+	qsort(latency, NUM_BENCH_GC_WRITES, sizeof(u32), compare_latency);
+	printf("%d writes of %d bytes (gc reserve %d): %d erased inline, %d us average, %d us p99, %d us max\n",
+			 NUM_BENCH_GC_WRITES, LONG_BUFFER_SIZE, reserve, inline_erases,
+			 (int)(total / NUM_BENCH_GC_WRITES),
+			 latency[NUM_BENCH_GC_WRITES * 99 / 100],
+			 latency[NUM_BENCH_GC_WRITES - 1]);
+
+	if( test_unlink(file) < 0 ){
+		return -1;
+	}
+	return inline_erases;
+}
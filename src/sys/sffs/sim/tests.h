@@ -9,7 +9,7 @@
 #include <sys/stat.h>
 
 
-int test_run(bool file_test, bool dir_test);
+int test_run(bool file_test, bool dir_test, bool bench_test);
 
 int test_dir();
 int test_listdir(const char * path);
@@ -19,6 +19,11 @@ int test_rw(const char * file);
 int test_rw_long(const char * file);
 int test_rw_short(const char * file);
 
+int test_bench_append(const char * file);
+int test_bench_read(const char * file);
+int test_bench_large(const char * file);
+int test_bench_gc(const char * file, int reserve);
+
 
 
 
@@ -34,6 +39,7 @@ extern int test_close(void * handle);
 extern int test_remove(const char * path);
 extern int test_unlink(const char * path);
 extern int test_stat(const char * path, struct stat * stat);
+extern int test_gc(int reserve);
 
 
 #endif /* TESTS_H_ */
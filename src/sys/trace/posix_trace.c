@@ -7,6 +7,7 @@
 #include "../scheduler/scheduler_root.h"
 #include "cortexm/mpu.h"
 #include "cortexm/task.h"
+#include "sos/pool.h"
 #include "sos/symbols.h"
 #include "trace.h"
 
@@ -15,11 +16,18 @@ typedef struct {
   void *next;
 } trace_list_t;
 
+#define TRACE_POOL_GROW_COUNT 4
+
 static trace_list_t *trace_first = 0;
+static sos_pool_t trace_pool =
+  SOS_POOL_INITIALIZER(sizeof(trace_list_t), TRACE_POOL_GROW_COUNT);
 
 static void trace_cleanup() {
   trace_list_t *entry;
-  for (entry = trace_first; entry != 0; entry = entry->next) {
+  trace_list_t *next;
+  for (entry = trace_first; entry != 0; entry = next) {
+    // shutting down the trace takes it out of the list
+    next = entry->next;
     int tid = entry->trace.tid;
     if ((task_enabled(tid) == 0) || (task_get_pid(tid) != entry->trace.pid)) {
       // delete the trace
@@ -29,31 +37,30 @@ static void trace_cleanup() {
 }
 
 static trace_id_handle_t *trace_find_free() {
-  trace_list_t *entry;
-  trace_list_t *new_entry;
-  trace_list_t *last_entry;
-  last_entry = 0;
-  for (entry = trace_first; entry != 0; entry = entry->next) {
-    last_entry = entry;
-    if (entry->trace.tid == 0) {
-      return &entry->trace;
-    }
-  }
-
-  // no free message queues
-  new_entry = _malloc_r(sos_task_table[0].global_reent, sizeof(trace_list_t));
+  trace_list_t *new_entry = sos_pool_alloc(&trace_pool);
   if (new_entry == 0) {
     return 0;
   }
+  new_entry->next = trace_first;
+  trace_first = new_entry;
+  return &new_entry->trace;
+}
 
-  if (last_entry == 0) {
-    trace_first = new_entry;
-  } else {
-    last_entry->next = new_entry;
+static void trace_delete(trace_id_handle_t *trace) {
+  trace_list_t *entry;
+  trace_list_t *last_entry = 0;
+  for (entry = trace_first; entry != 0; entry = entry->next) {
+    if (&entry->trace == trace) {
+      if (last_entry == 0) {
+        trace_first = entry->next;
+      } else {
+        last_entry->next = entry->next;
+      }
+      sos_pool_free(&trace_pool, entry);
+      return;
+    }
+    last_entry = entry;
   }
-
-  new_entry->next = 0;
-  return &new_entry->trace;
 }
 
 static trace_id_handle_t *trace_get_ptr(trace_id_t id) {
@@ -580,6 +587,7 @@ int posix_trace_shutdown(trace_id_t id) {
   cortexm_svcall(svcall_shutdown_trace_id, &args);
   mq_discard(id->mq);
   memset(id, 0, sizeof(trace_id_handle_t));
+  trace_delete(id);
   return 0;
 }
 